@@ -1,97 +1,241 @@
-#include <stdio.h>
 #include "pico/stdlib.h"
-#include "pico/rand.h"
+#include <stdio.h>
 #include <jbc_util.h>
+#include <fixed_math.h>
 #include <board.h>
 #include <operations.h>
 #include <display.h>
 #include <keypad.h>
 #include <analog_psu_ctrl.h>
+#include <settings_store.h>
+#include <heater_ctrl.h>
+#include <tip_temp.h>
+#include <temp_ctrl.h>
+#include <standby.h>
+#include <autotune.h>
+#include <power_meter.h>
+#include <telemetry.h>
+#include <profile.h>
+#include <deadline.h>
+#include <command.h>
+#include <timer_wheel.h>
+#include <rt_core.h>
+#include <events.h>
 
 #define PWR_TOTAL   IRON_MAX_WATT
 #define PSET_COUNT  MAX_TEMP_PRESETS
 #define TEMP_TOTAL  IRON_MAX_TEMP
 
-// spin here for 1 second while scanning for keypad inputs
-// and sending to the menu operations. Return after
-// 1 second.
-#define PCHK_MS_SLP_INTVAL 100
-static void poll_chk_operations(void) {
-    char key = 0;
-    uint32_t ms_intval = 0;
-    while (ms_intval < 1000) {
-        if (keypad_get(&key)) {
-            if ( ops_poll(key) ) {
-                printf("[ops_poll()] resetting operations\n");
-                ops_reset(); // silently reset state machine, ok if operation completed as well.
-            }
+// meter (tip temp, power) screen update interval, when readings arrive
+#define METER_UPDT_PD_US    100000  /* 10 Hz */
+
+static uint32_t clamp_u32(uint32_t v, uint32_t max) {
+    return (v > max) ? max : v;
+}
+
+// diagnostics screen: the hot-path profile of the last window [usec]
+static void diag_update(void) {
+    static const char * const abbr[TLM_PRF_COUNT] = {
+#define PRF_ABBR(id, name, ab)  ab,
+        TLM_PRF_IDS(PRF_ABBR)
+#undef PRF_ABBR
+    };
+    char ln[DIAG_LINE_LEN + 1];
+    prf_stats_t st;
+    uint32_t i, cyc_us = prf_cycles_per_us();
+    int n = 1;
+    disp_diag_line(0, "[us]    n/s  avg  max");
+    for (i = 0 ; i < TLM_PRF_COUNT && n < DIAG_LINES ; i++) {
+        if (prf_get(i, &st) == 0 && st.count) {
+            snprintf(ln, sizeof(ln), "%-7.7s%4lu%5lu%5lu", abbr[i],
+                (unsigned long)clamp_u32(st.count * 1000 / PRF_REPORT_MS, 9999),
+                (unsigned long)clamp_u32(st.mean / cyc_us, 99999),
+                (unsigned long)clamp_u32(st.max / cyc_us, 99999));
+            disp_diag_line(n++, ln);
+        }
+    }
+    if (PRF_ENABLE != 1) {
+        disp_diag_line(n++, "profiling off");
+    }
+    while (n < DIAG_LINES) {
+        disp_diag_line(n++, "");
+    }
+    disp_refresh();
+}
+
+// pass a key to the menu operations, any key cancels tuning
+static void op_key(char k) {
+    tlm_key(k);
+    if (at_is_running()) {
+        at_stop();
+        ops_tune_done(AT_IDLE);
+        return;
+    }
+    if ( ops_poll(k) ) {
+        tlm_log(TLM_LOG_OPS_RESET, 0, 0, 0);
+        ops_reset(); // silently reset state machine, ok if operation completed as well.
+    }
+}
+
+// pass all buffered keys to the menu operations
+static void chk_operations(void) {
+    char keys[KEYBUFFER_LEN];
+    int i, n;
+    while ((n = keypad_get_n(keys, KEYBUFFER_LEN)) > 0) {
+        for (i = 0 ; i < n ; i++) {
+            op_key(keys[i]);
+        }
+    }
+    if (get_diagShown()) {
+        diag_update();
+    }
+}
+
+// a key of a remote command: tuning is cancelled and the diagnostics screen
+// left first, as by a key press, so the key itself takes effect
+static void cmd_key(char k) {
+    if (at_is_running() || get_diagShown()) {
+        op_key(k);
+    }
+    op_key(k);
+}
+
+// iron put down / lifted: heat indicator follows the standby state
+static void chk_standby(void) {
+    int s = sby_get_state();
+    tlm_log(TLM_LOG_SBY_ACTIVE + s, 0, 0, 0); // IDs in SBY_xxx order
+    if (s == SBY_SLEEP) {
+        char p = get_activePreset();
+        if (p == ' ') {
+            tlm_log(TLM_LOG_ENERGY_MANUAL, pm_get_session_mwh(), pm_get_preset_mwh(p), 0);
+        } else {
+            tlm_log(TLM_LOG_ENERGY_PRESET, pm_get_session_mwh(), (uint32_t)p, pm_get_preset_mwh(p));
         }
-        sleep_ms(PCHK_MS_SLP_INTVAL);
-        ms_intval += PCHK_MS_SLP_INTVAL;
     }
+    if (s == SBY_ACTIVE && get_wakeStatus()) {
+        disp_heat_on();
+    } else {
+        disp_cool_on();
+    }
+    disp_refresh();
+}
+
+// update the tip temperature and power meters, and the boost time left
+static void meter_update(void) {
+    static int boost_shown = 0;
+    int pwr = (int)((pm_get_mw() + 500) / 1000);               // delivered power [W]
+    int pwr_percent = (int)fx_percent(pwr, PWR_TOTAL);          // computed % of total power
+    int32_t tip_temp = tc_get_temp();                           // measured tip temp [cdeg C]
+    int boost = (int)((tc_get_boost_left_ms() + 999) / 1000);  // [sec], rounded up
+    if (boost != boost_shown) {
+        boost_shown = boost;
+        disp_boost(boost);
+    }
+    disp_pwr_txt(pwr);
+    disp_pwr_bar(pwr_percent);
+    if (tip_temp != TT_TEMP_OPEN) {
+        disp_tip_temp(tt_cdeg_to_scale(tip_temp, (char)get_tempScale()));
+    }
+    disp_refresh();
 }
 
 int main()
 {
-    stdio_init_all();
+    // main loop events and the telemetry, before any of the producers start
+    ev_init();
+    tlm_init();
+#if (FX_BENCH==1)
+    fx_bench();
+#endif
+    prf_init();
+    dl_init();
+    // core0's timer wheel alarm, before any module adds a task
+    tw_init();
 
     // Setup Display handler and show the operating screen
     disp_init();
     disp_startscrn();
+    disp_poll();
     //sleep_si(10);
     sleep_si(1);
     disp_opscrn();
-    // Setup/Init Menu Operations
+    // Restore the saved settings and Setup/Init Menu Operations
+    sst_init();
     ops_init();
+    // remote commands on the console UART
+    cmd_init();
     // Startup keypad scanning
     keypad_init();
     keypad_start();
-    // Startup Analog PSU Manager
-    apc_init();
-    apc_enable();
+    // Startup the control path on core1: the analog PSU manager, the heater
+    // engine and the temperature controller (rt_core.h)
+    rt_start();
 
     if ( ! apc_is_running() ) {
-        printf("[Analog PSU VMon] monitoring task did not start!\n");
+        tlm_log(TLM_LOG_APC_NOT_RUNNING, 0, 0, 0);
     }
 
-    // test loop stage
-    //char  key = 0;
-    uint32_t R;                 // random value
-    int pwr = 0;                // random power setting
-    int pwr_percent = 0;        // computed % of total power
-    bool isHeating = false;     // random heating/cooling cycle
-    char preset = '*';          // keyed preset ['A', 'B', 'C', 'D']
-    int temp = 0;               // random tip PRESET temp
-    int tip_temp = 0;           // LED tip temperatur value displayed (max:TEMP_TOTAL)
+    // Event driven from here: sleep until a key, a PSU fault, the iron being
+    // put down / lifted or a new tip reading (or mains half-cycle) wakes us. Keys are handled right away,
+    // the meters are paced at METER_UPDT_PD_US. The screen is drawn once
+    // the events are handled.
+    uint32_t meter_last = time_us_32() - METER_UPDT_PD_US;
+    dl_register(TLM_DL_FRAME, METER_UPDT_PD_US, DL_FRAME_DEADLINE_US);
     while (true) {
-        // look for any relevent keys (A,B,C,D)
-        // key = 0;
-        // do {
-        //     if (key == 'A' || key == 'B' || key == 'C' || key == 'D') {
-        //         preset = key;
-        //         break;
-        //     }
-        // } while (keypad_get(&key));
-        R = get_rand_32();
-        isHeating = (bool)(R & 0x1);
-        pwr = R % PWR_TOTAL;
-        pwr_percent = (int)( (float)pwr * 100.0 / (float)PWR_TOTAL );
-        temp = pwr + 100;
-        tip_temp = R % TEMP_TOTAL;
-        // ---
-        // if (isHeating)
-        //     disp_heat_on();
-        // else
-        //     disp_cool_on();
-        disp_pwr_txt(pwr);
-        disp_pwr_bar(pwr_percent);
-        // preset ABCD to-do
-        //disp_pset_temp(temp);
-        //disp_preset_show(preset);
-        disp_tip_temp(tip_temp);
-        disp_refresh();
-        // ---
-        //sleep_si(2);
-        poll_chk_operations(); // 1 sec delay while keypad scanning & menu operations
+        uint32_t ev = ev_wait(EV_ALL);
+        if (ev & EV_TLM) {
+            tlm_poll(); // core1's records
+        }
+        if (ev & EV_KEY) {
+            chk_operations();
+        }
+        if (ev & EV_CMD) {
+            cmd_poll(cmd_key);
+        }
+        if (ev & EV_STBY) {
+            chk_standby();
+        }
+        if ((ev & EV_BOOST) && !tc_boost_active()) {
+            tlm_log(TLM_LOG_BOOST_END, tc_get_boost_budget_j(), 0, 0);
+        }
+        if ((ev & EV_ADC) && at_is_running()) {
+            int s = at_poll();
+            if (s != AT_SETTLE && s != AT_STEP) {
+                ops_tune_done(s);
+            }
+        }
+        if ((ev & EV_PSU_FAULT) && apc_get_fault()) {
+            apc_stats_t st;
+            int r;
+            for (r = APC_RAIL_P16V ; apc_get_stats(r, &st) == 0 ; r++) {
+                if (st.fault) {
+                    tlm_psu_t rec;
+                    rec.rail = (uint8_t)r;
+                    rec.fault = 1;
+                    rec.rsvd = 0;
+                    rec.fault_ms = (uint32_t)(st.fault_time_us / 1000);
+                    rec.cycles = st.cycles;
+                    rec.max_over_us = st.max_over_us;
+                    tlm_put(TLM_REC_PSU, &rec);
+                }
+            }
+        }
+        if (ev & EV_ZC) {
+            pm_poll(); // delivered heater energy, half-cycles fired
+        }
+        rt_poll(); // settings changed above to core1
+        if (sst_pending()) {
+            sst_poll(); // settings to flash
+        }
+        dl_poll();
+        if (prf_poll() && get_diagShown()) {
+            diag_update(); // profile window closed
+        }
+        if ((ev & (EV_ADC | EV_ZC)) && (time_us_32() - meter_last) >= METER_UPDT_PD_US) {
+            meter_last = time_us_32();
+            meter_update();
+            dl_run(TLM_DL_FRAME, meter_last);
+        }
+        disp_poll();
     }
 }
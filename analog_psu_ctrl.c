@@ -1,8 +1,41 @@
+/******************************************************************************
+ * Manage the Analog Power Supplies
+ *
+ * Hysteretic control of the +/-16V reservoir caps: the charge MOSFET is on
+ * until the rail's comparator reports CHG_OVER, then off until it reports
+ * CHG_UNDER again.
+ *
+ * PIO (APSU_USE_PIO): one state machine per rail runs the whole loop, the
+ * CPU is not involved. The comparator is ignored for APSU_PIO_BLANK_US after
+ * every switch (switching noise), and a rail that does not drop back below
+ * the threshold within APSU_DISCHG_WT_US of the switch-off raises a PIO IRQ
+ * flag -> discharge fault. Ripple no longer depends on what else runs.
+ *
+ * Fallback (no state machine free): switch-off from the GPIO edge ISR,
+ * switch-on again from a periodic timer wheel task (10..20 msec later).
+ *
+ * Statistics (apc_get_stats): charge cycles, on/off time totals for the
+ * duty cycle, a log2 histogram of the discharge time and the longest one.
+ * In PIO mode the state machine times both phases itself and pushes one
+ * word per cycle (charge polls | discharge polls << 16) that the RX ISR
+ * folds in; in timer mode the edge ISR and the timer task time-stamp them.
+ * Either way a cycle costs a few adds in an ISR.
+ *
+ */
 
 #include <analog_psu_ctrl.h>
 #include <board.h>
+#include <events.h>
+#include <profile.h>
+#include <deadline.h>
+#include <timer_wheel.h>
 #include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "hardware/clocks.h"
+#include "hardware/sync.h"
 #include <pico/time.h>
+#include <string.h>
 
 // set '1' if -16v/-12v/-5v side of the PSU is populated on the PCB
 #define USING_N16V_PSU 0
@@ -29,37 +62,70 @@ int apc_init(void) {
     gpio_init(APSU_N16V_CHARGE_STATE);
     gpio_set_dir(APSU_N16V_CHARGE_STATE, GPIO_IN);
 #endif
-    // enable/start GPIO ISR - leave running all the time!
-    gpio_set_irq_enabled_with_callback(APSU_P16V_CHARGE_STATE, 
-        GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true, 
-        &gpio_callback);
     return 0;
 }
 
 
-static bool              timer_running = 0;             // 1ms timer
-static repeating_timer_t psutmr;                        // 1ms timer handle
+static bool              timer_running = 0;             // regulating (PIO or timer)
+static bool              pio_mode = false;              // regulating by PIO
+static int               psu_tw = -1;                   // scan task (timer wheel)
 static uint32_t          P16v_discharge_counter = 0;    // count the discharge period for +16V
 static bool              P16V_count_enable = false;     // when true, counter is to increment
 static bool              P16V_dischg_wt_enable = false; // when true, the discharge fault is to be monitored
-static bool              P16V_FAULT = false;
 #if (USING_N16V_PSU==1)
 static uint32_t          N16v_discharge_counter = 0;    // count the discharge period for -16V
 static bool              N16V_count_enable = false;     // when true, counter is to increment
 static bool              N16V_dischg_wt_enable = false; // when true, the discharge fault is to be monitored
-static bool              N16V_FAULT = false;
 #endif
-#define P16V_CHG_EN_THRESH       1  /* (10ms) msec delay before re-enabling the +16V charge MOSFET */
-#define P16V_DISCHG_WT_ALARM    20  /* (200ms) msec delay before signalling a fault (did not see the over-voltage signal de-assert in this time) */
-#define APSU_SCAN_PD_MS         10  /* msec periodic timer interval [msec] */
+#define P16V_CHG_EN_THRESH       1  /* scan periods (10..20 ms) before re-enabling the +16V charge MOSFET */
+#define P16V_DISCHG_WT_ALARM    (APSU_DISCHG_WT_US / (APSU_SCAN_PD_MS * 1000))  /* scan periods before signalling a fault (did not see the over-voltage signal de-assert in this time) */
+#define APSU_SCAN_PD_MS         10  /* periodic timer interval [msec] */
+
+// per rail statistics accumulators, written from ISRs only
+typedef struct apc_acc_type {
+    uint32_t cycles;
+    uint64_t on_us;                     // total MOSFET on time
+    uint64_t off_us;                    // total MOSFET off time
+    uint32_t hist[APC_HIST_BINS];
+    uint32_t max_over_us;
+    bool     fault;
+    uint64_t fault_time_us;
+    uint32_t t_on, t_off;               // timer mode: last switch on / off
+} apc_acc_t;
+
+static apc_acc_t acc[2];
+
+static inline void stat_charged(apc_acc_t * a, uint32_t on_us) {
+    a->cycles ++;
+    a->on_us += on_us;
+}
+
+static inline void stat_over(apc_acc_t * a, uint32_t over_us) {
+    int bin = (32 - __builtin_clz(over_us | 1)) - 8;    // bit length - 8
+    a->hist[(bin < 0) ? 0 : ((bin >= APC_HIST_BINS) ? APC_HIST_BINS - 1 : bin)] ++;
+    if (over_us > a->max_over_us) {
+        a->max_over_us = over_us;
+    }
+}
+
+static void stat_fault(apc_acc_t * a) {
+    if (!a->fault) {
+        a->fault = true;
+        a->fault_time_us = time_us_64();
+    }
+    ev_post(EV_PSU_FAULT);
+}
 
 /* ISR Routine - GPIO Edge Interrupts */
 void gpio_callback(uint gpio, uint32_t event_mask) {
+    PRF_MARK(m);
     if (gpio == APSU_P16V_CHARGE_STATE) {
         if (event_mask & GPIO_IRQ_EDGE_FALL) {
             // (falling edge into: APSU_X16V_CHG_OVER)
             // +16V threshold reached, turn off MOSFET
             gpio_put(APSU_P16V_ON_L, APSU_X16V_DISABLE);
+            acc[0].t_off = time_us_32();
+            stat_charged(&acc[0], acc[0].t_off - acc[0].t_on);
             P16v_discharge_counter = 0;
             P16V_count_enable = true;
             P16V_dischg_wt_enable = true;
@@ -68,6 +134,7 @@ void gpio_callback(uint gpio, uint32_t event_mask) {
             // +16V level fallen below the threshold, voltage 
             // is falling, disable the discharge wait fault enable flag.
             P16V_dischg_wt_enable = false;
+            stat_over(&acc[0], time_us_32() - acc[0].t_off);
         }
     }
 #if (USING_N16V_PSU==1)
@@ -76,6 +143,8 @@ void gpio_callback(uint gpio, uint32_t event_mask) {
             // (falling edge into: APSU_X16V_CHG_OVER)
             // -16V threshold reached, turn off MOSFET
             gpio_put(APSU_N16V_ON_L, APSU_X16V_DISABLE);
+            acc[1].t_off = time_us_32();
+            stat_charged(&acc[1], acc[1].t_off - acc[1].t_on);
             N16v_discharge_counter = 0;
             N16V_count_enable = true;
             N16V_dischg_wt_enable = true;
@@ -84,29 +153,200 @@ void gpio_callback(uint gpio, uint32_t event_mask) {
             // -16V level fallen below the threshold, voltage 
             // is falling, disable the discharge wait fault enable flag.
             N16V_dischg_wt_enable = false;
+            stat_over(&acc[1], time_us_32() - acc[1].t_off);
         }
     }
 #endif
+    PRF_END(TLM_PRF_GPIO_CALLBACK, m);
 }
 
 /* msec polling task, timing the 16v discharge period and faults */
-static bool chk_thresholds(repeating_timer_t * rptdata) {
+static void chk_thresholds(void * ctx) {
+    uint32_t start = time_us_32();
+    PRF_MARK(m);
     if (P16V_count_enable) {
         if (P16V_dischg_wt_enable && (P16v_discharge_counter > P16V_DISCHG_WT_ALARM)) {
             // throw a fault on the +16v charge system.
             // next PCB version, add a crowbar/disable on the +50v voltage rail
             // and add a fuse to it (blow the fuse!)
-            P16V_FAULT = true;
             P16V_dischg_wt_enable = false;
+            stat_fault(&acc[0]);
         }
         if (P16v_discharge_counter > P16V_CHG_EN_THRESH) {
             // +16v fallen enough, set it to charge again
             P16V_count_enable = false;
             gpio_put(APSU_P16V_ON_L, APSU_X16V_ENABLE);
+            acc[0].t_on = time_us_32();
+            acc[0].off_us += acc[0].t_on - acc[0].t_off;
         }
         P16v_discharge_counter ++;
     }
-    return timer_running; // set to 0/false to stop the repeating-timer
+#if (USING_N16V_PSU==1)
+    if (N16V_count_enable) {
+        if (N16V_dischg_wt_enable && (N16v_discharge_counter > P16V_DISCHG_WT_ALARM)) {
+            N16V_dischg_wt_enable = false;
+            stat_fault(&acc[1]);
+        }
+        if (N16v_discharge_counter > P16V_CHG_EN_THRESH) {
+            N16V_count_enable = false;
+            gpio_put(APSU_N16V_ON_L, APSU_X16V_ENABLE);
+            acc[1].t_on = time_us_32();
+            acc[1].off_us += acc[1].t_on - acc[1].t_off;
+        }
+        N16v_discharge_counter ++;
+    }
+#endif
+    PRF_END(TLM_PRF_CHK_THRESHOLDS, m);
+    dl_run(TLM_DL_PSU, start);
+}
+
+// ***************************************************************************
+// PIO hysteretic controller
+// ***************************************************************************
+
+// runs at 1 cycle per usec, set pin := ON_L, in pin / jmp pin := CHARGE_STATE
+#define APC_PIO_HZ          1000000
+#define APC_CHG_POLL_US     2       /* charge poll loop period */
+#define APC_POLL_US         10      /* discharge (fault) poll loop period */
+#define APC_POLL_MAX        (APSU_DISCHG_WT_US / APC_POLL_US)
+#define APC_PROG_LEN        20
+#define APC_PROG_WRAP_TGT   3
+
+#if (APC_POLL_MAX > 0xFFFF)
+#error "APSU_DISCHG_WT_US too long for a 16 bit poll count"
+#endif
+#if (APSU_X16V_CHG_UNDER != 1)
+#error "PIO controller expects CHG_UNDER on a high CHARGE_STATE (jmp pin)"
+#endif
+
+static PIO        apc_pio = NULL;
+static int        apc_sm[2] = { -1, -1 };
+static uint       apc_offset = 0;
+static uint16_t   apc_instr[APC_PROG_LEN];
+static const pio_program_t apc_program = { apc_instr, APC_PROG_LEN, -1 };
+
+static void apc_pio_build(void) {
+    uint i = 0;
+    apc_instr[i++] = pio_encode_pull(false, true);                        // 0 blanking [usec]
+    apc_instr[i++] = pio_encode_mov(pio_y, pio_osr);                      // 1
+    apc_instr[i++] = pio_encode_pull(false, true);                        // 2 fault timeout [polls], kept in OSR
+    apc_instr[i++] = pio_encode_set(pio_pins, APSU_X16V_ENABLE);          // 3 charge (wrap target)
+    apc_instr[i++] = pio_encode_mov(pio_x, pio_y);                        // 4
+    apc_instr[i] = pio_encode_jmp_x_dec(i); i++;                          // 5 blank
+    apc_instr[i++] = pio_encode_mov_not(pio_x, pio_null);                 // 6 count charge polls down from ~0
+    apc_instr[i] = pio_encode_jmp_x_dec(i + 1); i++;                      // 7
+    apc_instr[i] = pio_encode_jmp_pin(i - 1); i++;                        // 8 CHG_UNDER (high), still charging
+    apc_instr[i++] = pio_encode_set(pio_pins, APSU_X16V_DISABLE);         // 9 threshold reached
+    apc_instr[i++] = pio_encode_in(pio_x, 16);                            // 10 ~charge polls
+    apc_instr[i++] = pio_encode_mov(pio_x, pio_y);                        // 11
+    apc_instr[i] = pio_encode_jmp_x_dec(i); i++;                          // 12 blank
+    apc_instr[i++] = pio_encode_mov(pio_x, pio_osr);                      // 13
+    apc_instr[i++] = pio_encode_jmp_pin(APC_PROG_LEN - 2);                // 14 CHG_UNDER (high), charge again
+    apc_instr[i] = pio_encode_jmp_x_dec(i - 1) | pio_encode_delay(APC_POLL_US - 2); i++; // 15
+    apc_instr[i++] = pio_encode_irq_set(true, 0);                         // 16 discharge fault
+    apc_instr[i++] = pio_encode_wait_pin(APSU_X16V_CHG_UNDER, 0);         // 17
+    apc_instr[i++] = pio_encode_in(pio_x, 16);                            // 18 polls left
+    apc_instr[i++] = pio_encode_push(false, false);                       // 19 (wrap)
+}
+
+// fold in one cycle pushed by the state machine
+static void apc_pio_cycle(apc_acc_t * a, uint32_t v) {
+    uint32_t chg = 0xFFFF - (v & 0xFFFF);
+    uint32_t left = v >> 16;
+    uint32_t on_us = APSU_PIO_BLANK_US + chg * APC_CHG_POLL_US;
+    uint32_t off_us = APSU_PIO_BLANK_US + ((left <= APC_POLL_MAX) ? APC_POLL_MAX - left : APC_POLL_MAX) * APC_POLL_US;
+    stat_charged(a, on_us);
+    a->off_us += off_us;
+    stat_over(a, off_us);
+}
+
+/* ISR Routine - PIO RX FIFO (cycle stats) and IRQ flags (discharge fault) */
+static void apc_pio_isr(void) {
+    int r;
+    PRF_MARK(m);
+    for (r = 0 ; r < 2 ; r++) {
+        if (apc_sm[r] < 0) {
+            continue;
+        }
+        while (!pio_sm_is_rx_fifo_empty(apc_pio, apc_sm[r])) {
+            apc_pio_cycle(&acc[r], pio_sm_get(apc_pio, apc_sm[r]));
+        }
+        if (pio_interrupt_get(apc_pio, apc_sm[r])) {
+            pio_interrupt_clear(apc_pio, apc_sm[r]);
+            stat_fault(&acc[r]);
+        }
+    }
+    PRF_END(TLM_PRF_APC_PIO_ISR, m);
+}
+
+static int apc_pio_rail_start(int r, uint on_pin, uint state_pin) {
+    pio_sm_config c;
+    apc_sm[r] = pio_claim_unused_sm(apc_pio, false);
+    if (apc_sm[r] < 0) {
+        return 1;
+    }
+    pio_sm_set_pins_with_mask(apc_pio, apc_sm[r], (uint32_t)APSU_X16V_DISABLE << on_pin, 1u << on_pin);
+    pio_sm_set_pindirs_with_mask(apc_pio, apc_sm[r], 1u << on_pin, 1u << on_pin);
+    pio_gpio_init(apc_pio, on_pin);
+    c = pio_get_default_sm_config();
+    sm_config_set_set_pins(&c, on_pin, 1);
+    sm_config_set_in_pins(&c, state_pin);
+    sm_config_set_jmp_pin(&c, state_pin);
+    sm_config_set_in_shift(&c, true, false, 32);    // charge in [15:0], discharge in [31:16]
+    sm_config_set_wrap(&c, apc_offset + APC_PROG_WRAP_TGT, apc_offset + APC_PROG_LEN - 1);
+    sm_config_set_clkdiv(&c, (float)clock_get_hz(clk_sys) / APC_PIO_HZ);
+    pio_sm_init(apc_pio, apc_sm[r], apc_offset, &c);
+    pio_sm_put(apc_pio, apc_sm[r], (APSU_PIO_BLANK_US > 1) ? APSU_PIO_BLANK_US - 1 : 0);
+    pio_sm_put(apc_pio, apc_sm[r], APC_POLL_MAX);
+    pio_set_irq0_source_enabled(apc_pio, (enum pio_interrupt_source)(pis_interrupt0 + apc_sm[r]), true);
+    pio_set_irq0_source_enabled(apc_pio, (enum pio_interrupt_source)(pis_sm0_rx_fifo_not_empty + apc_sm[r]), true);
+    pio_sm_set_enabled(apc_pio, apc_sm[r], true);
+    return 0;
+}
+
+static void apc_pio_rail_stop(int r, uint on_pin) {
+    if (apc_sm[r] >= 0) {
+        pio_sm_set_enabled(apc_pio, apc_sm[r], false);
+        pio_set_irq0_source_enabled(apc_pio, (enum pio_interrupt_source)(pis_interrupt0 + apc_sm[r]), false);
+        pio_set_irq0_source_enabled(apc_pio, (enum pio_interrupt_source)(pis_sm0_rx_fifo_not_empty + apc_sm[r]), false);
+        pio_interrupt_clear(apc_pio, apc_sm[r]);
+        pio_sm_unclaim(apc_pio, apc_sm[r]);
+        apc_sm[r] = -1;
+        // MOSFET off, pin back to SIO
+        gpio_put(on_pin, APSU_X16V_DISABLE);
+        gpio_set_function(on_pin, GPIO_FUNC_SIO);
+    }
+}
+
+static void apc_pio_stop(void) {
+    irq_set_enabled(pio_get_index(apc_pio) ? PIO1_IRQ_0 : PIO0_IRQ_0, false);
+    apc_pio_rail_stop(APC_RAIL_P16V, APSU_P16V_ON_L);
+#if (USING_N16V_PSU==1)
+    apc_pio_rail_stop(APC_RAIL_N16V, APSU_N16V_ON_L);
+#endif
+    pio_remove_program(apc_pio, &apc_program, apc_offset);
+}
+
+// Start the PIO controller, 0 := SUCCESS, else no state machine or program
+// space (use the timer loop).
+static int apc_pio_start(void) {
+    apc_pio = APSU_PIO;
+    apc_pio_build();
+    if (!pio_can_add_program(apc_pio, &apc_program)) {
+        return 1;
+    }
+    apc_offset = pio_add_program(apc_pio, &apc_program);
+    irq_set_exclusive_handler(pio_get_index(apc_pio) ? PIO1_IRQ_0 : PIO0_IRQ_0, apc_pio_isr);
+    if (apc_pio_rail_start(APC_RAIL_P16V, APSU_P16V_ON_L, APSU_P16V_CHARGE_STATE)
+#if (USING_N16V_PSU==1)
+        || apc_pio_rail_start(APC_RAIL_N16V, APSU_N16V_ON_L, APSU_N16V_CHARGE_STATE)
+#endif
+    ) {
+        apc_pio_stop();
+        return 1;
+    }
+    irq_set_enabled(pio_get_index(apc_pio) ? PIO1_IRQ_0 : PIO0_IRQ_0, true);
+    return 0;
 }
 
 
@@ -114,12 +354,34 @@ static bool chk_thresholds(repeating_timer_t * rptdata) {
 int apc_enable(void) {
     int rc = 1;
     if (!timer_running) {
-        timer_running = (bool)add_repeating_timer_ms(APSU_SCAN_PD_MS, chk_thresholds, NULL, &psutmr);
-        if (timer_running) {
-            // enable 16v charging
-            gpio_put(APSU_P16V_ON_L, APSU_X16V_ENABLE);
-            rc = 0; // ok
+#if (APSU_USE_PIO==1)
+        pio_mode = (apc_pio_start() == 0);
+        timer_running = pio_mode;
+#endif
+        if (!timer_running) {
+            dl_register(TLM_DL_PSU, APSU_SCAN_PD_MS * 1000, APSU_SCAN_PD_MS * 1000);
+            if (psu_tw < 0) {
+                psu_tw = tw_add(chk_thresholds, NULL, TW_PRIO_HIGH);
+            }
+            timer_running = (tw_start_periodic(psu_tw, APSU_SCAN_PD_MS * 1000) == 0);
+            if (timer_running) {
+                // GPIO ISR, enabled while regulating in the timer mode
+                gpio_set_irq_enabled_with_callback(APSU_P16V_CHARGE_STATE, 
+                    GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true, 
+                    &gpio_callback);
+#if (USING_N16V_PSU==1)
+                gpio_set_irq_enabled_with_callback(APSU_N16V_CHARGE_STATE, 
+                    GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true, 
+                    &gpio_callback);
+                gpio_put(APSU_N16V_ON_L, APSU_X16V_ENABLE);
+                acc[1].t_on = time_us_32();
+#endif
+                // enable 16v charging
+                gpio_put(APSU_P16V_ON_L, APSU_X16V_ENABLE);
+                acc[0].t_on = time_us_32();
+            }
         }
+        rc = (timer_running == false); // 0 := SUCCESS
     }
     return rc;
 }
@@ -134,9 +396,58 @@ int apc_disable(void) {
     int rc = 1;
     if (timer_running) {
         timer_running = false;
+        if (pio_mode) {
+            apc_pio_stop();
+            pio_mode = false;
+        } else {
+            tw_stop(psu_tw);
+            gpio_set_irq_enabled(APSU_P16V_CHARGE_STATE, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, false);
+#if (USING_N16V_PSU==1)
+            gpio_set_irq_enabled(APSU_N16V_CHARGE_STATE, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, false);
+            gpio_put(APSU_N16V_ON_L, APSU_X16V_DISABLE);
+#endif
+        }
         // disable 16v charging
         gpio_put(APSU_P16V_ON_L, APSU_X16V_DISABLE);
         rc = 0;
     }
     return rc;
 }
+
+// true once a discharge fault has been seen on any rail
+bool apc_get_fault(void) {
+    return acc[APC_RAIL_P16V].fault || acc[APC_RAIL_N16V].fault;
+}
+
+// Copy out the statistics for 'rail'. The accumulators are updated by the
+// ISRs on core1, masking interrupts here (core0) would not hold them off:
+// the copy is taken again until two in a row agree (an update is a few
+// adds, it cannot keep racing the copy).
+int apc_get_stats(int rail, apc_stats_t * st) {
+    apc_acc_t a, b;
+    uint64_t total;
+    int i;
+#if (USING_N16V_PSU==1)
+    if (!st || rail < APC_RAIL_P16V || rail > APC_RAIL_N16V) {
+#else
+    if (!st || rail != APC_RAIL_P16V) {
+#endif
+        return 1;
+    }
+    memcpy(&b, &acc[rail], sizeof(b));
+    do {
+        memcpy(&a, &b, sizeof(a));
+        __dmb();
+        memcpy(&b, &acc[rail], sizeof(b));
+    } while (memcmp(&a, &b, sizeof(a)) != 0);
+    total = a.on_us + a.off_us;
+    st->cycles = a.cycles;
+    st->duty_pm = total ? (uint32_t)(a.on_us * 1000 / total) : 0;
+    for (i = 0 ; i < APC_HIST_BINS ; i++) {
+        st->dischg_hist[i] = a.hist[i];
+    }
+    st->max_over_us = a.max_over_us;
+    st->fault = a.fault;
+    st->fault_time_us = a.fault_time_us;
+    return 0;
+}
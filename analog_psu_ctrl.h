@@ -26,4 +26,29 @@ bool apc_is_running(void);
 // Disable 16v regulation
 int apc_disable(void);
 
+// true once a discharge fault has been seen on any rail (EV_PSU_FAULT is posted)
+bool apc_get_fault(void);
+
+// rails
+#define APC_RAIL_P16V   0
+#define APC_RAIL_N16V   1   /* only with the -16V side populated */
+
+// discharge time histogram: bin 0 < 256 usec, bin i [2^(i+7), 2^(i+8)) usec,
+// last bin open ended (>= 16.4 msec)
+#define APC_HIST_BINS   8
+
+// Regulator statistics, per rail, since apc_init()
+typedef struct apc_stats_type {
+    uint32_t cycles;                    // charge cycles (MOSFET on -> off)
+    uint32_t duty_pm;                   // charge duty cycle [0.1 %]
+    uint32_t dischg_hist[APC_HIST_BINS];// discharge (over threshold) times
+    uint32_t max_over_us;               // longest time over threshold [usec]
+    bool     fault;                     // discharge fault, latched
+    uint64_t fault_time_us;             // time of the first fault [usec since boot]
+} apc_stats_t;
+
+// Copy out the statistics for 'rail' (APC_RAIL_xxx)
+// returns 0 := SUCCESS, 1 := bad args or the rail is not populated
+int apc_get_stats(int rail, apc_stats_t * st);
+
 #endif /* _ANALOG_PSU_H_ */
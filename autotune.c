@@ -0,0 +1,258 @@
+/******************************************************************************
+ * Controller Auto-Tuning
+ *
+ * 1. SETTLE  closed loop at the setpoint until the tip has stayed within
+ *            AT_SETTLE_BAND_C for AT_SETTLE_MS; the tip temperature T0 and
+ *            the holding power P0 are averaged over that time.
+ * 2. STEP    open loop at P0 + AT_STEP_W, the response is logged until the
+ *            tip has risen AT_STEP_RISE_C (or AT_STEP_MAX_MS). The log is
+ *            halved (every other sample dropped) whenever it fills, so any
+ *            tip fits in AT_LOG_MAX samples.
+ * 3. FIT     first order plus dead time, process reaction curve:
+ *              K   = (T0 - ambient) / P0            (steady state)
+ *              R   = steepest slope of the response  (least squares over a
+ *                                                     sliding window)
+ *              L   = where the tangent at R crosses T0, after the step
+ *              tau = K * step / R
+ *
+ * Gains (at_model_gains()), for the controller in temp_ctrl.c:
+ *   kff = 1 / K,  kc = tau / K                       (feedforward, exact)
+ *   kp  = tau / (K * (tc + L)),  tc = L             (SIMC)
+ *   ki  = kp / min(tau, 4 * (tc + L)),  kd = kp * L / 2
+ *
+ * The tip is heated a little above the setpoint for a few seconds only,
+ * the time constant does not need the full (minutes long) response.
+ *
+ */
+
+#include <autotune.h>
+#include <temp_ctrl.h>
+#include <tip_temp.h>
+#include <standby.h>
+#include <operations.h>
+#include <board.h>
+#include <telemetry.h>
+
+#define AT_SETTLE_BAND_C    2
+#define AT_SETTLE_MS        5000
+#define AT_SETTLE_TMOUT_MS  60000
+#define AT_STEP_W           50      /* power step above the holding power [W] */
+#define AT_STEP_RISE_C      20
+#define AT_STEP_MAX_MS      10000
+#define AT_LOG_MAX          256
+#define AT_FIT_WIN_MIN      8       /* least squares window, samples */
+#define AT_DEAD_MIN_MS      10      /* one half-cycle */
+
+static int      at_state = AT_IDLE;
+static bool     at_have_model = false;
+static at_model_t at_model;
+
+static uint32_t at_t0_us;           // start of the current phase
+static uint32_t at_band_us;         // settle: entered the band
+static int64_t  at_sum_t;           // settle: sum of tip temps [cdeg]
+static int64_t  at_sum_p;           // settle: sum of power requests [W]
+static uint32_t at_n;
+static int32_t  at_temp0;           // T0 [cdeg]
+static uint32_t at_p0_mw;           // P0 [mW]
+static uint32_t at_step_mw;         // step above P0 [mW], actual (clamped)
+
+static uint32_t at_log_t[AT_LOG_MAX];   // [msec] since the step
+static int32_t  at_log_v[AT_LOG_MAX];   // [cdeg]
+static uint32_t at_log_n;
+static uint32_t at_log_pd_ms;           // logging interval, doubles on each halving
+static uint32_t at_log_next_ms;
+
+static void at_end(int state) {
+    tc_set_open_loop(-1);
+    at_state = state;
+}
+
+static bool at_iron_ok(void) {
+    return tc_is_running() && tc_get_fault() == TC_FAULT_NONE && get_wakeStatus() &&
+           sby_get_state() == SBY_ACTIVE && tc_get_setpoint() > 0;
+}
+
+static void at_log(uint32_t t_ms, int32_t v) {
+    uint32_t i;
+    if (t_ms < at_log_next_ms) {
+        return;
+    }
+    if (at_log_n == AT_LOG_MAX) {
+        for (i = 0 ; i < AT_LOG_MAX / 2 ; i++) {
+            at_log_t[i] = at_log_t[2 * i];
+            at_log_v[i] = at_log_v[2 * i];
+        }
+        at_log_n = AT_LOG_MAX / 2;
+        at_log_pd_ms = at_log_pd_ms ? at_log_pd_ms * 2 : 20;
+    }
+    at_log_t[at_log_n] = t_ms;
+    at_log_v[at_log_n] = v;
+    at_log_n ++;
+    at_log_next_ms = t_ms + at_log_pd_ms;
+}
+
+// FOPDT from the logged step response, 0 := ok
+static int at_fit(void) {
+    uint32_t w = at_log_n / 8;
+    uint32_t i, j;
+    int64_t best = 0, best_tm = 0, best_vm = 0;
+    int64_t k, tau, dead;
+    if (w < AT_FIT_WIN_MIN) {
+        w = AT_FIT_WIN_MIN;
+    }
+    if (at_log_n < w || at_p0_mw < 1000 || at_temp0 <= TT_CDEG(ADC_TEMP_CJ_DEGC + 50)) {
+        return 1;
+    }
+    // steepest least squares slope over 'w' samples [cdeg / sec]
+    for (i = 0 ; i + w <= at_log_n ; i++) {
+        int64_t st = 0, sv = 0, stt = 0, stv = 0, den, r;
+        for (j = i ; j < i + w ; j++) {
+            int64_t t = at_log_t[j] - at_log_t[i];
+            st += t;
+            sv += at_log_v[j];
+            stt += t * t;
+            stv += t * at_log_v[j];
+        }
+        den = (int64_t)w * stt - st * st;
+        if (den <= 0) {
+            continue;
+        }
+        r = ((int64_t)w * stv - st * sv) * 1000 / den;
+        if (r > best) {
+            best = r;
+            best_tm = at_log_t[i] + st / w;
+            best_vm = sv / w;
+        }
+    }
+    if (best <= 0) {
+        return 1;
+    }
+    k = ((int64_t)at_temp0 - TT_CDEG(ADC_TEMP_CJ_DEGC)) * 1000 / at_p0_mw;  // [cdeg / W]
+    tau = k * at_step_mw / best;                                             // [msec]
+    dead = best_tm - (best_vm - at_temp0) * 1000 / best;                     // [msec]
+    if (dead < AT_DEAD_MIN_MS) {
+        dead = AT_DEAD_MIN_MS;
+    }
+    if (k <= 0 || k > UINT16_MAX || tau / 10 <= 0 || tau / 10 > UINT16_MAX || dead > UINT16_MAX) {
+        return 1;
+    }
+    at_model.k = (uint16_t)k;
+    at_model.tau = (uint16_t)(tau / 10);
+    at_model.dead = (uint16_t)dead;
+    at_have_model = true;
+    tlm_log(TLM_LOG_AT_STEP, (uint32_t)at_temp0, at_p0_mw, at_step_mw);
+    tlm_log(TLM_LOG_AT_MODEL, at_model.k, (uint32_t)at_model.tau * 10, at_model.dead);
+    return 0;
+}
+
+// Start tuning at the current setpoint
+int at_start(void) {
+    if (at_is_running() || !at_iron_ok()) {
+        return 1;
+    }
+    tc_boost_stop();
+    at_t0_us = time_us_32();
+    at_band_us = 0;
+    at_state = AT_SETTLE;
+    return 0;
+}
+
+// Abort tuning, closed loop control is restored
+int at_stop(void) {
+    if (!at_is_running()) {
+        return 1;
+    }
+    at_end(AT_IDLE);
+    return 0;
+}
+
+// is tuning in progress ?
+bool at_is_running(void) {
+    return at_state == AT_SETTLE || at_state == AT_STEP;
+}
+
+// Step the tuning, call on every new tip reading
+int at_poll(void) {
+    uint32_t now = time_us_32();
+    int32_t temp = tc_get_temp();
+    int state = at_state;
+    if (!at_is_running()) {
+        return state;
+    }
+    if (!at_iron_ok() || temp == TT_TEMP_OPEN) {
+        at_end(AT_FAIL);
+        return at_state;
+    }
+    if (state == AT_SETTLE) {
+        int32_t err = temp - tc_get_setpoint();
+        if (err > TT_CDEG(AT_SETTLE_BAND_C) || err < -TT_CDEG(AT_SETTLE_BAND_C)) {
+            at_band_us = 0;
+        } else if (!at_band_us) {
+            at_band_us = now;
+            at_sum_t = at_sum_p = 0;
+            at_n = 0;
+        }
+        if (at_band_us) {
+            at_sum_t += temp;
+            at_sum_p += tc_get_power();
+            at_n ++;
+            if ((now - at_band_us) >= AT_SETTLE_MS * 1000u) {
+                uint32_t p1;
+                at_temp0 = (int32_t)(at_sum_t / at_n);
+                at_p0_mw = (uint32_t)(at_sum_p * 1000 / at_n);
+                p1 = (at_p0_mw + 500) / 1000 + AT_STEP_W;
+                if (p1 > IRON_MAX_WATT) {
+                    p1 = IRON_MAX_WATT;
+                }
+                if (p1 * 1000 <= at_p0_mw) {
+                    at_end(AT_FAIL); // already at full power
+                    return at_state;
+                }
+                tc_set_open_loop((int32_t)p1);
+                at_step_mw = p1 * 1000 - at_p0_mw;
+                at_log_n = 0;
+                at_log_pd_ms = 0;
+                at_log_next_ms = 0;
+                at_t0_us = now;
+                at_state = AT_STEP;
+            }
+        } else if ((now - at_t0_us) >= AT_SETTLE_TMOUT_MS * 1000u) {
+            at_end(AT_FAIL);
+        }
+    } else {
+        uint32_t t_ms = (now - at_t0_us) / 1000;
+        at_log(t_ms, temp);
+        if (temp - at_temp0 >= TT_CDEG(AT_STEP_RISE_C) || t_ms >= AT_STEP_MAX_MS) {
+            at_end(at_fit() ? AT_FAIL : AT_DONE);
+        }
+    }
+    return at_state;
+}
+
+// the last identified model
+int at_get_model(at_model_t * m) {
+    if (!at_have_model || !m) {
+        return 1;
+    }
+    *m = at_model;
+    return 0;
+}
+
+// Controller gains from a model
+int at_model_gains(const at_model_t * m, tc_gains_t * g) {
+    int64_t k, tau, dead, kp, ti;
+    if (!m || !g || m->k == 0 || m->tau == 0 || m->dead == 0) {
+        return 1;
+    }
+    k = m->k;                   // [cdeg / W]
+    tau = (int64_t)m->tau * 10; // [msec]
+    dead = m->dead;             // [msec]
+    kp = 100000 * tau / (k * 2 * dead);                 // [mW / C]
+    ti = (tau < 8 * dead) ? tau : 8 * dead;             // [msec]
+    g->kp = (int32_t)kp;
+    g->ki = (int32_t)(kp * 1000 / ti);
+    g->kd = (int32_t)(kp * dead / 2000);
+    g->kff = (int32_t)(100000 / k);
+    g->kc = (int32_t)(tau * 100 / k);
+    return 0;
+}
@@ -0,0 +1,55 @@
+/******************************************************************************
+ * Controller Auto-Tuning
+ *
+ * Identifies the tip as a first order plus dead time (FOPDT) process from
+ * a heater power step at the working temperature, and computes the
+ * temperature controller gains from that model.
+ *
+ * Runs from the main loop (at_poll() on every new tip reading). The
+ * controller is held in open loop for the power step only (tc_set_open_loop())
+ * and is back in closed loop when tuning ends, either way.
+ *
+ */
+
+#ifndef _AUTOTUNE_H_
+#define _AUTOTUNE_H_
+
+#include "pico/stdlib.h"
+#include <temp_ctrl.h>
+
+// states, at_poll() result
+#define AT_IDLE         0
+#define AT_SETTLE       1   /* closed loop, waiting for the tip to settle at the setpoint */
+#define AT_STEP         2   /* open loop power step, recording the response */
+#define AT_DONE         3   /* model identified, at_get_model() */
+#define AT_FAIL         4   /* aborted / no usable response */
+
+// FOPDT model, in the units kept in the settings store
+typedef struct at_model_type {
+    uint16_t k;         // static gain, tip temp rise over ambient per watt [cdeg C / W]
+    uint16_t tau;       // time constant [10 msec]
+    uint16_t dead;      // dead time [msec]
+} at_model_t;
+
+// Start tuning at the current setpoint (iron awake, off-hook, no fault).
+// returns 0 := started, 1 := refused
+int at_start(void);
+
+// Abort tuning, closed loop control is restored
+int at_stop(void);
+
+// is tuning in progress (AT_SETTLE / AT_STEP) ?
+bool at_is_running(void);
+
+// Step the tuning, call on every new tip reading. Returns the state,
+// AT_DONE / AT_FAIL when tuning has ended (AT_IDLE if stopped).
+int at_poll(void);
+
+// the last identified model, 1 := none
+int at_get_model(at_model_t * m);
+
+// Controller gains from a model ('ramp' is kept from 'g'),
+// returns 1 if the model is not usable (g unchanged)
+int at_model_gains(const at_model_t * m, tc_gains_t * g);
+
+#endif /* _AUTOTUNE_H_ */
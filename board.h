@@ -25,7 +25,7 @@
  * 6  Keyboard R2                   35 ADC_VREF
  * 7  Keyboard R3                   34 DISP_RESET
  * 8  GND                           33 GND
- * 9  Keyboard C0                   32 
+ * 9  Keyboard C0                   32 ADC_VLINE
  * 10 Keyboard C1                   31 ADC_TEMP
  * 11 Keyboard C2                   30 *RUN
  * 12 Keyboard C3                   29 IRON_ON_HOOK_DET
@@ -46,6 +46,8 @@
 #define DISP_DRVR_SPI_MOSI          PICO_DEFAULT_SPI_TX_PIN
 #define DISP_DRVR_SPI_CS            PICO_DEFAULT_SPI_CSN_PIN
 #define DISP_DRVR_SPI_CLK_FREQ_HZ   4000000UL   /* 4 MHz */
+#define DISP_PANEL_SPI_CLK_HZ       10000000UL  /* frame updates (DMA), up to the SSD1309 max: 10 MHz */
+#define DISP_PANEL_SPI_CLK_MAX_HZ   10000000UL  /* SSD1309 serial clock cycle >= 100 ns */
 #define DISP_DRVR_SPI_GPIO_DC       GP20
 #define DISP_DRVR_SPI_GPIO_RST      GP28
 
@@ -64,6 +66,13 @@
 #define KYBD_DBTIME    4 /* Tscan ~ 10 msec*/
 #define KYBD_BUFLEN    2
 #define KYBD_SCAN_PD_MS 20
+// IRQ started PIO scan: rows idle low, a falling edge on any column starts a
+// state machine that scans and debounces the matrix in hardware and stops
+// once all keys are released. Rows and columns must be consecutive GPIOs.
+// Falls back to the timer scan above if no state machine is free.
+#define KYBD_USE_PIO_SCAN   1
+#define KYBD_SCAN_PIO       pio0
+#define KYBD_PIO_DB_US      5000 /* matrix must be stable over this interval */
 
 // external keyboard FIFO. Add key entries 
 // using queue_push, remove keys using queue_pop
@@ -75,12 +84,15 @@
 
 /* ** [GPIO] ZeroCrossingAC ---------------- */
 #define AC_ZC_INPUT GP10
+#define AC_ZC_MIN_PD_US         6000  /* ignore ZC edges closer than this (detector noise), < 1/2 cycle @ 60Hz */
+#define AC_ZC_LOSS_TMOUT_US     25000 /* no ZC edge in this time: mains lost, heater forced off */
 
 /* ** [GPIO] HeaterControl ----------------- */
 #define HTR_CTRL_ON_L    GP11  /* Enable heater power pulses */
 #define HTR_CTRL_OFF_L   GP12  /* Heater shutoff - hold active while not heating */
 #define HTR_CTL_OFF 1  /* not active */
 #define HTR_CTL_ON  0  /* active     */
+#define HTR_MEAS_GAP_MAX 16    /* longest run of fired half-cycles, then one is left off for a tip reading */
 
 /* ** [GPIO] Analog Power Supply Controller  */
 #define APSU_P16V_ON_L          GP13  /* [out] active (low) - charge +16V cap */
@@ -95,6 +107,14 @@
 #define APSU_X16V_DISABLE       1
 #define APSU_X16V_CHG_OVER      0
 #define APSU_X16V_CHG_UNDER     1
+// PIO hysteretic controller: one state machine per rail switches the MOSFET
+// off on CHG_OVER and back on at CHG_UNDER, with the comparator ignored for
+// APSU_PIO_BLANK_US after every switch. Falls back to the GPIO ISR + timer
+// loop if no state machine is free.
+#define APSU_USE_PIO            1
+#define APSU_PIO                pio1
+#define APSU_PIO_BLANK_US       20      /* comparator blanking after a switch [usec] */
+#define APSU_DISCHG_WT_US       200000  /* no CHG_UNDER within this after switch-off := fault [usec] */
 
 /* ** [GPIO] OPTION - JBC IRON IN-CRADLE DETECT (active low) */
 #define IRON_ONHOOK_DET_L       GP22
@@ -102,10 +122,41 @@
 #define IRON_ONHOOK_DET_USE_PD  0
 #define IRON_ONHOOK             0
 #define IRON_OFFHOOK            1
+#define IRON_ONHOOK_DEB_US      300000  /* on-hook level held this long := in the cradle [usec] */
+#define IRON_SLEEP_CHECK_US     1000000 /* STANDBY: sleep delay setting re-read at least this often [usec] */
+
+/* ** [TELEMETRY] ------------------------- */
+#define TLM_UART                uart0
+#define TLM_UART_TX             GP0   /* CONSOLE_TX */
+#define TLM_UART_RX             GP1   /* CONSOLE_RX, remote commands (command.h) */
+#define TLM_UART_BAUD           921600  /* 92 kB/s, ~3800 records/s */
+#define TLM_RING_RECS           170     /* records buffered (4 KB) */
+#define TLM_CORE1_RECS          64      /* core1 records waiting for the main loop (power of 2, ~0.3 s of samples) */
+#define CMD_LINE_LEN            120     /* remote command line, chars */
+#define CMD_RX_LEN              256     /* received bytes buffered for the main loop */
 
 /* ** [ADC]  Temp -------------------------- */
 #define ADC_TEMP    GP26
-
+#define ADC_TEMP_CHAN           0     /* GP26 := ADC0 */
+#define ADC_TEMP_FS_DEGC        600   /* tip temp above the cold junction at ADC full scale */
+#define ADC_TEMP_CJ_DEGC        25    /* cold junction temp, no CJ sensor fitted */
+#define ADC_TEMP_OPEN_RAW       4000  /* reading above this := thermocouple open */
+#define ADC_TEMP_SAMPLE_HZ      16000 /* free-running conversion rate */
+#define ADC_TEMP_WINDOW         64    /* conversions captured after a ZC, heater off (power of 2, 4 ms) */
+#define ADC_TEMP_SETTLE         8     /* first conversions of a window discarded, amplifier recovery */
+
+/* ** [ADC]  Heater line sense ------------- */
+#define ADC_VLINE               GP27
+#define ADC_VLINE_CHAN          1     /* GP27 := ADC1 */
+#define ADC_VLINE_FS_MV         50000 /* rectified heater line, divided: instantaneous volts at ADC full scale [mV] */
+#define HTR_RES_MOHM            2880  /* heater cartridge resistance [mOhm], 200 W at 24 Vrms */
+#define HTR_LINE_VRMS_NOM       24    /* heater line, until measured [Vrms] */
+
+
+/* ** [FLASH] Settings store, the last sectors of the flash */
+#define SST_SECTORS             4     /* log sectors, written round robin (wear levelling) */
+#define SST_RETRY_MS            100   /* after a failed flash write, doubled per failure ... */
+#define SST_RETRY_MAX_MS        10000 /* ... up to this */
 
 /* System Definitions and Maximums */
 
@@ -113,8 +164,36 @@
 #define IRON_START_SCALE        'C'
 
 #define IRON_MAX_TEMP           800 /* F */
+#define IRON_TRIP_TEMP_C        450 /* heater forced off above this, deg. Celcius */
 #define IRON_MAX_WATT           200
 #define MAX_TEMP_PRESETS        4   /* 'A', 'B', 'C', 'D' */
 #define SLEEP_DELAY_DEFAULT     20  /* sleep delay default, [sec] */
+#define IRON_STANDBY_TEMP_C     150 /* setpoint cap while in the cradle, deg. Celcius */
+
+/* Boost ('0' key): setpoint raised for a limited time, heater energy capped by a budget */
+#define BOOST_TEMP_C            50    /* added to the setpoint, deg. Celcius */
+#define BOOST_TIME_S            30    /* boost reverts after this [sec] */
+#define BOOST_BUDGET_J          3000  /* heater energy one boost may use, full budget (15 s flat out) [J] */
+#define BOOST_MIN_J             750   /* budget needed to start a boost [J] */
+#define BOOST_RECHARGE_W        20    /* budget refill rate while not boosting [W] */
+
+/* Build options */
+#define FX_BENCH                0   /* '1' logs fixed-point vs float cycle counts at startup */
+#ifndef PRF_ENABLE
+#define PRF_ENABLE              1   /* '1' profiles the hot paths (profile.h), '0' compiles it out */
+#endif
+#define PRF_REPORT_MS           1000 /* profile window, stats sent / shown once per window [msec] */
+
+/* Deadline monitor (deadline.h) */
+#define DL_ZC_DEADLINE_US       1000  /* heater gate set this long after the zero-crossing at the latest [usec] */
+#define DL_ZC_WARN_US           250   /* a half-cycle this late raises the shed level [usec] */
+#define DL_SHED_HOLD_HC         100   /* half-cycles on time before the shed level drops a step */
+#define DL_FRAME_DEADLINE_US    50000 /* meter screen update this late is a miss [usec] */
+#define DL_TLM_THIN             4     /* DL_SHED_TLM: 1 in n controller samples sent */
+#define DL_REPORT_MS            1000  /* deadline window, stats sent once per window [msec] */
+
+/* Timer wheel (timer_wheel.h), the timed tasks on one hardware alarm per core */
+#define TW_TASK_MAX             8     /* task slots */
+#define TW_SLACK_US             20    /* tasks due this soon after the alarm run with it [usec] */
 
 #endif /* BOARD_H */
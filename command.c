@@ -0,0 +1,364 @@
+/******************************************************************************
+ * Remote Commands
+ *
+ * The receive ISR only copies bytes into a ring (CMD_RX_LEN, single
+ * producer / single consumer, no lock) and posts EV_CMD at the end of a
+ * line. The main loop (cmd_poll) collects the lines and runs them. A ring
+ * overrun or a line longer than CMD_LINE_LEN spoils the line it hits, the
+ * line is answered TLM_CMD_ERR_LONG and not run.
+ *
+ * A command's key sequence starts from the top of the menu (ops_reset), a
+ * half typed keypad sequence is dropped.
+ *
+ */
+
+#include <command.h>
+#include <board.h>
+#include <events.h>
+#include <telemetry.h>
+#include <operations.h>
+#include <analog_psu_ctrl.h>
+#include <temp_ctrl.h>
+#include <tip_temp.h>
+#include <standby.h>
+#include <power_meter.h>
+#include "hardware/uart.h"
+#include "hardware/irq.h"
+#include <string.h>
+#include <ctype.h>
+
+#define CMD_MAX_DIGITS  3       /* as on the keypad */
+
+static volatile char     rx_buf[CMD_RX_LEN];
+static volatile uint32_t rx_head = 0;       // ISR owned
+static volatile uint32_t rx_tail = 0;       // main loop owned
+static volatile uint32_t rx_drops = 0;
+static volatile bool     rx_overrun = false;
+static char              line[CMD_LINE_LEN + 1];
+static uint32_t          line_len = 0;
+static bool              line_bad = false;
+static uint32_t          line_count = 0;
+static bool              cmd_running = false;
+
+/* ISR Routine - UART receive FIFO */
+static void cmd_rx_isr(void) {
+    bool eol = false;
+    while (uart_is_readable(TLM_UART)) {
+        char c = uart_getc(TLM_UART);
+        uint32_t h = rx_head;
+        if (h - rx_tail < CMD_RX_LEN) {
+            rx_buf[h % CMD_RX_LEN] = c;
+            rx_head = h + 1;
+        } else {
+            rx_drops ++;
+            rx_overrun = true;
+        }
+        if (c == '\n' || c == '\r') {
+            eol = true;
+        }
+    }
+    if (eol) {
+        ev_post(EV_CMD);
+    }
+}
+
+static const char * skip_ws(const char * p) {
+    while (*p == ' ' || *p == '\t') {
+        p ++;
+    }
+    return p;
+}
+
+// up to CMD_MAX_DIGITS digits into 'keys' (and 'val'), returns the chars used, 0 := none / too many
+static int get_digits(const char * p, char * keys, uint32_t * val) {
+    int n = 0;
+    *val = 0;
+    while (isdigit((unsigned char)p[n])) {
+        if (n == CMD_MAX_DIGITS) {
+            return 0;
+        }
+        keys[n] = p[n];
+        *val = *val * 10 + (uint32_t)(p[n] - '0');
+        n ++;
+    }
+    keys[n] = '\0';
+    return n;
+}
+
+// a set temp within the iron's range, in the current scale
+static bool temp_ok(uint32_t t) {
+    char scale = (char)get_tempScale();
+    return t > 0 && tt_scale_to_cdeg((int32_t)t, scale) <= tt_scale_to_cdeg(IRON_MAX_TEMP, 'F');
+}
+
+static void send_keys(cmd_key_fn key_fn, const char * keys) {
+    ops_reset();
+    while (*keys) {
+        key_fn(*keys++);
+    }
+}
+
+// set temp: the +/- 50, 10, 1 keys from where it is now
+static int cmd_settemp(cmd_key_fn key_fn, const char * arg) {
+    static const uint32_t step[3] = { 50, 10, 1 };
+    static const char inc_key[3] = { '8', '5', '2' };
+    static const char dec_key[3] = { '7', '4', '1' };
+    char digs[CMD_MAX_DIGITS + 1];
+    char keys[2] = { 0, 0 };
+    uint32_t t, cur;
+    int i;
+    if (!get_digits(arg, digs, &t) || *skip_ws(arg + strlen(digs))) {
+        return TLM_CMD_ERR_SYNTAX;
+    }
+    if (!temp_ok(t)) {
+        return TLM_CMD_ERR_RANGE;
+    }
+    for (i = 0 ; i < 3 ; i++) {
+        while ((cur = get_tipTempSetting()) != t && (cur > t ? cur - t : t - cur) >= step[i]) {
+            keys[0] = (cur < t) ? inc_key[i] : dec_key[i];
+            send_keys(key_fn, keys);
+            if (get_tipTempSetting() == cur) {
+                return TLM_CMD_ERR_REFUSED;
+            }
+        }
+    }
+    return (get_tipTempSetting() == t) ? TLM_CMD_OK : TLM_CMD_ERR_REFUSED;
+}
+
+// all four presets: checked first, then set one by one
+static int cmd_presets(cmd_key_fn key_fn, const char * arg) {
+    char digs[MAX_TEMP_PRESETS][CMD_MAX_DIGITS + 1];
+    char keys[CMD_MAX_DIGITS + 4];
+    uint32_t val[MAX_TEMP_PRESETS], t;
+    bool tuned;
+    const char * p = arg;
+    int i, n;
+    for (i = 0 ; i < MAX_TEMP_PRESETS ; i++) {
+        p = skip_ws(p);
+        if (*p == '-') {
+            digs[i][0] = '*'; // clear
+            digs[i][1] = '\0';
+            p ++;
+        } else if ((n = get_digits(p, digs[i], &val[i])) > 0) {
+            if (!temp_ok(val[i])) {
+                return TLM_CMD_ERR_RANGE;
+            }
+            p += n;
+        } else {
+            digs[i][0] = '\0'; // left as is
+        }
+        p = skip_ws(p);
+        if (*p != ((i < MAX_TEMP_PRESETS - 1) ? ',' : '\0')) {
+            return TLM_CMD_ERR_SYNTAX;
+        }
+        p ++;
+    }
+    for (i = 0 ; i < MAX_TEMP_PRESETS ; i++) {
+        if (!digs[i][0]) {
+            continue;
+        }
+        keys[0] = '#';
+        keys[1] = (char)('A' + i);
+        keys[2] = '\0';
+        strcat(keys, digs[i]);
+        if (digs[i][0] != '*') {
+            strcat(keys, "#");
+        }
+        send_keys(key_fn, keys);
+        if (get_tempPreset((char)('A' + i), &t, &tuned) != (digs[i][0] != '*') ||
+            (digs[i][0] != '*' && t != val[i])) {
+            return TLM_CMD_ERR_REFUSED;
+        }
+    }
+    return TLM_CMD_OK;
+}
+
+static int cmd_select(cmd_key_fn key_fn, const char * arg) {
+    char keys[2] = { 0, 0 };
+    keys[0] = (char)toupper((unsigned char)*arg);
+    if (keys[0] < 'A' || keys[0] >= 'A' + MAX_TEMP_PRESETS || *skip_ws(arg + 1)) {
+        return TLM_CMD_ERR_SYNTAX;
+    }
+    send_keys(key_fn, keys);
+    return (get_activePreset() == keys[0]) ? TLM_CMD_OK : TLM_CMD_ERR_REFUSED;
+}
+
+static int cmd_scale(cmd_key_fn key_fn, const char * arg) {
+    char s = (char)toupper((unsigned char)*arg);
+    if ((s != 'C' && s != 'F') || *skip_ws(arg + 1)) {
+        return TLM_CMD_ERR_SYNTAX;
+    }
+    send_keys(key_fn, (s == 'C') ? "#1C" : "#1D");
+    return (get_tempScale() == (uint32_t)s) ? TLM_CMD_OK : TLM_CMD_ERR_REFUSED;
+}
+
+static int cmd_sleepdly(cmd_key_fn key_fn, const char * arg) {
+    char keys[CMD_MAX_DIGITS + 4] = "#2";
+    char digs[CMD_MAX_DIGITS + 1];
+    uint32_t d;
+    int n;
+    if (*arg == '*' && !*skip_ws(arg + 1)) {
+        send_keys(key_fn, "#2*");
+        return (get_sleepDelay() == SLEEP_DELAY_DEFAULT) ? TLM_CMD_OK : TLM_CMD_ERR_REFUSED;
+    }
+    if ((n = get_digits(arg, digs, &d)) == 0 || *skip_ws(arg + n)) {
+        return TLM_CMD_ERR_SYNTAX;
+    }
+    strcat(keys, digs);
+    strcat(keys, "#");
+    send_keys(key_fn, keys);
+    return (get_sleepDelay() == d) ? TLM_CMD_OK : TLM_CMD_ERR_REFUSED;
+}
+
+static int16_t to_i16(int32_t v) {
+    return (int16_t)((v > INT16_MAX) ? INT16_MAX : (v < INT16_MIN + 1) ? INT16_MIN + 1 : v);
+}
+
+static void send_state(void) {
+    tlm_state_t st;
+    tlm_presets_t pr;
+    char scale = (char)get_tempScale();
+    int32_t tip = tc_get_temp();
+    uint32_t t;
+    bool tuned;
+    int i;
+    memset(&st, 0, sizeof(st));
+    st.setpoint = (uint16_t)get_tipTempSetting();
+    st.tip = (tip == TT_TEMP_OPEN) ? INT16_MIN : to_i16(tt_cdeg_to_scale(tip, scale));
+    st.power = (uint16_t)((pm_get_mw() + 500) / 1000);
+    st.sleep_dly = (uint16_t)get_sleepDelay();
+    st.scale = (uint8_t)scale;
+    st.preset = (uint8_t)get_activePreset();
+    st.wake = get_wakeStatus() ? 1 : 0;
+    st.sby = (uint8_t)sby_get_state();
+    st.fault = (uint8_t)tc_get_fault();
+    st.psu_fault = apc_get_fault() ? 1 : 0;
+    st.boost = (uint8_t)((tc_get_boost_left_ms() + 999) / 1000);
+    tlm_put(TLM_REC_STATE, &st);
+    memset(&pr, 0, sizeof(pr));
+    for (i = 0 ; i < MAX_TEMP_PRESETS ; i++) {
+        if (get_tempPreset((char)('A' + i), &t, &tuned)) {
+            pr.temp[i] = (uint16_t)t;
+            pr.tuned |= (uint8_t)(tuned ? 1u << i : 0);
+        }
+    }
+    pr.scale = (uint8_t)scale;
+    tlm_put(TLM_REC_PRESETS, &pr);
+}
+
+static void send_psu(void) {
+    apc_stats_t st;
+    tlm_psu_t rec;
+    int r;
+    for (r = APC_RAIL_P16V ; apc_get_stats(r, &st) == 0 ; r++) {
+        rec.rail = (uint8_t)r;
+        rec.fault = st.fault ? 1 : 0;
+        rec.rsvd = 0;
+        rec.fault_ms = (uint32_t)(st.fault_time_us / 1000);
+        rec.cycles = st.cycles;
+        rec.max_over_us = st.max_over_us;
+        tlm_put(TLM_REC_PSU, &rec);
+    }
+}
+
+// one command, 'c' trimmed
+static int run_cmd(cmd_key_fn key_fn, const char * c) {
+    char op = (char)toupper((unsigned char)c[0]);
+    const char * arg = skip_ws(c + 1);
+    switch (op) {
+    case 'T': return cmd_settemp(key_fn, arg);
+    case 'P': return cmd_presets(key_fn, arg);
+    case 'S': return cmd_select(key_fn, arg);
+    case 'U': return cmd_scale(key_fn, arg);
+    case 'D': return cmd_sleepdly(key_fn, arg);
+    case '?':
+        if (!*arg) {
+            send_state();
+        } else if (toupper((unsigned char)*arg) == 'P' && !*skip_ws(arg + 1)) {
+            send_psu();
+        } else {
+            return TLM_CMD_ERR_SYNTAX;
+        }
+        return TLM_CMD_OK;
+    default:
+        return TLM_CMD_ERR_SYNTAX;
+    }
+}
+
+static void run_line(cmd_key_fn key_fn, char * ln, bool bad) {
+    tlm_ack_t ack;
+    uint32_t start = time_us_32();
+    char * c = ln, * end;
+    int rc = TLM_CMD_OK;
+    memset(&ack, 0, sizeof(ack));
+    ack.line = (uint16_t)++line_count;
+    if (bad) {
+        rc = TLM_CMD_ERR_LONG;
+        ack.failed = 1;
+    }
+    while (!bad && c) {
+        end = strchr(c, ';');
+        if (end) {
+            *end = '\0';
+        }
+        c = (char *)skip_ws(c);
+        if (*c) {
+            char * e = c + strlen(c);
+            while (e > c && (e[-1] == ' ' || e[-1] == '\t')) {
+                *--e = '\0';
+            }
+            rc = run_cmd(key_fn, c);
+            if (rc != TLM_CMD_OK) {
+                ack.failed = (uint8_t)(ack.done + 1);
+                break;
+            }
+            ack.done ++;
+        }
+        c = end ? end + 1 : NULL;
+    }
+    ack.error = (uint8_t)rc;
+    ack.exec_us = time_us_32() - start;
+    ack.rx_drops = rx_drops;
+    tlm_put(TLM_REC_ACK, &ack);
+}
+
+int cmd_init(void) {
+    uint irq = uart_get_index(TLM_UART) ? UART1_IRQ : UART0_IRQ;
+    if (cmd_running) {
+        return 1;
+    }
+    rx_head = rx_tail = 0;
+    line_len = 0;
+    line_bad = false;
+    irq_set_exclusive_handler(irq, cmd_rx_isr);
+    irq_set_enabled(irq, true);
+    uart_set_irq_enables(TLM_UART, true, false);
+    cmd_running = true;
+    return 0;
+}
+
+int cmd_poll(cmd_key_fn key_fn) {
+    int n = 0;
+    while (rx_tail != rx_head) {
+        char c = rx_buf[rx_tail % CMD_RX_LEN];
+        rx_tail ++;
+        if (rx_overrun) {
+            rx_overrun = false;
+            line_bad = true;
+        }
+        if (c == '\n' || c == '\r') {
+            if (line_len || line_bad) {
+                line[line_len] = '\0';
+                run_line(key_fn, line, line_bad);
+                n ++;
+            }
+            line_len = 0;
+            line_bad = false;
+        } else if (line_len < CMD_LINE_LEN) {
+            line[line_len++] = c;
+        } else {
+            line_bad = true;
+        }
+    }
+    return n;
+}
@@ -0,0 +1,43 @@
+/******************************************************************************
+ * Remote Commands
+ *
+ * Line based command interface on the console UART receive pin (TLM_UART,
+ * the transmit side carries the telemetry). A line is one or more commands
+ * separated by ';', '\n' or '\r' terminated, at most CMD_LINE_LEN chars:
+ *
+ *   T <temp>           set temp, in the current scale (as the +/- keys)
+ *   P <a>,<b>,<c>,<d>  presets A .. D at once (as #A350#), '-' clears one
+ *                      (as #A*), empty leaves it as is
+ *   S <A..D>           select a preset (as the preset key)
+ *   U <C|F>            temp scale (as #1C / #1D)
+ *   D <sec>            sleep delay (as #2..#), '*' := the default (#2*)
+ *   ?                  state and presets (TLM_REC_STATE, TLM_REC_PRESETS)
+ *   ?P                 PSU statistics, a TLM_REC_PSU record per rail
+ *
+ * e.g. "U C;P 320,350,380,-;S B;D 120;?" sets up a station in one line.
+ *
+ * The commands run in order, up to the first that fails, from the main
+ * loop: each one is turned into its key sequence and handed key by key to
+ * the same handler as the keypad, so the settings, the screen and the logs
+ * follow as if typed in. The result is read back to check it took. A line
+ * is answered with a TLM_REC_ACK telemetry record.
+ *
+ */
+
+#ifndef _COMMAND_H_
+#define _COMMAND_H_
+
+#include "pico/stdlib.h"
+
+// handler for the keys of a command, as for the keys off the keypad
+typedef void (*cmd_key_fn)(char k);
+
+// Setup the receive interrupt (after tlm_init, the UART is shared). Lines
+// post EV_CMD to the main loop.
+int cmd_init(void);
+
+// Main loop: run the lines received, the keys go to 'key_fn'.
+// Returns the number of lines run.
+int cmd_poll(cmd_key_fn key_fn);
+
+#endif /* _COMMAND_H_ */
@@ -0,0 +1,254 @@
+/******************************************************************************
+ * Deadline Monitor and Load Shedding
+ *
+ * Per task, the writer (dl_run) keeps running totals of runs, misses and
+ * the histogram, and the max of the current window. Closing a window
+ * (dl_poll) takes the totals' difference to the last window and asks the
+ * writer to restart the max with its next run, as the profiler does.
+ *
+ * A measured period (the mains half-cycle) is timed over two runs: the
+ * zero-crossing detector's rising and falling edges are not evenly spaced,
+ * a full cycle is. A run more than DL_RESTART_PDS periods after the last
+ * one means the task was stopped (mains lost, timer mode off), it starts over
+ * rather than counting as late.
+ *
+ */
+
+#include <deadline.h>
+#include <telemetry.h>
+#include "pico/time.h"
+#include <string.h>
+
+#define DL_RESTART_PDS  4
+
+typedef struct dl_task_type {
+    uint32_t          period_us;        // registered, 0 := measured
+    volatile uint32_t deadline_us;      // 0 := not registered
+    volatile uint32_t pd_q4;            // period in use [us/16]
+    volatile uint32_t prev_us[2];       // last starts, newest first
+    volatile uint8_t  valid;            // starts in prev_us
+    volatile uint32_t runs;             // running, writer owned
+    volatile uint32_t missed;
+    volatile uint32_t hist[DL_HIST_BINS];
+    volatile uint32_t max_late;         // this window
+    volatile uint32_t max_late_all;
+    volatile bool     restart;          // set by dl_poll, max starts over
+} dl_task_t;
+
+static dl_task_t  dl_task[TLM_DL_COUNT];
+static dl_stats_t dl_last[TLM_DL_COUNT];    // totals at the last window
+static dl_stats_t dl_win[TLM_DL_COUNT];
+static uint32_t   dl_win_us = 0;
+static bool       dl_running = false;
+
+// shed level, written by the half-cycle only
+static volatile int      dl_shed_level = DL_SHED_NONE;
+static volatile uint32_t dl_shed_late = 0;      // lateness that last raised it
+static volatile uint32_t dl_ok_hc = 0;          // half-cycles on time in a row
+static volatile int      dl_shed_top = DL_SHED_NONE;
+static volatile uint32_t dl_raised = 0;
+static int               dl_shed_logged = DL_SHED_NONE;
+
+static uint32_t hist_bin(uint32_t late_us) {
+    uint32_t b = 0, v = late_us / DL_HIST_MIN_US;
+    while (v && b < DL_HIST_BINS - 1) {
+        v >>= 1;
+        b ++;
+    }
+    return b;
+}
+
+// ISR - the half-cycle's lateness raises / lowers the shed level
+static void shed_step(uint32_t late_us) {
+    if (late_us >= DL_ZC_WARN_US) {
+        dl_ok_hc = 0;
+        dl_shed_late = late_us;
+        if (dl_shed_level < DL_SHED_MAX) {
+            dl_shed_level ++;
+            dl_raised ++;
+            if (dl_shed_level > dl_shed_top) {
+                dl_shed_top = dl_shed_level;
+            }
+        }
+    } else if (dl_shed_level > DL_SHED_NONE && ++dl_ok_hc >= DL_SHED_HOLD_HC) {
+        dl_ok_hc = 0;
+        dl_shed_level --;
+    }
+}
+
+// ISR safe, one writer per 'task'.
+void dl_run(uint32_t task, uint32_t start_us) {
+    dl_task_t * t;
+    uint32_t span, iv, pd, late;
+    if (task >= TLM_DL_COUNT || !dl_running || !dl_task[task].deadline_us) {
+        return;
+    }
+    t = &dl_task[task];
+    span = t->period_us ? 1 : 2;
+    iv = start_us - t->prev_us[span - 1];
+    t->prev_us[1] = t->prev_us[0];
+    t->prev_us[0] = start_us;
+    if (t->valid < span) {
+        t->valid ++;
+        return;
+    }
+    if (!t->pd_q4) {
+        t->pd_q4 = iv * 16 / span; // first measured period
+        return;
+    }
+    pd = span * (t->pd_q4 / 16);
+    if (iv > DL_RESTART_PDS * pd) {
+        t->valid = 1; // stopped, start over
+        return;
+    }
+    if (!t->period_us && iv < pd + pd / 2) {
+        t->pd_q4 += ((int32_t)(iv * 16 / span) - (int32_t)t->pd_q4) / 16;
+    }
+    late = ((iv > pd) ? iv - pd : 0) + (time_us_32() - start_us);
+    if (t->restart) {
+        t->max_late = late;
+        t->restart = false;
+    } else if (late > t->max_late) {
+        t->max_late = late;
+    }
+    if (late > t->max_late_all) {
+        t->max_late_all = late;
+    }
+    if (late > t->deadline_us) {
+        t->missed ++;
+    }
+    t->hist[hist_bin(late)] ++;
+    t->runs ++;
+    if (task == TLM_DL_ZC) {
+        shed_step(late);
+    }
+}
+
+void dl_skip(uint32_t task) {
+    if (task < TLM_DL_COUNT) {
+        dl_task[task].valid = 0;
+    }
+}
+
+int dl_init(void) {
+    memset(dl_task, 0, sizeof(dl_task));
+    memset(dl_last, 0, sizeof(dl_last));
+    memset(dl_win, 0, sizeof(dl_win));
+    dl_shed_level = DL_SHED_NONE;
+    dl_shed_logged = DL_SHED_NONE;
+    dl_shed_top = DL_SHED_NONE;
+    dl_ok_hc = 0;
+    dl_raised = 0;
+    dl_win_us = time_us_32();
+    dl_running = true;
+    return 0;
+}
+
+int dl_register(uint32_t task, uint32_t period_us, uint32_t deadline_us) {
+    dl_task_t * t;
+    if (task >= TLM_DL_COUNT || !deadline_us) {
+        return 1;
+    }
+    t = &dl_task[task];
+    t->deadline_us = 0;
+    t->period_us = period_us;
+    t->pd_q4 = period_us * 16;
+    t->valid = 0;
+    t->restart = true;
+    t->deadline_us = deadline_us; // last, enables dl_run
+    return 0;
+}
+
+int dl_get_shed(void) {
+    return dl_shed_level;
+}
+
+bool dl_is_shed(int level) {
+    return dl_shed_level >= level;
+}
+
+int dl_get_shed_max(uint32_t * raised) {
+    if (raised) {
+        *raised = dl_raised;
+    }
+    return dl_shed_top;
+}
+
+bool dl_poll(void) {
+    dl_task_t * t;
+    dl_stats_t * w, * l;
+    tlm_deadline_t rec;
+    uint32_t i, b, n, m;
+    int shed = dl_shed_level;
+    if (!dl_running) {
+        return false;
+    }
+    if (shed != dl_shed_logged) {
+        dl_shed_logged = shed;
+        tlm_log(TLM_LOG_DL_SHED, (uint32_t)shed, dl_shed_late, 0);
+    }
+    if ((time_us_32() - dl_win_us) < DL_REPORT_MS * 1000u) {
+        return false;
+    }
+    dl_win_us = time_us_32();
+    for (i = 0 ; i < TLM_DL_COUNT ; i++) {
+        t = &dl_task[i];
+        w = &dl_win[i];
+        l = &dl_last[i];
+        if (!t->deadline_us) {
+            continue;
+        }
+        n = t->runs;
+        m = t->missed;
+        w->period_us = t->pd_q4 / 16;
+        w->deadline_us = t->deadline_us;
+        w->runs = n - l->runs;
+        w->missed = m - l->missed;
+        w->max_late_us = w->runs ? t->max_late : 0;
+        for (b = 0 ; b < DL_HIST_BINS ; b++) {
+            uint32_t h = t->hist[b];
+            w->hist[b] = h - l->hist[b];
+            l->hist[b] = h;
+        }
+        t->restart = true;
+        l->runs = n;
+        l->missed = m;
+        if (w->runs) {
+            rec.task = (uint8_t)i;
+            rec.shed = (uint8_t)shed;
+            rec.missed = (uint16_t)((w->missed > 0xFFFF) ? 0xFFFF : w->missed);
+            rec.max_late_us = w->max_late_us;
+            for (b = 0 ; b < DL_HIST_BINS ; b++) {
+                rec.hist[b] = (uint8_t)((w->hist[b] > 0xFF) ? 0xFF : w->hist[b]);
+            }
+            tlm_put(TLM_REC_DEADLINE, &rec);
+        }
+    }
+    return true;
+}
+
+int dl_get_stats(uint32_t task, dl_stats_t * st) {
+    if (task >= TLM_DL_COUNT || !dl_task[task].deadline_us) {
+        return 1;
+    }
+    *st = dl_win[task];
+    return 0;
+}
+
+int dl_get_totals(uint32_t task, dl_stats_t * st) {
+    dl_task_t * t;
+    uint32_t b;
+    if (task >= TLM_DL_COUNT || !dl_task[task].deadline_us) {
+        return 1;
+    }
+    t = &dl_task[task];
+    st->period_us = t->pd_q4 / 16;
+    st->deadline_us = t->deadline_us;
+    st->runs = t->runs;
+    st->missed = t->missed;
+    st->max_late_us = t->max_late_all;
+    for (b = 0 ; b < DL_HIST_BINS ; b++) {
+        st->hist[b] = t->hist[b];
+    }
+    return 0;
+}
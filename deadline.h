@@ -0,0 +1,95 @@
+/******************************************************************************
+ * Deadline Monitor and Load Shedding
+ *
+ * Timestamps the periodic tasks (TLM_DL_TASKS, telemetry_rec.h). A task
+ * reports each run with dl_run(task, start): the run's lateness is how much
+ * later than one period after the previous start it started, plus its own
+ * run time. A run later than the task's deadline is a miss. Lateness goes
+ * into a log2 histogram, bin 0 < 16 us, bin i < 16 << i us, the last bin
+ * takes the rest.
+ *
+ *   zc          the mains half-cycle (zc_isr), up to the heater gate being
+ *               set. Period: the measured half-cycle, deadline
+ *               DL_ZC_DEADLINE_US.
+ *   psu_scan    chk_thresholds, the PSU timer (timer mode only, the PIO
+ *               regulator has no periodic task)
+ *   keypad_scan chk_keyboard, the keypad timer (timer scan only)
+ *   frame       the meter screen update in the main loop
+ *
+ * The half-cycle is the control path (core1, rt_core.h): a half-cycle later
+ * than DL_ZC_WARN_US raises the shed level one step, DL_SHED_HOLD_HC
+ * half-cycles in a row on time lower it one step. Only core1 work competes
+ * with the half-cycle, so only core1 work is shed, in this order:
+ *
+ *   DL_SHED_METER   the power meter's line sense sampling (a core1 timer
+ *                   task, interrupts off for the conversion) is paused, the
+ *                   last line amplitude is kept
+ *   DL_SHED_TLM     controller samples are thinned to 1 in DL_TLM_THIN
+ *
+ * Core0 work (frames, flash writes) is not shed: it runs on the other core
+ * and cannot delay a half-cycle. Its lateness is still monitored (frame).
+ *
+ * Each task has one writer, dl_run takes no lock. The main loop (dl_poll)
+ * closes a window every DL_REPORT_MS and sends one TLM_REC_DEADLINE record
+ * per task that ran, and logs changes of the shed level.
+ *
+ */
+
+#ifndef _DEADLINE_H_
+#define _DEADLINE_H_
+
+#include <board.h>
+#include <telemetry_rec.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// shed levels, each sheds the work of the levels below as well
+#define DL_SHED_NONE    0
+#define DL_SHED_METER   1
+#define DL_SHED_TLM     2
+#define DL_SHED_MAX     DL_SHED_TLM
+
+#define DL_HIST_BINS    8
+#define DL_HIST_MIN_US  16
+
+typedef struct dl_stats_type {
+    uint32_t period_us;     // 0 := not registered
+    uint32_t deadline_us;
+    uint32_t runs;          // in the window
+    uint32_t missed;
+    uint32_t max_late_us;
+    uint32_t hist[DL_HIST_BINS];
+} dl_stats_t;
+
+// Clear the stats, start the first window. Call first.
+int dl_init(void);
+
+// Watch 'task': period 0 := measured from the runs (the mains half-cycle)
+int dl_register(uint32_t task, uint32_t period_us, uint32_t deadline_us);
+
+// ISR safe, one caller per task: a run that started at 'start_us' is done
+void dl_run(uint32_t task, uint32_t start_us);
+
+// The task was skipped (shed), its next run starts over
+void dl_skip(uint32_t task);
+
+// Current shed level, DL_SHED_xxx
+int dl_get_shed(void);
+
+// true := work of shed level 'level' is to be skipped now
+bool dl_is_shed(int level);
+
+// Highest shed level reached and the times it was raised, since dl_init
+int dl_get_shed_max(uint32_t * raised);
+
+// Main loop: close the window every DL_REPORT_MS. Returns true when a new
+// window is out.
+bool dl_poll(void);
+
+// Stats of 'task' over the last window, 0 := ok
+int dl_get_stats(uint32_t task, dl_stats_t * st);
+
+// Stats of 'task' since dl_init, 0 := ok
+int dl_get_totals(uint32_t task, dl_stats_t * st);
+
+#endif /* _DEADLINE_H_ */
@@ -0,0 +1,295 @@
+/******************************************************************************
+ * SSD1309 Panel Transfers
+ * 
+ * Dirty tracking against a shadow of the panel GDDRAM. For every page the
+ * first and last changed column give the window to send; runs of pages 
+ * with the same window are merged and sent as one (horizontal addressing 
+ * mode wraps the column back to the window start on each new page):
+ * 
+ *  [DC=0] 0x21 x0 x1  0x22 p0 p1   [DC=1] (x1-x0+1) * (p1-p0+1) bytes
+ * 
+ * A one digit change of the tip temperature then costs about a hundred 
+ * bytes instead of a 1 KB frame.
+ * 
+ * Double buffered DMA transfers: the changed bytes of a frame are copied
+ * into a free transfer buffer (the shadow is updated at the same time, so
+ * it always holds what the panel will show once the queue is empty) and 
+ * the buffer is queued. The DMA completion ISR walks the windows of the 
+ * active buffer: wait for the shifter to drain, send the 6 address bytes
+ * (DC low), then DMA the window's data (DC high). When the active buffer
+ * is done the queued one is started, else the completion callback is run.
+ * 
+ * The graphics driver pushes each composited frame as one SPI write of the
+ * whole GDDRAM (DC high) after its own full frame address window. The link
+ * wraps the driver's spi_write_blocking() calls (CMakeLists.txt): such a
+ * frame is staged here and the call returns at once; the full frame window
+ * is dropped (every window sent here carries its own). Any other write
+ * (driver commands, a frame written in pieces) waits for the queue to
+ * empty and goes out as it is.
+ * 
+ * The driver raises CS and moves DC as soon as its call returns, so while
+ * a transfer runs both pins are held through the pad output override and
+ * the driver's own levels only reach the pins again once the queue is
+ * empty.
+ * 
+ */
+
+#include <disp_panel.h>
+#include <gfxDriverLowPriv.h>
+#include <board.h>
+#include "hardware/spi.h"
+#include "hardware/gpio.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include <string.h>
+
+#define SSD1309_SET_MEM_MODE    0x20
+#define SSD1309_MEM_MODE_HORZ   0x00
+#define SSD1309_SET_COL_ADDR    0x21
+#define SSD1309_SET_PAGE_ADDR   0x22
+#define SSD1309_WIN_CMD_LEN     6
+
+#define NO_CHANGE               0xFF    /* page window start, page is clean */
+#define PNL_PIN_LOW             GPIO_OVERRIDE_LOW
+#define PNL_PIN_HIGH            GPIO_OVERRIDE_HIGH
+#define PNL_PIN_DRIVER          GPIO_OVERRIDE_NORMAL    /* the driver's level */
+#define PNL_DMA_IRQ             DMA_IRQ_1
+
+// one frame's worth of changes
+typedef struct pnl_xfer_type {
+    uint8_t  nwin;
+    uint8_t  win[GFX_DISP_PAGES][SSD1309_WIN_CMD_LEN];  // address window commands
+    uint16_t win_len[GFX_DISP_PAGES];                   // data bytes per window
+    uint8_t  data[GFX_DISP_PAGES * GFX_DISP_WIDTH];
+} pnl_xfer_t;
+
+static uint8_t       shadow[GFX_DISP_PAGES][GFX_DISP_WIDTH];  // panel content, after the queue
+static bool          shadow_valid = false;
+static pnl_xfer_t    xfer[2];
+static volatile int  xfer_active = -1;      // buffer on the wire
+static volatile int  xfer_queued = -1;      // buffer waiting behind it
+static uint8_t       cur_win;               // next window of the active buffer
+static uint16_t      cur_off;               // ... and its data offset
+static int           pnl_dma = -1;
+static volatile pnl_done_cb_t done_cb = NULL;
+static pnl_stats_t   stats;
+
+// the driver's address window ahead of each full frame
+static const uint8_t full_win[SSD1309_WIN_CMD_LEN] = {
+    SSD1309_SET_COL_ADDR, 0, GFX_DISP_WIDTH - 1, SSD1309_SET_PAGE_ADDR, 0, GFX_DISP_PAGES - 1
+};
+
+// the SDK's write, the driver's calls are wrapped (__wrap_spi_write_blocking)
+int __real_spi_write_blocking(spi_inst_t * spi, const uint8_t * src, size_t len);
+
+static void spi_drain(void) {
+    while (spi_is_busy(DISP_DRVR_SPI_CHAN)) {
+        tight_loop_contents();
+    }
+    // discard what was clocked in while sending
+    while (spi_is_readable(DISP_DRVR_SPI_CHAN)) {
+        (void)spi_get_hw(DISP_DRVR_SPI_CHAN)->dr;
+    }
+    spi_get_hw(DISP_DRVR_SPI_CHAN)->icr = SPI_SSPICR_RORIC_BITS;
+}
+
+// start the next window of the active buffer, or finish it. ISR or IRQs off.
+static void xfer_next(void) {
+    pnl_xfer_t * x;
+    while (xfer_active >= 0) {
+        x = &xfer[xfer_active];
+        spi_drain();
+        if (cur_win < x->nwin) {
+            gpio_set_outover(DISP_DRVR_SPI_GPIO_DC, PNL_PIN_LOW);
+            __real_spi_write_blocking(DISP_DRVR_SPI_CHAN, x->win[cur_win], SSD1309_WIN_CMD_LEN);
+            gpio_set_outover(DISP_DRVR_SPI_GPIO_DC, PNL_PIN_HIGH);
+            dma_channel_transfer_from_buffer_now(pnl_dma, &x->data[cur_off], x->win_len[cur_win]);
+            cur_off += x->win_len[cur_win];
+            cur_win ++;
+            return;
+        }
+        // buffer done, start the queued one if any
+        xfer_active = xfer_queued;
+        xfer_queued = -1;
+        cur_win = 0;
+        cur_off = 0;
+    }
+    // queue empty, the pins go back to the driver
+    gpio_set_outover(DISP_DRVR_SPI_GPIO_DC, PNL_PIN_DRIVER);
+    gpio_set_outover(DISP_DRVR_SPI_CS, PNL_PIN_DRIVER);
+    if (done_cb) {
+        done_cb();
+    }
+}
+
+/* ISR Routine - panel DMA channel complete */
+static void pnl_dma_isr(void) {
+    if (dma_channel_get_irq1_status(pnl_dma)) {
+        dma_channel_acknowledge_irq1(pnl_dma);
+        xfer_next();
+    }
+}
+
+// changed column window [x0, x1] of page 'p', x0 := NO_CHANGE if none
+static void page_window(const uint8_t * row, int p, uint8_t * x0, uint8_t * x1) {
+    int a = 0, b = GFX_DISP_WIDTH - 1;
+    if (shadow_valid) {
+        while (a < GFX_DISP_WIDTH && row[a] == shadow[p][a]) a++;
+        if (a == GFX_DISP_WIDTH) {
+            *x0 = NO_CHANGE;
+            *x1 = 0;
+            return;
+        }
+        while (row[b] == shadow[p][b]) b--;
+    }
+    *x0 = (uint8_t)a;
+    *x1 = (uint8_t)b;
+}
+
+// Setup the panel transfers, call after the graphics driver is started.
+int pnl_init(void) {
+    const uint8_t mode[] = { SSD1309_SET_MEM_MODE, SSD1309_MEM_MODE_HORZ };
+    dma_channel_config c;
+    memset(&stats, 0, sizeof(stats));
+    shadow_valid = false;
+    xfer_active = xfer_queued = -1;
+    pnl_set_spi_clock(DISP_PANEL_SPI_CLK_HZ);
+    gpio_put(DISP_DRVR_SPI_GPIO_DC, 0);
+    gpio_put(DISP_DRVR_SPI_CS, 0);
+    __real_spi_write_blocking(DISP_DRVR_SPI_CHAN, mode, sizeof(mode));
+    gpio_put(DISP_DRVR_SPI_CS, 1);
+    stats.bytes += sizeof(mode);
+    // byte DMA into the SPI TX FIFO, paced by its DREQ
+    pnl_dma = dma_claim_unused_channel(true);
+    c = dma_channel_get_default_config(pnl_dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, spi_get_dreq(DISP_DRVR_SPI_CHAN, true));
+    dma_channel_configure(pnl_dma, &c, &spi_get_hw(DISP_DRVR_SPI_CHAN)->dr, NULL, 0, false);
+    dma_channel_set_irq1_enabled(pnl_dma, true);
+    irq_set_exclusive_handler(PNL_DMA_IRQ, pnl_dma_isr);
+    irq_set_enabled(PNL_DMA_IRQ, true);
+    return 0;
+}
+
+// Queue the changes in 'frame' for the panel and return
+int pnl_write_frame(const uint8_t * frame) {
+    uint8_t x0[GFX_DISP_PAGES], x1[GFX_DISP_PAGES];
+    pnl_xfer_t * x;
+    int p, q, n, buf;
+    uint32_t irq;
+    stats.frames ++;
+    for (p = 0 ; p < GFX_DISP_PAGES ; p++) {
+        page_window(&frame[p * GFX_DISP_WIDTH], p, &x0[p], &x1[p]);
+    }
+    shadow_valid = true;
+    for (p = 0 ; p < GFX_DISP_PAGES && x0[p] == NO_CHANGE ; p++);
+    if (p == GFX_DISP_PAGES) {
+        return 0; // nothing changed
+    }
+    // a free buffer: neither on the wire nor queued
+    if (xfer_queued >= 0) {
+        stats.stalls ++;
+        while (xfer_queued >= 0) {
+            tight_loop_contents();
+        }
+    }
+    buf = (xfer_active == 0) ? 1 : 0;
+    x = &xfer[buf];
+    x->nwin = 0;
+    n = 0;
+    for (p = 0 ; p < GFX_DISP_PAGES ; p = q) {
+        int w;
+        // run of pages [p, q) with the same window
+        for (q = p + 1 ; q < GFX_DISP_PAGES && x0[q] == x0[p] && x1[q] == x1[p] ; q++);
+        if (x0[p] == NO_CHANGE) {
+            continue;
+        }
+        w = x1[p] - x0[p] + 1;
+        x->win[x->nwin][0] = SSD1309_SET_COL_ADDR;
+        x->win[x->nwin][1] = x0[p];
+        x->win[x->nwin][2] = x1[p];
+        x->win[x->nwin][3] = SSD1309_SET_PAGE_ADDR;
+        x->win[x->nwin][4] = (uint8_t)p;
+        x->win[x->nwin][5] = (uint8_t)(q - 1);
+        x->win_len[x->nwin] = (uint16_t)(w * (q - p));
+        x->nwin ++;
+        for ( ; p < q ; p++) {
+            memcpy(&x->data[n], &frame[p * GFX_DISP_WIDTH + x0[p]], w);
+            memcpy(&shadow[p][x0[p]], &frame[p * GFX_DISP_WIDTH + x0[p]], w);
+            n += w;
+        }
+    }
+    stats.frames_sent ++;
+    stats.windows += x->nwin;
+    stats.bytes += n + x->nwin * SSD1309_WIN_CMD_LEN;
+    // hand over: queue behind the active one, or start now
+    irq = save_and_disable_interrupts();
+    if (xfer_active >= 0) {
+        xfer_queued = buf;
+    } else {
+        xfer_active = buf;
+        cur_win = 0;
+        cur_off = 0;
+        gpio_set_outover(DISP_DRVR_SPI_CS, PNL_PIN_LOW);
+        xfer_next();
+    }
+    restore_interrupts(irq);
+    return 0;
+}
+
+// The driver's SPI writes (linked with --wrap=spi_write_blocking): a full
+// frame of data for the panel is staged for the dirty tracking and the call
+// returns, its address window is dropped. Anything else waits for the queue.
+int __wrap_spi_write_blocking(spi_inst_t * spi, const uint8_t * src, size_t len) {
+    if (spi == DISP_DRVR_SPI_CHAN && pnl_dma >= 0) {
+        if (gpio_get_out_level(DISP_DRVR_SPI_GPIO_DC)) {
+            if (len == GFX_DISP_PAGES * GFX_DISP_WIDTH) {
+                pnl_write_frame(src);
+                return (int)len;
+            }
+        } else if (len == sizeof(full_win) && !memcmp(src, full_win, len)) {
+            return (int)len;
+        }
+        pnl_wait();
+    }
+    return __real_spi_write_blocking(spi, src, len);
+}
+
+// Send the next frame in full (panel content unknown)
+void pnl_invalidate(void) {
+    shadow_valid = false;
+}
+
+// transfer in progress ?
+bool pnl_busy(void) {
+    return xfer_active >= 0;
+}
+
+// wait for all queued frames to reach the panel
+void pnl_wait(void) {
+    while (xfer_active >= 0) {
+        tight_loop_contents();
+    }
+}
+
+void pnl_set_done_cb(pnl_done_cb_t cb) {
+    done_cb = cb;
+}
+
+// Set the panel SPI clock [Hz], limited to DISP_PANEL_SPI_CLK_MAX_HZ.
+uint32_t pnl_set_spi_clock(uint32_t hz) {
+    if (hz > DISP_PANEL_SPI_CLK_MAX_HZ) {
+        hz = DISP_PANEL_SPI_CLK_MAX_HZ;
+    }
+    pnl_wait();
+    return spi_set_baudrate(DISP_DRVR_SPI_CHAN, hz);
+}
+
+void pnl_get_stats(pnl_stats_t * s) {
+    if (s) {
+        *s = stats;
+    }
+}
@@ -0,0 +1,64 @@
+/******************************************************************************
+ * SSD1309 Panel Transfers
+ * 
+ * Takes the composited frames from the graphics driver stack (its frame
+ * writes are wrapped at link time, see disp_panel.c) and sends only what
+ * changed to the panel. A shadow copy of the panel's GDDRAM is kept;
+ * each frame is compared against it page by page and only the changed column
+ * window of each page goes over SPI.
+ * 
+ * Transfers are DMA driven and do not block: a frame is staged (the caller's
+ * buffer is free on return) and sent in the background, so the driver's
+ * frame push returns in the time of the compare and copy. One more frame
+ * can be staged behind the one on the wire; only a driver command sent
+ * while frames are queued waits for them.
+ * 
+ */
+
+#ifndef _DISP_PANEL_H_
+#define _DISP_PANEL_H_
+
+#include "pico/stdlib.h"
+
+// transfer statistics
+typedef struct pnl_stats_type {
+    uint32_t frames;        // frames submitted
+    uint32_t frames_sent;   // ... with any change to send
+    uint32_t windows;       // address windows sent
+    uint32_t bytes;         // SPI bytes, commands + data
+    uint32_t stalls;        // submits that had to wait for a free buffer
+} pnl_stats_t;
+
+// completion callback, runs from the DMA ISR once the last queued frame
+// is on the panel
+typedef void (*pnl_done_cb_t)(void);
+
+// Setup the panel transfers, call after the graphics driver is started
+// (on the core that is to take the DMA interrupt). The SPI clock is raised
+// to DISP_PANEL_SPI_CLK_HZ. The first frame is sent in full.
+int pnl_init(void);
+
+// Queue the changes in 'frame' (GFX_DISP_PAGES x GFX_DISP_WIDTH, SSD1309 
+// GDDRAM layout) for the panel and return. 'frame' is not referenced after
+// the call. Only waits if two frames are already queued.
+int pnl_write_frame(const uint8_t * frame);
+
+// Send the next frame in full (panel content unknown)
+void pnl_invalidate(void);
+
+// transfer in progress ?
+bool pnl_busy(void);
+
+// wait for all queued frames to reach the panel
+void pnl_wait(void);
+
+// set the completion callback, NULL to remove
+void pnl_set_done_cb(pnl_done_cb_t cb);
+
+// Set the panel SPI clock [Hz], limited to DISP_PANEL_SPI_CLK_MAX_HZ.
+// Returns the clock actually set. Waits for any transfer to finish.
+uint32_t pnl_set_spi_clock(uint32_t hz);
+
+void pnl_get_stats(pnl_stats_t * s);
+
+#endif /* _DISP_PANEL_H_ */
@@ -5,6 +5,14 @@
  * Declare methods to change the display
  * Add a poll() method to refresh the display
  * 
+ * The disp_* calls only record the new value in a display model and mark
+ * it dirty; disp_refresh() marks the model for a render pass and returns.
+ * The main loop runs the pass (disp_poll) once it has handled its events:
+ * the changed items are drawn through the graphics layers and the panel
+ * gets the changed pages (SPI DMA). Updates made before the pass are
+ * coalesced into it. All of it is core0, core1 is the heater's (rt_core.h):
+ * a slow frame delays the next key or meter update, never a half-cycle.
+ * 
  */
 
 #include <display.h>
@@ -12,8 +20,12 @@
 #include <linegfx.h>
 #include <textgfx.h>
 #include <led_overlay.h>
+#include <disp_panel.h>
 #include <jbc_util.h>
+#include <fixed_math.h>
 #include <board.h>  /* system limits */
+#include <profile.h>
+#include <string.h>
 
 /* Screen Setup - START */
 /* for now this is a simple 2 lines of text, can improve later.
@@ -44,6 +56,9 @@
     /* Temp Scale Indicator */
 #define TMPSCALE_TEXT_LINE  WATT_TEXT_LINE
 #define TMPSCALE_TEXT_XPOS  18
+    /* boost (BOOST nnns) / tuning (TUNING), blank when off */
+#define BOOST_TEXT_LINE     7
+#define BOOST_TEXT_XPOS     11
     /* Power BAR indicator */
 #define PWR_BAR_TL_X        4       /* try to line up with Wattage text*/
 #define PWR_BAR_TL_Y        48
@@ -98,22 +113,229 @@
  * | *******  COOL
  * |
  * | (bar)       W
- * |
+ * |          BOOST  nns
  * 
  * "PRESET" Text X-pos start-char = 11
  */
 static const char op_txt_overlay[] = "\n           PSET A\n           TEMP 300\n           HEAT *\n           COOL\n\n              W\n";
 
 
+// display model, the changes since the last render pass
+#define DM_SCREEN       (1u << 0)
+#define DM_PRESET       (1u << 1)
+#define DM_TIP_TEMP     (1u << 2)
+#define DM_PSET_TEMP    (1u << 3)
+#define DM_HEAT_COOL    (1u << 4)
+#define DM_PWR_BAR      (1u << 5)
+#define DM_PWR_TXT      (1u << 6)
+#define DM_TEMP_SCALE   (1u << 7)
+#define DM_BOOST        (1u << 8)
+#define DM_TUNE         (1u << 9)
+#define DM_DIAG         (1u << 10)
+#define DM_REFRESH      (1u << 31)  /* push to the panel */
+#define DM_OP_ITEMS     (DM_PRESET | DM_TIP_TEMP | DM_PSET_TEMP | DM_HEAT_COOL | DM_PWR_BAR | DM_PWR_TXT | DM_TEMP_SCALE | DM_BOOST | DM_TUNE)
+
+#define SCRN_NONE       0
+#define SCRN_START      1
+#define SCRN_OPS        2
+#define SCRN_DIAG       3
+
+typedef struct disp_model_type {
+    uint32_t dirty;         // items changed since the last pass
+    uint32_t valid;         // items ever set (redrawn after a screen change)
+    int      screen;
+    char     preset;
+    int      tip_temp;
+    int      pset_temp;
+    bool     is_heating;
+    int      pwr_percent;
+    int      pwr_watts;
+    char     temp_scale;
+    int      boost_secs;    // 0 := boost off
+    bool     tuning;
+    char     diag[DIAG_LINES][DIAG_LINE_LEN + 1];
+} disp_model_t;
+
 static bool is_initialized = false;
 static void * led_hndl = NULL;
+static disp_model_t model;
+
+// ***************************************************************************
+// Render Service (disp_poll)
+// ***************************************************************************
+
+static void add_border_gfx(void) {
+    lgfx_box(BRDR_X1, BRDR_Y1, BRDR_X2, BRDR_Y2, COLOUR_BLK);
+    lgfx_line(LIN1_X1, LIN1_Y1, LIN1_X2, LIN1_Y2, COLOUR_BLK);
+    lgfx_visibility(1);
+}
+
+static void rnd_startscrn(void) {
+    textgfx_clear();
+    REPORT_BRD_INFO;
+    REPORT_FW_VERSION;
+    textgfx_puts("FRAXSYS ENG.\n");
+}
+
+static void rnd_opscrn(void) {
+    textgfx_clear();
+    textgfx_puts(op_txt_overlay);
+    ledo_visible(1); // make visible
+    // border graphics (line art)
+    add_border_gfx();
+}
+
+static void rnd_preset_show(char P) {
+    textgfx_cursor(PRESET_TEXT_XPOS, PRESET_TEXT_LINE);
+    textgfx_putc(P);
+}
+
+#define TEMP_PSET_CHAR_LEN  3
+static char temp_pset[TEMP_PSET_CHAR_LEN+1];
+static void rnd_pset_temp(int T) {
+    if (i_to_strflen((uint32_t)T, temp_pset, TEMP_PSET_CHAR_LEN+1, TEMP_PSET_CHAR_LEN) != NULL) {
+        textgfx_cursor(PRESET_TXT_TMP_XP, PRESET_TXT_TMP_LN);
+        textgfx_puts(temp_pset);
+    }
+}
+
+static void rnd_heat_cool(bool is_heating) {
+    textgfx_cursor(HEAT_IND_XPOS, HEAT_IND_LINE);
+    textgfx_putc( (is_heating) ? '*' : ' ' );
+    textgfx_cursor(COOL_IND_XPOS, COOL_IND_LINE);
+    textgfx_putc( (is_heating) ? ' ' : '*' );
+}
+
+static void rnd_pwr_bar(int percent) {
+    uint8_t plen = (uint8_t)fx_scale(percent, PWR_BAR_W, 100);
+    // power bar-graph and surrounding box/border
+    lgfx_box(PWR_BAR_BOX_X1, PWR_BAR_BOX_Y1, PWR_BAR_BOX_X2, PWR_BAR_BOX_Y2, COLOUR_BLK);
+    lgfx_bgraph(PWR_BAR_TL_X, PWR_BAR_TL_Y, PWR_BAR_H, PWR_BAR_W, plen, COLOUR_BLK);
+}
+
+#define PWR_WATTAGE_CHAR_LEN  3
+static char pwr_wattage[PWR_WATTAGE_CHAR_LEN+1];
+static void rnd_pwr_txt(int P) {
+    if (i_to_strflen((uint32_t)P, pwr_wattage, PWR_WATTAGE_CHAR_LEN+1, PWR_WATTAGE_CHAR_LEN) != NULL) {
+        textgfx_cursor(WATT_TEXT_XPOS, WATT_TEXT_LINE);
+        textgfx_puts(pwr_wattage);
+    }
+}
+
+static void rnd_settemp_scale(char S) {
+    textgfx_cursor(TMPSCALE_TEXT_XPOS, TMPSCALE_TEXT_LINE);
+    textgfx_putc(S);
+}
+
+#define BOOST_SECS_CHAR_LEN  3
+static char boost_secs[BOOST_SECS_CHAR_LEN+1];
+static void rnd_boost(int secs) {
+    textgfx_cursor(BOOST_TEXT_XPOS, BOOST_TEXT_LINE);
+    if (secs > 0 && i_to_strflen((uint32_t)secs, boost_secs, BOOST_SECS_CHAR_LEN+1, BOOST_SECS_CHAR_LEN) != NULL) {
+        textgfx_puts("BOOST");
+        textgfx_puts(boost_secs);
+        textgfx_putc('s');
+    } else {
+        textgfx_puts("         ");
+    }
+}
+
+// shares the boost field, the two never run together
+static void rnd_tune(void) {
+    textgfx_cursor(BOOST_TEXT_XPOS, BOOST_TEXT_LINE);
+    textgfx_puts("TUNING   ");
+}
+
+// diagnostics: DIAG_LINES lines of text, the panel to itself
+static void rnd_diagscrn(void) {
+    textgfx_clear();
+    ledo_visible(0);
+    lgfx_visibility(0);
+}
+
+static void rnd_diag(const disp_model_t * m) {
+    int i;
+    for (i = 0 ; i < DIAG_LINES ; i++) {
+        textgfx_cursor(0, i);
+        textgfx_puts(m->diag[i]);
+    }
+}
+
+// draw everything that changed in 'm' and push the frame
+static void render(const disp_model_t * m) {
+    uint32_t d = m->dirty;
+    PRF_MARK(pm);
+    if (d & DM_SCREEN) {
+        if (m->screen == SCRN_START) {
+            rnd_startscrn();
+        } else if (m->screen == SCRN_OPS) {
+            rnd_opscrn();
+            d |= m->valid & DM_OP_ITEMS; // template overwrote them
+        } else if (m->screen == SCRN_DIAG) {
+            rnd_diagscrn();
+            d |= m->valid & DM_DIAG;
+        }
+    }
+    if (m->screen == SCRN_DIAG && (d & DM_DIAG)) {
+        rnd_diag(m);
+    }
+    if (m->screen == SCRN_OPS) {
+        if (d & DM_PRESET)      rnd_preset_show(m->preset);
+        if (d & DM_PSET_TEMP)   rnd_pset_temp(m->pset_temp);
+        if (d & DM_HEAT_COOL)   rnd_heat_cool(m->is_heating);
+        if (d & DM_PWR_BAR)     rnd_pwr_bar(m->pwr_percent);
+        if (d & DM_PWR_TXT)     rnd_pwr_txt(m->pwr_watts);
+        if (d & DM_TEMP_SCALE)  rnd_settemp_scale(m->temp_scale);
+        if (d & (DM_TUNE | DM_BOOST)) {
+            if (m->tuning) {
+                rnd_tune();
+            } else {
+                rnd_boost(m->boost_secs);
+            }
+        }
+        if (d & DM_TIP_TEMP) {
+            PRF_MARK(lm);
+            ledo_update(led_hndl, (uint32_t)m->tip_temp);
+            ledo_refresh(led_hndl); // currently also calls the compositor which needs to be straightened out.
+            PRF_END(TLM_PRF_LEDO_REFRESH, lm);
+            if (!(d & ~(DM_TIP_TEMP | DM_REFRESH))) {
+                PRF_END(TLM_PRF_DISP_RENDER, pm);
+                return; // frame already pushed
+            }
+        }
+    }
+    // for now, call the text graphic refresh function 
+    // as it is calling the compositor after updating it's
+    // own text framebuffer. This needs to get
+    // straightened out as it's still working in the 
+    // old non-layered way...
+    //gfx_displayRefresh();
+    textgfx_refresh();
+    PRF_END(TLM_PRF_DISP_RENDER, pm);
+}
+
+// ***************************************************************************
+// Display API (core0)
+// ***************************************************************************
+
+// record a change in the display model
+#define DISP_POST(item, assign) do { \
+        assign; \
+        model.dirty |= (item); \
+        model.valid |= (item); \
+    } while (0)
 
 int disp_init(void) {
     if (!is_initialized) {
+        model.screen = SCRN_NONE;
+        model.dirty = model.valid = 0;
         bsp_ConfigureGfxDriver();   // as defined by GFX_DRIVER_LL_STACK
         bsp_StartGfxDriver();
         gfx_displayOn();
         gfx_clearDisplay();
+        // from here on the driver's frames go out through the dirty page
+        // tracking (disp_panel.c)
+        pnl_init();
         lgfx_init(LAYER_GFX);
         text_init(LAYER_TXT);
         textgfx_init(REFRESH_ON_DEMAND, SET_TEXTWRAP_ON);
@@ -123,36 +345,22 @@ int disp_init(void) {
         led_hndl = ledo_open(TEMP_LED_TL_POS_X, TEMP_LED_TL_POS_Y, TEMP_LED_DIGCOUNT, 298, TEMP_LED_UPDT_ON_CHG);
         is_initialized = true;
     }
+    return 0;
 }
 
 int disp_startscrn(void) {
     int rc = 1;
     if (is_initialized) {
-        textgfx_clear();
-        REPORT_BRD_INFO;
-        REPORT_FW_VERSION;
-        textgfx_puts("FRAXSYS ENG.\n");
+        DISP_POST(DM_SCREEN, model.screen = SCRN_START);
         rc = disp_refresh();
     }
     return rc;
 }
 
-static void add_border_gfx(void) {
-    lgfx_box(BRDR_X1, BRDR_Y1, BRDR_X2, BRDR_Y2, COLOUR_BLK);
-    lgfx_line(LIN1_X1, LIN1_Y1, LIN1_X2, LIN1_Y2, COLOUR_BLK);
-    lgfx_visibility(1);
-}
-
 int disp_opscrn(void) {
     int rc = 1;
     if (is_initialized) {
-        textgfx_clear();
-        textgfx_puts(op_txt_overlay);
-        textgfx_refresh();
-        ledo_visible(1); // make visible
-        ledo_refresh(led_hndl); // currently also calls the compositor which needs to be straightened out.
-        // border graphics (line art)
-        add_border_gfx();
+        DISP_POST(DM_SCREEN, model.screen = SCRN_OPS);
         // Add Powerbar
         disp_pwr_bar(50);
         // Test wattage text update
@@ -173,8 +381,7 @@ int disp_setscrn(void) {
 
 // update the active preset (A,B,C,D)
 int disp_preset_show(char P) {
-    textgfx_cursor(PRESET_TEXT_XPOS, PRESET_TEXT_LINE);
-    textgfx_putc(P);
+    DISP_POST(DM_PRESET, model.preset = P);
     return 0;
 }
 
@@ -182,72 +389,50 @@ int disp_preset_show(char P) {
 int disp_tip_temp(int T) {
     int rc = 1;
     if (T >= 0 && T <= IRON_MAX_TEMP) {
-        rc = ledo_update(led_hndl, (uint32_t)T);
-        ledo_refresh(led_hndl); // currently also calls the compositor which needs to be straightened out.
+        DISP_POST(DM_TIP_TEMP, model.tip_temp = T);
+        rc = 0;
     }
     return rc;
 }
 
 // update preset set-temp
-#define TEMP_PSET_CHAR_LEN  3
-static char temp_pset[TEMP_PSET_CHAR_LEN+1];
 int disp_pset_temp(int T) {
     int rc = 1;
     if (T >= 0 && T <= IRON_MAX_TEMP) {
-        if (i_to_strflen((uint32_t)T, temp_pset, TEMP_PSET_CHAR_LEN+1, TEMP_PSET_CHAR_LEN) != NULL) {
-            textgfx_cursor(PRESET_TXT_TMP_XP, PRESET_TXT_TMP_LN);
-            textgfx_puts(temp_pset);
-            rc = 0;
-        }
+        DISP_POST(DM_PSET_TEMP, model.pset_temp = T);
+        rc = 0;
     }
     return rc;
 }   
 
-static bool is_heating = false;
-static int update_heat_cool(void) {
-    textgfx_cursor(HEAT_IND_XPOS, HEAT_IND_LINE);
-    textgfx_putc( (is_heating) ? '*' : ' ' );
-    textgfx_cursor(COOL_IND_XPOS, COOL_IND_LINE);
-    textgfx_putc( (is_heating) ? ' ' : '*' );
-    return 0;
-}
-
 // indicate heating
 int disp_heat_on(void) {
-    is_heating = true;
-    return update_heat_cool();
+    DISP_POST(DM_HEAT_COOL, model.is_heating = true);
+    return 0;
 }
 
 // indicate cooling
 int disp_cool_on(void) {
-    is_heating = false;
-    return update_heat_cool();
+    DISP_POST(DM_HEAT_COOL, model.is_heating = false);
+    return 0;
 }
 
 // update power bar (%)
 int disp_pwr_bar(int percent) {
     int rc = 1;
     if (percent >= 0 && percent <= 100) {
-        float pdiv = 100.0 / percent;
-        uint8_t plen = (uint8_t)((float)PWR_BAR_W / pdiv);
-        // power bar-graph and surrounding box/border
-        lgfx_box(PWR_BAR_BOX_X1, PWR_BAR_BOX_Y1, PWR_BAR_BOX_X2, PWR_BAR_BOX_Y2, COLOUR_BLK);
-        rc = lgfx_bgraph(PWR_BAR_TL_X, PWR_BAR_TL_Y, PWR_BAR_H, PWR_BAR_W, plen, COLOUR_BLK);
+        DISP_POST(DM_PWR_BAR, model.pwr_percent = percent);
+        rc = 0;
     }
     return rc;
 }
 
 // update power numerical text (*** W)
-#define PWR_WATTAGE_CHAR_LEN  3
-static char pwr_wattage[PWR_WATTAGE_CHAR_LEN+1];
 int disp_pwr_txt(int P) {
     int rc = 1;
-    if (P >= 0) {
-        if (i_to_strflen((uint32_t)P, pwr_wattage, PWR_WATTAGE_CHAR_LEN+1, PWR_WATTAGE_CHAR_LEN) != NULL) {
-            textgfx_cursor(WATT_TEXT_XPOS, WATT_TEXT_LINE);
-            textgfx_puts(pwr_wattage);
-            rc = 0;
-        }
+    if (P >= 0 && P <= 999) {
+        DISP_POST(DM_PWR_TXT, model.pwr_watts = P);
+        rc = 0;
     }
     return rc;
 }
@@ -256,21 +441,67 @@ int disp_pwr_txt(int P) {
 int disp_settemp_scale(char S) {
     int rc = 1;
     if (S == 'C' || S == 'F') {
-        textgfx_cursor(TMPSCALE_TEXT_XPOS, TMPSCALE_TEXT_LINE);
-        textgfx_putc(S);
+        DISP_POST(DM_TEMP_SCALE, model.temp_scale = S);
         rc = 0;
     }
     return rc;
 }
 
-int disp_refresh(void) {
-    // for now, call the text graphic refresh function 
-    // as it is calling the compositor after updating it's
-    // own text framebuffer. This needs to get
-    // straightened out as it's still working in the 
-    // old non-layered way...
-    //return gfx_displayRefresh();
-    return textgfx_refresh();
+// boost time left [sec], 0 := boost off (field blanked)
+int disp_boost(int secs) {
+    int rc = 1;
+    if (secs >= 0 && secs <= 999) {
+        DISP_POST(DM_BOOST, model.boost_secs = secs);
+        rc = 0;
+    }
+    return rc;
 }
 
+// indicate controller tuning
+int disp_tune(bool on) {
+    DISP_POST(DM_TUNE, model.tuning = on);
+    return 0;
+}
 
+// show the diagnostics screen, or go back to the operation screen
+int disp_diagscrn(bool on) {
+    int rc = 1;
+    if (is_initialized) {
+        DISP_POST(DM_SCREEN, model.screen = on ? SCRN_DIAG : SCRN_OPS);
+        rc = 0;
+    }
+    return rc;
+}
+
+// set diagnostics text line 'ln', cut / padded to DIAG_LINE_LEN
+int disp_diag_line(int ln, const char * txt) {
+    int rc = 1;
+    if (ln >= 0 && ln < DIAG_LINES && txt) {
+        size_t n = strnlen(txt, DIAG_LINE_LEN);
+        memcpy(model.diag[ln], txt, n);
+        memset(model.diag[ln] + n, ' ', DIAG_LINE_LEN - n);
+        model.diag[ln][DIAG_LINE_LEN] = '\0';
+        model.dirty |= DM_DIAG;
+        model.valid |= DM_DIAG;
+        rc = 0;
+    }
+    return rc;
+}
+
+// mark the pending changes for the next render pass, does not draw
+int disp_refresh(void) {
+    PRF_MARK(m);
+    DISP_POST(DM_REFRESH, (void)0);
+    PRF_END(TLM_PRF_DISP_REFRESH, m);
+    return 0;
+}
+
+// Main loop: run the render pass if a refresh is pending
+int disp_poll(void) {
+    if (!is_initialized || !(model.dirty & DM_REFRESH)) {
+        return 0;
+    }
+    render(&model);
+    model.dirty = 0;
+    return 1;
+}
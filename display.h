@@ -12,6 +12,11 @@
 #ifndef _DISPLAY_H_
 #define _DISPLAY_H_
 
+#include <stdbool.h>
+
+#define DIAG_LINES      8           /* diagnostics screen, text lines */
+#define DIAG_LINE_LEN   21          /* chars per line */
+
 // Display intiialization, call first.
 int disp_init(void);
 
@@ -27,6 +32,11 @@ int disp_cool_on(void);             // indicate cooling
 int disp_pwr_bar(int percent);      // update power bar (%)
 int disp_pwr_txt(int P);            // update power numerical text (*** W)
 int disp_settemp_scale(char S);     // set temp scale ('C','F')
-int disp_refresh(void);             // refresh display
+int disp_boost(int secs);           // boost time left [sec], 0 := boost off
+int disp_tune(bool on);             // indicate controller tuning
+int disp_diagscrn(bool on);         // show the diagnostics screen, false := back to the operation screen
+int disp_diag_line(int ln, const char * txt); // set diagnostics text line 0 .. DIAG_LINES-1
+int disp_refresh(void);             // refresh display (on the next disp_poll)
+int disp_poll(void);                // main loop: render and push a pending refresh, 1 := rendered
 
 #endif /* _DISPLAY_H_ */
@@ -0,0 +1,90 @@
+/******************************************************************************
+ * Main Loop Events
+ *
+ * No lock is shared between the cores. Core0's producers (its ISRs) OR into
+ * a pending mask with the local interrupts masked. Core1 cannot clear bits
+ * in a word core0 clears (the M0+ has no atomic read-modify-write on RAM),
+ * so it counts instead: one post counter per event bit, written by core1
+ * only (its interrupts masked), and the main loop takes an event when the
+ * counter moved since it last looked. Either way a post never waits on the
+ * other core.
+ *
+ * A post always ends with __sev(): if it lands between the main loop's
+ * check and its __wfe(), the event register is already set and __wfe()
+ * returns at once, so no wakeup is lost.
+ *
+ */
+
+#include <events.h>
+#include "hardware/sync.h"
+
+#define EV_BITS     8       /* EV_ALL */
+
+static volatile uint32_t ev_pending = 0;        // core0 posts
+static volatile uint32_t ev_c1_posts[EV_BITS];  // core1 posts, per bit, core1 writes
+static uint32_t          ev_c1_seen[EV_BITS];   // ... taken by the main loop
+static volatile bool     ev_ready = false;
+
+// Setup the event mask, call before any producer is started.
+int ev_init(void) {
+    int i;
+    ev_pending = 0;
+    for (i = 0 ; i < EV_BITS ; i++) {
+        ev_c1_seen[i] = ev_c1_posts[i];
+    }
+    ev_ready = true;
+    return 0;
+}
+
+// Post event(s) and wake the main loop. ISR safe, either core.
+void ev_post(uint32_t events) {
+    uint32_t irq;
+    int i;
+    if (!ev_ready) {
+        return;
+    }
+    irq = save_and_disable_interrupts();
+    if (get_core_num() == 0) {
+        ev_pending |= events;
+    } else {
+        for (i = 0 ; i < EV_BITS ; i++) {
+            if (events & (1u << i)) {
+                ev_c1_posts[i] ++;
+            }
+        }
+    }
+    restore_interrupts(irq);
+    __sev();
+}
+
+// Take the pending events in 'mask' without waiting, 0 if none.
+uint32_t ev_poll(uint32_t mask) {
+    uint32_t irq, n, ev = 0;
+    int i;
+    if (!ev_ready) {
+        return 0;
+    }
+    for (i = 0 ; i < EV_BITS ; i++) {
+        if (mask & (1u << i)) {
+            n = ev_c1_posts[i];
+            if (n != ev_c1_seen[i]) {
+                ev_c1_seen[i] = n;
+                ev |= 1u << i;
+            }
+        }
+    }
+    irq = save_and_disable_interrupts();
+    ev |= ev_pending & mask;
+    ev_pending &= ~mask;
+    restore_interrupts(irq);
+    return ev;
+}
+
+// Wait for any event in 'mask', returns (and clears) those pending.
+uint32_t ev_wait(uint32_t mask) {
+    uint32_t ev;
+    while ((ev = ev_poll(mask)) == 0) {
+        __wfe();
+    }
+    return ev;
+}
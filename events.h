@@ -0,0 +1,42 @@
+/******************************************************************************
+ * Main Loop Events
+ * 
+ * Event mask shared between the ISRs / timer tasks (producers) and the main 
+ * loop (consumer). A producer posts its event bit and wakes the main loop 
+ * with __sev(); the main loop sleeps in __wfe() until an event it waits for
+ * is pending. Events of the same kind posted before the main loop gets to
+ * them are merged. Posting takes no lock shared with the other core.
+ * 
+ */
+
+#ifndef _EVENTS_H_
+#define _EVENTS_H_
+
+#include "pico/stdlib.h"
+
+// event bits
+#define EV_KEY          (1u << 0)   /* key(s) pushed into the keypad buffer */
+#define EV_PSU_FAULT    (1u << 1)   /* analog PSU fault raised */
+#define EV_ZC           (1u << 2)   /* mains half-cycle started, or mains lost */
+#define EV_ADC          (1u << 3)   /* new tip temperature reading */
+#define EV_STBY         (1u << 4)   /* standby state changed (iron put down / lifted) */
+#define EV_BOOST        (1u << 5)   /* boost ended (time up / budget used) */
+#define EV_CMD          (1u << 6)   /* command line(s) received on the console UART */
+#define EV_TLM          (1u << 7)   /* telemetry record(s) from core1 to queue (tlm_poll) */
+#define EV_ALL          (EV_KEY | EV_PSU_FAULT | EV_ZC | EV_ADC | EV_STBY | EV_BOOST | EV_CMD | EV_TLM)
+
+// Setup the event mask, call before any producer is started.
+int ev_init(void);
+
+// Post event(s) and wake the main loop. ISR safe, either core.
+void ev_post(uint32_t events);
+
+// Take the pending events in 'mask' without waiting, 0 if none. Main loop
+// (core0) only.
+uint32_t ev_poll(uint32_t mask);
+
+// Wait for any event in 'mask', returns (and clears) those pending. Main
+// loop (core0) only.
+uint32_t ev_wait(uint32_t mask);
+
+#endif /* _EVENTS_H_ */
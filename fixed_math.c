@@ -0,0 +1,162 @@
+/******************************************************************************
+ * Integer / Fixed-Point Math
+ *
+ * See fixed_math.h. Powers of ten come from a table, text conversion uses
+ * the RP2040's hardware integer divider (one divide per digit) and no
+ * float / double arithmetic is done anywhere outside fx_bench().
+ *
+ */
+
+#include <fixed_math.h>
+#include <board.h>
+#include <string.h>
+
+static const uint32_t pow10_tbl[FX_POW10_MAX + 1] = {
+    1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u, 100000000u, 1000000000u
+};
+
+// 10^n, n clamped to FX_POW10_MAX
+uint32_t fx_pow10(uint32_t n) {
+    return pow10_tbl[(n > FX_POW10_MAX) ? FX_POW10_MAX : n];
+}
+
+// Value of 'count' ASCII digits ('0' .. '9'), most significant first
+uint32_t fx_digs_to_u32(const char * digs, uint32_t count) {
+    uint32_t val = 0;
+    while (count--) {
+        val = val * 10 + (uint32_t)(*digs++ - '0');
+    }
+    return val;
+}
+
+// Convert unsigned value to a right justified string in a fixed window
+const char * fx_u32_to_strflen(uint32_t i, char * strbuf, size_t strbuflen, size_t strclen) {
+    const char * ret = NULL;
+    if (strbuf && strclen && strbuflen > strclen) {
+        char * p = strbuf + strclen;
+        ret = (const char *)strbuf;
+        *p = '\0';
+        if (strclen <= FX_POW10_MAX) {
+            i %= pow10_tbl[strclen]; // only what fits the window
+        }
+        // digits from the right, leading zeros blanked (so 0 is all blank)
+        do {
+            *--p = (i == 0) ? ' ' : '0' + (char)(i % 10);
+            i /= 10;
+        } while (p != strbuf);
+    }
+    return ret;
+}
+
+// ***************************************************************************
+// benchmark: old float / pow() implementations against the above
+// ***************************************************************************
+
+#if (FX_BENCH==1)
+
+#include <telemetry.h>
+#include <math.h>
+#include "hardware/structs/systick.h"
+
+#define FX_BENCH_LOOPS  100
+
+// SysTick as a 24 bit down counter at clk_sys
+static inline void cyc_start(void) {
+    systick_hw->rvr = 0x00FFFFFF;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5; // enable, processor clock
+}
+
+static inline uint32_t cyc_now(void) {
+    return systick_hw->cvr;
+}
+
+// -- previous implementations, kept verbatim for the comparison --
+
+static uint32_t old_digs_to_val(char * digs, uint8_t digCount) {
+    uint32_t val = 0;
+    while (digCount) {
+        digCount --;
+        val += (uint32_t)pow(10,digCount) * ((*digs) - '0');
+        digs ++;
+    }
+    return val;
+}
+
+static const char * old_i_to_strflen(uint32_t i, char * strbuf, size_t strbuflen, size_t strclen) {
+    const char * ret = NULL;
+    if (strbuf && strclen && strbuflen > strclen) {
+        uint32_t div  = (uint32_t)pow(10,strclen);
+        uint8_t  lblank = 1;
+        memset(strbuf, 0x20, strclen);
+        ret = (const char *)strbuf;
+        strbuf[strclen] = '\0';
+        while (i >= div) {
+            i -= div;
+        }
+        while (strclen) {
+            uint8_t idig;
+            div = div / 10;
+            strclen --;
+            idig = (uint8_t)(i / div);
+            *strbuf = '0' + idig;
+            i = i - ((uint32_t)idig * div);
+            if (lblank && (idig == 0)) {
+                *strbuf = ' ';
+            } else if (lblank) {
+                lblank = 0;
+            }
+            strbuf ++;
+        }
+    }
+    return ret;
+}
+
+static int old_pwr_percent(int pwr) {
+    return (int)( (float)pwr * 100.0 / (float)IRON_MAX_WATT );
+}
+
+static uint8_t old_pwr_bar_len(int percent) {
+    float pdiv = 100.0 / percent;
+    return (uint8_t)((float)50 / pdiv);
+}
+
+static volatile uint32_t bench_sink;
+
+// cycles per 'expr' into 'cyc', 'i' (the caller's) counts the loops and
+// may be used in 'expr'
+#define BENCH(cyc, i, expr) do {                                    \
+        uint32_t t0;                                                \
+        cyc_start();                                                \
+        t0 = cyc_now();                                             \
+        for ((i) = 0 ; (i) < FX_BENCH_LOOPS ; (i)++) {              \
+            bench_sink += (uint32_t)(expr);                         \
+        }                                                           \
+        (cyc) = (t0 - cyc_now()) / FX_BENCH_LOOPS;                  \
+    } while (0)
+
+// Log cycle counts per call (loop overhead included), old against new
+void fx_bench(void) {
+    char digs[3] = { '3', '5', '0' };
+    char buf[5];
+    uint32_t c_old, c_new, i;
+    BENCH(c_old, i, old_digs_to_val(digs, 3));
+    BENCH(c_new, i, fx_digs_to_u32(digs, 3));
+    tlm_log(TLM_LOG_FX_DIGS, c_old, c_new, 0);
+    BENCH(c_old, i, old_i_to_strflen(i + 150, buf, sizeof(buf), 4)[3]);
+    BENCH(c_new, i, fx_u32_to_strflen(i + 150, buf, sizeof(buf), 4)[3]);
+    tlm_log(TLM_LOG_FX_STRFLEN, c_old, c_new, 0);
+    BENCH(c_old, i, old_pwr_percent((int)i));
+    BENCH(c_new, i, fx_percent((int32_t)i, IRON_MAX_WATT));
+    tlm_log(TLM_LOG_FX_PERCENT, c_old, c_new, 0);
+    BENCH(c_old, i, old_pwr_bar_len((int)i + 1));
+    BENCH(c_new, i, fx_scale((int32_t)i + 1, 50, 100));
+    tlm_log(TLM_LOG_FX_BAR, c_old, c_new, 0);
+}
+
+#else
+
+void fx_bench(void) {
+}
+
+#endif /* FX_BENCH */
@@ -0,0 +1,101 @@
+/******************************************************************************
+ * Integer / Fixed-Point Math
+ *
+ * The RP2040 has no FPU: every float operation and every pow() call is a
+ * soft-float library call. This module keeps the hot paths (controller,
+ * meters, display, key entry) in integer arithmetic:
+ *
+ *  Q16.16 fixed-point    fx_t, FX_ONE, fx_from_int(), fx_to_int(), fx_mul(),
+ *                          fx_div(), fx_ratio()
+ *  Scaling               fx_scale(), fx_percent() - v * num / den, 64 bit
+ *                          intermediate, no rounding (same as a float
+ *                          result cast to int)
+ *  Powers of ten         fx_pow10() from a table, replaces pow(10, n)
+ *  Sine                  fx_sin_pi() - sin(pi * x) over one half period
+ *  Decimal text          fx_digs_to_u32(), fx_u32_to_strflen()
+ *
+ * fx_bench() (FX_BENCH builds) logs the cycle counts of the old float /
+ * pow() implementations against these on the telemetry stream.
+ *
+ */
+
+#ifndef _FIXED_MATH_H_
+#define _FIXED_MATH_H_
+
+#include "pico/stdlib.h"
+
+// Q16.16, range +/- 32768
+typedef int32_t fx_t;
+
+#define FX_SHIFT        16
+#define FX_ONE          ((fx_t)1 << FX_SHIFT)
+#define FX_POW10_MAX    9   /* largest power of ten in a uint32_t */
+
+static inline fx_t fx_from_int(int32_t i) {
+    return (fx_t)(i * FX_ONE);
+}
+
+// round to nearest (half away from zero)
+static inline int32_t fx_to_int(fx_t a) {
+    return (a >= 0) ? (a + FX_ONE / 2) >> FX_SHIFT : -((-a + FX_ONE / 2) >> FX_SHIFT);
+}
+
+// truncate toward zero
+static inline int32_t fx_trunc(fx_t a) {
+    return (a >= 0) ? a >> FX_SHIFT : -((-a) >> FX_SHIFT);
+}
+
+static inline fx_t fx_mul(fx_t a, fx_t b) {
+    return (fx_t)(((int64_t)a * b) >> FX_SHIFT);
+}
+
+// b == 0 saturates
+static inline fx_t fx_div(fx_t a, fx_t b) {
+    if (b == 0) {
+        return (a >= 0) ? INT32_MAX : INT32_MIN;
+    }
+    return (fx_t)(((int64_t)a << FX_SHIFT) / b);
+}
+
+// num / den as Q16.16
+static inline fx_t fx_ratio(int32_t num, int32_t den) {
+    return fx_div(fx_from_int(num), fx_from_int(den));
+}
+
+// v * num / den, truncated, den == 0 := 0
+static inline int32_t fx_scale(int32_t v, int32_t num, int32_t den) {
+    return den ? (int32_t)((int64_t)v * num / den) : 0;
+}
+
+// part as a percentage of total, truncated
+static inline int32_t fx_percent(int32_t part, int32_t total) {
+    return fx_scale(part, 100, total);
+}
+
+// sin(pi * x) for x in 0 .. FX_ONE (clamped), Q16.16. Bhaskara I's
+// approximation, error < 0.002.
+static inline fx_t fx_sin_pi(fx_t x) {
+    fx_t u;
+    if (x <= 0 || x >= FX_ONE) {
+        return 0;
+    }
+    u = fx_mul(x, FX_ONE - x);
+    return fx_div(16 * u, 5 * FX_ONE - 4 * u);
+}
+
+// 10^n, n clamped to FX_POW10_MAX
+uint32_t fx_pow10(uint32_t n);
+
+// Value of 'count' ASCII digits ('0' .. '9'), most significant first
+uint32_t fx_digs_to_u32(const char * digs, uint32_t count);
+
+// Convert unsigned value to a right justified string in a fixed character
+// window, leading zeros blanked, values too large for the window are shown
+// modulo 10^strclen (see i_to_strflen()).
+const char * fx_u32_to_strflen(uint32_t i, char * strbuf, size_t strbuflen, size_t strclen);
+
+// Log cycle counts (TLM_LOG_FX_xxx): float / pow() call sites against their
+// replacements. Only built with FX_BENCH set, call after tlm_init().
+void fx_bench(void);
+
+#endif /* _FIXED_MATH_H_ */
@@ -0,0 +1,253 @@
+/******************************************************************************
+ * Manage the Heater
+ *
+ * Zero-crossing synchronised burst-fire engine.
+ *
+ * Every edge on AC_ZC_INPUT starts a mains half-cycle. The ZC ISR runs a
+ * first order sigma-delta modulator on the requested power: the request is
+ * added to an accumulator and a half-cycle is fired whenever the accumulator
+ * reaches IRON_MAX_WATT (which is then subtracted). On-cycles are therefore
+ * spread as evenly as possible (eg. 25% := 1 in 4 half-cycles) rather than
+ * being grouped into long on/off blocks, keeping tip temperature ripple to a
+ * minimum. Switching only at the zero-crossing keeps EMI and flicker down.
+ *
+ * The modulator also keeps the fired half-cycles balanced between the two
+ * mains polarities (never more than one unmatched half-cycle) so that no DC
+ * is drawn through the supply transformer; a fire that would unbalance it is
+ * held over to the next (opposite polarity) half-cycle.
+ *
+ * Gate outputs, for a fired half-cycle:
+ *  HTR_CTRL_OFF_L released, HTR_CTRL_ON_L active until the next zero-crossing.
+ * otherwise:
+ *  HTR_CTRL_ON_L released, HTR_CTRL_OFF_L active.
+ *
+ * A hook (the temperature controller) can be run at the start of every
+ * half-cycle, ahead of the firing decision, and a second one (the tip
+ * sampling) right after it. No more than HTR_MEAS_GAP_MAX half-cycles are
+ * fired in a row, so the tip temperature can always be read within a
+ * bounded time, even at full power.
+ *
+ * If the zero-crossing signal is lost the heater is forced off by a one-shot
+ * timer wheel task that is re-started on every edge.
+ *
+ */
+
+#include <heater_ctrl.h>
+#include <board.h>
+#include <events.h>
+#include <profile.h>
+#include <deadline.h>
+#include <timer_wheel.h>
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include <pico/time.h>
+
+static volatile uint32_t htr_req_watts = 0;     // requested power
+static volatile bool     htr_running = false;
+static volatile bool     zc_mains_ok = false;
+static uint32_t          zc_last_us = 0;        // time of the last accepted ZC edge
+static volatile uint32_t zc_halfcycle_us = 0;   // measured half-cycle period
+static uint32_t          sd_accum = 0;          // sigma-delta accumulator [W]
+static int32_t           dc_balance = 0;        // fired (+ve) - fired (-ve) half-cycles
+static int              zc_loss_tw = -1;       // mains loss watchdog task
+static volatile uint32_t zc_count = 0;          // half-cycles seen
+static volatile uint32_t fire_count = 0;        // half-cycles fired
+static uint32_t          fire_run = 0;          // consecutive half-cycles fired
+static volatile htr_zc_hook_t zc_hook = NULL;
+static volatile htr_gate_hook_t gate_hook = NULL;
+static volatile bool     gate_on = false;
+
+// gate the heater for the coming half-cycle, or hold it off
+static inline void heater_gate(bool on) {
+    gate_on = on;
+    if (on) {
+        gpio_put(HTR_CTRL_OFF_L, HTR_CTL_OFF);
+        gpio_put(HTR_CTRL_ON_L, HTR_CTL_ON);
+    } else {
+        gpio_put(HTR_CTRL_ON_L, HTR_CTL_OFF);
+        gpio_put(HTR_CTRL_OFF_L, HTR_CTL_ON);
+    }
+}
+
+/* TIMER - no zero-crossing seen for AC_ZC_LOSS_TMOUT_US */
+static void zc_loss_cb(void * ctx) {
+    heater_gate(false);
+    zc_mains_ok = false;
+    zc_halfcycle_us = 0;
+    sd_accum = 0;
+    ev_post(EV_ZC);
+}
+
+// decide if this half-cycle is fired, 'pol' is the mains polarity (+1/-1)
+static bool sd_modulate(int32_t pol) {
+    uint32_t req = htr_req_watts;
+    if (req == 0) {
+        sd_accum = 0; // hard off, do not let a residue fire one more
+        return false;
+    }
+    sd_accum += req;
+    if (fire_run >= HTR_MEAS_GAP_MAX) {
+        // leave this one off for a tip reading, the accumulator carries 
+        // the request over (capped so it does not come back as a burst)
+        if (sd_accum > 2 * IRON_MAX_WATT) {
+            sd_accum = 2 * IRON_MAX_WATT;
+        }
+        return false;
+    }
+    if (sd_accum >= IRON_MAX_WATT) {
+        int32_t bal = dc_balance + pol;
+        if (bal >= -1 && bal <= 1) {
+            sd_accum -= IRON_MAX_WATT;
+            dc_balance = bal;
+            return true;
+        }
+        // hold over to the next (opposite) half-cycle
+    }
+    return false;
+}
+
+/* ISR Routine - AC Zero-Crossing, both edges */
+static void zc_isr(void) {
+    uint32_t ev = gpio_get_irq_event_mask(AC_ZC_INPUT) & (GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL);
+    uint32_t now;
+    bool fire = false;
+    PRF_MARK(m);
+    if (!ev) {
+        return;
+    }
+    gpio_acknowledge_irq(AC_ZC_INPUT, ev);
+    now = time_us_32();
+    if (zc_mains_ok && (now - zc_last_us) < AC_ZC_MIN_PD_US) {
+        return; // detector noise
+    }
+    if (zc_mains_ok) {
+        zc_halfcycle_us = now - zc_last_us;
+    }
+    zc_last_us = now;
+    zc_mains_ok = true;
+    zc_count ++;
+    if (zc_hook) {
+        zc_hook(zc_halfcycle_us);
+    }
+    if (htr_running) {
+        fire = sd_modulate(gpio_get(AC_ZC_INPUT) ? 1 : -1);
+    }
+    heater_gate(fire);
+    dl_run(TLM_DL_ZC, now);
+    if (fire) {
+        fire_count ++;
+        fire_run ++;
+    } else {
+        fire_run = 0;
+    }
+    if (gate_hook) {
+        gate_hook(fire);
+    }
+    // mains loss watchdog
+    tw_start_once(zc_loss_tw, AC_ZC_LOSS_TMOUT_US);
+    ev_post(EV_ZC);
+    PRF_END(TLM_PRF_ZC_ISR, m);
+}
+
+// Setup the heater gate outputs (heater held off) and the zero-crossing ISR.
+// Call htr_enable to start firing.
+int htr_init(void) {
+    // heater gates, held off
+    gpio_init(HTR_CTRL_ON_L);
+    gpio_put(HTR_CTRL_ON_L, HTR_CTL_OFF);
+    gpio_set_dir(HTR_CTRL_ON_L, GPIO_OUT);
+    gpio_init(HTR_CTRL_OFF_L);
+    gpio_put(HTR_CTRL_OFF_L, HTR_CTL_ON);
+    gpio_set_dir(HTR_CTRL_OFF_L, GPIO_OUT);
+    // zero-crossing detect. Uses a raw handler so the shared GPIO
+    // callback (analog PSU) is left alone.
+    gpio_init(AC_ZC_INPUT);
+    gpio_set_dir(AC_ZC_INPUT, GPIO_IN);
+    dl_register(TLM_DL_ZC, 0, DL_ZC_DEADLINE_US); // period: the measured half-cycle
+    zc_loss_tw = tw_add(zc_loss_cb, NULL, TW_PRIO_HIGH);
+    gpio_add_raw_irq_handler(AC_ZC_INPUT, zc_isr);
+    gpio_set_irq_enabled(AC_ZC_INPUT, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+    return 0;
+}
+
+// Enable heater firing (at the currently requested power)
+int htr_enable(void) {
+    int rc = 1;
+    if (!htr_running) {
+        sd_accum = 0;
+        htr_running = true;
+        rc = 0;
+    }
+    return rc;
+}
+
+// is the heater engine running ?
+bool htr_is_running(void) {
+    return htr_running;
+}
+
+// Disable heater firing, heater is held off.
+int htr_disable(void) {
+    int rc = 1;
+    if (htr_running) {
+        htr_running = false;
+        heater_gate(false);
+        rc = 0;
+    }
+    return rc;
+}
+
+// Request heater power [W], 0 .. IRON_MAX_WATT
+int htr_set_power(uint32_t watts) {
+    int rc = 0;
+    if (watts > IRON_MAX_WATT) {
+        watts = IRON_MAX_WATT;
+        rc = 1;
+    }
+    htr_req_watts = watts;
+    return rc;
+}
+
+// currently requested heater power [W]
+uint32_t htr_get_power(void) {
+    return htr_req_watts;
+}
+
+// true while zero-crossings are being seen
+bool htr_mains_ok(void) {
+    return zc_mains_ok;
+}
+
+// true while the heater is gated on (the current half-cycle is fired)
+bool htr_is_firing(void) {
+    return gate_on;
+}
+
+// last measured mains half-cycle period [usec], 0 if unknown
+uint32_t htr_get_halfcycle_us(void) {
+    return zc_halfcycle_us;
+}
+
+// time since the last zero-crossing (start of the current half-cycle) [usec]
+uint32_t htr_get_zc_age_us(void) {
+    return time_us_32() - zc_last_us;
+}
+
+// running totals of mains half-cycles seen and half-cycles fired
+void htr_get_counts(uint32_t * halfcycles, uint32_t * fired) {
+    if (halfcycles) *halfcycles = zc_count;
+    if (fired)      *fired = fire_count;
+}
+
+// Per half-cycle hook, called from the ZC ISR ahead of the firing decision
+int htr_set_zc_hook(htr_zc_hook_t hook) {
+    zc_hook = hook;
+    return 0;
+}
+
+// Gate hook, called from the ZC ISR right after the heater is switched
+int htr_set_gate_hook(htr_gate_hook_t hook) {
+    gate_hook = hook;
+    return 0;
+}
@@ -0,0 +1,63 @@
+/******************************************************************************
+ * Manage the Heater
+ *
+ * Zero-crossing synchronised burst-fire engine. The requested power level
+ * (0 .. IRON_MAX_WATT) is turned into whole mains half-cycles, spread evenly
+ * with a first order sigma-delta modulator and switched right after each
+ * zero-crossing edge on AC_ZC_INPUT.
+ *
+ */
+
+#ifndef _HEATER_CTRL_H_
+#define _HEATER_CTRL_H_
+
+#include "pico/stdlib.h"
+
+// Setup the heater gate outputs (heater held off) and the zero-crossing ISR.
+// Call htr_enable to start firing.
+int htr_init(void);
+
+// Enable heater firing (at the currently requested power)
+int htr_enable(void);
+
+// is the heater engine running ?
+bool htr_is_running(void);
+
+// Disable heater firing, heater is held off.
+int htr_disable(void);
+
+// Request heater power [W], 0 .. IRON_MAX_WATT. Applied from the next
+// zero-crossing. Returns 0 if accepted, 1 if clamped to IRON_MAX_WATT.
+int htr_set_power(uint32_t watts);
+
+// currently requested heater power [W]
+uint32_t htr_get_power(void);
+
+// true while zero-crossings are being seen
+bool htr_mains_ok(void);
+
+// true while the heater is gated on (the current half-cycle is fired)
+bool htr_is_firing(void);
+
+// last measured mains half-cycle period [usec], 0 if unknown
+uint32_t htr_get_halfcycle_us(void);
+
+// time since the last zero-crossing (start of the current half-cycle) [usec]
+uint32_t htr_get_zc_age_us(void);
+
+// running totals of mains half-cycles seen and half-cycles fired
+void htr_get_counts(uint32_t * halfcycles, uint32_t * fired);
+
+// Per half-cycle hook, called from the ZC ISR on every zero-crossing before
+// the firing decision is made, so a power request made from the hook is
+// applied to the half-cycle that is just starting. 'halfcycle_us' is the
+// measured period (0 if not yet known). Pass NULL to remove.
+typedef void (*htr_zc_hook_t)(uint32_t halfcycle_us);
+int htr_set_zc_hook(htr_zc_hook_t hook);
+
+// Gate hook, called from the ZC ISR right after the heater has been switched
+// for the half-cycle just started. 'fired' := heater on. Pass NULL to remove.
+typedef void (*htr_gate_hook_t)(bool fired);
+int htr_set_gate_hook(htr_gate_hook_t hook);
+
+#endif /* _HEATER_CTRL_H_ */
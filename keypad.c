@@ -4,39 +4,90 @@
  * Background task operations and key buffer.
  * This firmware uses a non-blocking poll read, not block-waiting for keys.
  * 
+ * Two ways of scanning the matrix:
+ * - PIO (KYBD_USE_PIO_SCAN): the rows idle driven low, so any key pulls its
+ *   column low. The falling edge starts a PIO state machine that drives one
+ *   row at a time, samples the columns, and pushes a 16 bit snapshot only 
+ *   when two scans KYBD_PIO_DB_US apart agree (debounced in hardware). The 
+ *   RX ISR turns new key-downs into keys and, once a snapshot shows all keys
+ *   released, stops the state machine and re-arms the column edges. Nothing
+ *   runs while the keypad is idle.
+ * - Timer: keyboard_poll() every KYBD_SCAN_PD_MS (a timer wheel task) with a
+ *   key repeat limiter.
+ *   Used when no state machine (or program space) is free.
  * 
  */
 
-#include "pico/critical_section.h"
+#include <keypad.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "hardware/clocks.h"
 #include <keyboard-gpio.h>
 #include <board.h>
+#include <events.h>
+#include <profile.h>
+#include <deadline.h>
+#include <timer_wheel.h>
+
+#if (KEYBUFFER_LEN & (KEYBUFFER_LEN - 1))
+#error "KEYBUFFER_LEN must be a power of 2"
+#endif
+#define KEYBUF_MASK (KEYBUFFER_LEN - 1)
 
 static void * kybd_hndl = NULL; /* keyboard object handle */
-static char   keybuf[KEYBUFFER_LEN+1];
-static int    keycount = 0;
 static int    repeat_timer = 0;
 static char   lastkey = 0;
 static bool   keytask_running = false;
-static repeating_timer_t kbtmr;
-critical_section_t keybrd_queue;
+static int    kp_tw = -1;       /* timer scan task */
+static bool   kp_pio_mode = false;  /* scanning by PIO, else by timer */
+
+static const char keymap[KYBD_ROW_COUNT][KYBD_COL_COUNT] = {
+    { '1', '2', '3', 'A' },
+    { '4', '5', '6', 'B' },
+    { '7', '8', '9', 'C' },
+    { '*', '0', '#', 'D' },
+};
+static const uint kp_rows[KYBD_ROW_COUNT] = { KYBD_ROW0, KYBD_ROW1, KYBD_ROW2, KYBD_ROW3 };
+static const uint kp_cols[KYBD_COL_COUNT] = { KYBD_COL0, KYBD_COL1, KYBD_COL2, KYBD_COL3 };
+
+// Key buffer: single producer (the scan task) / single consumer (main loop)
+// ring. Head and tail run free and are masked on access; each is written
+// by one side only, so no lock (and no interrupt masking) is needed, just
+// ordering: the producer writes the slot before publishing the new head,
+// the consumer reads the slot before publishing the new tail.
+static char              keybuf[KEYBUFFER_LEN];
+static volatile uint32_t kq_head = 0;  // next slot to write, producer owned
+static volatile uint32_t kq_tail = 0;  // next slot to read, consumer owned
 
 
 // ***************************************************************************
 // bottom-end functions for supporting keypad scanning and key buffering
 // including a higher level key repeat limiter.
+// (scan task context only)
 // ***************************************************************************
 
 // call from a timer routine to increment timer if running.
 static void keybrd_queue_tick(void) {
-    critical_section_enter_blocking(&keybrd_queue);
     if (repeat_timer) {
         repeat_timer += KEYBUFFER_TICK_PD_MS;
     }
-    critical_section_exit(&keybrd_queue);
+}
+
+// add a key to the ring, dropped if full
+static void keybrd_queue_put(char c) {
+    uint32_t head = kq_head;
+    if (head - kq_tail < KEYBUFFER_LEN) {
+        keybuf[head & KEYBUF_MASK] = c;
+        __mem_fence_release();
+        kq_head = head + 1;
+        ev_post(EV_KEY);
+    }
 }
 
 static void keybrd_queue_push(char c) {
-    critical_section_enter_blocking(&keybrd_queue);
     if (c == lastkey) {
         // manage key-repeat timing
         if (repeat_timer) {
@@ -51,19 +102,15 @@ static void keybrd_queue_push(char c) {
     }
     if (repeat_timer == 0) {
         // timeout or unique keypress, can add the key
-        if (keycount < KEYBUFFER_LEN) {
-            keybuf[keycount] = c;
-            keycount ++;
-            keybuf[keycount] = '\0';
-            //putchar((int)c);
-        }
+        keybrd_queue_put(c);
     }
     lastkey = c;
-    critical_section_exit(&keybrd_queue);
 }
 
 // ** TASK **
-static bool chk_keyboard(repeating_timer_t * rptdata) {
+static void chk_keyboard(void * ctx) {
+    uint32_t start = time_us_32();
+    PRF_MARK(m);
     // Put your timeout handler code in here
     keybrd_queue_tick();
     if (kybd_hndl) {
@@ -76,7 +123,193 @@ static bool chk_keyboard(repeating_timer_t * rptdata) {
             }
         }
     }
-    return 1; // set to 0/false to stop the r-timer
+    PRF_END(TLM_PRF_CHK_KEYBOARD, m);
+    dl_run(TLM_DL_KEYPAD, start);
+}
+
+
+// ***************************************************************************
+// PIO matrix scan
+// ***************************************************************************
+
+#define KPS_SETTLE      7   /* cycles to settle after driving a row */
+#define KPS_DB_LOOP     32  /* debounce delay loop: KPS_DB_LOOP * 32 cycles */
+#define KPS_ROWS_MASK   ((1u << KYBD_ROW_COUNT) - 1)
+#define KPS_PROG_LEN    24
+
+static PIO        kp_pio = NULL;
+static int        kp_sm = -1;
+static uint       kp_offset = 0;
+static uint16_t   kp_down = 0;      // debounced key-down map, bit (row * 4 + col)
+static uint16_t   kps_instr[KPS_PROG_LEN];
+static const pio_program_t kps_program = { kps_instr, KPS_PROG_LEN, -1 };
+
+// scan the 4 rows (one driven low at a time) into the ISR, 4 instructions
+// per row, 'at' is the program index to build at
+static uint kps_build_scan(uint at) {
+    uint r;
+    kps_instr[at++] = pio_encode_mov(pio_isr, pio_null);
+    for (r = 0 ; r < KYBD_ROW_COUNT ; r++) {
+        kps_instr[at++] = pio_encode_set(pio_pindirs, 1u << r) | pio_encode_delay(KPS_SETTLE);
+        kps_instr[at++] = pio_encode_in(pio_pins, KYBD_COL_COUNT);
+    }
+    return at;
+}
+
+// scan -> y, wait the debounce interval, scan -> x, push only if x == y
+static void kps_build(void) {
+    uint at = kps_build_scan(0);                                          // 0..8
+    kps_instr[at++] = pio_encode_mov(pio_y, pio_isr);                     // 9
+    kps_instr[at++] = pio_encode_set(pio_x, KPS_DB_LOOP - 1);             // 10
+    kps_instr[at] = pio_encode_jmp_x_dec(at) | pio_encode_delay(31);      // 11
+    at = kps_build_scan(at + 1);                                          // 12..20
+    kps_instr[at++] = pio_encode_mov(pio_x, pio_isr);                     // 21
+    kps_instr[at++] = pio_encode_jmp_x_ne_y(0);                           // 22, bounced
+    kps_instr[at++] = pio_encode_push(false, false);                      // 23, wrap
+}
+
+static void kps_cols_irq(bool enabled) {
+    int c;
+    for (c = 0 ; c < KYBD_COL_COUNT ; c++) {
+        gpio_acknowledge_irq(kp_cols[c], GPIO_IRQ_EDGE_FALL);
+        gpio_set_irq_enabled(kp_cols[c], GPIO_IRQ_EDGE_FALL, enabled);
+    }
+}
+
+static bool kps_any_col_low(void) {
+    int c;
+    for (c = 0 ; c < KYBD_COL_COUNT ; c++) {
+        if (!gpio_get(kp_cols[c])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void kps_scan_start(void) {
+    kps_cols_irq(false);
+    pio_sm_restart(kp_pio, kp_sm);
+    pio_sm_exec(kp_pio, kp_sm, pio_encode_jmp(kp_offset));
+    pio_sm_set_enabled(kp_pio, kp_sm, true);
+}
+
+// all keys released: park the state machine with all rows driven low and
+// wait for a column edge
+static void kps_scan_idle(void) {
+    pio_sm_set_enabled(kp_pio, kp_sm, false);
+    pio_sm_clear_fifos(kp_pio, kp_sm);
+    pio_sm_exec(kp_pio, kp_sm, pio_encode_set(pio_pindirs, KPS_ROWS_MASK));
+    kp_down = 0;
+    kps_cols_irq(true);
+    if (kps_any_col_low()) {
+        kps_scan_start(); // pressed while re-arming, no edge to come
+    }
+}
+
+/* ISR Routine - GPIO falling edge on a column (rows idle low) */
+static void kps_col_isr(void) {
+    int c;
+    bool start = false;
+    for (c = 0 ; c < KYBD_COL_COUNT ; c++) {
+        uint32_t ev = gpio_get_irq_event_mask(kp_cols[c]) & GPIO_IRQ_EDGE_FALL;
+        if (ev) {
+            gpio_acknowledge_irq(kp_cols[c], ev);
+            start = true;
+        }
+    }
+    if (start) {
+        kps_scan_start();
+    }
+}
+
+/* ISR Routine - PIO RX FIFO not empty, debounced matrix snapshots */
+static void kps_rx_isr(void) {
+    PRF_MARK(m);
+    while (!pio_sm_is_rx_fifo_empty(kp_pio, kp_sm)) {
+        // columns read high when open, right shifted: row r at bits 16 + 4r
+        uint16_t down = (uint16_t)~(pio_sm_get(kp_pio, kp_sm) >> 16);
+        uint16_t pressed = down & ~kp_down;
+        int i;
+        kp_down = down;
+        for (i = 0 ; pressed ; i++, pressed >>= 1) {
+            if (pressed & 1) {
+                keybrd_queue_put(keymap[i / KYBD_COL_COUNT][i % KYBD_COL_COUNT]);
+            }
+        }
+        if (!down) {
+            kps_scan_idle();
+            break;
+        }
+    }
+    PRF_END(TLM_PRF_KPS_RX_ISR, m);
+}
+
+// Start the PIO scan, 0 := SUCCESS, else no state machine / program space
+// or the pins are not consecutive (use the timer scan).
+static int kps_start(void) {
+    pio_sm_config c;
+    int i;
+    for (i = 1 ; i < KYBD_ROW_COUNT ; i++) {
+        if (kp_rows[i] != kp_rows[0] + i) return 1;
+    }
+    for (i = 1 ; i < KYBD_COL_COUNT ; i++) {
+        if (kp_cols[i] != kp_cols[0] + i) return 1;
+    }
+    kp_pio = KYBD_SCAN_PIO;
+    kps_build();
+    kp_sm = pio_claim_unused_sm(kp_pio, false);
+    if (kp_sm < 0) {
+        return 1;
+    }
+    if (!pio_can_add_program(kp_pio, &kps_program)) {
+        pio_sm_unclaim(kp_pio, kp_sm);
+        kp_sm = -1;
+        return 1;
+    }
+    kp_offset = pio_add_program(kp_pio, &kps_program);
+    // rows: PIO, output level low, direction switched by the program
+    for (i = 0 ; i < KYBD_ROW_COUNT ; i++) {
+        pio_gpio_init(kp_pio, kp_rows[i]);
+    }
+    c = pio_get_default_sm_config();
+    sm_config_set_set_pins(&c, kp_rows[0], KYBD_ROW_COUNT);
+    sm_config_set_in_pins(&c, kp_cols[0]);
+    sm_config_set_in_shift(&c, true, false, 32);
+    sm_config_set_wrap(&c, kp_offset, kp_offset + KPS_PROG_LEN - 1);
+    // debounce loop of KPS_DB_LOOP * 32 cycles := KYBD_PIO_DB_US
+    sm_config_set_clkdiv(&c, (float)clock_get_hz(clk_sys) * (KYBD_PIO_DB_US / 1e6f) / (KPS_DB_LOOP * 32));
+    pio_sm_init(kp_pio, kp_sm, kp_offset, &c);
+    pio_sm_set_pins_with_mask(kp_pio, kp_sm, 0, KPS_ROWS_MASK << kp_rows[0]);
+    pio_sm_set_pindirs_with_mask(kp_pio, kp_sm, KPS_ROWS_MASK << kp_rows[0], KPS_ROWS_MASK << kp_rows[0]);
+    // snapshot interrupt
+    pio_set_irq0_source_enabled(kp_pio, (enum pio_interrupt_source)(pis_sm0_rx_fifo_not_empty + kp_sm), true);
+    irq_set_exclusive_handler(pio_get_index(kp_pio) ? PIO1_IRQ_0 : PIO0_IRQ_0, kps_rx_isr);
+    irq_set_enabled(pio_get_index(kp_pio) ? PIO1_IRQ_0 : PIO0_IRQ_0, true);
+    // column edges
+    for (i = 0 ; i < KYBD_COL_COUNT ; i++) {
+        gpio_add_raw_irq_handler(kp_cols[i], kps_col_isr);
+    }
+    irq_set_enabled(IO_IRQ_BANK0, true);
+    kps_scan_idle();
+    return 0;
+}
+
+static void kps_stop(void) {
+    int i;
+    kps_cols_irq(false);
+    for (i = 0 ; i < KYBD_COL_COUNT ; i++) {
+        gpio_remove_raw_irq_handler(kp_cols[i], kps_col_isr);
+    }
+    pio_sm_set_enabled(kp_pio, kp_sm, false);
+    pio_set_irq0_source_enabled(kp_pio, (enum pio_interrupt_source)(pis_sm0_rx_fifo_not_empty + kp_sm), false);
+    irq_set_enabled(pio_get_index(kp_pio) ? PIO1_IRQ_0 : PIO0_IRQ_0, false);
+    pio_remove_program(kp_pio, &kps_program, kp_offset);
+    pio_sm_unclaim(kp_pio, kp_sm);
+    kp_sm = -1;
+    // rows back to the (timer scan) keyboard driver
+    for (i = 0 ; i < KYBD_ROW_COUNT ; i++) {
+        gpio_set_function(kp_rows[i], GPIO_FUNC_SIO);
+    }
 }
 
 
@@ -86,33 +319,26 @@ static bool chk_keyboard(repeating_timer_t * rptdata) {
 // until a timeout occurs.
 // ***************************************************************************
 
-// get buffered keycount, safely
-// value returned is a guaranteed buffered key count
-// returning 0 means key buffer is empty
+// buffered keycount, 0 means key buffer is empty
 static int keybrd_get_keycount(void) {
-    int rc = 0;
-    critical_section_enter_blocking(&keybrd_queue);
-    rc = keycount;
-    critical_section_exit(&keybrd_queue);
-    return rc;
+    return (int)(kq_head - kq_tail);
 }
 
-// pull single character from keybuf queue
-// returns keycount remaining.
-static int keybrd_queue_pop_c(char * c) {
-    int rc = 0;
-    critical_section_enter_blocking(&keybrd_queue);
-    if (c) {
-        int i;
-        *c = keybuf[0];
-        for ( i = 1 ; i < keycount ; i++ ) {
-            keybuf[i-1] = keybuf[i]; /* copy down, FIFO style */
-        }
-        keybuf[--keycount] = 0; /* not required but keeps the buffer clean for debugging */
-        rc = keycount;
+// pull up to 'n' characters from the queue, returns # pulled
+static int keybrd_queue_pop_n(char * c, int n) {
+    uint32_t tail = kq_tail;
+    uint32_t avail = kq_head - tail;
+    int i;
+    __mem_fence_acquire();
+    if (n > (int)avail) {
+        n = (int)avail;
     }
-    critical_section_exit(&keybrd_queue);
-    return rc;
+    for (i = 0 ; i < n ; i++) {
+        c[i] = keybuf[(tail + i) & KEYBUF_MASK];
+    }
+    __mem_fence_release();
+    kq_tail = tail + n;
+    return n;
 }
 
 
@@ -125,40 +351,39 @@ int keypad_init(void) {
     if (!kybd_hndl) {
         kybd_hndl = keyboard_map_create(KYBD_ROW_COUNT, KYBD_COL_COUNT, KYBD_DBTIME, KYBD_BUFLEN);
         if (kybd_hndl) {
-            keyboard_assign_row_gpio(kybd_hndl, 0, KYBD_ROW0);
-            keyboard_assign_row_gpio(kybd_hndl, 1, KYBD_ROW1);
-            keyboard_assign_row_gpio(kybd_hndl, 2, KYBD_ROW2);
-            keyboard_assign_row_gpio(kybd_hndl, 3, KYBD_ROW3);
-            keyboard_assign_col_gpio(kybd_hndl, 0, KYBD_COL0);
-            keyboard_assign_col_gpio(kybd_hndl, 1, KYBD_COL1);
-            keyboard_assign_col_gpio(kybd_hndl, 2, KYBD_COL2);
-            keyboard_assign_col_gpio(kybd_hndl, 3, KYBD_COL3);
-            keyboard_key_assign(kybd_hndl, 0, 0, '1');
-            keyboard_key_assign(kybd_hndl, 0, 1, '2');
-            keyboard_key_assign(kybd_hndl, 0, 2, '3');
-            keyboard_key_assign(kybd_hndl, 0, 3, 'A');
-            keyboard_key_assign(kybd_hndl, 1, 0, '4');
-            keyboard_key_assign(kybd_hndl, 1, 1, '5');
-            keyboard_key_assign(kybd_hndl, 1, 2, '6');
-            keyboard_key_assign(kybd_hndl, 1, 3, 'B');
-            keyboard_key_assign(kybd_hndl, 2, 0, '7');
-            keyboard_key_assign(kybd_hndl, 2, 1, '8');
-            keyboard_key_assign(kybd_hndl, 2, 2, '9');
-            keyboard_key_assign(kybd_hndl, 2, 3, 'C');
-            keyboard_key_assign(kybd_hndl, 3, 0, '*');
-            keyboard_key_assign(kybd_hndl, 3, 1, '0');
-            keyboard_key_assign(kybd_hndl, 3, 2, '#');
-            keyboard_key_assign(kybd_hndl, 3, 3, 'D');
+            int r, c;
+            for (r = 0 ; r < KYBD_ROW_COUNT ; r++) {
+                keyboard_assign_row_gpio(kybd_hndl, r, kp_rows[r]);
+            }
+            for (c = 0 ; c < KYBD_COL_COUNT ; c++) {
+                keyboard_assign_col_gpio(kybd_hndl, c, kp_cols[c]);
+            }
+            for (r = 0 ; r < KYBD_ROW_COUNT ; r++) {
+                for (c = 0 ; c < KYBD_COL_COUNT ; c++) {
+                    keyboard_key_assign(kybd_hndl, r, c, keymap[r][c]);
+                }
+            }
         }
     }
     return (kybd_hndl == NULL); // 0 := SUCCESS
 }
 
 // Call to start keypad polling  task operations.
+// PIO scan if enabled and a state machine is free, else the timer scan.
 int keypad_start(void) {
     int rc = 1;
     if (kybd_hndl && !keytask_running) {
-        keytask_running = add_repeating_timer_ms(KYBD_SCAN_PD_MS, chk_keyboard, NULL, &kbtmr);
+#if (KYBD_USE_PIO_SCAN==1)
+        kp_pio_mode = (kps_start() == 0);
+        keytask_running = kp_pio_mode;
+#endif
+        if (!keytask_running) {
+            dl_register(TLM_DL_KEYPAD, KYBD_SCAN_PD_MS * 1000, KYBD_SCAN_PD_MS * 1000);
+            if (kp_tw < 0) {
+                kp_tw = tw_add(chk_keyboard, NULL, TW_PRIO_LOW);
+            }
+            keytask_running = (tw_start_periodic(kp_tw, KYBD_SCAN_PD_MS * 1000) == 0);
+        }
         rc = (keytask_running == false); // 0 := SUCCESS
     }
     return rc;
@@ -168,12 +393,23 @@ int keypad_start(void) {
 int keypad_stop(void) {
     int rc = 1;
     if (kybd_hndl && keytask_running) {
-        keytask_running = ! cancel_repeating_timer(&kbtmr);
+        if (kp_pio_mode) {
+            kps_stop();
+            kp_pio_mode = false;
+            keytask_running = false;
+        } else {
+            keytask_running = (tw_stop(kp_tw) != 0);
+        }
         rc = (keytask_running == true); // 0 := SUCCESS
     }
     return rc;
 }
 
+// true if the keypad is scanned by PIO (IRQ started), false for the timer scan
+bool keypad_is_pio_scan(void) {
+    return kp_pio_mode;
+}
+
 // get a key. Returns # buffered keys including the one 
 // being returned. Places the returning key in 'c'.
 // if returning 0 then the buffer is empty and there was
@@ -183,9 +419,19 @@ int keypad_get(char * c) {
     if (keytask_running && c) {
         rc = keybrd_get_keycount();
         if (rc) {
-            keybrd_queue_pop_c(c);
+            keybrd_queue_pop_n(c, 1);
         }
     }
     return rc; // # buffered key incl. returning key.
 }
 
+// get up to 'n' keys into 'buf' (not terminated), oldest first.
+// Returns # keys placed into 'buf', 0 if the buffer is empty.
+int keypad_get_n(char * buf, int n) {
+    int rc = 0;
+    if (keytask_running && buf && n > 0) {
+        rc = keybrd_queue_pop_n(buf, n);
+    }
+    return rc;
+}
+
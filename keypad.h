@@ -10,6 +10,8 @@
 #ifndef _KEYPAD_H_
 #define _KEYPAD_H_
 
+#include "pico/stdlib.h"
+
 // Call to initialize the resources needed for keypad management.
 int keypad_init(void);
 
@@ -19,10 +21,17 @@ int keypad_start(void);
 // Stop the keypad task and cleanup. Call _start() to restart it.
 int keypad_stop(void);
 
+// true if the keypad is scanned by PIO (IRQ started), false for the timer scan
+bool keypad_is_pio_scan(void);
+
 // get a key. Returns # buffered keys including the one 
 // being returned. Places the returning key in 'c'.
 // if returning 0 then the buffer is empty and there was
 // no value placed into 'c'.
 int keypad_get(char * c);
 
+// get up to 'n' keys into 'buf' (not terminated), oldest first.
+// Returns # keys placed into 'buf', 0 if the buffer is empty.
+int keypad_get_n(char * buf, int n);
+
 #endif /* _KEYPAD_H_ */
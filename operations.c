@@ -19,14 +19,23 @@
  * - Calibration (FUTURE)
  * - Power Tweeks (FUTURE)
  * - Select Preset
+ * - Boost (start / stop)
+ * - Controller Tuning (per preset)
+ * - Diagnostics screen (hot-path profile)
  * 
  */
 
 #include <operations.h>
 #include <board.h>
 #include <display.h>
-#include <stdio.h>
-#include <math.h>
+#include <telemetry.h>
+#include <fixed_math.h>
+#include <settings_store.h>
+#include <standby.h>
+#include <temp_ctrl.h>
+#include <autotune.h>
+#include <profile.h>
+#include <tip_temp.h>
 
 
 /* State Tree
@@ -38,12 +47,18 @@
  *   |        +--> 1 --> [C,D] --> Set Scale [C,D] C:=Celcius, D:=Farenheit
  *   |        |
  *   |        +--> 2 --> +--> dig[1..3],'#' --> value --> change Sleep Delay <value> [sec]
- *   |                   |
- *   |                   +--> '*' (CANCEL or RESET TO DEFAULT)
+ *   |        |          |
+ *   |        |          +--> '*' (CANCEL or RESET TO DEFAULT)
+ *   |        |
+ *   |        +--> 3 --> Tune the controller for the active preset (any key cancels)
+ *   |        |
+ *   |        +--> 4 --> Diagnostics screen (any key goes back)
  *   |
  *   +--> [A,B,C,D] --> Select preset [A,B,C,D]. Ignore if unset
  *   |
  *   +--> '*' --> Toggle manual sleep/wake
+ *   |
+ *   +--> '0' --> Boost start / stop (time limited, see temp_ctrl.c)
  * 
  * (future)
  * '1' dec +1  temp
@@ -59,19 +74,42 @@ static uint32_t setTempPoint  = IRON_START_TEMP;        // target temp. change m
 static char     tempUnits     = IRON_START_SCALE;       // temperature range, 'C' := Celcius, 'F' := Farenheit
 static bool     sw_isWoken    = true;                   // wake ~ Heating, sleeping ~ Cooling
 static uint32_t setSleepDelay = SLEEP_DELAY_DEFAULT;
+static bool     diagShown     = false;                  // diagnostics screen up
+
+// Settings kept in flash (settings store keys)
+#define OPS_SKEY_SETTEMP    1
+#define OPS_SKEY_UNITS      2
+#define OPS_SKEY_SLEEPDLY   3
+#define OPS_SKEY_PRESET     4       /* 4 .. 7 := 'A' .. 'D' */
+#define OPS_PRESET_VALID    0x8000  /* preset value: valid flag | temp */
+#define OPS_SKEY_ACTIVE     8       /* active preset 'A' .. 'D', ' ' := manual */
+#define OPS_SKEY_MODEL      9       /* 9 .. 20 := 'A' .. 'D' tuned model { k, tau, dead } */
+                                    /* 21 .. 25 power_meter.c */
 
 // The state function protype (parent type)
 typedef void * (*stateFunction)(char); // returns the next state, cast to (stateFunction). If NULL then abort.
 
 static uint32_t digs_to_val(char * digs, uint8_t digCount) {
     // digs[] is an array of numerical characters {'0' .. '9'} not numbers!
-    uint32_t val = 0;
-    while (digCount) {
-        digCount --;
-        val += (uint32_t)pow(10,digCount) * ((*digs) - '0');
-        digs ++;
+    return fx_digs_to_u32(digs, digCount);
+}
+
+// highest set temp in 'scale', the iron's maximum
+static int32_t temp_max(char scale) {
+    return (scale == 'F') ? IRON_MAX_TEMP : tt_scale_to_cdeg(IRON_MAX_TEMP, 'F') / TT_CDEG(1);
+}
+
+// a set temp within the iron's range, in 'scale'
+static bool temp_in_range(int32_t t, char scale) {
+    return t > 0 && t <= temp_max(scale);
+}
+
+// a set temp limited to the iron's range, in the current scale
+static uint32_t temp_clamp(int32_t t) {
+    if (t < 1) {
+        return 1;
     }
-    return val;
+    return (t > temp_max(tempUnits)) ? (uint32_t)temp_max(tempUnits) : (uint32_t)t;
 }
 
 
@@ -82,8 +120,11 @@ typedef struct s_tempPreset_type {
     char     presetChar;
     uint8_t  isValid;
     uint32_t setTemp;
+    at_model_t model;   // tuned tip model, k == 0 := not tuned
 } s_tempPreset_t;
 static s_tempPreset_t tempPresets[TEMP_PRESET_COUNT] = {0};
+static char activePreset = ' ';     // ' ' := temp set manually
+static char tunePreset = ' ';       // preset being tuned
 
 static void init_temp_presets(void) {
     char presetLetter = 'A';
@@ -92,10 +133,75 @@ static void init_temp_presets(void) {
         tempPresets[i].presetChar = presetLetter;
         tempPresets[i].isValid = 0;
         tempPresets[i].setTemp = 0;
+        tempPresets[i].model.k = 0;
         presetLetter ++;
     }
 }
 
+static void save_temp_preset(size_t idx) {
+    sst_set(OPS_SKEY_PRESET + idx, (tempPresets[idx].isValid ? OPS_PRESET_VALID : 0) |
+        (uint16_t)(tempPresets[idx].setTemp & ~OPS_PRESET_VALID));
+}
+
+static void save_preset_model(size_t idx) {
+    sst_set(OPS_SKEY_MODEL + 3 * idx, tempPresets[idx].model.k);
+    sst_set(OPS_SKEY_MODEL + 3 * idx + 1, tempPresets[idx].model.tau);
+    sst_set(OPS_SKEY_MODEL + 3 * idx + 2, tempPresets[idx].model.dead);
+}
+
+static void set_active_preset(char k) {
+    activePreset = k;
+    sst_set(OPS_SKEY_ACTIVE, (uint16_t)k);
+}
+
+// controller gains for the active preset: tuned, else the built in ones.
+// Left alone when the temp is set manually (same tip).
+static void apply_preset_gains(void) {
+    size_t idx = (size_t)(activePreset - 'A');
+    tc_gains_t g;
+    if (idx >= TEMP_PRESET_COUNT) {
+        return;
+    }
+    tc_get_gains(&g);
+    if (at_model_gains(&tempPresets[idx].model, &g)) {
+        int32_t ramp = g.ramp;
+        tc_get_default_gains(&g);
+        g.ramp = ramp;
+    }
+    tc_set_gains(&g);
+}
+
+// settings from the last power cycle, defaults for any never changed.
+// Temps out of the iron's range (in the stored scale) are not taken.
+static void restore_settings(void) {
+    uint16_t v;
+    size_t i;
+    if (sst_get(OPS_SKEY_UNITS, &v) && (v == 'C' || v == 'F')) {
+        tempUnits = (char)v;
+    }
+    if (sst_get(OPS_SKEY_SETTEMP, &v) && temp_in_range(v, tempUnits)) {
+        setTempPoint = v;
+    } else {
+        setTempPoint = temp_clamp(tt_cdeg_to_scale(TT_CDEG(IRON_START_TEMP), tempUnits));
+    }
+    if (sst_get(OPS_SKEY_SLEEPDLY, &v)) {
+        setSleepDelay = v;
+    }
+    for (i = 0 ; i < TEMP_PRESET_COUNT ; i++) {
+        if (sst_get(OPS_SKEY_PRESET + i, &v) && temp_in_range(v & ~OPS_PRESET_VALID, tempUnits)) {
+            tempPresets[i].isValid = (v & OPS_PRESET_VALID) ? 1 : 0;
+            tempPresets[i].setTemp = v & ~OPS_PRESET_VALID;
+        }
+        if (sst_get(OPS_SKEY_MODEL + 3 * i, &tempPresets[i].model.k)) {
+            sst_get(OPS_SKEY_MODEL + 3 * i + 1, &tempPresets[i].model.tau);
+            sst_get(OPS_SKEY_MODEL + 3 * i + 2, &tempPresets[i].model.dead);
+        }
+    }
+    if (sst_get(OPS_SKEY_ACTIVE, &v) && v >= 'A' && v < 'A' + TEMP_PRESET_COUNT && tempPresets[v - 'A'].isValid) {
+        activePreset = (char)v;
+    }
+}
+
 // private stateful context data for sf_ts
 #define TEMPSET_DIG_COUNT 3
 typedef struct sf_tempSetData_type {
@@ -108,12 +214,13 @@ static sf_tempSetData_t sf_tempData = {0};
 
 static void * sf_ts_invoke(char k) {
     // ignore 'k', process the context data
-    sf_tempData.temp = digs_to_val(sf_tempData.digits, sf_tempData.digidx);
+    sf_tempData.temp = temp_clamp((int32_t)digs_to_val(sf_tempData.digits, sf_tempData.digidx));
     // TODO - Call method to change temp setting
     size_t idx = (size_t)(sf_tempData.setCode - 'A'); // convert code to index where 'A' := 0, 'B' := 1 etc.
-    printf("*** [sf_ts_invoke] * Set Temp [%c] = %u, idx[%u]\n", sf_tempData.setCode, sf_tempData.temp, idx);
+    tlm_log(TLM_LOG_TS_SET, (uint32_t)sf_tempData.setCode, sf_tempData.temp, idx);
     tempPresets[idx].isValid = 1;
     tempPresets[idx].setTemp = sf_tempData.temp;
+    save_temp_preset(idx);
     return NULL; // end of the state chain
 }
 
@@ -131,10 +238,16 @@ static void * sf_ts_wt_vals(char k) {
     if (k == '*') {
         if (sf_tempData.digidx == 0) {
             size_t idx = (size_t)(sf_tempData.setCode - 'A'); // convert code to index where 'A' := 0, 'B' := 1 etc.
-            printf("*** [sf_ts_wt_vals] * Setting [%c] CLEARED/UNSET, idx[%u]\n", sf_tempData.setCode, idx);
+            tlm_log(TLM_LOG_TS_CLEARED, (uint32_t)sf_tempData.setCode, idx, 0);
             tempPresets[idx].isValid = 0;
+            tempPresets[idx].model.k = 0;
+            save_temp_preset(idx);
+            save_preset_model(idx);
+            if (activePreset == sf_tempData.setCode) {
+                set_active_preset(' ');
+            }
         } else {
-            printf("*** [sf_ts_wt_vals] * Operation Cancelled\n");
+            tlm_log(TLM_LOG_TS_CANCEL, 0, 0, 0);
         }
         return NULL; // cancelled.
     }
@@ -144,15 +257,41 @@ static void * sf_ts_wt_vals(char k) {
 
 // ****** States for Scale Set ************************************************
 
+// set temp 't' in scale 'from' to the current scale, within the iron's range
+static uint32_t temp_convert(uint32_t t, char from) {
+    return temp_clamp(tt_cdeg_to_scale(tt_scale_to_cdeg((int32_t)t, from), tempUnits));
+}
+
+// The set temp and the presets are kept in the scale shown, so a scale
+// change converts (and stores) them: the tip target stays where it was.
+static void set_scale(char scale) {
+    char from = tempUnits;
+    size_t i;
+    if (scale == from) {
+        return;
+    }
+    tempUnits = scale;
+    sst_set(OPS_SKEY_UNITS, (uint16_t)tempUnits);
+    setTempPoint = temp_convert(setTempPoint, from);
+    sst_set(OPS_SKEY_SETTEMP, (uint16_t)setTempPoint);
+    for (i = 0 ; i < TEMP_PRESET_COUNT ; i++) {
+        if (tempPresets[i].isValid) {
+            tempPresets[i].setTemp = temp_convert(tempPresets[i].setTemp, from);
+            save_temp_preset(i);
+        }
+    }
+    disp_pset_temp(setTempPoint);
+}
+
 static void * sf_sset_chk_scale(char k) {
     if (k == 'C') {
-        printf("*** [sf_sset_chk_scale] * Set Scale :: Celcius\n");
-        tempUnits = 'C';
+        tlm_log(TLM_LOG_SCALE_C, 0, 0, 0);
+        set_scale('C');
     } else if (k == 'D') {
-        printf("*** [sf_sset_chk_scale] * Set Scale :: Farenheit\n");
-        tempUnits = 'F';
+        tlm_log(TLM_LOG_SCALE_F, 0, 0, 0);
+        set_scale('F');
     } else {
-        printf("*** [sf_sset_chk_scale] * Set Scale :: INVALID KEY (ignored)\n");
+        tlm_log(TLM_LOG_SCALE_INVALID, 0, 0, 0);
     }
     disp_settemp_scale(tempUnits);
     disp_refresh();
@@ -174,8 +313,9 @@ void * sf_slpdly_invoke(char k) {
     // ignore k, just process data
     sf_slpdlyData.sleepDelaySecs = digs_to_val(sf_slpdlyData.digs, sf_slpdlyData.digidx);
     // TODO - Call method to change temp setting
-    printf("*** [sf_slpdly_invoke] * Sleep delay = %u\n", sf_slpdlyData.sleepDelaySecs);
+    tlm_log(TLM_LOG_SLPDLY_SET, sf_slpdlyData.sleepDelaySecs, 0, 0);
     setSleepDelay = sf_slpdlyData.sleepDelaySecs;
+    sst_set(OPS_SKEY_SLEEPDLY, (uint16_t)setSleepDelay);
     return NULL; // end of the state chain
 }
 
@@ -190,10 +330,11 @@ void * sf_slpdly_wt_vals(char k) {
     }
     if (k == '*') {
         if (sf_slpdlyData.digidx == 0) {
-            printf("*** [sf_slpdly_wt_vals] * Sleep Delay RESET TO DEFAULT\n");
+            tlm_log(TLM_LOG_SLPDLY_DEFAULT, 0, 0, 0);
             setSleepDelay = SLEEP_DELAY_DEFAULT;
+            sst_set(OPS_SKEY_SLEEPDLY, (uint16_t)setSleepDelay);
         } else {
-            printf("*** [sf_slpdly_wt_vals] * Operation Cancelled\n");
+            tlm_log(TLM_LOG_SLPDLY_CANCEL, 0, 0, 0);
         }
         return NULL; // cancelled.
     }
@@ -204,15 +345,63 @@ void * sf_slpdly_wt_vals(char k) {
 // ****** States for Manual Sleep/Wake ****************************************
 
 
+// Independent of the cradle: a manually woken iron still follows standby
+// (see standby.c), a manually slept one stays off when lifted.
 void * sf_slpWake(void) {
     if (sw_isWoken) {
         sw_isWoken = false;
-        printf("*** [sw_isWoken] * going to sleep\n");
+        tlm_log(TLM_LOG_SLEEP, 0, 0, 0);
         disp_cool_on();
     } else {
         sw_isWoken = true;
-        printf("*** [sw_isWoken] * waking up\n");
-        disp_heat_on();
+        tlm_log(TLM_LOG_WAKE, 0, 0, 0);
+        if (sby_get_state() == SBY_ACTIVE) {
+            disp_heat_on();
+        }
+    }
+    disp_refresh();
+    return NULL;
+}
+
+// ****** States for Controller Tuning ****************************************
+
+void * sf_tune(void) {
+    size_t idx = (size_t)(activePreset - 'A');
+    if (idx >= TEMP_PRESET_COUNT) {
+        tlm_log(TLM_LOG_TUNE_NO_PRESET, 0, 0, 0);
+    } else if (at_start() == 0) {
+        tunePreset = activePreset;
+        tlm_log(TLM_LOG_TUNE_START, (uint32_t)tunePreset, setTempPoint, 0);
+        disp_boost(0);
+        disp_tune(true);
+        disp_refresh();
+    } else {
+        tlm_log(TLM_LOG_TUNE_REFUSED, 0, 0, 0);
+    }
+    return NULL;
+}
+
+// ****** States for Diagnostics **********************************************
+
+void * sf_diag(void) {
+    diagShown = true;
+    disp_diagscrn(true);
+    disp_refresh();
+    return NULL;
+}
+
+// ****** States for Boost ****************************************************
+
+void * sf_boost(void) {
+    if (tc_boost_active()) {
+        tc_boost_stop();
+        tlm_log(TLM_LOG_BOOST_STOP, 0, 0, 0);
+        disp_boost(0);
+    } else if (tc_boost_start() == 0) {
+        tlm_log(TLM_LOG_BOOST_START, BOOST_TEMP_C, BOOST_TIME_S, tc_get_boost_budget_j());
+        disp_boost(BOOST_TIME_S);
+    } else {
+        tlm_log(TLM_LOG_BOOST_REFUSED, tc_get_boost_budget_j(), 0, 0);
     }
     disp_refresh();
     return NULL;
@@ -222,15 +411,19 @@ void * sf_slpWake(void) {
 
 void * sf_selectPreset(char k) {
     size_t idx = (size_t)(k - 'A'); // convert code to index where 'A' := 0, 'B' := 1 etc.
-    printf("*** [sf_selectPreset] * Checking preset index[%u]...\n", idx);
+    tlm_log(TLM_LOG_PRESET_CHECK, idx, 0, 0);
     if (idx < TEMP_PRESET_COUNT && tempPresets[idx].isValid) {
-        printf("*** [sf_selectPreset] * Changing temp preset to Setting [%c] T=[%u]\n", k, tempPresets[idx].setTemp);
+        tlm_log(tempPresets[idx].model.k ? TLM_LOG_PRESET_SELECT_TUNED : TLM_LOG_PRESET_SELECT, (uint32_t)k,
+            tempPresets[idx].setTemp, 0);
         setTempPoint = tempPresets[idx].setTemp; // cache it, as this can be manually changed.
+        sst_set(OPS_SKEY_SETTEMP, (uint16_t)setTempPoint);
+        set_active_preset(k);
+        apply_preset_gains();
         disp_preset_show(k);
         disp_pset_temp(setTempPoint);
         disp_refresh();
     } else {
-        printf("*** [sf_selectPreset] * Preset not SET or selection invalid.\n");
+        tlm_log(TLM_LOG_PRESET_INVALID, 0, 0, 0);
     }
     return NULL;
 }
@@ -238,20 +431,24 @@ void * sf_selectPreset(char k) {
 // ****** States for manual Temp Change ***************************************
 
 void * sf_dec_temp(int val) {
-    setTempPoint -= val;
+    setTempPoint = temp_clamp((int32_t)setTempPoint - val);
+    sst_set(OPS_SKEY_SETTEMP, (uint16_t)setTempPoint);
+    set_active_preset(' ');
     disp_preset_show(' '); // temp now under manual control
     disp_pset_temp(setTempPoint);
     disp_refresh();
-    printf("*** [sf_dec_temp] * manual temp change to [%u]\n", setTempPoint);
+    tlm_log(TLM_LOG_TEMP_DEC, setTempPoint, 0, 0);
     return NULL;
 }
 
 void * sf_inc_temp(int val) {
-    setTempPoint += val;
+    setTempPoint = temp_clamp((int32_t)setTempPoint + val);
+    sst_set(OPS_SKEY_SETTEMP, (uint16_t)setTempPoint);
+    set_active_preset(' ');
     disp_preset_show(' '); // temp now under manual control
     disp_pset_temp(setTempPoint);
     disp_refresh();
-    printf("*** [sf_inc_temp] * manual temp change to [%u]\n", setTempPoint);
+    tlm_log(TLM_LOG_TEMP_INC, setTempPoint, 0, 0);
     return NULL;
 }
 
@@ -269,6 +466,14 @@ static void * sf_menu_chk(char k) {
         sf_slpdlyData.digidx = 0;
         rc = sf_slpdly_wt_vals;
         break;
+    case '3':
+        // Tune the controller
+        rc = sf_tune();
+        break;
+    case '4':
+        // Diagnostics screen
+        rc = sf_diag();
+        break;
     case 'A':
     case 'B':
     case 'C':
@@ -281,7 +486,7 @@ static void * sf_menu_chk(char k) {
     case '*':
     default:
         // ignore
-        printf("*** [sf_menu_chk] * Invalid key, ignored: %c\n", k);
+        tlm_log(TLM_LOG_MENU_INVALID, (uint32_t)k, 0, 0);
         rc = NULL;
     }
     return rc;
@@ -302,6 +507,9 @@ static void * sf_menu_init(char k) {
     case '*':
         rc = sf_slpWake();
         break;
+    case '0':
+        rc = sf_boost();
+        break;
     case '1':
         rc = sf_dec_temp(1);
         break;
@@ -347,9 +555,13 @@ static stateFunction next_State = NULL;
 // ***************************************************************************
 
 // Setup Operations
+// Settings are restored from the settings store (sst_init() first)
 int ops_init(void) {
     next_State = NULL;
     init_temp_presets();
+    restore_settings();
+    apply_preset_gains();
+    disp_preset_show(activePreset);
     disp_pset_temp(setTempPoint);
     disp_settemp_scale(tempUnits);
     if (sw_isWoken)
@@ -373,7 +585,14 @@ int ops_reset(void) {
 //  1 Error Occured
 int ops_poll(char k) {
     int rc = 1;
-    if (next_State) {
+    PRF_MARK(m);
+    if (diagShown) {
+        // any key goes back to the operation screen
+        diagShown = false;
+        disp_diagscrn(false);
+        disp_refresh();
+        rc = 0;
+    } else if (next_State) {
         next_State = (stateFunction)next_State(k);
         rc = 0; // stepping ok
     } else {
@@ -388,6 +607,30 @@ int ops_poll(char k) {
             chk = sf_init[++i];
         }
     }
+    PRF_END(TLM_PRF_OPS_POLL, m);
+    return rc;
+}
+
+// Tuning ended (at_poll() state, AT_IDLE := cancelled): a model goes with
+// the preset it was tuned for, and is used right away if still active.
+int ops_tune_done(int state) {
+    size_t idx = (size_t)(tunePreset - 'A');
+    at_model_t m;
+    int rc = 1;
+    disp_tune(false);
+    disp_refresh();
+    if (state == AT_DONE && idx < TEMP_PRESET_COUNT && at_get_model(&m) == 0) {
+        tempPresets[idx].model = m;
+        save_preset_model(idx);
+        if (activePreset == tunePreset) {
+            apply_preset_gains();
+        }
+        tlm_log(TLM_LOG_TUNE_DONE, (uint32_t)tunePreset, 0, 0);
+        rc = 0;
+    } else {
+        tlm_log((state == AT_IDLE) ? TLM_LOG_TUNE_CANCELLED : TLM_LOG_TUNE_FAILED, 0, 0, 0);
+    }
+    tunePreset = ' ';
     return rc;
 }
 
@@ -410,3 +653,24 @@ bool get_wakeStatus(void) {
 uint32_t get_sleepDelay(void) {
     return setSleepDelay;
 }
+
+// preset in use, ' ' := temp set manually
+char get_activePreset(void) {
+    return activePreset;
+}
+
+// diagnostics screen shown
+bool get_diagShown(void) {
+    return diagShown;
+}
+
+// preset 'p' ('A' .. 'D'): false := unset, else its temp and whether it has a tuned model
+bool get_tempPreset(char p, uint32_t * temp, bool * tuned) {
+    size_t idx = (size_t)(p - 'A');
+    if (idx >= TEMP_PRESET_COUNT || !tempPresets[idx].isValid) {
+        return false;
+    }
+    *temp = tempPresets[idx].setTemp;
+    *tuned = tempPresets[idx].model.k != 0;
+    return true;
+}
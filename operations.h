@@ -13,6 +13,9 @@
  * - Calibration (FUTURE)
  * - Power Tweeks (FUTURE)
  * - Select Preset
+ * - Boost (start / stop)
+ * - Controller Tuning (per preset)
+ * - Diagnostics screen
  * 
  */
 
@@ -22,7 +25,8 @@
 #include <stddef.h>
 #include <pico/types.h>
 
-// Setup Operations
+// Setup Operations, settings are restored from the settings store
+// (call sst_init() first)
 int ops_init(void);
 
 // Reset internal Operations
@@ -35,12 +39,19 @@ int ops_reset(void);
 //  1 Error Occured
 int ops_poll(char k);
 
+// Tuning ended, 'state' from at_poll() (AT_IDLE := cancelled). Stores the
+// model with the tuned preset. Returns 0 if a model was stored.
+int ops_tune_done(int state);
+
 // Getters
 
 uint32_t get_tipTempSetting(void);  // current temp setting for iron
 uint32_t get_tempScale(void);       // current temp scale ('C' | 'F')
 bool     get_wakeStatus(void);      // get wake status, true := running and heating
 uint32_t get_sleepDelay(void);      // get delay before sleeping
+char     get_activePreset(void);    // preset in use 'A' .. 'D', ' ' := temp set manually
+bool     get_diagShown(void);       // diagnostics screen shown
+bool     get_tempPreset(char p, uint32_t * temp, bool * tuned); // preset 'A' .. 'D' set? its temp, tuned model
 
 
 #endif /* _OPERATIONS_H_ */
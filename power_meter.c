@@ -0,0 +1,178 @@
+/******************************************************************************
+ * Heater Power Meter
+ *
+ * Energy per fired half-cycle := Vrms^2 / R * half-cycle, so the delivered
+ * energy follows from the fired count (htr_get_counts()) alone; sags of the
+ * line are picked up by measuring its amplitude while the heater conducts.
+ *
+ * Line amplitude: the ADC is idle on fired half-cycles (the tip window is
+ * only opened on the others), a timer task takes one conversion on ADC_VLINE
+ * half way through each fired half-cycle and scales it to the peak by the
+ * phase since the zero-crossing (sin(pi * age / half-cycle)). The readings
+ * are low-pass filtered. While the deadline monitor sheds DL_SHED_METER the
+ * sampling pauses and the last amplitude is used.
+ *
+ * Power window: a ring of PM_WIN_SLOTS snapshots of the energy total, one
+ * every PM_WIN_MS / PM_WIN_SLOTS, average power := energy / time between the
+ * oldest and the current one.
+ *
+ */
+
+#include <power_meter.h>
+#include <heater_ctrl.h>
+#include <operations.h>
+#include <settings_store.h>
+#include <fixed_math.h>
+#include <board.h>
+#include <timer_wheel.h>
+#include <deadline.h>
+#include "hardware/adc.h"
+#include "hardware/sync.h"
+#include <pico/time.h>
+
+#define PM_WIN_SLOTS        10
+#define PM_SLOT_US          (PM_WIN_MS * 1000 / PM_WIN_SLOTS)
+#define PM_SKEY_WH          21      /* 21 .. 25 := 'A' .. 'D', manual [Wh] */
+#define PM_BUCKETS          (MAX_TEMP_PRESETS + 1)
+#define PM_UJ_PER_WH        3600000000ull
+#define PM_UJ_PER_MWH       3600000ull
+#define PM_LINE_IDLE_US     10000   /* sampling interval without mains */
+#define PM_LINE_FILT_SHIFT  3       /* line amplitude low-pass, alpha = 1/8 */
+#define ADC_FS_COUNTS       4096
+
+typedef struct pm_slot_type {
+    uint32_t t_us;
+    uint64_t e_uj;
+    uint32_t hc;
+    uint32_t fired;
+} pm_slot_t;
+
+static volatile uint32_t pm_vpk_mv = HTR_LINE_VRMS_NOM * 1414; // line peak [mV]
+static int pm_tw = -1;                  // line sampling task
+
+static uint64_t  pm_e_uj = 0;           // since power up [uJ]
+static uint32_t  pm_last_fired;
+static pm_slot_t pm_win[PM_WIN_SLOTS];
+static uint32_t  pm_win_head = 0;       // oldest slot
+static uint32_t  pm_win_n = 0;
+static uint32_t  pm_mw = 0;
+static uint32_t  pm_duty = 0;
+
+static uint16_t  pm_wh[PM_BUCKETS];     // stored whole Wh per preset
+static uint64_t  pm_rem_uj[PM_BUCKETS]; // not yet a whole Wh
+
+static uint32_t bucket_of(char preset) {
+    uint32_t idx = (uint32_t)(preset - 'A');
+    return (idx < MAX_TEMP_PRESETS) ? idx : MAX_TEMP_PRESETS;
+}
+
+/* TIMER - one line sense conversion half way through a fired half-cycle */
+static void pm_line_cb(void * ctx) {
+    uint32_t hc = htr_get_halfcycle_us();
+    uint32_t irq, age, raw = 0;
+    bool got = false;
+    if (!hc || !htr_mains_ok() || dl_is_shed(DL_SHED_METER)) {
+        tw_start_once(pm_tw, PM_LINE_IDLE_US); // shed: the last amplitude stands
+        return;
+    }
+    // no tip window can open while the ZC ISR is held off
+    irq = save_and_disable_interrupts();
+    age = htr_get_zc_age_us();
+    if (htr_is_firing() && age >= hc * 3 / 10 && age <= hc * 7 / 10) {
+        adc_select_input(ADC_VLINE_CHAN);
+        raw = adc_read();
+        adc_select_input(ADC_TEMP_CHAN);
+        got = true;
+    }
+    restore_interrupts(irq);
+    if (got) {
+        fx_t s = fx_sin_pi(fx_ratio((int32_t)age, (int32_t)hc));   // >= 0.8 in the band
+        uint32_t v_mv = (uint32_t)((uint64_t)raw * ADC_VLINE_FS_MV / ADC_FS_COUNTS);
+        uint32_t vpk = (uint32_t)(((uint64_t)v_mv << FX_SHIFT) / (uint32_t)s);
+        pm_vpk_mv = pm_vpk_mv + (uint32_t)(((int32_t)vpk - (int32_t)pm_vpk_mv) >> PM_LINE_FILT_SHIFT);
+    }
+    // middle of the next half-cycle
+    tw_start_once(pm_tw, (age < hc) ? (hc - age) + hc / 2 : hc / 2);
+}
+
+// Setup the line sense input and its sampling task
+int pm_init(void) {
+    uint16_t v;
+    uint32_t i;
+    adc_gpio_init(ADC_VLINE);
+    for (i = 0 ; i < PM_BUCKETS ; i++) {
+        pm_wh[i] = sst_get(PM_SKEY_WH + i, &v) ? v : 0;
+        pm_rem_uj[i] = 0;
+    }
+    htr_get_counts(NULL, &pm_last_fired);
+    pm_tw = tw_add(pm_line_cb, NULL, TW_PRIO_NORMAL);
+    return tw_start_once(pm_tw, PM_LINE_IDLE_US);
+}
+
+// Account the half-cycles fired since the last call
+int pm_poll(void) {
+    uint32_t now = time_us_32();
+    uint32_t hc, fired, hc_us, b;
+    uint64_t vpk = pm_vpk_mv;
+    uint64_t e;
+    htr_get_counts(&hc, &fired);
+    hc_us = htr_get_halfcycle_us();
+    // full half-cycle energy [uJ] := Vpk^2 / 2R [mW] * half-cycle [us] / 1000
+    e = (uint64_t)(fired - pm_last_fired) * (vpk * vpk / (2 * HTR_RES_MOHM)) * hc_us / 1000;
+    pm_last_fired = fired;
+    pm_e_uj += e;
+    b = bucket_of(get_activePreset());
+    pm_rem_uj[b] += e;
+    if (pm_rem_uj[b] >= PM_UJ_PER_WH) {
+        pm_rem_uj[b] -= PM_UJ_PER_WH;
+        pm_wh[b] ++;
+        sst_set(PM_SKEY_WH + b, pm_wh[b]);
+    }
+    // window
+    if (pm_win_n == 0 || (now - pm_win[(pm_win_head + pm_win_n - 1) % PM_WIN_SLOTS].t_us) >= PM_SLOT_US) {
+        pm_slot_t * s;
+        if (pm_win_n == PM_WIN_SLOTS) {
+            pm_win_head = (pm_win_head + 1) % PM_WIN_SLOTS;
+            pm_win_n --;
+        }
+        s = &pm_win[(pm_win_head + pm_win_n) % PM_WIN_SLOTS];
+        s->t_us = now;
+        s->e_uj = pm_e_uj;
+        s->hc = hc;
+        s->fired = fired;
+        pm_win_n ++;
+    }
+    if (pm_win_n > 1) {
+        const pm_slot_t * o = &pm_win[pm_win_head];
+        uint32_t dt = now - o->t_us;
+        pm_mw = dt ? (uint32_t)((pm_e_uj - o->e_uj) * 1000 / dt) : pm_mw;
+        pm_duty = (hc != o->hc) ? (fired - o->fired) * 100 / (hc - o->hc) : 0;
+    }
+    return 0;
+}
+
+// average delivered power over the window [mW]
+uint32_t pm_get_mw(void) {
+    return pm_mw;
+}
+
+// fired share of the mains half-cycles over the window [%]
+uint32_t pm_get_duty(void) {
+    return pm_duty;
+}
+
+// measured heater line amplitude [mVrms]
+uint32_t pm_get_line_mv(void) {
+    return (uint32_t)((uint64_t)pm_vpk_mv * 1000 / 1414);
+}
+
+// energy delivered since power up [mWh]
+uint32_t pm_get_session_mwh(void) {
+    return (uint32_t)(pm_e_uj / PM_UJ_PER_MWH);
+}
+
+// energy delivered with a preset in use, all sessions [mWh]
+uint32_t pm_get_preset_mwh(char preset) {
+    uint32_t b = bucket_of(preset);
+    return (uint32_t)pm_wh[b] * 1000 + (uint32_t)(pm_rem_uj[b] / PM_UJ_PER_MWH);
+}
@@ -0,0 +1,44 @@
+/******************************************************************************
+ * Heater Power Meter
+ *
+ * Delivered heater power and energy, from the mains half-cycles the heater
+ * engine actually fired (not the controller's request) and the heater line
+ * amplitude measured on ADC_VLINE, into a heater of HTR_RES_MOHM.
+ *
+ * Power is averaged over a sliding window of PM_WIN_MS. Energy is kept per
+ * session (since power up) and per preset (stored, whole Wh).
+ *
+ */
+
+#ifndef _POWER_METER_H_
+#define _POWER_METER_H_
+
+#include "pico/stdlib.h"
+
+#define PM_WIN_MS       1000    /* power averaging window */
+
+// Setup the line sense input and its sampling task, restore the preset
+// energy totals. Call after tt_init() (ADC) and htr_init().
+int pm_init(void);
+
+// Account the half-cycles fired since the last call. Call from the main
+// loop, at least once per window slot (PM_WIN_MS / 10).
+int pm_poll(void);
+
+// average delivered power over the window [mW]
+uint32_t pm_get_mw(void);
+
+// fired share of the mains half-cycles over the window [%]
+uint32_t pm_get_duty(void);
+
+// measured heater line amplitude [mVrms]
+uint32_t pm_get_line_mv(void);
+
+// energy delivered since power up [mWh]
+uint32_t pm_get_session_mwh(void);
+
+// energy delivered with a preset in use ('A' .. 'D', ' ' := manual temp),
+// all sessions [mWh]
+uint32_t pm_get_preset_mwh(char preset);
+
+#endif /* _POWER_METER_H_ */
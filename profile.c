@@ -0,0 +1,168 @@
+/******************************************************************************
+ * Hot-path Profiling
+ *
+ * Per path, the writer (PRF_END) keeps running totals of calls and cycles
+ * and the min / max of the current window. Closing a window (prf_poll)
+ * takes the totals' difference to the last window and asks the writer to
+ * restart min / max with its next call, so the writer never waits on the
+ * main loop.
+ *
+ */
+
+#include <profile.h>
+#include <telemetry.h>
+#include "pico/time.h"
+#include "hardware/sync.h"
+#include "hardware/clocks.h"
+#include <string.h>
+
+#define SYSTICK_MAX     0x00FFFFFFu
+
+#if (PRF_ENABLE==1)
+
+typedef struct prf_point_type {
+    volatile uint32_t count;    // running, writer owned
+    volatile uint32_t sum;      // running [cycles], wraps
+    volatile uint32_t min;      // this window
+    volatile uint32_t max;
+    volatile uint8_t  core;
+    volatile bool     restart;  // set by prf_poll, min / max start over
+} prf_point_t;
+
+static prf_point_t prf_pt[TLM_PRF_COUNT];
+static uint32_t    prf_count[TLM_PRF_COUNT];   // totals at the last window
+static uint32_t    prf_sum[TLM_PRF_COUNT];
+static prf_stats_t prf_win[TLM_PRF_COUNT];
+static uint32_t    prf_cyc_us = 0;
+static uint32_t    prf_span_us = 0;            // longest time SysTick can measure
+static uint32_t    prf_win_us = 0;
+static bool        prf_running = false;
+
+static void systick_start(void) {
+    systick_hw->rvr = SYSTICK_MAX;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5; // enable, processor clock
+}
+
+// ISR safe, either core. One writer per 'id'.
+void prf_end(uint32_t id, prf_mark_t m) {
+    prf_point_t * p = &prf_pt[id];
+    uint32_t us = time_us_32() - m.us;
+    uint32_t cyc;
+    if (!prf_running) {
+        return;
+    }
+    if (us < prf_span_us) {
+        cyc = (m.cyc - systick_hw->cvr) & SYSTICK_MAX;
+    } else {
+        cyc = us * prf_cyc_us;
+    }
+    if (p->restart) {
+        p->min = cyc;
+        p->max = cyc;
+        p->restart = false;
+    } else {
+        if (cyc < p->min) p->min = cyc;
+        if (cyc > p->max) p->max = cyc;
+    }
+    p->sum += cyc;
+    p->count ++;
+    p->core = (uint8_t)get_core_num();
+}
+
+int prf_init(void) {
+    uint32_t i;
+    if (prf_running) {
+        return 1;
+    }
+    prf_cyc_us = clock_get_hz(clk_sys) / 1000000;
+    prf_span_us = SYSTICK_MAX / prf_cyc_us - 1000; // margin for the two reads
+    memset(prf_pt, 0, sizeof(prf_pt));
+    memset(prf_win, 0, sizeof(prf_win));
+    for (i = 0 ; i < TLM_PRF_COUNT ; i++) {
+        prf_pt[i].restart = true;
+        prf_count[i] = 0;
+        prf_sum[i] = 0;
+    }
+    systick_start();
+    prf_win_us = time_us_32();
+    prf_running = true;
+    return 0;
+}
+
+int prf_core_init(void) {
+    systick_start();
+    return 0;
+}
+
+bool prf_poll(void) {
+    prf_point_t * p;
+    prf_stats_t * w;
+    tlm_prof_t rec;
+    uint32_t i, c, s, n;
+    if (!prf_running || (time_us_32() - prf_win_us) < PRF_REPORT_MS * 1000u) {
+        return false;
+    }
+    prf_win_us = time_us_32();
+    for (i = 0 ; i < TLM_PRF_COUNT ; i++) {
+        p = &prf_pt[i];
+        w = &prf_win[i];
+        c = p->count;
+        s = p->sum;
+        n = c - prf_count[i];
+        w->count = n;
+        w->min = n ? p->min : 0;
+        w->max = n ? p->max : 0;
+        w->mean = n ? (s - prf_sum[i]) / n : 0;
+        w->core = p->core;
+        p->restart = true;
+        prf_count[i] = c;
+        prf_sum[i] = s;
+        if (n) {
+            rec.id = (uint8_t)i;
+            rec.core = w->core;
+            rec.count = (uint16_t)((n > 0xFFFF) ? 0xFFFF : n);
+            rec.min = w->min;
+            rec.max = w->max;
+            rec.mean = w->mean;
+            tlm_put(TLM_REC_PROF, &rec);
+        }
+    }
+    return true;
+}
+
+int prf_get(uint32_t id, prf_stats_t * st) {
+    if (id >= TLM_PRF_COUNT || !prf_running) {
+        return 1;
+    }
+    *st = prf_win[id];
+    return 0;
+}
+
+uint32_t prf_cycles_per_us(void) {
+    return prf_cyc_us;
+}
+
+#else
+
+int prf_init(void) {
+    return 0;
+}
+
+int prf_core_init(void) {
+    return 0;
+}
+
+bool prf_poll(void) {
+    return false;
+}
+
+int prf_get(uint32_t id, prf_stats_t * st) {
+    return 1;
+}
+
+uint32_t prf_cycles_per_us(void) {
+    return clock_get_hz(clk_sys) / 1000000;
+}
+
+#endif
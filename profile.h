@@ -0,0 +1,86 @@
+/******************************************************************************
+ * Hot-path Profiling
+ *
+ * Cycle counts of the code paths listed in TLM_PRF_IDS (telemetry_rec.h).
+ * A path is bracketed by PRF_MARK / PRF_END:
+ *
+ *   PRF_MARK(m);                  // last declaration of the block
+ *   ...
+ *   PRF_END(TLM_PRF_ZC_ISR, m);
+ *
+ * Cycles are read from the SysTick of the running core (24 bit, processor
+ * clock, started by prf_init / prf_core_init on each core). Paths longer
+ * than a SysTick period are taken from the microsecond timer instead.
+ *
+ * Each path has one writer (its ISR / task), so PRF_END takes no lock. The
+ * main loop (prf_poll) closes a window every PRF_REPORT_MS: count, min, max
+ * and mean cycles per path go out as TLM_REC_PROF records and are kept for
+ * the diagnostics screen (prf_get). A call that ends while the window is
+ * being closed may be counted in the next one.
+ *
+ * With PRF_ENABLE 0 the marks compile to nothing and the API is stubbed.
+ *
+ */
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include <board.h>
+#include <telemetry_rec.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct prf_stats_type {
+    uint32_t count;         // calls in the window
+    uint32_t min;           // [cycles]
+    uint32_t max;           // [cycles]
+    uint32_t mean;          // [cycles]
+    uint8_t  core;          // core it last ran on
+} prf_stats_t;
+
+#if (PRF_ENABLE==1)
+
+#include "pico/time.h"
+#include "hardware/structs/systick.h"
+
+typedef struct prf_mark_type {
+    uint32_t cyc;           // SysTick (counts down)
+    uint32_t us;
+} prf_mark_t;
+
+static inline prf_mark_t prf_begin(void) {
+    prf_mark_t m;
+    m.cyc = systick_hw->cvr;
+    m.us = time_us_32();
+    return m;
+}
+
+void prf_end(uint32_t id, prf_mark_t m);
+
+#define PRF_MARK(m)         prf_mark_t m = prf_begin()
+#define PRF_END(id, m)      prf_end((id), (m))
+
+#else
+
+#define PRF_MARK(m)
+#define PRF_END(id, m)      ((void)0)
+
+#endif
+
+// Start the SysTick on this core (core0) and the first window.
+int prf_init(void);
+
+// Start the SysTick on core1, call from core1.
+int prf_core_init(void);
+
+// Main loop: close the window every PRF_REPORT_MS. Returns true when a new
+// window is out.
+bool prf_poll(void);
+
+// Stats of path 'id' over the last window, 0 := ok
+int prf_get(uint32_t id, prf_stats_t * st);
+
+// Processor cycles per microsecond
+uint32_t prf_cycles_per_us(void);
+
+#endif /* _PROFILE_H_ */
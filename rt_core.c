@@ -0,0 +1,158 @@
+/******************************************************************************
+ * Real-Time Core
+ *
+ * Core1 brings the control path up (its ISRs and timer wheel tasks are then
+ * bound to it) and sleeps in __wfe(): from there on it only runs ISRs.
+ *
+ * Both shared records are sequence locked: the writer makes the count odd,
+ * copies the record in and makes it even again, with a barrier each side.
+ * A reader that sees the same even count before and after its copy has a
+ * complete record. The two sides never wait on each other: core1 keeps its
+ * last complete rt_ctl_t if a read races the main loop, the main loop only
+ * retries a read of rt_meas_t (a half-cycle's write is a few hundred
+ * cycles).
+ *
+ * Core1's ISRs all run at the default priority, they do not preempt one
+ * another: a pointer from rt_ctl() stays valid for the rest of that ISR.
+ *
+ */
+
+#include <rt_core.h>
+#include <operations.h>
+#include <analog_psu_ctrl.h>
+#include <heater_ctrl.h>
+#include <tip_temp.h>
+#include <standby.h>
+#include <power_meter.h>
+#include <timer_wheel.h>
+#include <profile.h>
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+
+static volatile uint32_t rt_ctl_seq = 0;
+static rt_ctl_t          rt_ctl_pub;            // shared, written by core0
+static rt_ctl_t          rt_ctl_c0;             // core0's copy
+static bool              rt_ctl_c0_valid = false;
+static rt_ctl_t          rt_ctl_c1;             // core1's last complete copy
+static uint32_t          rt_ctl_c1_seq = 0;
+
+static volatile uint32_t rt_meas_seq = 0;
+static rt_meas_t         rt_meas_pub;           // shared, written by core1
+static rt_meas_t         rt_meas_c0;            // core0's last read
+
+static volatile bool     rt_ready = false;
+
+// core1: bring the control path up, then run ISRs only
+static void rt_core1_main(void) {
+    prf_core_init();
+    tw_init();      // core1's alarm, the control tasks below run on it
+    // Analog PSU supervisor
+    apc_init();
+    apc_enable();
+    // The heater engine and the temperature controller. The controller
+    // runs from the engine's zero-crossing ISR, once per mains half-cycle.
+    htr_init();
+    tt_init();
+    tc_init();
+    sby_init();
+    pm_init();
+    htr_enable();
+    tc_enable();
+    rt_ready = true;
+    __sev();
+    while (true) {
+        __wfe();
+    }
+}
+
+// Launch core1 and bring the control path up on it
+int rt_start(void) {
+    if (rt_ready) {
+        return 1;
+    }
+    rt_ctl_edit();
+    rt_poll();
+    rt_ctl_commit();
+    // core1 starts from a complete record, even if its first read races
+    // the next commit
+    rt_ctl_c1 = rt_ctl_pub;
+    rt_ctl_c1_seq = rt_ctl_seq;
+    multicore_launch_core1(rt_core1_main);
+    while (!rt_ready) {
+        __wfe();
+    }
+    return 0;
+}
+
+// Main loop: publish the operator settings if they changed
+int rt_poll(void) {
+    rt_ctl_t * c = rt_ctl_edit();
+    bool awake = get_wakeStatus();
+    int32_t sp = tt_scale_to_cdeg((int32_t)get_tipTempSetting(), (char)get_tempScale());
+    uint32_t delay = get_sleepDelay();
+    if (awake == c->awake && sp == c->sp_cdeg && delay == c->sleep_delay_s) {
+        return 0;
+    }
+    c->awake = awake;
+    c->sp_cdeg = sp;
+    c->sleep_delay_s = delay;
+    rt_ctl_commit();
+    return 1;
+}
+
+// core0: the record to change (then rt_ctl_commit), or to read back
+rt_ctl_t * rt_ctl_edit(void) {
+    if (!rt_ctl_c0_valid) {
+        rt_ctl_c0.open_loop_w = -1;
+        tc_get_default_gains(&rt_ctl_c0.gains);
+        rt_ctl_c0_valid = true;
+    }
+    return &rt_ctl_c0;
+}
+
+void rt_ctl_commit(void) {
+    rt_ctl_seq ++;  // odd: being written
+    __dmb();
+    rt_ctl_pub = rt_ctl_c0;
+    __dmb();
+    rt_ctl_seq ++;
+}
+
+// core1: take a newer record if one is complete, else keep the last one
+const rt_ctl_t * rt_ctl(void) {
+    rt_ctl_t c;
+    uint32_t s = rt_ctl_seq;
+    if (s != rt_ctl_c1_seq && !(s & 1)) {
+        __dmb();
+        c = rt_ctl_pub;
+        __dmb();
+        if (rt_ctl_seq == s) {
+            rt_ctl_c1 = c;
+            rt_ctl_c1_seq = s;
+        }
+    }
+    return &rt_ctl_c1;
+}
+
+// core1 (the ZC ISR, the only writer)
+void rt_meas_put(const rt_meas_t * m) {
+    rt_meas_seq ++;
+    __dmb();
+    rt_meas_pub = *m;
+    __dmb();
+    rt_meas_seq ++;
+}
+
+// core0 (main loop)
+const rt_meas_t * rt_meas(void) {
+    uint32_t s;
+    do {
+        while ((s = rt_meas_seq) & 1) {
+            tight_loop_contents();
+        }
+        __dmb();
+        rt_meas_c0 = rt_meas_pub;
+        __dmb();
+    } while (rt_meas_seq != s);
+    return &rt_meas_c0;
+}
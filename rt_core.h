@@ -0,0 +1,92 @@
+/******************************************************************************
+ * Real-Time Core
+ *
+ * Splits the station over the two cores:
+ *
+ *   core1   the control path: the heater engine (ZC ISR, firing), the tip
+ *           ADC window, the temperature controller, the cradle standby,
+ *           the power meter line sampling and the analog PSU supervisor,
+ *           with their ISRs and timer wheel tasks
+ *   core0   the user side: keypad, menu operations, remote commands, the
+ *           display, telemetry, the settings store (flash) and autotune
+ *
+ * Nothing the main loop does (a screen redraw, a flash erase with core0's
+ * interrupts off) runs on core1 or holds anything core1 waits for, so it
+ * cannot delay a half-cycle. The image runs from RAM and core1 is not
+ * locked out for flash writes (see CMakeLists.txt).
+ *
+ * The cores share two records, each with one writer and a sequence count
+ * (odd while it is being written):
+ *
+ *   rt_ctl_t    core0 -> core1, what the operator asked for. The main loop
+ *               publishes it (rt_ctl_edit / rt_ctl_commit, rt_poll); core1
+ *               reads it through rt_ctl() which keeps the last complete
+ *               copy: a read that races a write uses that one, core1 never
+ *               waits on core0.
+ *   rt_meas_t   core1 -> core0, the controller state, written once per
+ *               half-cycle (rt_meas_put). Core0 reads it through rt_meas(),
+ *               retrying a read that raced the write.
+ *
+ * Single word state (standby state, half-cycle counts, PSU fault flag,
+ * the deadline monitor's shed level) is read directly. Telemetry records
+ * from core1 go through telemetry's own handoff ring, events through
+ * ev_post (either core).
+ *
+ * Core1 takes no lock core0 holds: the timer wheel has a table and lock
+ * per core, ev_post is lock-free and telemetry has its own ring. The one
+ * shared lock left is the SDK's timer spin lock in
+ * hardware_alarm_set_target, held for a few register accesses.
+ *
+ */
+
+#ifndef _RT_CORE_H_
+#define _RT_CORE_H_
+
+#include "pico/stdlib.h"
+#include <temp_ctrl.h>
+
+// core0 -> core1: operator settings
+typedef struct rt_ctl_type {
+    bool       awake;           // false := put to sleep from the menu
+    int32_t    sp_cdeg;         // operator setpoint [cdeg C], before boost / standby
+    uint32_t   sleep_delay_s;   // cradle -> sleep [sec], 0 := at once
+    int32_t    open_loop_w;     // fixed heater power [W], -1 := closed loop
+    uint32_t   boost_req;       // boost requests so far
+    bool       boost_on;        // the last one: true := start, false := stop
+    tc_gains_t gains;
+} rt_ctl_t;
+
+// core1 -> core0: controller state after the last half-cycle
+typedef struct rt_meas_type {
+    int32_t  temp;              // measured tip temp [cdeg C]
+    int32_t  setpoint;          // target [cdeg C], 0 := heater off
+    uint32_t power;             // requested heater power [W]
+    uint32_t boost_left_ms;     // 0 := not boosting
+    uint32_t boost_budget_j;
+    uint32_t boost_req;         // boost requests taken (rt_ctl_t.boost_req)
+    uint8_t  fault;             // TC_FAULT_xxx
+    bool     running;           // closed loop enabled
+    bool     boost;
+} rt_meas_t;
+
+// Launch core1 and bring the control path up on it (call after sst_init /
+// ops_init, core1 reads the settings). Returns once core1 is running.
+int rt_start(void);
+
+// Main loop: publish the operator settings if they changed.
+int rt_poll(void);
+
+// core0: the record to change, then publish it
+rt_ctl_t * rt_ctl_edit(void);
+void       rt_ctl_commit(void);
+
+// core1: the operator settings, the last complete copy. ISR safe.
+const rt_ctl_t * rt_ctl(void);
+
+// core1 (the ZC ISR): publish the controller state
+void rt_meas_put(const rt_meas_t * m);
+
+// core0: the controller state after the last half-cycle
+const rt_meas_t * rt_meas(void);
+
+#endif /* _RT_CORE_H_ */
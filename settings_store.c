@@ -0,0 +1,294 @@
+/******************************************************************************
+ * Settings Store
+ *
+ * Log layout, per sector (FLASH_SECTOR_SIZE), 8 byte records:
+ *
+ *   slot 0      header  { key 0, ver, generation, magic, crc }
+ *   slot 1 ..   records { key, ver, value, 0, crc }, erased (0xFF) := free
+ *
+ * The sector with the newest valid header is the active one; boot replays
+ * its records in order, the last record of a key wins. A record with a bad
+ * CRC (power lost while programming) is skipped. New records are appended
+ * by programming their page with all other bytes left at 0xFF (NOR flash
+ * only clears bits, so the records already there are untouched).
+ *
+ * When the active sector is full the next one (round robin, so the erases
+ * are spread over all SST_SECTORS) is erased and gets a new header with the
+ * current value of every key, in a single page. The old sector stays valid
+ * until that page is written, so a power loss at any point leaves either
+ * the old or the new sector complete.
+ *
+ * Erase and program run through flash_safe_execute(): core0's interrupts
+ * are off while the flash is out of XIP mode. Core1 is not parked, it runs
+ * the heater from RAM (the whole image is, see rt_core.h), so a write can
+ * go ahead at any time: it holds up the main loop, not the half-cycles.
+ *
+ * A failed write leaves the keys dirty. sst_poll() then backs off before
+ * the next try (SST_RETRY_MS, doubled per failure up to SST_RETRY_MAX_MS)
+ * and logs each failure, so a broken flash does not take the main loop
+ * out of XIP on every pass.
+ *
+ * Boot replay reads at most one sector (512 records, table driven CRC).
+ * A blank store is formatted by sst_init() (first boot only).
+ *
+ */
+
+#include <settings_store.h>
+#include <board.h>
+#include <telemetry.h>
+#include "hardware/flash.h"
+#include "pico/flash.h"
+#include <string.h>
+
+#define SST_REGION_OFS      (PICO_FLASH_SIZE_BYTES - SST_SECTORS * FLASH_SECTOR_SIZE)
+#define SST_REC_SIZE        8
+#define SST_SLOTS           (FLASH_SECTOR_SIZE / SST_REC_SIZE)
+#define SST_SLOTS_PER_PAGE  (FLASH_PAGE_SIZE / SST_REC_SIZE)
+#define SST_KEY_HDR         0
+#define SST_VER             1
+#define SST_MAGIC           0x4A42  /* 'JB' */
+#define SST_SAFE_TMOUT_MS   10      /* flash_safe_execute entry / exit */
+
+typedef struct sst_rec_type {
+    uint8_t  key;
+    uint8_t  ver;
+    uint16_t value;     // header: generation
+    uint16_t aux;       // header: SST_MAGIC
+    uint16_t crc;       // CRC-16/CCITT over the first 6 bytes
+} sst_rec_t;
+
+static uint16_t sst_val[SST_KEY_MAX];
+static uint32_t sst_have = 0;           // keys with a value
+static uint32_t sst_dirty = 0;          // keys to write
+static int      sst_active = -1;        // active sector, -1 := none yet
+static uint16_t sst_gen = 0;
+static uint32_t sst_next = 0;           // next free slot in the active sector
+static uint32_t sst_boot_us = 0;
+static uint32_t sst_fails = 0;          // failed writes in a row
+static uint32_t sst_retry_t0;           // last failure [usec]
+static uint32_t sst_retry_us;           // ... next try that long after
+
+// flash operation, handed to the RAM resident workers
+static uint8_t  sst_page[FLASH_PAGE_SIZE];
+static uint32_t sst_op_ofs;
+static bool     sst_op_erase;
+
+static const uint16_t crc_nib[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+static uint16_t rec_crc(const sst_rec_t * r) {
+    const uint8_t * p = (const uint8_t *)r;
+    uint16_t crc = 0xFFFF;
+    int i;
+    for (i = 0 ; i < 6 ; i++) {
+        crc = (uint16_t)((crc << 4) ^ crc_nib[(crc >> 12) ^ (p[i] >> 4)]);
+        crc = (uint16_t)((crc << 4) ^ crc_nib[(crc >> 12) ^ (p[i] & 0x0F)]);
+    }
+    return crc;
+}
+
+static void rec_make(sst_rec_t * r, uint8_t key, uint16_t value, uint16_t aux) {
+    r->key = key;
+    r->ver = SST_VER;
+    r->value = value;
+    r->aux = aux;
+    r->crc = rec_crc(r);
+}
+
+static const sst_rec_t * slot_ptr(int sector, uint32_t slot) {
+    return (const sst_rec_t *)(XIP_BASE + SST_REGION_OFS + (uint32_t)sector * FLASH_SECTOR_SIZE + slot * SST_REC_SIZE);
+}
+
+static bool rec_erased(const sst_rec_t * r) {
+    const uint32_t * w = (const uint32_t *)r;
+    return w[0] == 0xFFFFFFFF && w[1] == 0xFFFFFFFF;
+}
+
+static bool rec_valid(const sst_rec_t * r) {
+    return r->ver == SST_VER && r->crc == rec_crc(r);
+}
+
+// ***************************************************************************
+// flash access (RAM resident, core0's interrupts off)
+// ***************************************************************************
+
+static void __not_in_flash_func(sst_flash_op)(void * param) {
+    (void)param;
+    if (sst_op_erase) {
+        flash_range_erase(sst_op_ofs, FLASH_SECTOR_SIZE);
+    }
+    flash_range_program(sst_op_ofs, sst_page, FLASH_PAGE_SIZE);
+}
+
+static int sst_flash_page(uint32_t ofs, bool erase_first) {
+    sst_op_ofs = ofs;
+    sst_op_erase = erase_first;
+    return (flash_safe_execute(sst_flash_op, NULL, SST_SAFE_TMOUT_MS) == PICO_OK) ? 0 : 1;
+}
+
+// ***************************************************************************
+// log
+// ***************************************************************************
+
+// new generation in the next sector: every key, one page
+static int sst_compact(void) {
+    int sector = (sst_active < 0) ? 0 : (sst_active + 1) % SST_SECTORS;
+    uint32_t slot = 1;
+    uint32_t have = sst_have;
+    sst_rec_t * r = (sst_rec_t *)sst_page;
+    uint8_t k;
+    memset(sst_page, 0xFF, sizeof(sst_page));
+    rec_make(&r[0], SST_KEY_HDR, (uint16_t)(sst_gen + 1), SST_MAGIC);
+    for (k = 1 ; k < SST_KEY_MAX ; k++) {
+        if (have & (1u << k)) {
+            rec_make(&r[slot++], k, sst_val[k], 0);
+        }
+    }
+    sst_dirty = 0;
+    if (sst_flash_page(SST_REGION_OFS + (uint32_t)sector * FLASH_SECTOR_SIZE, true)) {
+        sst_dirty = have;
+        return 1;
+    }
+    sst_active = sector;
+    sst_gen ++;
+    sst_next = slot;
+    return 0;
+}
+
+// append the dirty keys that fit in the current page
+static int sst_append(void) {
+    uint32_t first = sst_next;
+    uint32_t page_end = (first / SST_SLOTS_PER_PAGE + 1) * SST_SLOTS_PER_PAGE;
+    uint32_t written = 0;
+    sst_rec_t * r = (sst_rec_t *)sst_page;
+    uint8_t k;
+    memset(sst_page, 0xFF, sizeof(sst_page));
+    for (k = 1 ; k < SST_KEY_MAX && sst_next < page_end ; k++) {
+        if (sst_dirty & (1u << k)) {
+            rec_make(&r[sst_next % SST_SLOTS_PER_PAGE], k, sst_val[k], 0);
+            written |= 1u << k;
+            sst_next ++;
+        }
+    }
+    sst_dirty &= ~written;
+    if (sst_flash_page(SST_REGION_OFS + (uint32_t)sst_active * FLASH_SECTOR_SIZE +
+                       (first / SST_SLOTS_PER_PAGE) * FLASH_PAGE_SIZE, false)) {
+        sst_dirty |= written;
+        sst_next = first;
+        return 1;
+    }
+    return 0;
+}
+
+// ***************************************************************************
+// public
+// ***************************************************************************
+
+// Find the newest log sector and replay it into the RAM copy.
+int sst_init(void) {
+    uint32_t t0 = time_us_32();
+    uint32_t slot;
+    int s;
+    sst_active = -1;
+    sst_have = 0;
+    sst_dirty = 0;
+    for (s = 0 ; s < SST_SECTORS ; s++) {
+        const sst_rec_t * h = slot_ptr(s, 0);
+        if (h->key == SST_KEY_HDR && h->aux == SST_MAGIC && rec_valid(h)) {
+            if (sst_active < 0 || (int16_t)(h->value - sst_gen) > 0) {
+                sst_active = s;
+                sst_gen = h->value;
+            }
+        }
+    }
+    if (sst_active >= 0) {
+        sst_next = SST_SLOTS;
+        for (slot = 1 ; slot < SST_SLOTS ; slot++) {
+            const sst_rec_t * r = slot_ptr(sst_active, slot);
+            if (rec_erased(r)) {
+                sst_next = slot;
+                break;
+            }
+            if (r->key < SST_KEY_MAX && r->key != SST_KEY_HDR && rec_valid(r)) {
+                sst_val[r->key] = r->value;
+                sst_have |= 1u << r->key;
+            }
+        }
+    }
+    sst_boot_us = time_us_32() - t0;
+    if (sst_active < 0) {
+        // blank store (first boot), format the first sector now
+        return sst_compact();
+    }
+    return 0;
+}
+
+// Stored value for 'key', returns false if it was never set.
+bool sst_get(uint8_t key, uint16_t * value) {
+    if (key == SST_KEY_HDR || key >= SST_KEY_MAX || !(sst_have & (1u << key))) {
+        return false;
+    }
+    if (value) {
+        *value = sst_val[key];
+    }
+    return true;
+}
+
+// Set 'key' (RAM copy, written to flash by sst_poll()).
+int sst_set(uint8_t key, uint16_t value) {
+    if (key == SST_KEY_HDR || key >= SST_KEY_MAX) {
+        return 1;
+    }
+    if ((sst_have & (1u << key)) && sst_val[key] == value) {
+        return 0; // no change
+    }
+    sst_val[key] = value;
+    sst_have |= 1u << key;
+    sst_dirty |= 1u << key;
+    return 0;
+}
+
+// Write pending changes.
+int sst_poll(void) {
+    uint32_t ms, i;
+    int rc;
+    if (!sst_dirty) {
+        return 0;
+    }
+    if (sst_fails && (time_us_32() - sst_retry_t0) < sst_retry_us) {
+        return 0; // backing off
+    }
+    if (sst_active < 0 || sst_next >= SST_SLOTS) {
+        rc = sst_compact();
+    } else {
+        rc = sst_append();
+    }
+    if (!rc) {
+        sst_fails = 0;
+        return 0;
+    }
+    ms = SST_RETRY_MS;
+    for (i = 0 ; i < sst_fails && ms < SST_RETRY_MAX_MS ; i++) {
+        ms <<= 1;
+    }
+    if (ms > SST_RETRY_MAX_MS) {
+        ms = SST_RETRY_MAX_MS;
+    }
+    sst_fails ++;
+    sst_retry_t0 = time_us_32();
+    sst_retry_us = ms * 1000;
+    tlm_log(TLM_LOG_SST_FAIL, sst_fails, ms, 0);
+    return rc;
+}
+
+// true if changes are waiting for sst_poll()
+bool sst_pending(void) {
+    return sst_dirty != 0;
+}
+
+// time the boot replay took [usec]
+uint32_t sst_get_boot_us(void) {
+    return sst_boot_us;
+}
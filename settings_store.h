@@ -0,0 +1,48 @@
+/******************************************************************************
+ * Settings Store
+ *
+ * Persistent key / value settings (16 bit values) in the last SST_SECTORS
+ * flash sectors, kept as an append-only log of small CRC protected records.
+ *
+ * sst_set() only updates the RAM copy; the main loop calls sst_poll(), which
+ * writes the changed keys to flash:
+ * - appending records (a page program, ~0.5 msec)
+ * - moving to the next sector when the current one is full (a sector
+ *   erase, ~45 msec)
+ * Either one stops the main loop (core0) for that long; the heater runs on
+ * core1 from RAM and carries on (rt_core.h).
+ *
+ */
+
+#ifndef _SETTINGS_STORE_H_
+#define _SETTINGS_STORE_H_
+
+#include "pico/stdlib.h"
+
+#define SST_KEY_MAX     32  /* keys 1 .. SST_KEY_MAX-1, with the header one page */
+
+// Find the newest log sector and replay it into the RAM copy.
+// Call once at boot, before any sst_get().
+int sst_init(void);
+
+// Stored value for 'key', returns false if it was never set.
+bool sst_get(uint8_t key, uint16_t * value);
+
+// Set 'key' (RAM copy, written to flash by sst_poll()).
+// returns 0 := SUCCESS, 1 := bad key
+int sst_set(uint8_t key, uint16_t value);
+
+// Write pending changes. Call from the main loop (not from an ISR), eg. on
+// every mains half-cycle event. After a failed write the next try waits
+// SST_RETRY_MS, doubled per failure up to SST_RETRY_MAX_MS (each failure
+// is logged); sst_pending() stays true meanwhile.
+// returns 0 := SUCCESS / nothing to do yet, 1 := flash access failed
+int sst_poll(void);
+
+// true if changes are waiting for sst_poll()
+bool sst_pending(void);
+
+// time the boot replay took [usec]
+uint32_t sst_get_boot_us(void);
+
+#endif /* _SETTINGS_STORE_H_ */
@@ -0,0 +1,29 @@
+/******************************************************************************
+ * Host Simulation - picoDrivers shim
+ *
+ * Low level graphics driver interface (SSD1309, 128 x 64, 1 bpp). The
+ * simulated panel keeps its own GDDRAM copy and charges every frame push to
+ * the virtual clock at DISP_DRVR_SPI_CLK_FREQ_HZ.
+ *
+ */
+
+#ifndef _SIM_GFXDRIVERLOWPRIV_H_
+#define _SIM_GFXDRIVERLOWPRIV_H_
+
+#include <pico/types.h>
+
+#define GFX_DISP_WIDTH      128
+#define GFX_DISP_HEIGHT     64
+#define GFX_DISP_PAGES      (GFX_DISP_HEIGHT / 8)
+
+#define COLOUR_WHT          0   /* pixel off */
+#define COLOUR_BLK          1   /* pixel on  */
+
+int bsp_ConfigureGfxDriver(void);
+int bsp_StartGfxDriver(void);
+int gfx_displayOn(void);
+int gfx_displayOff(void);
+int gfx_clearDisplay(void);
+int gfx_displayRefresh(void);
+
+#endif /* _SIM_GFXDRIVERLOWPRIV_H_ */
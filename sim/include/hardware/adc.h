@@ -0,0 +1,38 @@
+/******************************************************************************
+ * Host Simulation - Pico SDK shim
+ *
+ * ADC, 12 bit. Conversions on the tip thermocouple channel come from the
+ * plant model (sensor temperature, noise and heater pickup). Free-running
+ * mode paces conversions from the clock divider into a 4 deep FIFO, or
+ * straight to DMA when the FIFO DREQ is enabled.
+ *
+ */
+
+#ifndef _SIM_HARDWARE_ADC_H_
+#define _SIM_HARDWARE_ADC_H_
+
+#include <pico/types.h>
+
+void     adc_init(void);
+void     adc_gpio_init(uint gpio);
+void     adc_select_input(uint input);
+uint16_t adc_read(void);
+
+typedef struct {
+    io_rw_32 cs;
+    io_rw_32 result;
+    io_rw_32 fcs;
+    io_ro_32 fifo;
+    io_rw_32 div;
+} adc_hw_t;
+
+extern adc_hw_t sim_adc_hw;
+#define adc_hw (&sim_adc_hw)
+
+void     adc_fifo_setup(bool en, bool dreq_en, uint16_t dreq_thresh, bool err_in_fifo, bool byte_shift);
+void     adc_set_clkdiv(float clkdiv);
+void     adc_run(bool run);
+uint8_t  adc_fifo_get_level(void);
+void     adc_fifo_drain(void);
+
+#endif /* _SIM_HARDWARE_ADC_H_ */
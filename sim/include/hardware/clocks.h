@@ -0,0 +1,31 @@
+/******************************************************************************
+ * Host Simulation - Pico SDK shim
+ *
+ * Clock tree, fixed at the SDK defaults (clk_sys / clk_peri 125 MHz).
+ *
+ */
+
+#ifndef _SIM_HARDWARE_CLOCKS_H_
+#define _SIM_HARDWARE_CLOCKS_H_
+
+#include <pico/types.h>
+
+enum clock_index {
+    clk_gpout0 = 0,
+    clk_gpout1,
+    clk_gpout2,
+    clk_gpout3,
+    clk_ref,
+    clk_sys,
+    clk_peri,
+    clk_usb,
+    clk_adc,
+    clk_rtc,
+    CLK_COUNT
+};
+
+static inline uint32_t clock_get_hz(enum clock_index clk_index) {
+    return (clk_index == clk_usb || clk_index == clk_adc) ? 48000000u : ((clk_index == clk_rtc) ? 46875u : 125000000u);
+}
+
+#endif /* _SIM_HARDWARE_CLOCKS_H_ */
@@ -0,0 +1,89 @@
+/******************************************************************************
+ * Host Simulation - Pico SDK shim
+ *
+ * DMA. Channels move data between memory and the simulated peripherals: a
+ * peripheral model offers or asks for one item on its DREQ and a busy channel
+ * paced by that DREQ carries it (sim_dma.c). Only the transfer count of the
+ * channel registers is modelled. A channel raises DMA_IRQ_0/1 on completion
+ * if enabled.
+ *
+ */
+
+#ifndef _SIM_HARDWARE_DMA_H_
+#define _SIM_HARDWARE_DMA_H_
+
+#include <pico/types.h>
+
+#define NUM_DMA_CHANNELS    12
+
+// DREQ sources
+#define DREQ_SPI0_TX        16
+#define DREQ_SPI0_RX        17
+#define DREQ_SPI1_TX        18
+#define DREQ_SPI1_RX        19
+#define DREQ_UART0_TX       20
+#define DREQ_UART0_RX       21
+#define DREQ_UART1_TX       22
+#define DREQ_UART1_RX       23
+#define DREQ_ADC            36
+#define DREQ_FORCE          63
+
+enum dma_channel_transfer_size {
+    DMA_SIZE_8 = 0,
+    DMA_SIZE_16 = 1,
+    DMA_SIZE_32 = 2
+};
+
+typedef struct {
+    uint   size;
+    bool   read_incr;
+    bool   write_incr;
+    uint   dreq;
+    bool   ring_write;
+    uint   ring_bits;       // 0 := no ring
+    bool   enable;
+} dma_channel_config;
+
+typedef struct {
+    io_rw_32 transfer_count;
+} dma_channel_hw_t;
+
+int  dma_claim_unused_channel(bool required);
+void dma_channel_unclaim(uint channel);
+
+dma_channel_config dma_channel_get_default_config(uint channel);
+static inline void channel_config_set_transfer_data_size(dma_channel_config * c, enum dma_channel_transfer_size size) { c->size = size; }
+static inline void channel_config_set_read_increment(dma_channel_config * c, bool incr)  { c->read_incr = incr; }
+static inline void channel_config_set_write_increment(dma_channel_config * c, bool incr) { c->write_incr = incr; }
+static inline void channel_config_set_dreq(dma_channel_config * c, uint dreq)            { c->dreq = dreq; }
+static inline void channel_config_set_ring(dma_channel_config * c, bool write, uint size_bits) {
+    c->ring_write = write;
+    c->ring_bits  = size_bits;
+}
+static inline void channel_config_set_enable(dma_channel_config * c, bool enable)        { c->enable = enable; }
+
+void dma_channel_configure(uint channel, const dma_channel_config * config, volatile void * write_addr,
+                           const volatile void * read_addr, uint transfer_count, bool trigger);
+void dma_channel_set_read_addr(uint channel, const volatile void * read_addr, bool trigger);
+void dma_channel_set_write_addr(uint channel, volatile void * write_addr, bool trigger);
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger);
+void dma_channel_start(uint channel);
+void dma_channel_abort(uint channel);
+bool dma_channel_is_busy(uint channel);
+void dma_channel_wait_for_finish_blocking(uint channel);
+dma_channel_hw_t * dma_channel_hw_addr(uint channel);
+
+static inline void dma_channel_transfer_from_buffer_now(uint channel, const volatile void * read_addr, uint32_t transfer_count) {
+    dma_channel_set_read_addr(channel, read_addr, false);
+    dma_channel_set_trans_count(channel, transfer_count, true);
+}
+
+// completion interrupts, DMA_IRQ_0 / DMA_IRQ_1
+void dma_channel_set_irq0_enabled(uint channel, bool enabled);
+void dma_channel_set_irq1_enabled(uint channel, bool enabled);
+bool dma_channel_get_irq0_status(uint channel);
+bool dma_channel_get_irq1_status(uint channel);
+void dma_channel_acknowledge_irq0(uint channel);
+void dma_channel_acknowledge_irq1(uint channel);
+
+#endif /* _SIM_HARDWARE_DMA_H_ */
@@ -0,0 +1,35 @@
+/******************************************************************************
+ * Host Simulation - Pico SDK shim
+ *
+ * On-board QSPI flash (sim_flash.c). The whole device is a RAM array that
+ * XIP_BASE points at, so memory mapped reads work as on the target. Erase
+ * and program obey NOR rules (erase to 0xFF, program only clears bits) and
+ * stall the calling core (and any core flash_safe_execute locks out) for
+ * the typical device time, as they do with XIP off.
+ *
+ */
+
+#ifndef _SIM_HARDWARE_FLASH_H_
+#define _SIM_HARDWARE_FLASH_H_
+
+#include <pico/types.h>
+
+#define FLASH_PAGE_SIZE         (1u << 8)
+#define FLASH_SECTOR_SIZE       (1u << 12)
+#define FLASH_BLOCK_SIZE        (1u << 16)
+#ifndef PICO_FLASH_SIZE_BYTES
+#define PICO_FLASH_SIZE_BYTES   (2 * 1024 * 1024)
+#endif
+
+extern uint8_t sim_flash_mem[PICO_FLASH_SIZE_BYTES];
+#define XIP_BASE                ((uintptr_t)sim_flash_mem)
+
+// RAM resident function (pico/platform.h)
+#define __not_in_flash_func(func_name) func_name
+
+// 'flash_offs' / 'count' multiples of FLASH_SECTOR_SIZE
+void flash_range_erase(uint32_t flash_offs, size_t count);
+// 'flash_offs' / 'count' multiples of FLASH_PAGE_SIZE
+void flash_range_program(uint32_t flash_offs, const uint8_t * data, size_t count);
+
+#endif /* _SIM_HARDWARE_FLASH_H_ */
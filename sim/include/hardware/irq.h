@@ -0,0 +1,41 @@
+/******************************************************************************
+ * Host Simulation - Pico SDK shim
+ *
+ * NVIC control. Peripheral models raise an interrupt with sim_irq_raise();
+ * the exclusive handler runs at once if the interrupt is enabled. The GPIO
+ * bank dispatches its own handlers directly.
+ *
+ */
+
+#ifndef _SIM_HARDWARE_IRQ_H_
+#define _SIM_HARDWARE_IRQ_H_
+
+#include <pico/types.h>
+
+#define TIMER_IRQ_0     0
+#define TIMER_IRQ_1     1
+#define TIMER_IRQ_2     2
+#define TIMER_IRQ_3     3
+#define PIO0_IRQ_0      7
+#define PIO0_IRQ_1      8
+#define PIO1_IRQ_0      9
+#define PIO1_IRQ_1      10
+#define DMA_IRQ_0       11
+#define DMA_IRQ_1       12
+#define IO_IRQ_BANK0    13
+#define SIO_IRQ_PROC0   15
+#define SIO_IRQ_PROC1   16
+#define UART0_IRQ       20
+#define UART1_IRQ       21
+#define ADC_IRQ_FIFO    22
+
+#define NUM_IRQS        32
+
+typedef void (*irq_handler_t)(void);
+
+void irq_set_enabled(uint num, bool enabled);
+bool irq_is_enabled(uint num);
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+void irq_remove_handler(uint num, irq_handler_t handler);
+
+#endif /* _SIM_HARDWARE_IRQ_H_ */
@@ -0,0 +1,152 @@
+/******************************************************************************
+ * Host Simulation - Pico SDK shim
+ *
+ * PIO. Two blocks of four state machines sharing 32 instruction slots, run
+ * by an instruction level interpreter in virtual time at clk_sys / clkdiv
+ * (sim_pio.c). Modelled: all nine instructions with delay and side-set,
+ * wrap, autopush / autopull, the 4 deep FIFOs (joinable), the eight IRQ
+ * flags and the PIOx_IRQ_0/1 lines (RX not empty, TX not full, flags 0..3).
+ * A state machine stalled on a WAIT, a FIFO or an IRQ flag sleeps until a
+ * GPIO, FIFO or flag changes.
+ *
+ */
+
+#ifndef _SIM_HARDWARE_PIO_H_
+#define _SIM_HARDWARE_PIO_H_
+
+#include <pico/types.h>
+#include <hardware/pio_instructions.h>
+#include <hardware/gpio.h>
+
+#define NUM_PIOS                2
+#define NUM_PIO_STATE_MACHINES  4
+#define PIO_INSTRUCTION_COUNT   32
+
+typedef struct pio_hw pio_hw_t;
+typedef pio_hw_t *    PIO;
+
+extern pio_hw_t sim_pio0_hw, sim_pio1_hw;
+#define pio0 (&sim_pio0_hw)
+#define pio1 (&sim_pio1_hw)
+
+typedef struct pio_program {
+    const uint16_t * instructions;
+    uint8_t          length;
+    int8_t           origin;    // required load address, -1 := any
+} pio_program_t;
+
+typedef struct {
+    float    clkdiv;
+    uint     wrap_target, wrap;
+    uint     in_base;
+    uint     out_base, out_count;
+    uint     set_base, set_count;
+    uint     sideset_base, sideset_count;   // incl. the enable bit when optional
+    bool     sideset_opt, sideset_pindirs;
+    uint     jmp_pin;
+    bool     in_shift_right, autopush;
+    uint     push_threshold;
+    bool     out_shift_right, autopull;
+    uint     pull_threshold;
+    uint     fifo_join;
+    bool     out_sticky;
+    uint     mov_status_sel, mov_status_n;
+} pio_sm_config;
+
+enum pio_fifo_join {
+    PIO_FIFO_JOIN_NONE = 0,
+    PIO_FIFO_JOIN_TX   = 1,
+    PIO_FIFO_JOIN_RX   = 2,
+};
+
+enum pio_mov_status_type {
+    STATUS_TX_LESSTHAN = 0,
+    STATUS_RX_LESSTHAN = 1,
+};
+
+enum pio_interrupt_source {
+    pis_interrupt0 = 8,
+    pis_interrupt1 = 9,
+    pis_interrupt2 = 10,
+    pis_interrupt3 = 11,
+    pis_sm0_tx_fifo_not_full = 4,
+    pis_sm1_tx_fifo_not_full = 5,
+    pis_sm2_tx_fifo_not_full = 6,
+    pis_sm3_tx_fifo_not_full = 7,
+    pis_sm0_rx_fifo_not_empty = 0,
+    pis_sm1_rx_fifo_not_empty = 1,
+    pis_sm2_rx_fifo_not_empty = 2,
+    pis_sm3_rx_fifo_not_empty = 3,
+};
+
+// config
+pio_sm_config pio_get_default_sm_config(void);
+static inline void sm_config_set_wrap(pio_sm_config * c, uint wrap_target, uint wrap) { c->wrap_target = wrap_target; c->wrap = wrap; }
+static inline void sm_config_set_in_pins(pio_sm_config * c, uint in_base) { c->in_base = in_base; }
+static inline void sm_config_set_out_pins(pio_sm_config * c, uint out_base, uint out_count) { c->out_base = out_base; c->out_count = out_count; }
+static inline void sm_config_set_set_pins(pio_sm_config * c, uint set_base, uint set_count) { c->set_base = set_base; c->set_count = set_count; }
+static inline void sm_config_set_sideset_pins(pio_sm_config * c, uint sideset_base) { c->sideset_base = sideset_base; }
+static inline void sm_config_set_sideset(pio_sm_config * c, uint bit_count, bool optional, bool pindirs) {
+    c->sideset_count = bit_count; c->sideset_opt = optional; c->sideset_pindirs = pindirs;
+}
+static inline void sm_config_set_clkdiv(pio_sm_config * c, float div) { c->clkdiv = (div < 1.0f) ? 1.0f : div; }
+static inline void sm_config_set_clkdiv_int_frac(pio_sm_config * c, uint16_t div_int, uint8_t div_frac) {
+    c->clkdiv = (div_int ? (float)div_int : 65536.0f) + (float)div_frac / 256.0f;
+}
+static inline void sm_config_set_jmp_pin(pio_sm_config * c, uint pin) { c->jmp_pin = pin; }
+static inline void sm_config_set_in_shift(pio_sm_config * c, bool shift_right, bool autopush, uint push_threshold) {
+    c->in_shift_right = shift_right; c->autopush = autopush; c->push_threshold = push_threshold;
+}
+static inline void sm_config_set_out_shift(pio_sm_config * c, bool shift_right, bool autopull, uint pull_threshold) {
+    c->out_shift_right = shift_right; c->autopull = autopull; c->pull_threshold = pull_threshold;
+}
+static inline void sm_config_set_fifo_join(pio_sm_config * c, enum pio_fifo_join join) { c->fifo_join = join; }
+static inline void sm_config_set_out_special(pio_sm_config * c, bool sticky, bool has_enable_pin, uint enable_pin_index) { c->out_sticky = sticky; }
+static inline void sm_config_set_mov_status(pio_sm_config * c, enum pio_mov_status_type status_sel, uint status_n) {
+    c->mov_status_sel = status_sel; c->mov_status_n = status_n;
+}
+
+// program memory
+bool pio_can_add_program(PIO pio, const pio_program_t * program);
+uint pio_add_program(PIO pio, const pio_program_t * program);
+void pio_remove_program(PIO pio, const pio_program_t * program, uint loaded_offset);
+
+// state machines
+void pio_sm_claim(PIO pio, uint sm);
+int  pio_claim_unused_sm(PIO pio, bool required);
+void pio_sm_unclaim(PIO pio, uint sm);
+bool pio_sm_is_claimed(PIO pio, uint sm);
+int  pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config * config);
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled);
+void pio_sm_restart(PIO pio, uint sm);
+void pio_sm_clkdiv_restart(PIO pio, uint sm);
+void pio_sm_exec(PIO pio, uint sm, uint instr);
+uint8_t pio_sm_get_pc(PIO pio, uint sm);
+void pio_sm_set_pins_with_mask(PIO pio, uint sm, uint32_t pin_values, uint32_t pin_mask);
+void pio_sm_set_pindirs_with_mask(PIO pio, uint sm, uint32_t pin_dirs, uint32_t pin_mask);
+int  pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out);
+void pio_gpio_init(PIO pio, uint pin);
+uint pio_get_index(PIO pio);
+
+// FIFOs
+void     pio_sm_put(PIO pio, uint sm, uint32_t data);
+void     pio_sm_put_blocking(PIO pio, uint sm, uint32_t data);
+uint32_t pio_sm_get(PIO pio, uint sm);
+uint32_t pio_sm_get_blocking(PIO pio, uint sm);
+bool     pio_sm_is_rx_fifo_empty(PIO pio, uint sm);
+bool     pio_sm_is_rx_fifo_full(PIO pio, uint sm);
+bool     pio_sm_is_tx_fifo_empty(PIO pio, uint sm);
+bool     pio_sm_is_tx_fifo_full(PIO pio, uint sm);
+uint     pio_sm_get_rx_fifo_level(PIO pio, uint sm);
+uint     pio_sm_get_tx_fifo_level(PIO pio, uint sm);
+void     pio_sm_clear_fifos(PIO pio, uint sm);
+void     pio_sm_drain_tx_fifo(PIO pio, uint sm);
+
+// IRQ flags and lines
+bool pio_interrupt_get(PIO pio, uint pio_interrupt_num);
+void pio_interrupt_clear(PIO pio, uint pio_interrupt_num);
+void pio_set_irq0_source_enabled(PIO pio, enum pio_interrupt_source source, bool enabled);
+void pio_set_irq1_source_enabled(PIO pio, enum pio_interrupt_source source, bool enabled);
+void pio_set_irqn_source_enabled(PIO pio, uint irq_index, enum pio_interrupt_source source, bool enabled);
+
+#endif /* _SIM_HARDWARE_PIO_H_ */
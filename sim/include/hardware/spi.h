@@ -0,0 +1,68 @@
+/******************************************************************************
+ * Host Simulation - Pico SDK shim
+ *
+ * SPI, transmit only. Bytes written to spi0 go to the simulated SSD1309
+ * panel (sim_spi.c -> sim_gfx.c), which samples DISP_DRVR_SPI_GPIO_DC per write to tell
+ * commands from data. Blocking writes cost (len * 8 / baudrate) of virtual
+ * time. DMA writes (DREQ_SPIx_TX) are shifted out one byte per byte time;
+ * the RX side is not modelled.
+ *
+ */
+
+#ifndef _SIM_HARDWARE_SPI_H_
+#define _SIM_HARDWARE_SPI_H_
+
+#include <pico/types.h>
+#include <hardware/dma.h>
+
+// Raspberry Pi Pico board defaults
+#define PICO_DEFAULT_SPI            0
+#define PICO_DEFAULT_SPI_SCK_PIN    18
+#define PICO_DEFAULT_SPI_TX_PIN     19
+#define PICO_DEFAULT_SPI_RX_PIN     16
+#define PICO_DEFAULT_SPI_CSN_PIN    17
+
+typedef struct spi_inst {
+    uint     index;
+    uint32_t baudrate;
+    bool     enabled;
+} spi_inst_t;
+
+typedef struct {
+    io_rw_32 cr0;
+    io_rw_32 cr1;
+    io_rw_32 dr;
+    io_rw_32 sr;
+    io_rw_32 cpsr;
+    io_rw_32 imsc;
+    io_rw_32 ris;
+    io_rw_32 mis;
+    io_rw_32 icr;
+    io_rw_32 dmacr;
+} spi_hw_t;
+
+#define SPI_SSPICR_RORIC_BITS   0x00000001
+
+extern spi_inst_t sim_spi[2];
+extern spi_hw_t   sim_spi_hw[2];
+#define spi0        (&sim_spi[0])
+#define spi1        (&sim_spi[1])
+#define spi_default spi0
+
+uint spi_init(spi_inst_t * spi, uint baudrate);
+void spi_deinit(spi_inst_t * spi);
+uint spi_set_baudrate(spi_inst_t * spi, uint baudrate);
+uint spi_get_baudrate(const spi_inst_t * spi);
+int  spi_write_blocking(spi_inst_t * spi, const uint8_t * src, size_t len);
+bool spi_is_busy(const spi_inst_t * spi);
+bool spi_is_readable(const spi_inst_t * spi);
+
+static inline spi_hw_t * spi_get_hw(spi_inst_t * spi) {
+    return &sim_spi_hw[spi->index];
+}
+
+static inline uint spi_get_dreq(spi_inst_t * spi, bool is_tx) {
+    return (spi->index ? DREQ_SPI1_TX : DREQ_SPI0_TX) + (is_tx ? 0 : 1);
+}
+
+#endif /* _SIM_HARDWARE_SPI_H_ */
@@ -0,0 +1,27 @@
+/******************************************************************************
+ * Host Simulation - Pico SDK shim
+ *
+ * SysTick. The current value counts down at the processor clock from the
+ * virtual clock, free running over 24 bits: writes are accepted and have
+ * no effect. Firmware code takes no virtual time, so a profiled section
+ * only shows the time the simulation models (blocking SPI / UART writes,
+ * flash stalls, waits).
+ *
+ */
+
+#ifndef _SIM_HARDWARE_STRUCTS_SYSTICK_H_
+#define _SIM_HARDWARE_STRUCTS_SYSTICK_H_
+
+#include <pico/types.h>
+
+typedef struct {
+    io_rw_32 csr;
+    io_rw_32 rvr;
+    io_rw_32 cvr;
+    io_rw_32 calib;
+} systick_hw_t;
+
+systick_hw_t * sim_systick(void);
+#define systick_hw  (sim_systick())
+
+#endif /* _SIM_HARDWARE_STRUCTS_SYSTICK_H_ */
@@ -0,0 +1,35 @@
+/******************************************************************************
+ * Host Simulation - Pico SDK shim
+ *
+ * Interrupt masking, barriers, spin locks and the inter-core events.
+ * Simulated ISRs and core1 only ever run at the points the virtual clock is
+ * handed over, never asynchronously, so masking and locking have nothing to
+ * do. __sev()/__wfe() are real: __wfe() hands the clock over until the next
+ * event (or interrupt, on core0).
+ *
+ */
+
+#ifndef _SIM_HARDWARE_SYNC_H_
+#define _SIM_HARDWARE_SYNC_H_
+
+#include <pico/types.h>
+
+static inline uint32_t save_and_disable_interrupts(void) { return 0; }
+static inline void     restore_interrupts(uint32_t status) { (void)status; }
+static inline void     __dmb(void) { __sync_synchronize(); }
+static inline void     __mem_fence_acquire(void) { __sync_synchronize(); }
+static inline void     __mem_fence_release(void) { __sync_synchronize(); }
+
+void __sev(void);
+void __wfe(void);
+uint get_core_num(void);
+
+typedef volatile uint32_t spin_lock_t;
+
+static inline int           spin_lock_claim_unused(bool required) { static int n = 16; return n++; }
+spin_lock_t *               sim_spin_lock(uint lock_num);
+static inline spin_lock_t * spin_lock_init(uint lock_num) { return sim_spin_lock(lock_num); }
+static inline uint32_t      spin_lock_blocking(spin_lock_t * lock) { (void)lock; return 0; }
+static inline void          spin_unlock(spin_lock_t * lock, uint32_t saved_irq) { (void)lock; (void)saved_irq; }
+
+#endif /* _SIM_HARDWARE_SYNC_H_ */
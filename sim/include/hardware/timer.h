@@ -0,0 +1,25 @@
+/******************************************************************************
+ * Host Simulation - Pico SDK shim
+ *
+ * Hardware alarms. Each alarm is a scheduler task: the callback runs "in
+ * interrupt context" once the virtual clock reaches the target, and the
+ * alarm is disarmed. A forced interrupt runs it at the current time.
+ *
+ */
+
+#ifndef _SIM_HARDWARE_TIMER_H_
+#define _SIM_HARDWARE_TIMER_H_
+
+#include <pico/types.h>
+#include <pico/time.h>
+
+typedef void (*hardware_alarm_callback_t)(uint alarm_num);
+
+void hardware_alarm_claim(uint alarm_num);
+int  hardware_alarm_claim_unused(bool required);
+void hardware_alarm_set_callback(uint alarm_num, hardware_alarm_callback_t callback);
+bool hardware_alarm_set_target(uint alarm_num, absolute_time_t t);
+void hardware_alarm_cancel(uint alarm_num);
+void hardware_alarm_force_irq(uint alarm_num);
+
+#endif /* _SIM_HARDWARE_TIMER_H_ */
@@ -0,0 +1,53 @@
+/******************************************************************************
+ * Host Simulation - Pico SDK shim
+ *
+ * UART. Bytes written to uart0 (directly or by DMA on DREQ_UART0_TX) are
+ * shifted out at 10 bits per byte time and handed to the telemetry receiver
+ * (sim_uart.c). uart0 receives the scripted command lines (sim_uart_send)
+ * into a 32 byte FIFO, with the receive interrupt raised per byte.
+ *
+ */
+
+#ifndef _SIM_HARDWARE_UART_H_
+#define _SIM_HARDWARE_UART_H_
+
+#include <pico/types.h>
+#include <hardware/dma.h>
+
+typedef struct uart_inst {
+    uint     index;
+    uint32_t baudrate;
+    bool     enabled;
+} uart_inst_t;
+
+typedef struct {
+    io_rw_32 dr;
+    io_rw_32 rsr;
+    io_rw_32 fr;
+} uart_hw_t;
+
+extern uart_inst_t sim_uart[2];
+extern uart_hw_t   sim_uart_hw[2];
+#define uart0       (&sim_uart[0])
+#define uart1       (&sim_uart[1])
+
+uint uart_init(uart_inst_t * uart, uint baudrate);
+void uart_deinit(uart_inst_t * uart);
+void uart_write_blocking(uart_inst_t * uart, const uint8_t * src, size_t len);
+bool uart_is_readable(uart_inst_t * uart);
+char uart_getc(uart_inst_t * uart);
+void uart_set_irq_enables(uart_inst_t * uart, bool rx_has_data, bool tx_needs_data);
+
+static inline uint uart_get_index(uart_inst_t * uart) {
+    return uart->index;
+}
+
+static inline uart_hw_t * uart_get_hw(uart_inst_t * uart) {
+    return &sim_uart_hw[uart->index];
+}
+
+static inline uint uart_get_dreq(uart_inst_t * uart, bool is_tx) {
+    return (uart->index ? DREQ_UART1_TX : DREQ_UART0_TX) + (is_tx ? 0 : 1);
+}
+
+#endif /* _SIM_HARDWARE_UART_H_ */
@@ -0,0 +1,20 @@
+/******************************************************************************
+ * Host Simulation - picoDrivers shim
+ *
+ * GPIO matrix keyboard. Key presses come from the simulation key script.
+ *
+ */
+
+#ifndef _SIM_KEYBOARD_GPIO_H_
+#define _SIM_KEYBOARD_GPIO_H_
+
+#include <pico/stdlib.h>
+
+void * keyboard_map_create(int rows, int cols, int dbtime, int buflen);
+int    keyboard_assign_row_gpio(void * hndl, int row, uint gpio);
+int    keyboard_assign_col_gpio(void * hndl, int col, uint gpio);
+int    keyboard_key_assign(void * hndl, int row, int col, char c);
+int    keyboard_poll(void * hndl);              // scan, returns # buffered keys
+int    keyboard_getkey(void * hndl, char * c);  // pop a key, returns # keys left
+
+#endif /* _SIM_KEYBOARD_GPIO_H_ */
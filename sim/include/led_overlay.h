@@ -0,0 +1,19 @@
+/******************************************************************************
+ * Host Simulation - picoDrivers shim
+ *
+ * Large 7-segment "LED" numeric overlay.
+ *
+ */
+
+#ifndef _SIM_LED_OVERLAY_H_
+#define _SIM_LED_OVERLAY_H_
+
+#include <gfxDriverLowPriv.h>
+
+int    led0_init(int layer);
+int    ledo_visible(int visible);
+void * ledo_open(uint8_t x, uint8_t y, uint8_t digits, uint32_t value, int update_on_chg);
+int    ledo_update(void * hndl, uint32_t value);
+int    ledo_refresh(void * hndl);
+
+#endif /* _SIM_LED_OVERLAY_H_ */
@@ -0,0 +1,20 @@
+/******************************************************************************
+ * Host Simulation - picoDrivers shim
+ *
+ * Line art layer.
+ *
+ */
+
+#ifndef _SIM_LINEGFX_H_
+#define _SIM_LINEGFX_H_
+
+#include <gfxDriverLowPriv.h>
+
+int lgfx_init(int layer);
+int lgfx_visibility(int visible);
+int lgfx_clear(void);
+int lgfx_line(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, int colour);
+int lgfx_box(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, int colour);
+int lgfx_bgraph(uint8_t x, uint8_t y, uint8_t h, uint8_t w, uint8_t len, int colour);
+
+#endif /* _SIM_LINEGFX_H_ */
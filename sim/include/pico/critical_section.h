@@ -0,0 +1,23 @@
+/******************************************************************************
+ * Host Simulation - Pico SDK shim
+ *
+ * The simulation runs every "core" and ISR from a single host thread, so a
+ * critical section never has anything to exclude.
+ *
+ */
+
+#ifndef _SIM_PICO_CRITICAL_SECTION_H_
+#define _SIM_PICO_CRITICAL_SECTION_H_
+
+#include <pico/stdlib.h>
+
+typedef struct critical_section {
+    int depth;
+} critical_section_t;
+
+static inline void critical_section_init(critical_section_t * crit_sec) { crit_sec->depth = 0; }
+static inline void critical_section_enter_blocking(critical_section_t * crit_sec) { crit_sec->depth ++; }
+static inline void critical_section_exit(critical_section_t * crit_sec) { crit_sec->depth --; }
+static inline void critical_section_deinit(critical_section_t * crit_sec) { (void)crit_sec; }
+
+#endif /* _SIM_PICO_CRITICAL_SECTION_H_ */
@@ -0,0 +1,21 @@
+/******************************************************************************
+ * Host Simulation - Pico SDK shim
+ *
+ * pico_flash: run a function with the other core locked out and interrupts
+ * disabled, so it can erase / program the flash safely. Core1 and the ISRs
+ * only run when the virtual clock is handed over, so the function just runs;
+ * the erase / program stalls the cores it would stop (sim_flash.c).
+ *
+ */
+
+#ifndef _SIM_PICO_FLASH_H_
+#define _SIM_PICO_FLASH_H_
+
+#include <pico/types.h>
+
+#define PICO_OK     0
+
+int  flash_safe_execute(void (*func)(void *), void * param, uint32_t enter_exit_timeout_ms);
+bool flash_safe_execute_core_init(void);
+
+#endif /* _SIM_PICO_FLASH_H_ */
@@ -0,0 +1,16 @@
+/******************************************************************************
+ * Host Simulation - Pico SDK shim
+ *
+ * Core1 launch. Core1 runs as a coroutine on the virtual clock (sim_core.c).
+ *
+ */
+
+#ifndef _SIM_PICO_MULTICORE_H_
+#define _SIM_PICO_MULTICORE_H_
+
+#include <pico/types.h>
+
+void multicore_launch_core1(void (*entry)(void));
+void multicore_reset_core1(void);
+
+#endif /* _SIM_PICO_MULTICORE_H_ */
@@ -0,0 +1,16 @@
+/******************************************************************************
+ * Host Simulation - Pico SDK shim
+ *
+ * Deterministic stand-in for pico_rand (seeded from the sim command line).
+ *
+ */
+
+#ifndef _SIM_PICO_RAND_H_
+#define _SIM_PICO_RAND_H_
+
+#include <pico/types.h>
+
+uint32_t get_rand_32(void);
+uint64_t get_rand_64(void);
+
+#endif /* _SIM_PICO_RAND_H_ */
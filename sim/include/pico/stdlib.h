@@ -0,0 +1,20 @@
+/******************************************************************************
+ * Host Simulation - Pico SDK shim
+ *
+ * pico_stdlib aggregate header.
+ *
+ */
+
+#ifndef _SIM_PICO_STDLIB_H_
+#define _SIM_PICO_STDLIB_H_
+
+#include <pico/types.h>
+#include <pico/time.h>
+#include <hardware/gpio.h>
+
+bool stdio_init_all(void);
+
+// busy-wait loop body; costs 1 usec of virtual time so the loop can end
+void tight_loop_contents(void);
+
+#endif /* _SIM_PICO_STDLIB_H_ */
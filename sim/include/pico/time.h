@@ -0,0 +1,50 @@
+/******************************************************************************
+ * Host Simulation - Pico SDK shim
+ *
+ * Time, sleep and repeating timers. All time is virtual: sleeping advances
+ * the simulation clock and runs whatever timers, ISRs and plant models fall
+ * due in the meantime.
+ *
+ */
+
+#ifndef _SIM_PICO_TIME_H_
+#define _SIM_PICO_TIME_H_
+
+#include <pico/types.h>
+
+typedef struct repeating_timer repeating_timer_t;
+typedef bool (*repeating_timer_callback_t)(repeating_timer_t * rt);
+
+struct repeating_timer {
+    int64_t                    delay_us;
+    repeating_timer_callback_t callback;
+    void *                     user_data;
+    int                        sim_task;    /* sim scheduler slot */
+};
+
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+absolute_time_t get_absolute_time(void);
+uint32_t to_ms_since_boot(absolute_time_t t);
+uint64_t to_us_since_boot(absolute_time_t t);
+int64_t  absolute_time_diff_us(absolute_time_t from, absolute_time_t to);
+
+void sleep_ms(uint32_t ms);
+void sleep_us(uint64_t us);
+void busy_wait_us(uint64_t us);
+void busy_wait_ms(uint32_t ms);
+
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void * user_data, repeating_timer_t * out);
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void * user_data, repeating_timer_t * out);
+bool cancel_repeating_timer(repeating_timer_t * timer);
+
+// one-shot alarms; the callback returns 0 (done), >0 (re-arm in that many
+// usec from now) or <0 (re-arm relative to the previous target)
+typedef int32_t alarm_id_t;
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void * user_data);
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void * user_data, bool fire_if_past);
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void * user_data, bool fire_if_past);
+bool       cancel_alarm(alarm_id_t alarm_id);
+
+#endif /* _SIM_PICO_TIME_H_ */
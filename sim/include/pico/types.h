@@ -0,0 +1,24 @@
+/******************************************************************************
+ * Host Simulation - Pico SDK shim
+ *
+ * Base types normally provided by the RP2040 SDK.
+ *
+ */
+
+#ifndef _SIM_PICO_TYPES_H_
+#define _SIM_PICO_TYPES_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef unsigned int uint;
+typedef uint64_t     absolute_time_t;   /* [usec] since (simulated) boot */
+
+static inline absolute_time_t from_us_since_boot(uint64_t us) { return us; }
+
+// peripheral register access qualifiers
+typedef volatile uint32_t       io_rw_32;
+typedef const volatile uint32_t io_ro_32;
+
+#endif /* _SIM_PICO_TYPES_H_ */
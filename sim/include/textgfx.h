@@ -0,0 +1,29 @@
+/******************************************************************************
+ * Host Simulation - picoDrivers shim
+ *
+ * Text layer, 21 x 8 characters of 5x7 font in 6x8 cells.
+ *
+ */
+
+#ifndef _SIM_TEXTGFX_H_
+#define _SIM_TEXTGFX_H_
+
+#include <gfxDriverLowPriv.h>
+
+#define TEXTGFX_COLS        21
+#define TEXTGFX_LINES       8
+
+#define REFRESH_ON_DEMAND   0
+#define REFRESH_ON_WRITE    1
+#define SET_TEXTWRAP_OFF    0
+#define SET_TEXTWRAP_ON     1
+
+int text_init(int layer);
+int textgfx_init(int refresh_mode, int wrap_mode);
+int textgfx_clear(void);
+int textgfx_cursor(uint8_t x, uint8_t line);
+int textgfx_putc(char c);
+int textgfx_puts(const char * s);
+int textgfx_refresh(void);
+
+#endif /* _SIM_TEXTGFX_H_ */
@@ -0,0 +1,158 @@
+/******************************************************************************
+ * Host Simulation of the JBC 200W Controller
+ *
+ * Internal interface between the simulation core (virtual clock, scheduler,
+ * GPIO bank), the plant models (mains, tip, analog PSU), the simulated
+ * display/keypad and the report generator.
+ *
+ * Time is kept in microseconds from simulated boot. Nothing ever waits on
+ * the host clock: a run is deterministic for a given command line and runs
+ * as fast as the host can execute it.
+ *
+ */
+
+#ifndef _SIM_H_
+#define _SIM_H_
+
+#include <pico/types.h>
+#include <stdio.h>
+
+typedef uint64_t sim_time_t;                /* [usec] */
+#define SIM_NEVER   UINT64_MAX
+#define SIM_MS(ms)  ((sim_time_t)(ms) * 1000ull)
+#define SIM_S(s)    ((sim_time_t)(s) * 1000000ull)
+
+// ---- scheduler -------------------------------------------------------------
+
+// Task callback, runs at its due time (as an ISR would). Returns the next
+// due time or SIM_NEVER to go idle (the slot is kept, re-arm with
+// sim_task_due()).
+typedef sim_time_t (*sim_task_fn)(void * ctx, sim_time_t now);
+
+int        sim_task_add(sim_task_fn fn, void * ctx, sim_time_t due);   // returns slot or -1
+void       sim_task_due(int slot, sim_time_t due);
+void       sim_task_remove(int slot);
+
+sim_time_t sim_now(void);
+void       sim_advance_to(sim_time_t t);    // run all tasks due up to 't'
+void       sim_advance(sim_time_t dt);
+sim_time_t sim_next_due(void);             // earliest task due time
+#define    SIM_CORE(n)     (1u << (n))
+void       sim_stall_cores(uint32_t cores, sim_time_t dt); // SIM_CORE() mask stopped for 'dt', interrupts held
+void       sim_set_end(sim_time_t t, void (*on_end)(void));
+void       sim_rand_seed(uint64_t seed);
+
+// ---- GPIO bank -------------------------------------------------------------
+
+// drive an input pin from a model, fires any enabled edge ISR
+void sim_gpio_drive(uint pin, bool level);
+// observe output level / direction changes (plant models hook the heater
+// and PSU pins, the keypad matrix its rows)
+typedef void (*sim_gpio_hook_fn)(uint pin, bool level);
+void sim_gpio_add_out_hook(sim_gpio_hook_fn fn);
+bool sim_gpio_is_output(uint pin);
+// output level on the pad, after the output override (gpio_set_outover)
+bool sim_gpio_pad_level(uint pin);
+
+// ---- DMA (sim_dma.c) ------------------------------------------------------
+
+// a peripheral offers one item on 'dreq', returns false if no busy channel took it
+bool sim_dma_dreq_write(uint dreq, uint32_t value);
+// a peripheral takes one item from 'dreq', returns false if no busy channel has one
+bool sim_dma_dreq_read(uint dreq, uint32_t * value);
+// ... in two steps: the channel completes (and interrupts) only at _end(),
+// once the peripheral has dealt with the item
+bool sim_dma_dreq_read_begin(uint dreq, uint32_t * value);
+void sim_dma_dreq_read_end(uint dreq);
+// called when a channel paced by 'dreq' is started, so the peripheral can begin pulling
+void sim_dma_set_kick(uint dreq, void (*kick)(void));
+
+// ---- PIO (sim_pio.c) --------------------------------------------------------
+
+// a GPIO level changed, state machines stalled on a WAIT take another look
+void sim_pio_gpio_changed(void);
+
+// ---- flash (sim_flash.c) ---------------------------------------------------
+
+// erased device; if 'path' is given its last 'bytes' are kept there between runs
+int      sim_flash_init(const char * path, uint32_t bytes);
+int      sim_flash_save(void);
+uint32_t sim_flash_erases(void);
+uint32_t sim_flash_programs(void);
+sim_time_t sim_flash_max_stall(void);
+
+// ---- interrupts (sim_core.c) -----------------------------------------------
+
+void sim_irq_raise(uint num);
+
+// ---- plant models (sim_plant.c) --------------------------------------------
+
+typedef struct sim_plant_cfg_type {
+    double mains_hz;        // line frequency
+    double line_vrms;       // heater supply, [V rms]
+    double htr_ohms;        // heater resistance
+    double ambient_c;
+    double tip_j_per_k;     // lumped tip + heater heat capacity
+    double tip_k_per_w;     // tip to ambient thermal resistance
+    double sensor_tau_s;    // thermocouple lag
+    double load_j_per_k;    // solder joint / ground plane heat capacity
+    double load_w_per_k;    // tip to joint conductance while loaded
+} sim_plant_cfg_t;
+
+void   sim_plant_defaults(sim_plant_cfg_t * cfg);
+void   sim_plant_init(const sim_plant_cfg_t * cfg);
+void   sim_plant_load(sim_time_t start, sim_time_t duration);  // schedule a heavy joint
+void   sim_plant_hook(sim_time_t start, sim_time_t duration);  // iron in the cradle
+double sim_plant_tip_c(void);
+double sim_plant_sensor_c(void);
+double sim_plant_heater_w(void);            // average over the last half-cycle
+double sim_plant_energy_j(void);
+bool   sim_plant_loaded(void);
+bool   sim_plant_onhook(void);
+bool   sim_plant_psu_ripple(int rail, double * vmin, double * vmax);    // rail 0:+16V 1:-16V
+
+// ---- display (sim_gfx.c) ---------------------------------------------------
+
+void     sim_gfx_dump_ascii(FILE * f);
+int      sim_gfx_dump_pbm(const char * path);
+uint32_t sim_gfx_frames(void);
+void     sim_panel_rx(const uint8_t * buf, size_t len);    // spi0 -> panel
+
+// ---- SPI (sim_spi.c) -------------------------------------------------------
+
+uint64_t sim_spi_bytes(void);               // spi0, blocking and DMA
+uint64_t sim_spi_busy_us(void);
+
+// ---- keypad (sim_keypad.c) -------------------------------------------------
+
+int  sim_keypad_script(const char * spec);  // "t:keys[,t:keys...]", t in [sec]
+char sim_keypad_down(void);                 // currently pressed key or 0
+
+// ---- UART / telemetry (sim_uart.c) -----------------------------------------
+
+typedef struct sim_uart_stats_type {
+    uint64_t   bytes;
+    uint32_t   records;
+    uint32_t   samples;
+    uint32_t   keys;
+    uint32_t   logs;
+    uint32_t   lost;        // sequence gaps (dropped in the firmware ring)
+    uint32_t   bad;         // bytes skipped resyncing, CRC errors
+    sim_time_t busy_us;     // uart0 shifting
+    uint32_t   acks;        // command lines answered
+    uint32_t   acks_failed;
+    sim_time_t ack_max_us;  // line end received to its ack sent
+} sim_uart_stats_t;
+
+int  sim_uart_capture(const char * path);   // raw uart0 stream to 'path'
+int  sim_uart_send(sim_time_t t, const char * text); // 'text' to uart0 RX from 't', a line per '\n'
+void sim_uart_close(void);
+void sim_uart_stats(sim_uart_stats_t * st);
+
+// ---- metrics / report (sim_main.c) -----------------------------------------
+
+void sim_metric_key_down(char k);
+void sim_metric_key_decoded(char k);
+void sim_metric_frame(bool ui_changed);
+
+#endif /* _SIM_H_ */
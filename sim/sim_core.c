@@ -0,0 +1,794 @@
+/******************************************************************************
+ * Host Simulation - core
+ *
+ * Virtual clock and task scheduler, plus the Pico SDK shims that sit directly
+ * on it: time/sleep, repeating timers and alarms, the hardware alarms, the
+ * GPIO bank with edge interrupts, core1 and the inter-core events, pico_rand
+ * and stdio.
+ *
+ * Tasks run strictly in due-time order; ties run in slot order so that a run
+ * is reproducible. A task runs "in interrupt context": it must not sleep.
+ *
+ * Core1 is a coroutine with its own stack, resumed from a task. Whenever it
+ * waits (sleeps, busy-waits on a peripheral, __wfe) it hands the virtual
+ * clock back, so the two cores run concurrently in virtual time. Switches
+ * only happen at those points, spin locks have nothing to do.
+ *
+ * Interrupts belong to the core that enabled them (NVIC line, GPIO pin,
+ * hardware alarm callback) and their handlers run with get_core_num() set
+ * to that core. A stalled core (sim_stall_cores: interrupts off, a flash
+ * write) runs nothing: its interrupts are held pending to the end of the
+ * stall, while the other core, the peripherals and the plant carry on.
+ *
+ */
+
+#include <sim.h>
+#include <pico/stdlib.h>
+#include <pico/rand.h>
+#include <hardware/sync.h>
+#include <pico/multicore.h>
+#include <hardware/clocks.h>
+#include <hardware/timer.h>
+#include <hardware/structs/systick.h>
+#include <stdlib.h>
+#include <ucontext.h>
+
+// ***************************************************************************
+// scheduler
+// ***************************************************************************
+
+#define SIM_TASK_MAX 64
+
+typedef struct sim_task_type {
+    bool        used;
+    sim_task_fn fn;
+    void *      ctx;
+    sim_time_t  due;
+} sim_task_t;
+
+static sim_task_t tasks[SIM_TASK_MAX];
+static sim_time_t now_us = 0;
+static sim_time_t end_us = SIM_NEVER;
+static void    (* end_fn)(void) = NULL;
+static int        run_depth = 0;
+static int        isr_depth = 0;                // ISRs running, either core
+static sim_time_t stall_until[2];               // core stalled until, 0 := running
+
+int sim_task_add(sim_task_fn fn, void * ctx, sim_time_t due) {
+    int i;
+    for (i = 0 ; i < SIM_TASK_MAX ; i++) {
+        if (!tasks[i].used) {
+            tasks[i].used = true;
+            tasks[i].fn   = fn;
+            tasks[i].ctx  = ctx;
+            tasks[i].due  = due;
+            return i;
+        }
+    }
+    fprintf(stderr, "[sim] out of task slots\n");
+    return -1;
+}
+
+void sim_task_due(int slot, sim_time_t due) {
+    if (slot >= 0 && slot < SIM_TASK_MAX && tasks[slot].used) {
+        tasks[slot].due = due;
+    }
+}
+
+void sim_task_remove(int slot) {
+    if (slot >= 0 && slot < SIM_TASK_MAX) {
+        tasks[slot].used = false;
+    }
+}
+
+sim_time_t sim_now(void) {
+    return now_us;
+}
+
+void sim_set_end(sim_time_t t, void (*on_end)(void)) {
+    end_us = t;
+    end_fn = on_end;
+}
+
+static int next_task(sim_time_t limit) {
+    int i, sel = -1;
+    sim_time_t best = SIM_NEVER;
+    for (i = 0 ; i < SIM_TASK_MAX ; i++) {
+        if (tasks[i].used && tasks[i].due <= limit && tasks[i].due < best) {
+            best = tasks[i].due;
+            sel  = i;
+        }
+    }
+    return sel;
+}
+
+static void core1_yield(sim_time_t due);
+static void stall_release(uint core);
+static int  cur_core = 0;
+
+// run the next task due up to 't', false if there is none
+static bool run_next(sim_time_t t) {
+    sim_time_t limit = (t < end_us) ? t : end_us;
+    sim_time_t nd;
+    int slot = next_task(limit);
+    if (slot < 0) {
+        return false;
+    }
+    if (tasks[slot].due > now_us) {
+        now_us = tasks[slot].due;
+    }
+    tasks[slot].due = SIM_NEVER;
+    nd = tasks[slot].fn(tasks[slot].ctx, now_us);
+    if (tasks[slot].used && nd != SIM_NEVER) {
+        tasks[slot].due = (nd > now_us) ? nd : now_us + 1;
+    }
+    return true;
+}
+
+// the clock to 't', or the end of the run
+static void finish_at(sim_time_t t) {
+    if (t >= end_us) {
+        now_us = end_us;
+        if (end_fn) end_fn();
+        exit(0);
+    }
+    if (t > now_us) now_us = t;
+}
+
+void sim_advance_to(sim_time_t t) {
+    if (isr_depth) {
+        // busy-wait in an ISR (either core); nothing else can run meanwhile
+        if (t > now_us) now_us = t;
+        return;
+    }
+    if (cur_core == 1) {
+        core1_yield(t);
+        return;
+    }
+    if (run_depth) {
+        // busy-wait from within a task; nothing else can run meanwhile
+        if (t > now_us) now_us = t;
+        return;
+    }
+    run_depth ++;
+    while (run_next(t)) {
+    }
+    run_depth --;
+    finish_at(t);
+}
+
+void sim_advance(sim_time_t dt) {
+    sim_advance_to(now_us + dt);
+}
+
+// the cores in 'cores' stopped (interrupts off, locked out) for 'dt': the
+// clock moves on and everything else due meanwhile runs on time, their
+// interrupts are taken at the end
+void sim_stall_cores(uint32_t cores, sim_time_t dt) {
+    sim_time_t end = now_us + dt;
+    uint c;
+    bool nested = false;
+    for (c = 0 ; c < 2 ; c++) {
+        if ((cores & SIM_CORE(c)) && stall_until[c]) {
+            // already stalled: the outer stall runs on to the later end
+            if (end > stall_until[c]) stall_until[c] = end;
+            nested = true;
+        }
+    }
+    if (nested || !(cores & (SIM_CORE(0) | SIM_CORE(1)))) {
+        return;
+    }
+    for (c = 0 ; c < 2 ; c++) {
+        if (cores & SIM_CORE(c)) stall_until[c] = end;
+    }
+    run_depth ++;
+    while (1) {
+        for (c = 0 ; c < 2 ; c++) {
+            if ((cores & SIM_CORE(c)) && stall_until[c] > end) end = stall_until[c];
+        }
+        if (!run_next(end)) {
+            break;
+        }
+    }
+    run_depth --;
+    for (c = 0 ; c < 2 ; c++) {
+        if (cores & SIM_CORE(c)) stall_until[c] = 0;
+    }
+    finish_at(end);
+    for (c = 0 ; c < 2 ; c++) {
+        if (cores & SIM_CORE(c)) stall_release(c);
+    }
+}
+
+// enter an ISR of 'core', false := the core is stalled (the caller holds
+// the interrupt pending)
+static bool isr_enter(uint core, int * saved) {
+    if (stall_until[core & 1]) {
+        return false;
+    }
+    *saved = cur_core;
+    cur_core = (int)(core & 1);
+    isr_depth ++;
+    run_depth ++; // handlers run as ISRs, even if raised from thread code
+    return true;
+}
+
+static void isr_exit(int saved) {
+    run_depth --;
+    isr_depth --;
+    cur_core = saved;
+}
+
+sim_time_t sim_next_due(void) {
+    int i;
+    sim_time_t best = SIM_NEVER;
+    for (i = 0 ; i < SIM_TASK_MAX ; i++) {
+        if (tasks[i].used && tasks[i].due < best) {
+            best = tasks[i].due;
+        }
+    }
+    return best;
+}
+
+// ***************************************************************************
+// core1, events
+// ***************************************************************************
+
+#define SIM_CORE1_STACK (256 * 1024)
+
+static ucontext_t  core1_ctx;
+static ucontext_t  core1_ret;
+static void *      core1_stack = NULL;
+static void     (* core1_entry)(void) = NULL;
+static int         core1_slot = -1;
+static sim_time_t  core1_due = SIM_NEVER;
+static bool        core1_wfe = false;
+static bool        core1_held = false;     // came due while stalled
+static bool        core_event[2];
+
+static void core1_trampoline(void) {
+    core1_entry();
+    while (1) {
+        core1_yield(SIM_NEVER); // returned from its entry point, core1 parks
+    }
+}
+
+static sim_time_t core1_task(void * ctx, sim_time_t now) {
+    if (stall_until[1]) {
+        core1_held = true; // resumed at the end of the stall
+        return SIM_NEVER;
+    }
+    cur_core  = 1;
+    core1_due = SIM_NEVER;
+    swapcontext(&core1_ret, &core1_ctx);
+    cur_core  = 0;
+    return core1_due;
+}
+
+static void core1_yield(sim_time_t due) {
+    core1_due = due;
+    swapcontext(&core1_ctx, &core1_ret);
+}
+
+void multicore_launch_core1(void (*entry)(void)) {
+    if (core1_slot >= 0) {
+        return;
+    }
+    core1_stack = malloc(SIM_CORE1_STACK);
+    getcontext(&core1_ctx);
+    core1_ctx.uc_stack.ss_sp   = core1_stack;
+    core1_ctx.uc_stack.ss_size = SIM_CORE1_STACK;
+    core1_ctx.uc_link          = NULL;
+    makecontext(&core1_ctx, core1_trampoline, 0);
+    core1_entry = entry;
+    core1_slot  = sim_task_add(core1_task, NULL, now_us);
+}
+
+void multicore_reset_core1(void) {
+    // only from core0; core1 is dropped wherever it was waiting
+    if (core1_slot >= 0 && cur_core == 0) {
+        sim_task_remove(core1_slot);
+        core1_slot = -1;
+        core1_wfe  = false;
+    }
+}
+
+spin_lock_t * sim_spin_lock(uint lock_num) {
+    static spin_lock_t locks[32];
+    return &locks[lock_num & 31];
+}
+
+uint get_core_num(void) {
+    return (uint)cur_core;
+}
+
+void __sev(void) {
+    core_event[0] = core_event[1] = true;
+    if (core1_wfe && core1_slot >= 0) {
+        sim_task_due(core1_slot, now_us);
+    }
+}
+
+void __wfe(void) {
+    if (cur_core == 1) {
+        if (!core_event[1]) {
+            core1_wfe = true;
+            core1_yield(SIM_NEVER);
+            core1_wfe = false;
+        }
+        core_event[1] = false;
+        return;
+    }
+    if (!core_event[0] && !run_depth) {
+        // woken by the next event or interrupt, whichever comes first
+        sim_advance_to(sim_next_due());
+    }
+    core_event[0] = false;
+}
+
+// ***************************************************************************
+// NVIC
+// ***************************************************************************
+
+static irq_handler_t irq_handlers[NUM_IRQS];
+static bool          irq_enabled[NUM_IRQS];
+static uint8_t       irq_core[NUM_IRQS];        // core it was enabled on
+static bool          irq_held[NUM_IRQS];        // raised while that core was stalled
+
+void irq_set_enabled(uint num, bool enabled) {
+    if (num < NUM_IRQS) {
+        irq_enabled[num] = enabled;
+        if (enabled) irq_core[num] = (uint8_t)cur_core;
+    }
+}
+
+bool irq_is_enabled(uint num) {
+    return (num < NUM_IRQS) ? irq_enabled[num] : false;
+}
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler) {
+    if (num < NUM_IRQS) irq_handlers[num] = handler;
+}
+
+void irq_remove_handler(uint num, irq_handler_t handler) {
+    if (num < NUM_IRQS && irq_handlers[num] == handler) irq_handlers[num] = NULL;
+}
+
+void sim_irq_raise(uint num) {
+    int saved;
+    if (num < NUM_IRQS && irq_enabled[num] && irq_handlers[num]) {
+        if (!isr_enter(irq_core[num], &saved)) {
+            irq_held[num] = true;
+            return;
+        }
+        irq_handlers[num]();
+        isr_exit(saved);
+    }
+}
+
+void tight_loop_contents(void) {
+    sim_advance(1);
+}
+
+// ***************************************************************************
+// pico_time
+// ***************************************************************************
+
+// SysTick, free running from the virtual clock at the processor clock
+systick_hw_t * sim_systick(void) {
+    static systick_hw_t st;
+    st.cvr = 0x00FFFFFFu - (uint32_t)((now_us * (clock_get_hz(clk_sys) / 1000000u)) & 0x00FFFFFFu);
+    return &st;
+}
+
+uint64_t time_us_64(void)                   { return now_us; }
+uint32_t time_us_32(void)                   { return (uint32_t)now_us; }
+absolute_time_t get_absolute_time(void)     { return now_us; }
+uint32_t to_ms_since_boot(absolute_time_t t){ return (uint32_t)(t / 1000ull); }
+uint64_t to_us_since_boot(absolute_time_t t){ return t; }
+int64_t  absolute_time_diff_us(absolute_time_t from, absolute_time_t to) { return (int64_t)(to - from); }
+
+void sleep_us(uint64_t us)      { sim_advance(us); }
+void sleep_ms(uint32_t ms)      { sim_advance(SIM_MS(ms)); }
+void busy_wait_us(uint64_t us)  { sim_advance(us); }
+void busy_wait_ms(uint32_t ms)  { sim_advance(SIM_MS(ms)); }
+
+static sim_time_t rpt_timer_task(void * ctx, sim_time_t now) {
+    repeating_timer_t * rt = (repeating_timer_t *)ctx;
+    if (rt->callback(rt)) {
+        return now + (sim_time_t)((rt->delay_us < 0) ? -rt->delay_us : rt->delay_us);
+    }
+    sim_task_remove(rt->sim_task);
+    rt->sim_task = -1;
+    return SIM_NEVER;
+}
+
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void * user_data, repeating_timer_t * out) {
+    if (!out || !callback || delay_us == 0) {
+        return false;
+    }
+    out->delay_us  = delay_us;
+    out->callback  = callback;
+    out->user_data = user_data;
+    out->sim_task  = sim_task_add(rpt_timer_task, out,
+        now_us + (sim_time_t)((delay_us < 0) ? -delay_us : delay_us));
+    return (out->sim_task >= 0);
+}
+
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void * user_data, repeating_timer_t * out) {
+    return add_repeating_timer_us((int64_t)delay_ms * 1000, callback, user_data, out);
+}
+
+bool cancel_repeating_timer(repeating_timer_t * timer) {
+    if (timer && timer->sim_task >= 0) {
+        sim_task_remove(timer->sim_task);
+        timer->sim_task = -1;
+        return true;
+    }
+    return false;
+}
+
+#define SIM_ALARM_MAX 8
+
+typedef struct sim_alarm_type {
+    alarm_callback_t callback;
+    void *           user_data;
+    int              slot;
+    sim_time_t       target;
+} sim_alarm_t;
+
+static sim_alarm_t alarms[SIM_ALARM_MAX];
+
+static sim_time_t alarm_task(void * ctx, sim_time_t now) {
+    sim_alarm_t * a = (sim_alarm_t *)ctx;
+    alarm_id_t id = (alarm_id_t)(a - alarms) + 1;
+    int64_t r = a->callback(id, a->user_data);
+    if (a->slot >= 0 && r != 0) {
+        a->target = (r > 0) ? now + (sim_time_t)r : a->target + (sim_time_t)(-r);
+        return a->target;
+    }
+    if (a->slot >= 0) {
+        sim_task_remove(a->slot);
+        a->slot = -1;
+    }
+    return SIM_NEVER;
+}
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void * user_data, bool fire_if_past) {
+    int i;
+    for (i = 0 ; i < SIM_ALARM_MAX ; i++) {
+        if (!alarms[i].callback || alarms[i].slot < 0) {
+            alarms[i].callback  = callback;
+            alarms[i].user_data = user_data;
+            alarms[i].target    = now_us + us;
+            alarms[i].slot      = sim_task_add(alarm_task, &alarms[i], alarms[i].target);
+            return (alarms[i].slot >= 0) ? (alarm_id_t)(i + 1) : -1;
+        }
+    }
+    return -1;
+}
+
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void * user_data, bool fire_if_past) {
+    return add_alarm_in_us(SIM_MS(ms), callback, user_data, fire_if_past);
+}
+
+bool cancel_alarm(alarm_id_t alarm_id) {
+    int i = (int)alarm_id - 1;
+    if (i >= 0 && i < SIM_ALARM_MAX && alarms[i].callback && alarms[i].slot >= 0) {
+        sim_task_remove(alarms[i].slot);
+        alarms[i].slot = -1;
+        return true;
+    }
+    return false;
+}
+
+// hardware alarms: one task each, the callback runs at the target
+#define SIM_HW_ALARMS 4
+
+typedef struct sim_hw_alarm_type {
+    bool                      claimed;
+    hardware_alarm_callback_t callback;
+    int                       slot;         /* sim scheduler slot + 1, 0 := none */
+    uint                      core;         /* its TIMER_IRQ is enabled on */
+    bool                      held;         /* fired while that core was stalled */
+} sim_hw_alarm_t;
+
+static sim_hw_alarm_t hw_alarm[SIM_HW_ALARMS];
+
+static sim_time_t hw_alarm_task(void * ctx, sim_time_t now) {
+    sim_hw_alarm_t * a = (sim_hw_alarm_t *)ctx;
+    int saved;
+    if (a->callback) {
+        if (!isr_enter(a->core, &saved)) {
+            a->held = true;
+            return SIM_NEVER;
+        }
+        a->callback((uint)(a - hw_alarm));
+        isr_exit(saved);
+    }
+    return SIM_NEVER; // disarmed, unless the callback set a new target
+}
+
+void hardware_alarm_claim(uint alarm_num) {
+    if (alarm_num < SIM_HW_ALARMS) {
+        hw_alarm[alarm_num].claimed = true;
+    }
+}
+
+int hardware_alarm_claim_unused(bool required) {
+    int i;
+    for (i = 0 ; i < SIM_HW_ALARMS ; i++) {
+        if (!hw_alarm[i].claimed) {
+            hw_alarm[i].claimed = true;
+            return i;
+        }
+    }
+    if (required) {
+        fprintf(stderr, "[sim] no hardware alarm free\n");
+        exit(1);
+    }
+    return -1;
+}
+
+void hardware_alarm_set_callback(uint alarm_num, hardware_alarm_callback_t callback) {
+    sim_hw_alarm_t * a;
+    if (alarm_num >= SIM_HW_ALARMS) {
+        return;
+    }
+    a = &hw_alarm[alarm_num];
+    a->callback = callback;
+    a->core = (uint)cur_core;
+    if (callback && !a->slot) {
+        a->slot = sim_task_add(hw_alarm_task, a, SIM_NEVER) + 1;
+    }
+}
+
+// true := the target is already past, the alarm is left disarmed
+bool hardware_alarm_set_target(uint alarm_num, absolute_time_t t) {
+    if (alarm_num >= SIM_HW_ALARMS || !hw_alarm[alarm_num].slot) {
+        return true;
+    }
+    hw_alarm[alarm_num].held = false;
+    if (t <= now_us) {
+        sim_task_due(hw_alarm[alarm_num].slot - 1, SIM_NEVER);
+        return true;
+    }
+    sim_task_due(hw_alarm[alarm_num].slot - 1, t);
+    return false;
+}
+
+void hardware_alarm_cancel(uint alarm_num) {
+    if (alarm_num < SIM_HW_ALARMS && hw_alarm[alarm_num].slot) {
+        hw_alarm[alarm_num].held = false;
+        sim_task_due(hw_alarm[alarm_num].slot - 1, SIM_NEVER);
+    }
+}
+
+void hardware_alarm_force_irq(uint alarm_num) {
+    if (alarm_num < SIM_HW_ALARMS && hw_alarm[alarm_num].slot) {
+        sim_task_due(hw_alarm[alarm_num].slot - 1, now_us);
+    }
+}
+
+// ***************************************************************************
+// GPIO bank
+// ***************************************************************************
+
+typedef struct sim_gpio_type {
+    uint          func;
+    bool          out_en;
+    bool          out;
+    uint8_t       outover;      /* pad output override */
+    bool          in;
+    uint32_t      irq_mask;
+    uint32_t      irq_pending;
+    irq_handler_t raw_handler;
+    uint8_t       core;         /* its edge IRQs go to */
+    bool          held;         /* edge(s) while that core was stalled */
+} sim_gpio_t;
+
+static sim_gpio_t          gpios[NUM_BANK0_GPIOS];
+static gpio_irq_callback_t gpio_isr[2];     /* per core */
+#define SIM_GPIO_HOOK_MAX 4
+
+static sim_gpio_hook_fn    out_hooks[SIM_GPIO_HOOK_MAX];
+static int                 out_hook_count = 0;
+
+void sim_gpio_add_out_hook(sim_gpio_hook_fn fn) {
+    if (out_hook_count < SIM_GPIO_HOOK_MAX) {
+        out_hooks[out_hook_count++] = fn;
+    }
+}
+
+// output level or direction changed
+static void gpio_out_changed(uint pin) {
+    int i;
+    for (i = 0 ; i < out_hook_count ; i++) {
+        out_hooks[i](pin, gpios[pin].out);
+    }
+    sim_pio_gpio_changed();
+}
+
+// IO_IRQ_BANK0 on the pin's core: its raw handler, else that core's callback
+static void gpio_dispatch(uint pin) {
+    sim_gpio_t * g = &gpios[pin];
+    int saved;
+    if (!isr_enter(g->core, &saved)) {
+        g->held = true;
+        return;
+    }
+    g->held = false;
+    if (g->raw_handler) {
+        g->raw_handler();
+    } else if (gpio_isr[g->core]) {
+        gpio_isr[g->core](pin, g->irq_pending);
+    }
+    g->irq_pending = 0;
+    isr_exit(saved);
+}
+
+void sim_gpio_drive(uint pin, bool level) {
+    if (pin < NUM_BANK0_GPIOS && gpios[pin].in != level) {
+        uint32_t ev = level ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL;
+        gpios[pin].in = level;
+        if (gpios[pin].irq_mask & ev) {
+            gpios[pin].irq_pending |= ev;
+            gpio_dispatch(pin);
+        }
+        sim_pio_gpio_changed();
+    }
+}
+
+// end of a stall: take the interrupts held for 'core'
+static void stall_release(uint core) {
+    uint i;
+    if (core == 1 && core1_held && core1_slot >= 0) {
+        core1_held = false;
+        sim_task_due(core1_slot, now_us);
+    }
+    for (i = 0 ; i < SIM_HW_ALARMS ; i++) {
+        if (hw_alarm[i].held && hw_alarm[i].core == core) {
+            hw_alarm[i].held = false;
+            sim_task_due(hw_alarm[i].slot - 1, now_us);
+        }
+    }
+    for (i = 0 ; i < NUM_IRQS ; i++) {
+        if (irq_held[i] && irq_core[i] == core) {
+            irq_held[i] = false;
+            sim_irq_raise(i);
+        }
+    }
+    for (i = 0 ; i < NUM_BANK0_GPIOS ; i++) {
+        if (gpios[i].held && gpios[i].core == core && gpios[i].irq_pending) {
+            gpio_dispatch(i);
+        }
+    }
+}
+
+void gpio_init(uint gpio) {
+    if (gpio < NUM_BANK0_GPIOS) {
+        bool was_out = gpios[gpio].out_en;
+        gpios[gpio].func   = GPIO_FUNC_SIO;
+        gpios[gpio].out_en = false;
+        gpios[gpio].out    = false;
+        if (was_out) gpio_out_changed(gpio);
+    }
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn) {
+    if (gpio < NUM_BANK0_GPIOS) gpios[gpio].func = fn;
+}
+
+enum gpio_function gpio_get_function(uint gpio) {
+    return (gpio < NUM_BANK0_GPIOS) ? (enum gpio_function)gpios[gpio].func : GPIO_FUNC_NULL;
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+    if (gpio < NUM_BANK0_GPIOS && gpios[gpio].out_en != out) {
+        gpios[gpio].out_en = out;
+        gpio_out_changed(gpio);
+    }
+}
+
+void gpio_put(uint gpio, bool value) {
+    if (gpio < NUM_BANK0_GPIOS && gpios[gpio].out != value) {
+        gpios[gpio].out = value;
+        if (gpios[gpio].out_en) gpio_out_changed(gpio);
+    }
+}
+
+bool gpio_get(uint gpio) {
+    if (gpio < NUM_BANK0_GPIOS) {
+        return gpios[gpio].out_en ? gpios[gpio].out : gpios[gpio].in;
+    }
+    return false;
+}
+
+bool sim_gpio_is_output(uint pin) {
+    return (pin < NUM_BANK0_GPIOS) ? gpios[pin].out_en : false;
+}
+
+bool gpio_get_out_level(uint gpio) {
+    return (gpio < NUM_BANK0_GPIOS) ? gpios[gpio].out : false;
+}
+
+void gpio_set_outover(uint gpio, uint value) {
+    if (gpio < NUM_BANK0_GPIOS) gpios[gpio].outover = (uint8_t)value;
+}
+
+// the level on the pad: the SIO output through the override
+bool sim_gpio_pad_level(uint pin) {
+    if (pin >= NUM_BANK0_GPIOS) return false;
+    switch (gpios[pin].outover) {
+    case GPIO_OVERRIDE_INVERT:  return !gpios[pin].out;
+    case GPIO_OVERRIDE_LOW:     return false;
+    case GPIO_OVERRIDE_HIGH:    return true;
+    default:                    return gpios[pin].out;
+    }
+}
+
+void gpio_pull_up(uint gpio)        { if (gpio < NUM_BANK0_GPIOS) gpios[gpio].in = true; }
+void gpio_pull_down(uint gpio)      { if (gpio < NUM_BANK0_GPIOS) gpios[gpio].in = false; }
+void gpio_disable_pulls(uint gpio)  { (void)gpio; }
+
+// enabled on the calling core (its PROCx_INTE)
+void gpio_set_irq_enabled(uint gpio, uint32_t event_mask, bool enabled) {
+    if (gpio < NUM_BANK0_GPIOS) {
+        if (enabled) {
+            gpios[gpio].irq_mask |= event_mask;
+            gpios[gpio].core = (uint8_t)cur_core;
+        } else {
+            gpios[gpio].irq_mask &= ~event_mask;
+        }
+    }
+}
+
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t event_mask, bool enabled, gpio_irq_callback_t callback) {
+    gpio_set_irq_enabled(gpio, event_mask, enabled);
+    if (enabled) {
+        gpio_isr[cur_core] = callback;
+    }
+}
+
+void gpio_add_raw_irq_handler(uint gpio, irq_handler_t handler) {
+    if (gpio < NUM_BANK0_GPIOS) gpios[gpio].raw_handler = handler;
+}
+
+void gpio_remove_raw_irq_handler(uint gpio, irq_handler_t handler) {
+    if (gpio < NUM_BANK0_GPIOS && gpios[gpio].raw_handler == handler) gpios[gpio].raw_handler = NULL;
+}
+
+uint32_t gpio_get_irq_event_mask(uint gpio) {
+    return (gpio < NUM_BANK0_GPIOS) ? gpios[gpio].irq_pending : 0;
+}
+
+void gpio_acknowledge_irq(uint gpio, uint32_t event_mask) {
+    if (gpio < NUM_BANK0_GPIOS) gpios[gpio].irq_pending &= ~event_mask;
+}
+
+// ***************************************************************************
+// pico_rand / stdio
+// ***************************************************************************
+
+static uint64_t rand_state = 0x4A4243323030ull; /* "JBC200" */
+
+void sim_rand_seed(uint64_t seed) {
+    rand_state = seed ? seed : 1;
+}
+
+uint64_t get_rand_64(void) {
+    // xorshift64*
+    rand_state ^= rand_state >> 12;
+    rand_state ^= rand_state << 25;
+    rand_state ^= rand_state >> 27;
+    return rand_state * 0x2545F4914F6CDD1Dull;
+}
+
+uint32_t get_rand_32(void) {
+    return (uint32_t)(get_rand_64() >> 32);
+}
+
+bool stdio_init_all(void) {
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    return true;
+}
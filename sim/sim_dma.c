@@ -0,0 +1,221 @@
+/******************************************************************************
+ * Host Simulation - DMA
+ *
+ * A channel is busy from its trigger until its transfer count runs out or it
+ * is aborted. Peripheral models move data through it one item per DREQ:
+ *
+ *  sim_dma_dreq_write() - peripheral -> memory (eg. the ADC FIFO)
+ *  sim_dma_dreq_read()  - memory -> peripheral (eg. SPI TX), the peripheral
+ *                         is kicked when a channel on its DREQ is started
+ *
+ * Transfers are instant; the peripheral model owns the pacing.
+ *
+ */
+
+#include <sim.h>
+#include <hardware/dma.h>
+#include <hardware/irq.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct sim_dma_type {
+    bool               claimed;
+    bool               busy;
+    dma_channel_config cfg;
+    uintptr_t          rd;
+    uintptr_t          wr;
+    uintptr_t          wr_base;     // ring base
+    uint32_t           count;       // reload value
+    dma_channel_hw_t   hw;          // live transfer count
+    bool               irq_en[2];
+    bool               irq_st[2];
+} sim_dma_t;
+
+#define SIM_DREQ_MAX    64
+
+static sim_dma_t dma[NUM_DMA_CHANNELS];
+static void   (* kick_fn[SIM_DREQ_MAX])(void);
+
+int dma_claim_unused_channel(bool required) {
+    int i;
+    for (i = 0 ; i < NUM_DMA_CHANNELS ; i++) {
+        if (!dma[i].claimed) {
+            memset(&dma[i], 0, sizeof(dma[i]));
+            dma[i].claimed = true;
+            return i;
+        }
+    }
+    if (required) {
+        fprintf(stderr, "[sim] no free DMA channel\n");
+        exit(1);
+    }
+    return -1;
+}
+
+void dma_channel_unclaim(uint channel) {
+    if (channel < NUM_DMA_CHANNELS) {
+        dma[channel].claimed = false;
+        dma[channel].busy = false;
+    }
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel) {
+    dma_channel_config c = {
+        .size = DMA_SIZE_32, .read_incr = true, .write_incr = false,
+        .dreq = DREQ_FORCE, .ring_write = false, .ring_bits = 0, .enable = true
+    };
+    return c;
+}
+
+static void dma_trigger(sim_dma_t * d) {
+    d->hw.transfer_count = d->count;
+    d->wr_base = d->wr;
+    d->busy = d->cfg.enable && d->count > 0;
+    if (d->busy && d->cfg.dreq < SIM_DREQ_MAX && kick_fn[d->cfg.dreq]) {
+        kick_fn[d->cfg.dreq]();
+    }
+}
+
+// last item moved
+static void dma_complete(sim_dma_t * d) {
+    int i;
+    d->busy = false;
+    for (i = 0 ; i < 2 ; i++) {
+        if (d->irq_en[i]) {
+            d->irq_st[i] = true;
+            sim_irq_raise(i ? DMA_IRQ_1 : DMA_IRQ_0);
+        }
+    }
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config * config, volatile void * write_addr,
+                           const volatile void * read_addr, uint transfer_count, bool trigger) {
+    sim_dma_t * d = &dma[channel];
+    d->cfg   = *config;
+    d->wr    = (uintptr_t)write_addr;
+    d->rd    = (uintptr_t)read_addr;
+    d->count = transfer_count;
+    if (trigger) dma_trigger(d);
+}
+
+void dma_channel_set_read_addr(uint channel, const volatile void * read_addr, bool trigger) {
+    dma[channel].rd = (uintptr_t)read_addr;
+    if (trigger) dma_trigger(&dma[channel]);
+}
+
+void dma_channel_set_write_addr(uint channel, volatile void * write_addr, bool trigger) {
+    dma[channel].wr = (uintptr_t)write_addr;
+    if (trigger) dma_trigger(&dma[channel]);
+}
+
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger) {
+    dma[channel].count = trans_count;
+    if (trigger) dma_trigger(&dma[channel]);
+}
+
+void dma_channel_start(uint channel) {
+    dma_trigger(&dma[channel]);
+}
+
+void dma_channel_abort(uint channel) {
+    dma[channel].busy = false;
+}
+
+bool dma_channel_is_busy(uint channel) {
+    return dma[channel].busy;
+}
+
+void dma_channel_wait_for_finish_blocking(uint channel) {
+    while (dma[channel].busy) {
+        sim_advance(1);
+    }
+}
+
+dma_channel_hw_t * dma_channel_hw_addr(uint channel) {
+    return &dma[channel].hw;
+}
+
+static void dma_store(uintptr_t addr, uint size, uint32_t v) {
+    switch (size) {
+    case DMA_SIZE_8:  *(volatile uint8_t *)addr  = (uint8_t)v;  break;
+    case DMA_SIZE_16: *(volatile uint16_t *)addr = (uint16_t)v; break;
+    default:          *(volatile uint32_t *)addr = v;           break;
+    }
+}
+
+bool sim_dma_dreq_write(uint dreq, uint32_t value) {
+    int i;
+    for (i = 0 ; i < NUM_DMA_CHANNELS ; i++) {
+        sim_dma_t * d = &dma[i];
+        if (d->busy && d->cfg.dreq == dreq) {
+            dma_store(d->wr, d->cfg.size, value);
+            if (d->cfg.write_incr) {
+                d->wr += 1u << d->cfg.size;
+                if (d->cfg.ring_write && d->cfg.ring_bits) {
+                    uintptr_t mask = ((uintptr_t)1 << d->cfg.ring_bits) - 1;
+                    d->wr = (d->wr_base & ~mask) | (d->wr & mask);
+                }
+            }
+            if (--d->hw.transfer_count == 0) {
+                dma_complete(d);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint32_t dma_load(uintptr_t addr, uint size) {
+    switch (size) {
+    case DMA_SIZE_8:  return *(volatile uint8_t *)addr;
+    case DMA_SIZE_16: return *(volatile uint16_t *)addr;
+    default:          return *(volatile uint32_t *)addr;
+    }
+}
+
+bool sim_dma_dreq_read_begin(uint dreq, uint32_t * value) {
+    int i;
+    for (i = 0 ; i < NUM_DMA_CHANNELS ; i++) {
+        sim_dma_t * d = &dma[i];
+        if (d->busy && d->cfg.dreq == dreq && d->hw.transfer_count) {
+            *value = dma_load(d->rd, d->cfg.size);
+            if (d->cfg.read_incr) {
+                d->rd += 1u << d->cfg.size;
+            }
+            d->hw.transfer_count --;
+            return true;
+        }
+    }
+    return false;
+}
+
+void sim_dma_dreq_read_end(uint dreq) {
+    int i;
+    for (i = 0 ; i < NUM_DMA_CHANNELS ; i++) {
+        sim_dma_t * d = &dma[i];
+        if (d->busy && d->cfg.dreq == dreq && d->hw.transfer_count == 0) {
+            dma_complete(d);
+        }
+    }
+}
+
+bool sim_dma_dreq_read(uint dreq, uint32_t * value) {
+    bool rc = sim_dma_dreq_read_begin(dreq, value);
+    if (rc) {
+        sim_dma_dreq_read_end(dreq);
+    }
+    return rc;
+}
+
+void sim_dma_set_kick(uint dreq, void (*kick)(void)) {
+    if (dreq < SIM_DREQ_MAX) {
+        kick_fn[dreq] = kick;
+    }
+}
+
+void dma_channel_set_irq0_enabled(uint channel, bool enabled) { dma[channel].irq_en[0] = enabled; }
+void dma_channel_set_irq1_enabled(uint channel, bool enabled) { dma[channel].irq_en[1] = enabled; }
+bool dma_channel_get_irq0_status(uint channel)                { return dma[channel].irq_st[0]; }
+bool dma_channel_get_irq1_status(uint channel)                { return dma[channel].irq_st[1]; }
+void dma_channel_acknowledge_irq0(uint channel)               { dma[channel].irq_st[0] = false; }
+void dma_channel_acknowledge_irq1(uint channel)               { dma[channel].irq_st[1] = false; }
@@ -0,0 +1,124 @@
+/******************************************************************************
+ * Host Simulation - flash
+ *
+ * The QSPI flash as a RAM array (erased), mapped at XIP_BASE. Erase and
+ * program follow NOR rules and stall the calling core, and any core locked
+ * out by flash_safe_execute (one that called flash_safe_execute_core_init),
+ * for the typical W25Q16 times, as the target does while XIP is off:
+ *
+ *  sector erase    45 msec
+ *  page program    0.4 msec
+ *
+ * The end of the device (the settings store) can be loaded from and saved
+ * to a file, so settings survive from one run to the next.
+ *
+ */
+
+#include <sim.h>
+#include <hardware/flash.h>
+#include <pico/flash.h>
+#include <hardware/sync.h>
+#include <string.h>
+
+#define SIM_FLASH_ERASE_US      45000
+#define SIM_FLASH_PROGRAM_US    400
+
+uint8_t sim_flash_mem[PICO_FLASH_SIZE_BYTES];
+
+static const char * keep_path = NULL;
+static uint32_t   keep_bytes = 0;
+static uint32_t   erases = 0;
+static uint32_t   programs = 0;
+static sim_time_t max_stall = 0;
+static uint32_t   victims = 0;      // cores that can be locked out
+static uint32_t   lockout = 0;      // locked out by flash_safe_execute now
+
+static void flash_stall(sim_time_t dt) {
+    if (dt > max_stall) {
+        max_stall = dt;
+    }
+    sim_stall_cores(SIM_CORE(get_core_num()) | lockout, dt);
+}
+
+void flash_range_erase(uint32_t flash_offs, size_t count) {
+    if ((flash_offs % FLASH_SECTOR_SIZE) || (count % FLASH_SECTOR_SIZE) ||
+        flash_offs + count > PICO_FLASH_SIZE_BYTES) {
+        fprintf(stderr, "[sim] flash_range_erase: bad range 0x%x + 0x%zx\n", flash_offs, count);
+        return;
+    }
+    memset(&sim_flash_mem[flash_offs], 0xFF, count);
+    erases += (uint32_t)(count / FLASH_SECTOR_SIZE);
+    flash_stall((sim_time_t)SIM_FLASH_ERASE_US * (count / FLASH_SECTOR_SIZE));
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t * data, size_t count) {
+    size_t i;
+    if ((flash_offs % FLASH_PAGE_SIZE) || (count % FLASH_PAGE_SIZE) ||
+        flash_offs + count > PICO_FLASH_SIZE_BYTES) {
+        fprintf(stderr, "[sim] flash_range_program: bad range 0x%x + 0x%zx\n", flash_offs, count);
+        return;
+    }
+    for (i = 0 ; i < count ; i++) {
+        sim_flash_mem[flash_offs + i] &= data[i]; // NOR: program only clears bits
+    }
+    programs += (uint32_t)(count / FLASH_PAGE_SIZE);
+    flash_stall((sim_time_t)SIM_FLASH_PROGRAM_US * (count / FLASH_PAGE_SIZE));
+}
+
+int flash_safe_execute(void (*func)(void *), void * param, uint32_t enter_exit_timeout_ms) {
+    (void)enter_exit_timeout_ms;
+    lockout = victims & ~SIM_CORE(get_core_num());
+    func(param);
+    lockout = 0;
+    return PICO_OK;
+}
+
+bool flash_safe_execute_core_init(void) {
+    victims |= SIM_CORE(get_core_num());
+    return true;
+}
+
+// start with an erased device, then if 'path' is given the last 'bytes' of
+// it are loaded from (a missing file is left erased) and kept in 'path'
+int sim_flash_init(const char * path, uint32_t bytes) {
+    FILE * f;
+    memset(sim_flash_mem, 0xFF, sizeof(sim_flash_mem));
+    if (!path || bytes > PICO_FLASH_SIZE_BYTES) {
+        return path ? 1 : 0;
+    }
+    keep_path = path;
+    keep_bytes = bytes;
+    f = fopen(path, "rb");
+    if (f) {
+        size_t n = fread(&sim_flash_mem[PICO_FLASH_SIZE_BYTES - bytes], 1, bytes, f);
+        fclose(f);
+        (void)n;
+    }
+    return 0;
+}
+
+int sim_flash_save(void) {
+    FILE * f;
+    if (!keep_path) {
+        return 0;
+    }
+    f = fopen(keep_path, "wb");
+    if (!f) {
+        return 1;
+    }
+    fwrite(&sim_flash_mem[PICO_FLASH_SIZE_BYTES - keep_bytes], 1, keep_bytes, f);
+    fclose(f);
+    return 0;
+}
+
+uint32_t sim_flash_erases(void) {
+    return erases;
+}
+
+uint32_t sim_flash_programs(void) {
+    return programs;
+}
+
+sim_time_t sim_flash_max_stall(void) {
+    return max_stall;
+}
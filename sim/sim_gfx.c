@@ -0,0 +1,458 @@
+/******************************************************************************
+ * Host Simulation - display
+ *
+ * Stand-in for the picoDrivers graphics stack: four 1 bpp layers in SSD1309
+ * page format (text, line art, 7-segment LED overlay), a compositor, and a
+ * simulated SSD1309 panel.
+ *
+ * As on the target, textgfx_refresh() and ledo_refresh() both composite and
+ * push the whole frame: the address window, then the 1 KB frame in one
+ * blocking spi_write_blocking() (sim_spi.c), which the firmware link wraps
+ * (disp_panel.c) as it does on the target.
+ *
+ * The panel decodes what arrives over spi0 like an SSD1309 (addressing
+ * commands, GDDRAM writes), so application side transfer code is checked
+ * against what actually ends up on the screen.
+ *
+ */
+
+#include <sim.h>
+#include <sim_font.h>
+#include <board.h>
+#include <gfxDriverLowPriv.h>
+#include <linegfx.h>
+#include <textgfx.h>
+#include <led_overlay.h>
+#include <hardware/spi.h>
+#include <hardware/gpio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define GFX_LAYERS      4
+#define SSD1309_CMD_LEN 6   /* column + page address window per frame */
+
+typedef uint8_t page_buf_t[GFX_DISP_PAGES][GFX_DISP_WIDTH];
+
+static page_buf_t layer[GFX_LAYERS];
+static bool       layer_visible[GFX_LAYERS];
+static page_buf_t gddram;       // what the panel shows
+static bool       panel_on = false;
+static uint32_t   frame_count = 0;
+
+static void pix(int l, int x, int y, int colour) {
+    if (l >= 0 && l < GFX_LAYERS && x >= 0 && x < GFX_DISP_WIDTH && y >= 0 && y < GFX_DISP_HEIGHT) {
+        if (colour == COLOUR_BLK)
+            layer[l][y >> 3][x] |=  (uint8_t)(1u << (y & 7));
+        else
+            layer[l][y >> 3][x] &= (uint8_t)~(1u << (y & 7));
+    }
+}
+
+static void fill(int l, int x1, int y1, int x2, int y2, int colour) {
+    int x, y;
+    for (y = y1 ; y <= y2 ; y++)
+        for (x = x1 ; x <= x2 ; x++)
+            pix(l, x, y, colour);
+}
+
+// ***************************************************************************
+// compositor and panel
+// ***************************************************************************
+
+// ---- SSD1309 panel --------------------------------------------------------
+
+#define SSD_MODE_HORZ   0
+#define SSD_MODE_VERT   1
+#define SSD_MODE_PAGE   2
+
+static struct {
+    uint8_t mode;
+    uint8_t col, col_start, col_end;
+    uint8_t page, page_start, page_end;
+    uint8_t cmd[3];         // command being assembled
+    uint8_t cmd_len, cmd_need;
+} ssd = { SSD_MODE_PAGE, 0, 0, GFX_DISP_WIDTH - 1, 0, 0, GFX_DISP_PAGES - 1 };
+
+// settings area of the operating screen (preset, set temp, heat/cool: text
+// lines 1..4, boost / tuning: line 7, right of the divider), for the
+// key-to-screen metric
+#define UI_PAGE_MASK    ((1u << 1) | (1u << 2) | (1u << 3) | (1u << 4) | (1u << 7))
+#define UI_X_FIRST      64
+
+static uint8_t ui_seen[GFX_DISP_PAGES][GFX_DISP_WIDTH - UI_X_FIRST];
+
+// the panel content changed, report when a key's effect became visible
+static void panel_updated(void) {
+    int p;
+    bool changed = false;
+    for (p = 0 ; p < GFX_DISP_PAGES ; p++) {
+        if ((UI_PAGE_MASK & (1u << p)) && memcmp(ui_seen[p], &gddram[p][UI_X_FIRST], sizeof(ui_seen[0]))) {
+            memcpy(ui_seen[p], &gddram[p][UI_X_FIRST], sizeof(ui_seen[0]));
+            changed = true;
+        }
+    }
+    sim_metric_frame(changed);
+}
+
+static uint8_t ssd_cmd_len(uint8_t c) {
+    switch (c) {
+    case 0x21: case 0x22:
+        return 3;
+    case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3: case 0xD5:
+    case 0xD9: case 0xDA: case 0xDB: case 0xFD:
+        return 2;
+    default:
+        return 1;
+    }
+}
+
+static void ssd_command(const uint8_t * c) {
+    switch (c[0]) {
+    case 0x20: ssd.mode = c[1] & 3; break;
+    case 0x21: ssd.col  = ssd.col_start  = c[1] & 0x7F; ssd.col_end  = c[2] & 0x7F; break;
+    case 0x22: ssd.page = ssd.page_start = c[1] & 7;    ssd.page_end = c[2] & 7;    break;
+    case 0xAE: panel_on = false; break;
+    case 0xAF: panel_on = true;  break;
+    default:
+        if (c[0] >= 0xB0 && c[0] <= 0xB7) ssd.page = c[0] & 7;
+        else if (c[0] <= 0x0F)            ssd.col  = (ssd.col & 0xF0) | c[0];
+        else if (c[0] <= 0x1F)            ssd.col  = (ssd.col & 0x0F) | (uint8_t)((c[0] & 0x0F) << 4);
+        break;
+    }
+}
+
+static void ssd_data(uint8_t d) {
+    gddram[ssd.page & 7][ssd.col & 0x7F] = d;
+    if (ssd.mode == SSD_MODE_PAGE) {
+        ssd.col = (ssd.col + 1) & 0x7F;
+    } else if (ssd.mode == SSD_MODE_HORZ) {
+        if (ssd.col++ >= ssd.col_end) {
+            ssd.col = ssd.col_start;
+            ssd.page = (ssd.page >= ssd.page_end) ? ssd.page_start : ssd.page + 1;
+        }
+    } else {
+        if (ssd.page++ >= ssd.page_end) {
+            ssd.page = ssd.page_start;
+            ssd.col = (ssd.col >= ssd.col_end) ? ssd.col_start : ssd.col + 1;
+        }
+    }
+}
+
+// bytes clocked into the panel (sim_spi.c), DC sampled on the pad per write
+void sim_panel_rx(const uint8_t * buf, size_t len) {
+    bool data = sim_gpio_pad_level(DISP_DRVR_SPI_GPIO_DC);
+    size_t i;
+    for (i = 0 ; i < len ; i++) {
+        if (data) {
+            ssd_data(buf[i]);
+            continue;
+        }
+        if (ssd.cmd_len == 0) {
+            ssd.cmd_need = ssd_cmd_len(buf[i]);
+        }
+        ssd.cmd[ssd.cmd_len++] = buf[i];
+        if (ssd.cmd_len == ssd.cmd_need) {
+            ssd_command(ssd.cmd);
+            ssd.cmd_len = 0;
+        }
+    }
+    if (data) {
+        panel_updated();
+    }
+}
+
+// ---- compositor ------------------------------------------------------------
+
+// picoDrivers full frame write: address window + 1 KB over spi0, blocking
+static void push_full_frame(page_buf_t frame) {
+    const uint8_t win[SSD1309_CMD_LEN] = { 0x21, 0, GFX_DISP_WIDTH - 1, 0x22, 0, GFX_DISP_PAGES - 1 };
+    gpio_put(DISP_DRVR_SPI_CS, 0);
+    gpio_put(DISP_DRVR_SPI_GPIO_DC, 0);
+    spi_write_blocking(DISP_DRVR_SPI_CHAN, win, sizeof(win));
+    gpio_put(DISP_DRVR_SPI_GPIO_DC, 1);
+    spi_write_blocking(DISP_DRVR_SPI_CHAN, &frame[0][0], sizeof(page_buf_t));
+    gpio_put(DISP_DRVR_SPI_CS, 1);
+}
+
+static int composite_and_push(void) {
+    page_buf_t frame;
+    int l, p, x;
+    memset(frame, 0, sizeof(frame));
+    for (l = 0 ; l < GFX_LAYERS ; l++) {
+        if (layer_visible[l]) {
+            for (p = 0 ; p < GFX_DISP_PAGES ; p++)
+                for (x = 0 ; x < GFX_DISP_WIDTH ; x++)
+                    frame[p][x] |= layer[l][p][x];
+        }
+    }
+    frame_count ++;
+    push_full_frame(frame);
+    return 0;
+}
+
+int bsp_ConfigureGfxDriver(void)    { return 0; }
+int gfx_displayOn(void)             { panel_on = true; return 0; }
+int gfx_displayOff(void)            { panel_on = false; return 0; }
+int gfx_displayRefresh(void)        { return composite_and_push(); }
+
+int bsp_StartGfxDriver(void) {
+    const uint8_t mode[] = { 0x20, SSD_MODE_HORZ };
+    spi_init(DISP_DRVR_SPI_CHAN, DISP_DRVR_SPI_CLK_FREQ_HZ);
+    gpio_init(DISP_DRVR_SPI_GPIO_DC);
+    gpio_set_dir(DISP_DRVR_SPI_GPIO_DC, GPIO_OUT);
+    gpio_init(DISP_DRVR_SPI_CS);
+    gpio_put(DISP_DRVR_SPI_CS, 1);
+    gpio_set_dir(DISP_DRVR_SPI_CS, GPIO_OUT);
+    // panel init: horizontal addressing for the full frame writes
+    gpio_put(DISP_DRVR_SPI_CS, 0);
+    gpio_put(DISP_DRVR_SPI_GPIO_DC, 0);
+    spi_write_blocking(DISP_DRVR_SPI_CHAN, mode, sizeof(mode));
+    gpio_put(DISP_DRVR_SPI_CS, 1);
+    return 0;
+}
+
+int gfx_clearDisplay(void) {
+    page_buf_t blank;
+    memset(blank, 0, sizeof(blank));
+    push_full_frame(blank);
+    return 0;
+}
+
+// ***************************************************************************
+// line graphics layer
+// ***************************************************************************
+
+static int lgfx_layer = -1;
+
+int lgfx_init(int l)            { lgfx_layer = l; layer_visible[l] = false; return 0; }
+int lgfx_visibility(int v)      { if (lgfx_layer >= 0) layer_visible[lgfx_layer] = (v != 0); return 0; }
+int lgfx_clear(void)            { if (lgfx_layer >= 0) memset(layer[lgfx_layer], 0, sizeof(page_buf_t)); return 0; }
+
+int lgfx_line(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, int colour) {
+    int dx =  abs((int)x2 - (int)x1), sx = (x1 < x2) ? 1 : -1;
+    int dy = -abs((int)y2 - (int)y1), sy = (y1 < y2) ? 1 : -1;
+    int err = dx + dy, x = x1, y = y1;
+    while (1) {
+        pix(lgfx_layer, x, y, colour);
+        if (x == x2 && y == y2) break;
+        if (2 * err >= dy) { err += dy; x += sx; }
+        if (2 * err <= dx) { err += dx; y += sy; }
+    }
+    return 0;
+}
+
+int lgfx_box(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, int colour) {
+    lgfx_line(x1, y1, x2, y1, colour);
+    lgfx_line(x2, y1, x2, y2, colour);
+    lgfx_line(x2, y2, x1, y2, colour);
+    lgfx_line(x1, y2, x1, y1, colour);
+    return 0;
+}
+
+int lgfx_bgraph(uint8_t x, uint8_t y, uint8_t h, uint8_t w, uint8_t len, int colour) {
+    if (len > w) {
+        return 1;
+    }
+    if (len)
+        fill(lgfx_layer, x, y, x + len - 1, y + h - 1, colour);
+    if (len < w)
+        fill(lgfx_layer, x + len, y, x + w - 1, y + h - 1, !colour);
+    return 0;
+}
+
+// ***************************************************************************
+// text layer
+// ***************************************************************************
+
+static int     txt_layer = -1;
+static char    txt[TEXTGFX_LINES][TEXTGFX_COLS];
+static uint8_t cur_x = 0, cur_ln = 0;
+static bool    txt_wrap = true;
+
+int text_init(int l) {
+    txt_layer = l;
+    layer_visible[l] = true;
+    return textgfx_clear();
+}
+
+int textgfx_init(int refresh_mode, int wrap_mode) {
+    txt_wrap = (wrap_mode == SET_TEXTWRAP_ON);
+    return 0;
+}
+
+int textgfx_clear(void) {
+    memset(txt, ' ', sizeof(txt));
+    cur_x = cur_ln = 0;
+    return 0;
+}
+
+int textgfx_cursor(uint8_t x, uint8_t line) {
+    if (x >= TEXTGFX_COLS || line >= TEXTGFX_LINES) {
+        return 1;
+    }
+    cur_x  = x;
+    cur_ln = line;
+    return 0;
+}
+
+int textgfx_putc(char c) {
+    if (c == '\n') {
+        cur_x = 0;
+        cur_ln ++;
+    } else {
+        if (cur_x >= TEXTGFX_COLS) {
+            if (!txt_wrap) return 1;
+            cur_x = 0;
+            cur_ln ++;
+        }
+        if (cur_ln < TEXTGFX_LINES) {
+            txt[cur_ln][cur_x++] = c;
+        }
+    }
+    return 0;
+}
+
+int textgfx_puts(const char * s) {
+    while (s && *s) {
+        textgfx_putc(*s++);
+    }
+    return 0;
+}
+
+int textgfx_refresh(void) {
+    int ln, col, i;
+    if (txt_layer < 0) {
+        return 1;
+    }
+    memset(layer[txt_layer], 0, sizeof(page_buf_t));
+    for (ln = 0 ; ln < TEXTGFX_LINES ; ln++) {
+        for (col = 0 ; col < TEXTGFX_COLS ; col++) {
+            unsigned char c = (unsigned char)txt[ln][col];
+            if (c < SIM_FONT_FIRST || c > SIM_FONT_LAST) c = '?';
+            for (i = 0 ; i < SIM_FONT_W ; i++) {
+                layer[txt_layer][ln][col * 6 + i] = sim_font5x7[c - SIM_FONT_FIRST][i];
+            }
+        }
+    }
+    return composite_and_push();
+}
+
+// ***************************************************************************
+// 7-segment LED overlay
+// ***************************************************************************
+
+#define LED_DIG_W       14
+#define LED_DIG_H       31
+#define LED_SEG_T       3
+#define LED_DIG_PITCH   19
+
+typedef struct sim_led_type {
+    uint8_t  x, y, digits;
+    uint32_t value;
+} sim_led_t;
+
+static int       led_layer = -1;
+static sim_led_t leds[2];
+static int       led_count = 0;
+
+//                                 0     1     2     3     4     5     6     7     8     9
+static const uint8_t seg_map[] = { 0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07, 0x7F, 0x6F };
+
+static void draw_digit(int x, int y, int d) {
+    uint8_t s = seg_map[d];
+    int mid = y + LED_DIG_H / 2 - 1;
+    if (s & 0x01) fill(led_layer, x, y, x + LED_DIG_W - 1, y + LED_SEG_T - 1, COLOUR_BLK);                                   // a
+    if (s & 0x02) fill(led_layer, x + LED_DIG_W - LED_SEG_T, y, x + LED_DIG_W - 1, mid + 1, COLOUR_BLK);                     // b
+    if (s & 0x04) fill(led_layer, x + LED_DIG_W - LED_SEG_T, mid, x + LED_DIG_W - 1, y + LED_DIG_H - 1, COLOUR_BLK);         // c
+    if (s & 0x08) fill(led_layer, x, y + LED_DIG_H - LED_SEG_T, x + LED_DIG_W - 1, y + LED_DIG_H - 1, COLOUR_BLK);           // d
+    if (s & 0x10) fill(led_layer, x, mid, x + LED_SEG_T - 1, y + LED_DIG_H - 1, COLOUR_BLK);                                 // e
+    if (s & 0x20) fill(led_layer, x, y, x + LED_SEG_T - 1, mid + 1, COLOUR_BLK);                                             // f
+    if (s & 0x40) fill(led_layer, x, mid, x + LED_DIG_W - 1, mid + LED_SEG_T - 1, COLOUR_BLK);                               // g
+}
+
+int led0_init(int l)        { led_layer = l; return 0; }
+int ledo_visible(int v)     { if (led_layer >= 0) layer_visible[led_layer] = (v != 0); return 0; }
+
+void * ledo_open(uint8_t x, uint8_t y, uint8_t digits, uint32_t value, int update_on_chg) {
+    if (led_count < (int)(sizeof(leds) / sizeof(leds[0]))) {
+        sim_led_t * h = &leds[led_count++];
+        h->x = x;
+        h->y = y;
+        h->digits = digits;
+        h->value  = value;
+        return h;
+    }
+    return NULL;
+}
+
+int ledo_update(void * hndl, uint32_t value) {
+    if (!hndl) {
+        return 1;
+    }
+    ((sim_led_t *)hndl)->value = value;
+    return 0;
+}
+
+int ledo_refresh(void * hndl) {
+    sim_led_t * h = (sim_led_t *)hndl;
+    int i;
+    uint32_t v;
+    if (!h || led_layer < 0) {
+        return 1;
+    }
+    fill(led_layer, h->x, h->y, h->x + h->digits * LED_DIG_PITCH - 1, h->y + LED_DIG_H - 1, COLOUR_WHT);
+    v = h->value;
+    for (i = h->digits - 1 ; i >= 0 ; i--) {
+        draw_digit(h->x + i * LED_DIG_PITCH, h->y, (int)(v % 10));
+        v /= 10;
+        if (v == 0) break; // leading blanks
+    }
+    return composite_and_push();
+}
+
+// ***************************************************************************
+// simulation side
+// ***************************************************************************
+
+uint32_t sim_gfx_frames(void)       { return frame_count; }
+
+static bool gddram_pix(int x, int y) {
+    return panel_on && (gddram[y >> 3][x] & (1u << (y & 7)));
+}
+
+void sim_gfx_dump_ascii(FILE * f) {
+    int x, y;
+    fprintf(f, "+");
+    for (x = 0 ; x < GFX_DISP_WIDTH ; x++) fputc('-', f);
+    fprintf(f, "+\n");
+    // two pixel rows per text line
+    for (y = 0 ; y < GFX_DISP_HEIGHT ; y += 2) {
+        fputc('|', f);
+        for (x = 0 ; x < GFX_DISP_WIDTH ; x++) {
+            bool t = gddram_pix(x, y), b = gddram_pix(x, y + 1);
+            fputc(t ? (b ? '8' : '"') : (b ? ',' : ' '), f);
+        }
+        fprintf(f, "|\n");
+    }
+    fprintf(f, "+");
+    for (x = 0 ; x < GFX_DISP_WIDTH ; x++) fputc('-', f);
+    fprintf(f, "+\n");
+}
+
+int sim_gfx_dump_pbm(const char * path) {
+    FILE * f = fopen(path, "w");
+    int x, y;
+    if (!f) {
+        return 1;
+    }
+    fprintf(f, "P1\n%d %d\n", GFX_DISP_WIDTH, GFX_DISP_HEIGHT);
+    for (y = 0 ; y < GFX_DISP_HEIGHT ; y++) {
+        for (x = 0 ; x < GFX_DISP_WIDTH ; x++) {
+            fputc(gddram_pix(x, y) ? '1' : '0', f);
+        }
+        fputc('\n', f);
+    }
+    fclose(f);
+    return 0;
+}
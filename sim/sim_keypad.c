@@ -0,0 +1,233 @@
+/******************************************************************************
+ * Host Simulation - keypad
+ *
+ * Key script: a list of "t:keys" entries, 't' in seconds. Each key is held
+ * for SIM_KEY_HOLD_MS and released for SIM_KEY_GAP_MS before the next one,
+ * as a quick operator would type.
+ *
+ * The keyboard-gpio shim scans the scripted key like the real matrix
+ * driver: a key is reported once, after 'dbtime' consecutive scans in which
+ * it is seen held (that is when sim_metric_key_decoded() is called).
+ *
+ * The matrix is also modelled electrically for scanners that drive the
+ * pins themselves (PIO): a column input reads low while the held key's row
+ * is driven low, else it is pulled up.
+ *
+ *
+ */
+
+#include <sim.h>
+#include <keyboard-gpio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_KEY_HOLD_MS 80
+#define SIM_KEY_GAP_MS  80
+#define SIM_KEY_MAX     256
+
+typedef struct sim_keyev_type {
+    sim_time_t t;
+    char       key;     // 0 := release
+} sim_keyev_t;
+
+static void matrix_update(void);
+
+static sim_keyev_t keyev[SIM_KEY_MAX * 2];
+static int         keyev_count = 0;
+static int         keyev_next = 0;
+static char        key_down = 0;
+
+static int keyev_cmp(const void * a, const void * b) {
+    const sim_keyev_t * ka = (const sim_keyev_t *)a;
+    const sim_keyev_t * kb = (const sim_keyev_t *)b;
+    return (ka->t > kb->t) - (ka->t < kb->t);
+}
+
+static sim_time_t keyscript_task(void * ctx, sim_time_t now) {
+    while (keyev_next < keyev_count && keyev[keyev_next].t <= now) {
+        key_down = keyev[keyev_next].key;
+        if (key_down) {
+            sim_metric_key_down(key_down);
+        }
+        keyev_next ++;
+    }
+    matrix_update();
+    return (keyev_next < keyev_count) ? keyev[keyev_next].t : SIM_NEVER;
+}
+
+int sim_keypad_script(const char * spec) {
+    const char * p = spec;
+    while (p && *p) {
+        char * end;
+        double ts = strtod(p, &end);
+        sim_time_t t;
+        if (end == p || *end != ':') {
+            return 1;
+        }
+        t = (sim_time_t)(ts * 1e6);
+        p = end + 1;
+        while (*p && *p != ',') {
+            if (keyev_count + 2 > SIM_KEY_MAX * 2) {
+                return 1;
+            }
+            keyev[keyev_count].t   = t;
+            keyev[keyev_count].key = *p;
+            keyev_count ++;
+            t += SIM_MS(SIM_KEY_HOLD_MS);
+            keyev[keyev_count].t   = t;
+            keyev[keyev_count].key = 0;
+            keyev_count ++;
+            t += SIM_MS(SIM_KEY_GAP_MS);
+            p ++;
+        }
+        if (*p == ',') p ++;
+    }
+    qsort(keyev, keyev_count, sizeof(keyev[0]), keyev_cmp);
+    if (keyev_count) {
+        sim_task_add(keyscript_task, NULL, keyev[0].t);
+    }
+    return 0;
+}
+
+char sim_keypad_down(void) {
+    return key_down;
+}
+
+// ***************************************************************************
+// keyboard-gpio shim
+// ***************************************************************************
+
+#define KB_MAX_DIM 8
+
+typedef struct sim_kbd_type {
+    int  rows, cols, dbtime, buflen;
+    char map[KB_MAX_DIM][KB_MAX_DIM];
+    char cand;          // key being debounced
+    int  cand_scans;
+    char buf[KB_MAX_DIM];
+    int  count;
+    int  row_gpio[KB_MAX_DIM];
+    int  col_gpio[KB_MAX_DIM];
+} sim_kbd_t;
+
+static sim_kbd_t kbd;
+static bool      kbd_created = false;
+
+// column levels for the held key and the current row drive
+static void matrix_update(void) {
+    int r, c;
+    if (!kbd_created) {
+        return;
+    }
+    for (c = 0 ; c < kbd.cols ; c++) {
+        bool level = true;
+        for (r = 0 ; r < kbd.rows && key_down ; r++) {
+            int rp = kbd.row_gpio[r];
+            if (kbd.map[r][c] == key_down && rp >= 0 && sim_gpio_is_output(rp) && !gpio_get_out_level(rp)) {
+                level = false;
+            }
+        }
+        if (kbd.col_gpio[c] >= 0) {
+            sim_gpio_drive(kbd.col_gpio[c], level);
+        }
+    }
+}
+
+static void matrix_row_hook(uint pin, bool level) {
+    int r;
+    for (r = 0 ; r < kbd.rows ; r++) {
+        if (kbd.row_gpio[r] == (int)pin) {
+            matrix_update();
+            return;
+        }
+    }
+}
+
+void * keyboard_map_create(int rows, int cols, int dbtime, int buflen) {
+    if (rows > KB_MAX_DIM || cols > KB_MAX_DIM || buflen > KB_MAX_DIM) {
+        return NULL;
+    }
+    memset(&kbd, 0, sizeof(kbd));
+    kbd.rows   = rows;
+    kbd.cols   = cols;
+    kbd.dbtime = dbtime;
+    kbd.buflen = buflen;
+    memset(kbd.row_gpio, -1, sizeof(kbd.row_gpio));
+    memset(kbd.col_gpio, -1, sizeof(kbd.col_gpio));
+    if (!kbd_created) {
+        sim_gpio_add_out_hook(matrix_row_hook);
+    }
+    kbd_created = true;
+    return &kbd;
+}
+
+int keyboard_assign_row_gpio(void * hndl, int row, uint gpio) {
+    kbd.row_gpio[row] = (int)gpio;
+    gpio_init(gpio);
+    gpio_set_dir(gpio, GPIO_OUT);
+    return 0;
+}
+
+int keyboard_assign_col_gpio(void * hndl, int col, uint gpio) {
+    kbd.col_gpio[col] = (int)gpio;
+    gpio_init(gpio);
+    gpio_set_dir(gpio, GPIO_IN);
+    gpio_pull_up(gpio);
+    matrix_update(); // a key may already be held
+    return 0;
+}
+
+int keyboard_key_assign(void * hndl, int row, int col, char c) {
+    sim_kbd_t * k = (sim_kbd_t *)hndl;
+    if (!k || row >= k->rows || col >= k->cols) {
+        return 1;
+    }
+    k->map[row][col] = c;
+    matrix_update();
+    return 0;
+}
+
+static bool key_mapped(sim_kbd_t * k, char c) {
+    int r, col;
+    for (r = 0 ; r < k->rows ; r++)
+        for (col = 0 ; col < k->cols ; col++)
+            if (k->map[r][col] == c) return true;
+    return false;
+}
+
+int keyboard_poll(void * hndl) {
+    sim_kbd_t * k = (sim_kbd_t *)hndl;
+    char c = sim_keypad_down();
+    if (!k) {
+        return 0;
+    }
+    if (c && key_mapped(k, c)) {
+        if (c != k->cand) {
+            k->cand = c;
+            k->cand_scans = 0;
+        }
+        k->cand_scans ++;
+        if (k->cand_scans == k->dbtime && k->count < k->buflen) {
+            k->buf[k->count++] = c;
+            sim_metric_key_decoded(c);
+        }
+    } else {
+        k->cand = 0;
+        k->cand_scans = 0;
+    }
+    return k->count;
+}
+
+int keyboard_getkey(void * hndl, char * c) {
+    sim_kbd_t * k = (sim_kbd_t *)hndl;
+    int i;
+    if (!k || !k->count) {
+        return 0;
+    }
+    *c = k->buf[0];
+    k->count --;
+    for (i = 0 ; i < k->count ; i++) {
+        k->buf[i] = k->buf[i + 1];
+    }
+    return k->count;
+}
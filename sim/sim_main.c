@@ -0,0 +1,415 @@
+/******************************************************************************
+ * Host Simulation - entry point, scenario and report
+ *
+ * Runs the unmodified firmware main() (built as jbc_main()) against the
+ * simulated SDK, board and tip until the requested run time has elapsed in
+ * virtual time, then prints a report:
+ *
+ *  - heat-up time and overshoot for every setpoint step (the setpoint the
+ *    controller works to, so standby / sleep / wake are steps as well)
+ *  - droop and recovery time for every scripted solder joint load
+ *  - key-to-screen latency (key down to the first completed frame push
+ *    that shows its effect on the settings area), both from the physical
+ *    press (includes the matrix scan debounce) and from the key being
+ *    decoded by the scan (firmware response)
+ *  - display SPI traffic, analog PSU ripple and regulator statistics
+ *  - flash erases / page programs and the longest stall they caused
+ *  - heater energy against the firmware's power meter
+ *  - telemetry records received on the console UART, and any lost
+ *  - remote command lines answered, and the longest time to the answer
+ *  - lateness and missed deadlines of the periodic tasks, load shedding
+ *  - timer wheel interrupts against the task runs they served
+ *
+ * Usage: JBC200W_sim [options]
+ *  --time <s>          run time (default 30)
+ *  --keys <t:keys,..>  key script, eg. "2:#A350#,4:A"
+ *  --load <t:d,..>     heavy joint at t [s] lasting d [s]
+ *  --hook <t:d,..>     iron put in the cradle at t [s], lifted after d [s]
+ *  --stall <t:d,..>    from t [s] for d [s], interrupts held off for
+ *                      STALL_US every STALL_PD_US (a misbehaving ISR)
+ *  --stall-core <n>    the core --stall holds off (default 0)
+ *  --cmd <t:line>      remote command line sent on the console UART at t
+ *                      [s], eg. "2:U C;P 320,350,380,-;S B" (repeatable)
+ *  --mains <hz>        line frequency (default 50)
+ *  --vline <vrms>      heater supply voltage (default 24)
+ *  --band <C>          heat-up / recovery band around setpoint (default 5)
+ *  --seed <n>          pico_rand seed
+ *  --trace <file>      CSV trace every 10 ms
+ *  --frame <file>      final frame as PBM
+ *  --flash <file>      keep the settings store flash sectors in <file>
+ *                      (loaded at start, saved at the end of the run)
+ *  --tlm <file>        capture the telemetry stream (console UART) in <file>
+ *  --show              print the final frame
+ *
+ */
+
+#include <sim.h>
+#include <operations.h>
+#include <temp_ctrl.h>
+#include <standby.h>
+#include <power_meter.h>
+#include <analog_psu_ctrl.h>
+#include <settings_store.h>
+#include <deadline.h>
+#include <timer_wheel.h>
+#include <board.h>
+#include <hardware/flash.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+int jbc_main(void);
+
+#define MON_PD_US       SIM_MS(10)
+#define STEP_MAX        32
+#define KEYLAT_MAX      256
+#define STALL_MAX       8
+#define STALL_US        1200    /* interrupts off per stall */
+#define STALL_PD_US     7300    /* not a multiple of the half-cycle, hits the ZC edges now and then */
+
+static double  opt_time  = 30.0;
+static double  opt_band  = 5.0;
+static uint    opt_stall_core = 0;
+static bool    opt_show  = false;
+static char *  opt_frame = NULL;
+static FILE *  trace = NULL;
+
+// ***************************************************************************
+// metrics
+// ***************************************************************************
+
+typedef struct sim_step_type {
+    sim_time_t t0;
+    double     sp;
+    sim_time_t t_reach;     // first entry into the band, 0 := never
+    double     peak;        // after reaching the band
+    sim_time_t t_load;      // load event in this step, 0 := none
+    double     droop;       // minimum during/after the load
+    sim_time_t t_recover;
+} sim_step_t;
+
+static sim_step_t steps[STEP_MAX];
+static int        step_count = 0;
+static bool       was_loaded = false;
+
+static sim_time_t key_pending[KEYLAT_MAX];
+static int        key_pending_count = 0;
+static sim_time_t key_lat[KEYLAT_MAX];
+static int        key_lat_count = 0;
+static sim_time_t key_decoded = 0;          // last key decoded by the scan, 0 := none pending
+static sim_time_t key_dec_lat[KEYLAT_MAX];  // ... to screen
+static int        key_dec_lat_count = 0;
+
+void sim_metric_key_down(char k) {
+    if (key_pending_count < KEYLAT_MAX) {
+        key_pending[key_pending_count++] = sim_now();
+    }
+}
+
+void sim_metric_key_decoded(char k) {
+    key_decoded = sim_now();
+}
+
+// a frame reached the panel; 'ui_changed' := it shows the effect of a key
+// (the latest one pending, earlier keys that changed nothing are dropped)
+void sim_metric_frame(bool ui_changed) {
+    if (ui_changed && key_pending_count && key_lat_count < KEYLAT_MAX) {
+        key_lat[key_lat_count++] = sim_now() - key_pending[key_pending_count - 1];
+        key_pending_count = 0;
+        if (key_decoded) {
+            key_dec_lat[key_dec_lat_count++] = sim_now() - key_decoded;
+            key_decoded = 0;
+        }
+    }
+}
+
+static void report_latency(const char * what, const sim_time_t * lat, int count) {
+    sim_time_t lmin = SIM_NEVER, lmax = 0, lsum = 0;
+    int i;
+    for (i = 0 ; i < count ; i++) {
+        if (lat[i] < lmin) lmin = lat[i];
+        if (lat[i] > lmax) lmax = lat[i];
+        lsum += lat[i];
+    }
+    printf("[sim] key-to-screen latency (%s): %d keys, min %.2f ms, mean %.2f ms, max %.2f ms\n",
+        what, count, (double)lmin * 1e-3, (double)lsum * 1e-3 / count, (double)lmax * 1e-3);
+}
+
+// ***************************************************************************
+// scenario: interrupts held off
+// ***************************************************************************
+
+static sim_time_t stall_end[STALL_MAX];
+static int        stall_count = 0;
+
+static sim_time_t stall_task(void * ctx, sim_time_t now) {
+    sim_time_t * end = ctx;
+    if (now >= *end) {
+        return SIM_NEVER;
+    }
+    sim_stall_cores(SIM_CORE(opt_stall_core), STALL_US);
+    return now + STALL_PD_US;
+}
+
+static void stall_add(sim_time_t start, sim_time_t duration) {
+    if (stall_count < STALL_MAX) {
+        stall_end[stall_count] = start + duration;
+        sim_task_add(stall_task, &stall_end[stall_count++], start);
+    }
+}
+
+// the controller's target, 0 := heater off
+static double setpoint_c(void) {
+    return (double)tc_get_setpoint() * 0.01;
+}
+
+static sim_time_t monitor_task(void * ctx, sim_time_t now) {
+    double sp = setpoint_c();
+    double t  = sim_plant_tip_c();
+    sim_step_t * s = step_count ? &steps[step_count - 1] : NULL;
+    if (!s || s->sp != sp) {
+        if (step_count < STEP_MAX) {
+            s = &steps[step_count++];
+            memset(s, 0, sizeof(*s));
+            s->t0 = now;
+            s->sp = sp;
+        }
+    }
+    if (!s->t_reach && sp > 0) {
+        if (fabs(t - sp) <= opt_band) {
+            s->t_reach = now;
+            s->peak = t;
+        }
+    } else if (t > s->peak) {
+        s->peak = t;
+    }
+    if (sim_plant_loaded() && !was_loaded && !s->t_load) {
+        s->t_load = now;
+        s->droop = t;
+    }
+    was_loaded = sim_plant_loaded();
+    if (s->t_load && !s->t_recover) {
+        if (t < s->droop) {
+            s->droop = t;
+        } else if (t >= sp - opt_band && s->droop < sp - opt_band) {
+            s->t_recover = now;
+        }
+    }
+    if (trace) {
+        fprintf(trace, "%.3f,%.2f,%.2f,%.1f,%.1f,%.0f,%d,%d\n", (double)now * 1e-6,
+            t, sim_plant_sensor_c(), sim_plant_heater_w(), pm_get_mw() / 1000.0, sp, (int)sim_plant_loaded(),
+            (int)sim_plant_onhook());
+    }
+    return now + MON_PD_US;
+}
+
+static void report(void) {
+    int i;
+    double vmin, vmax;
+    sim_uart_stats_t ust;
+    printf("\n[sim] ---- report @ %.3f s ----\n", (double)sim_now() * 1e-6);
+    for (i = 0 ; i < step_count ; i++) {
+        sim_step_t * s = &steps[i];
+        printf("[sim] step %d @ %.3f s -> %.0f C: ", i, (double)s->t0 * 1e-6, s->sp);
+        if (s->sp == 0) {
+            printf("heater off");
+        } else if (s->t_reach) {
+            printf("heat-up %.3f s, overshoot %.1f C", (double)(s->t_reach - s->t0) * 1e-6,
+                (s->peak > s->sp) ? s->peak - s->sp : 0.0);
+        } else {
+            printf("setpoint not reached");
+        }
+        if (s->t_load) {
+            printf(", load @ %.3f s droop %.1f C ", (double)s->t_load * 1e-6, s->sp - s->droop);
+            if (s->t_recover)
+                printf("recovery %.3f s", (double)(s->t_recover - s->t_load) * 1e-6);
+            else
+                printf("not recovered");
+        }
+        printf("\n");
+    }
+    if (key_lat_count) {
+        report_latency("from press", key_lat, key_lat_count);
+    }
+    if (key_dec_lat_count) {
+        report_latency("from scan", key_dec_lat, key_dec_lat_count);
+    }
+    printf("[sim] display: %u frames, %llu SPI bytes, SPI busy %.1f ms (%.2f %%)\n",
+        sim_gfx_frames(), (unsigned long long)sim_spi_bytes(), (double)sim_spi_busy_us() * 1e-3,
+        (double)sim_spi_busy_us() * 100.0 / (double)sim_now());
+    printf("[sim] heater energy %.1f J, metered %.1f J (line %.2f Vrms)\n", sim_plant_energy_j(),
+        pm_get_session_mwh() * 3.6, pm_get_line_mv() / 1000.0);
+    printf("[sim] standby: %lu wakes, state %d\n", (unsigned long)sby_get_wakes(), sby_get_state());
+    for (i = 0 ; i < 2 ; i++) {
+        apc_stats_t st;
+        if (sim_plant_psu_ripple(i, &vmin, &vmax)) {
+            printf("[sim] %c16V rail ripple %.2f .. %.2f V\n", i ? '-' : '+', vmin, vmax);
+        }
+        if (apc_get_stats(i ? APC_RAIL_N16V : APC_RAIL_P16V, &st) == 0) {
+            int b;
+            printf("[sim] %c16V regulator: %u cycles, duty %.1f %%, max over %.2f ms, fault %s, discharge hist",
+                i ? '-' : '+', st.cycles, st.duty_pm * 0.1, st.max_over_us * 1e-3, st.fault ? "yes" : "no");
+            for (b = 0 ; b < APC_HIST_BINS ; b++) {
+                printf(" %u", st.dischg_hist[b]);
+            }
+            printf("\n");
+        }
+    }
+    sim_uart_stats(&ust);
+    printf("[sim] telemetry: %u records (%u samples, %u keys, %u logs), %llu bytes, UART busy %.1f %%, lost %u, bad %u\n",
+        ust.records, ust.samples, ust.keys, ust.logs, (unsigned long long)ust.bytes,
+        (double)ust.busy_us * 100.0 / (double)sim_now(), ust.lost, ust.bad);
+    for (i = 0 ; i < TLM_DL_COUNT ; i++) {
+        static const char * const name[TLM_DL_COUNT] = {
+#define DL_NAME(id, nm) nm,
+            TLM_DL_TASKS(DL_NAME)
+#undef DL_NAME
+        };
+        dl_stats_t dst;
+        if (dl_get_totals(i, &dst) == 0 && dst.runs) {
+            int b;
+            printf("[sim] deadline %s: %u runs, period %.2f ms, missed %u (> %.2f ms), max late %.3f ms, hist",
+                name[i], dst.runs, dst.period_us * 1e-3, dst.missed, dst.deadline_us * 1e-3, dst.max_late_us * 1e-3);
+            for (b = 0 ; b < DL_HIST_BINS ; b++) {
+                printf(" %u", dst.hist[b]);
+            }
+            printf("\n");
+        }
+    }
+    {
+        uint32_t raised;
+        int top = dl_get_shed_max(&raised);
+        printf("[sim] load shedding: level %d now, max %d, raised %u times\n", dl_get_shed(), top, raised);
+    }
+    {
+        tw_stats_t tst;
+        if (tw_get_stats(&tst) == 0) {
+            printf("[sim] timer wheel: %u tasks, %u alarm irqs for %u runs (%u idle), %u periods skipped, max late %.3f ms\n",
+                tst.tasks, tst.irqs, tst.runs, tst.idle, tst.skipped, tst.max_late_us * 1e-3);
+        }
+    }
+    printf("[sim] flash: %u sector erases, %u page programs, longest stall %.2f ms, settings pending %s\n",
+        sim_flash_erases(), sim_flash_programs(), (double)sim_flash_max_stall() * 1e-3, sst_pending() ? "yes" : "no");
+    if (ust.acks) {
+        printf("[sim] commands: %u lines answered, %u failed, longest line end to ack %.3f ms\n",
+            ust.acks, ust.acks_failed, (double)ust.ack_max_us * 1e-3);
+    }
+    if (sim_flash_save()) {
+        fprintf(stderr, "[sim] cannot write the flash file\n");
+    }
+    if (opt_show) {
+        sim_gfx_dump_ascii(stdout);
+    }
+    if (opt_frame && sim_gfx_dump_pbm(opt_frame)) {
+        fprintf(stderr, "[sim] cannot write %s\n", opt_frame);
+    }
+    if (trace) {
+        fclose(trace);
+    }
+    sim_uart_close();
+    fflush(stdout);
+}
+
+// ***************************************************************************
+// command line
+// ***************************************************************************
+
+// "t:d,.." -> fn(t, d)
+static int interval_script(const char * spec, void (*fn)(sim_time_t, sim_time_t)) {
+    const char * p = spec;
+    while (p && *p) {
+        char * end;
+        double t = strtod(p, &end), d;
+        if (end == p || *end != ':') return 1;
+        p = end + 1;
+        d = strtod(p, &end);
+        if (end == p) return 1;
+        fn((sim_time_t)(t * 1e6), (sim_time_t)(d * 1e6));
+        p = (*end == ',') ? end + 1 : end;
+    }
+    return 0;
+}
+
+static void usage(const char * prog) {
+    fprintf(stderr, "usage: %s [--time s] [--keys t:keys,..] [--load t:d,..] [--hook t:d,..] [--stall t:d,..]\n"
+                    "          [--stall-core n] [--cmd t:line] [--mains hz] [--vline vrms] [--band C] [--seed n]\n"
+                    "          [--trace file.csv] [--frame file.pbm] [--flash file] [--tlm file] [--show]\n", prog);
+    exit(2);
+}
+
+int main(int argc, char ** argv) {
+    sim_plant_cfg_t cfg;
+    const char * keys = NULL;
+    const char * loads = NULL;
+    const char * hooks = NULL;
+    const char * stalls = NULL;
+    const char * flash = NULL;
+    int i;
+    sim_plant_defaults(&cfg);
+    for (i = 1 ; i < argc ; i++) {
+        const char * a = argv[i];
+        const char * v = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (!strcmp(a, "--show")) {
+            opt_show = true;
+            continue;
+        }
+        if (!v) usage(argv[0]);
+        i ++;
+        if      (!strcmp(a, "--time"))  opt_time = atof(v);
+        else if (!strcmp(a, "--keys"))  keys = v;
+        else if (!strcmp(a, "--load"))  loads = v;
+        else if (!strcmp(a, "--hook"))  hooks = v;
+        else if (!strcmp(a, "--stall")) stalls = v;
+        else if (!strcmp(a, "--stall-core")) opt_stall_core = (uint)atoi(v) & 1;
+        else if (!strcmp(a, "--cmd")) {
+            char * end;
+            double t = strtod(v, &end);
+            if (end == v || *end != ':' || sim_uart_send((sim_time_t)(t * 1e6), end + 1)) {
+                fprintf(stderr, "[sim] bad --cmd spec\n");
+                return 2;
+            }
+        }
+        else if (!strcmp(a, "--mains")) cfg.mains_hz = atof(v);
+        else if (!strcmp(a, "--vline")) cfg.line_vrms = atof(v);
+        else if (!strcmp(a, "--band"))  opt_band = atof(v);
+        else if (!strcmp(a, "--seed"))  sim_rand_seed(strtoull(v, NULL, 0));
+        else if (!strcmp(a, "--frame")) opt_frame = (char *)v;
+        else if (!strcmp(a, "--flash")) flash = v;
+        else if (!strcmp(a, "--tlm")) {
+            if (sim_uart_capture(v)) {
+                fprintf(stderr, "[sim] cannot write %s\n", v);
+                return 1;
+            }
+        }
+        else if (!strcmp(a, "--trace")) {
+            trace = fopen(v, "w");
+            if (!trace) {
+                fprintf(stderr, "[sim] cannot write %s\n", v);
+                return 1;
+            }
+            fprintf(trace, "t_s,tip_c,sensor_c,heater_w,meter_w,setpoint_c,loaded,onhook\n");
+        }
+        else usage(argv[0]);
+    }
+    sim_plant_init(&cfg);
+    sim_flash_init(flash, SST_SECTORS * FLASH_SECTOR_SIZE);
+    if (keys && sim_keypad_script(keys)) {
+        fprintf(stderr, "[sim] bad --keys spec\n");
+        return 2;
+    }
+    if (loads && interval_script(loads, sim_plant_load)) {
+        fprintf(stderr, "[sim] bad --load spec\n");
+        return 2;
+    }
+    if (hooks && interval_script(hooks, sim_plant_hook)) {
+        fprintf(stderr, "[sim] bad --hook spec\n");
+        return 2;
+    }
+    if (stalls && interval_script(stalls, stall_add)) {
+        fprintf(stderr, "[sim] bad --stall spec\n");
+        return 2;
+    }
+    sim_task_add(monitor_task, NULL, 0);
+    sim_set_end((sim_time_t)(opt_time * 1e6), report);
+    return jbc_main(); // does not return, the run ends from the virtual clock
+}
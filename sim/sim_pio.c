@@ -0,0 +1,712 @@
+/******************************************************************************
+ * Host Simulation - PIO
+ *
+ * Instruction level interpreter for the two PIO blocks. Every enabled state
+ * machine is a scheduler task that executes its instructions at their
+ * cycle times (clk_sys / clkdiv, plus any delay) up to the current virtual
+ * time. Pins are read and written through the GPIO bank, writes only reach
+ * pins whose function is this PIO block.
+ *
+ * A state machine that stalls (WAIT not met, FIFO full / empty, IRQ WAIT)
+ * drops out of the schedule and is woken again by any GPIO change, by the
+ * CPU side of its FIFOs or by an IRQ flag change in its block, then resumes
+ * at that time.
+ *
+ */
+
+#include <sim.h>
+#include <hardware/pio.h>
+#include <hardware/irq.h>
+#include <pico/stdlib.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_CLK_SYS_MHZ     125.0
+#define PIO_FIFO_DEPTH      4
+
+typedef struct sim_fifo_type {
+    uint32_t data[2 * PIO_FIFO_DEPTH];
+    uint     rd, n, depth;
+} sim_fifo_t;
+
+typedef struct sim_sm_type {
+    PIO           pio;
+    uint          num;
+    bool          claimed;
+    bool          enabled;
+    pio_sm_config cfg;
+    uint8_t       pc;
+    uint32_t      x, y, isr, osr;
+    uint          isr_count, osr_count;
+    sim_fifo_t    rx, tx;
+    bool          exec_pending;     // instruction from MOV/OUT EXEC or pio_sm_exec()
+    uint16_t      exec_instr;
+    bool          push_pending;     // autopush waiting for RX space
+    bool          irq_waiting;      // IRQ WAIT: flag set, waiting for it to clear
+    bool          stalled;
+    double        t_next;           // time of the next instruction [usec]
+    bool          has_slot;
+    int           slot;
+} sim_sm_t;
+
+struct pio_hw {
+    uint16_t instr[PIO_INSTRUCTION_COUNT];
+    uint32_t used;                  // instruction slots in use
+    sim_sm_t sm[NUM_PIO_STATE_MACHINES];
+    uint8_t  irq_flags;
+    uint32_t inte[2];               // PIOx_IRQ_0/1 source enables
+    bool     line[2];               // PIOx_IRQ_0/1 level
+};
+
+pio_hw_t sim_pio0_hw, sim_pio1_hw;
+
+uint pio_get_index(PIO pio) {
+    return (pio == pio1) ? 1 : 0;
+}
+
+enum { SM_DONE, SM_JUMP, SM_STALL };
+
+// ***************************************************************************
+// helpers
+// ***************************************************************************
+
+static uint thresh(uint t) {
+    return t ? t : 32;
+}
+
+static void fifo_reset(sim_fifo_t * f, uint depth) {
+    f->rd = f->n = 0;
+    f->depth = depth;
+}
+
+static bool fifo_full(const sim_fifo_t * f)  { return f->n >= f->depth; }
+static bool fifo_empty(const sim_fifo_t * f) { return f->n == 0; }
+
+static void fifo_put(sim_fifo_t * f, uint32_t v) {
+    f->data[(f->rd + f->n) % (2 * PIO_FIFO_DEPTH)] = v;
+    f->n ++;
+}
+
+static uint32_t fifo_get(sim_fifo_t * f) {
+    uint32_t v = f->data[f->rd];
+    f->rd = (f->rd + 1) % (2 * PIO_FIFO_DEPTH);
+    f->n --;
+    return v;
+}
+
+static void fifo_depths(sim_sm_t * s) {
+    uint join = s->cfg.fifo_join;
+    fifo_reset(&s->rx, (join == PIO_FIFO_JOIN_RX) ? 2 * PIO_FIFO_DEPTH : ((join == PIO_FIFO_JOIN_TX) ? 0 : PIO_FIFO_DEPTH));
+    fifo_reset(&s->tx, (join == PIO_FIFO_JOIN_TX) ? 2 * PIO_FIFO_DEPTH : ((join == PIO_FIFO_JOIN_RX) ? 0 : PIO_FIFO_DEPTH));
+}
+
+static bool pin_owned(PIO pio, uint pin) {
+    return pin < NUM_BANK0_GPIOS && gpio_get_function(pin) == (enum gpio_function)(GPIO_FUNC_PIO0 + pio_get_index(pio));
+}
+
+static void pins_write(PIO pio, uint base, uint count, uint32_t v) {
+    uint i;
+    for (i = 0 ; i < count ; i++) {
+        uint pin = (base + i) & 31;
+        if (pin_owned(pio, pin)) gpio_put(pin, (v >> i) & 1);
+    }
+}
+
+static void pindirs_write(PIO pio, uint base, uint count, uint32_t v) {
+    uint i;
+    for (i = 0 ; i < count ; i++) {
+        uint pin = (base + i) & 31;
+        if (pin_owned(pio, pin)) gpio_set_dir(pin, (v >> i) & 1);
+    }
+}
+
+static uint32_t pins_read(uint base) {
+    uint32_t v = 0;
+    uint i;
+    for (i = 0 ; i < 32 ; i++) {
+        uint pin = (base + i) & 31;
+        if (pin < NUM_BANK0_GPIOS && gpio_get(pin)) v |= 1u << i;
+    }
+    return v;
+}
+
+static uint32_t bitrev(uint32_t v) {
+    uint32_t r = 0;
+    int i;
+    for (i = 0 ; i < 32 ; i++) {
+        r = (r << 1) | ((v >> i) & 1);
+    }
+    return r;
+}
+
+static uint irq_index(const sim_sm_t * s, uint idx) {
+    if (idx & 0x10) {
+        return (idx & 4) | ((idx + s->num) & 3);
+    }
+    return idx & 7;
+}
+
+static void sm_wake(sim_sm_t * s) {
+    if (s->enabled && s->stalled && s->has_slot) {
+        s->stalled = false;
+        if (s->t_next < (double)sim_now()) {
+            s->t_next = (double)sim_now();
+        }
+        sim_task_due(s->slot, sim_now());
+    }
+}
+
+static void block_wake(PIO pio) {
+    int i;
+    for (i = 0 ; i < NUM_PIO_STATE_MACHINES ; i++) {
+        sm_wake(&pio->sm[i]);
+    }
+}
+
+void sim_pio_gpio_changed(void) {
+    block_wake(pio0);
+    block_wake(pio1);
+}
+
+// level of the PIOx_IRQ_0/1 lines, raise on a rising level
+static void irq_lines_update(PIO pio) {
+    uint32_t src = 0;
+    int i;
+    for (i = 0 ; i < NUM_PIO_STATE_MACHINES ; i++) {
+        if (!fifo_empty(&pio->sm[i].rx)) src |= 1u << (pis_sm0_rx_fifo_not_empty + i);
+        if (!fifo_full(&pio->sm[i].tx))  src |= 1u << (pis_sm0_tx_fifo_not_full + i);
+    }
+    src |= (uint32_t)(pio->irq_flags & 0x0F) << pis_interrupt0;
+    for (i = 0 ; i < 2 ; i++) {
+        bool level = (src & pio->inte[i]) != 0;
+        if (level && !pio->line[i]) {
+            pio->line[i] = true;
+            sim_irq_raise((pio_get_index(pio) ? PIO1_IRQ_0 : PIO0_IRQ_0) + i);
+        }
+        pio->line[i] = (src & pio->inte[i]) != 0;
+    }
+}
+
+// ***************************************************************************
+// interpreter
+// ***************************************************************************
+
+static void sideset(sim_sm_t * s, uint field, uint dbits) {
+    uint n = s->cfg.sideset_count - (s->cfg.sideset_opt ? 1 : 0);
+    uint v;
+    if (!s->cfg.sideset_count) {
+        return;
+    }
+    if (s->cfg.sideset_opt && !(field & 0x10)) {
+        return;
+    }
+    v = (field >> dbits) & ((1u << n) - 1);
+    if (s->cfg.sideset_pindirs) {
+        pindirs_write(s->pio, s->cfg.sideset_base, n, v);
+    } else {
+        pins_write(s->pio, s->cfg.sideset_base, n, v);
+    }
+}
+
+static void isr_shift(sim_sm_t * s, uint32_t data, uint n) {
+    if (n < 32) {
+        data &= (1u << n) - 1;
+        s->isr = s->cfg.in_shift_right ? ((s->isr >> n) | (data << (32 - n))) : ((s->isr << n) | data);
+    } else {
+        s->isr = data;
+    }
+    s->isr_count = (s->isr_count + n > 32) ? 32 : s->isr_count + n;
+}
+
+static uint32_t osr_shift(sim_sm_t * s, uint n) {
+    uint32_t data;
+    if (n < 32) {
+        if (s->cfg.out_shift_right) {
+            data = s->osr & ((1u << n) - 1);
+            s->osr >>= n;
+        } else {
+            data = s->osr >> (32 - n);
+            s->osr <<= n;
+        }
+    } else {
+        data = s->osr;
+        s->osr = 0;
+    }
+    s->osr_count = (s->osr_count + n > 32) ? 32 : s->osr_count + n;
+    return data;
+}
+
+static int do_push(sim_sm_t * s, bool block) {
+    if (fifo_full(&s->rx)) {
+        if (block) {
+            return SM_STALL;
+        }
+    } else {
+        fifo_put(&s->rx, s->isr);
+    }
+    s->isr = 0;
+    s->isr_count = 0;
+    return SM_DONE;
+}
+
+static int execute(sim_sm_t * s, uint16_t instr) {
+    uint op   = instr >> 13;
+    uint arg1 = (instr >> 5) & 7;
+    uint arg2 = instr & 31;
+    PIO  pio  = s->pio;
+    uint32_t v = 0;
+    uint n, i;
+    bool c;
+    switch (op) {
+    case 0: // JMP
+        switch (arg1) {
+        case 0: c = true; break;
+        case 1: c = (s->x == 0); break;
+        case 2: c = (s->x != 0); s->x --; break;
+        case 3: c = (s->y == 0); break;
+        case 4: c = (s->y != 0); s->y --; break;
+        case 5: c = (s->x != s->y); break;
+        case 6: c = gpio_get(s->cfg.jmp_pin); break;
+        default: c = (s->osr_count < thresh(s->cfg.pull_threshold)); break;
+        }
+        if (c) {
+            s->pc = (uint8_t)arg2;
+            return SM_JUMP;
+        }
+        return SM_DONE;
+    case 1: // WAIT
+        c = (arg1 >> 2) & 1;
+        switch (arg1 & 3) {
+        case 0:  v = gpio_get(arg2); break;
+        case 1:  v = gpio_get((s->cfg.in_base + arg2) & 31); break;
+        default: v = (pio->irq_flags >> irq_index(s, arg2)) & 1; break;
+        }
+        if ((bool)v != c) {
+            return SM_STALL;
+        }
+        if ((arg1 & 3) == 2 && c) {
+            pio->irq_flags &= ~(1u << irq_index(s, arg2));
+            block_wake(pio);
+        }
+        return SM_DONE;
+    case 2: // IN
+        if (s->push_pending) {
+            if (do_push(s, true) == SM_STALL) return SM_STALL;
+            s->push_pending = false;
+            return SM_DONE;
+        }
+        n = arg2 ? arg2 : 32;
+        switch (arg1) {
+        case 0: v = pins_read(s->cfg.in_base); break;
+        case 1: v = s->x; break;
+        case 2: v = s->y; break;
+        case 6: v = s->isr; break;
+        case 7: v = s->osr; break;
+        default: v = 0; break;
+        }
+        isr_shift(s, v, n);
+        if (s->cfg.autopush && s->isr_count >= thresh(s->cfg.push_threshold)) {
+            if (do_push(s, true) == SM_STALL) {
+                s->push_pending = true;
+                return SM_STALL;
+            }
+        }
+        return SM_DONE;
+    case 3: // OUT
+        if (s->cfg.autopull && s->osr_count >= thresh(s->cfg.pull_threshold)) {
+            if (fifo_empty(&s->tx)) return SM_STALL;
+            s->osr = fifo_get(&s->tx);
+            s->osr_count = 0;
+        }
+        n = arg2 ? arg2 : 32;
+        v = osr_shift(s, n);
+        switch (arg1) {
+        case 0: pins_write(pio, s->cfg.out_base, s->cfg.out_count, v); break;
+        case 1: s->x = v; break;
+        case 2: s->y = v; break;
+        case 4: pindirs_write(pio, s->cfg.out_base, s->cfg.out_count, v); break;
+        case 5: s->pc = v & 31; return SM_JUMP;
+        case 6: s->isr = v; s->isr_count = n; break;
+        case 7: s->exec_pending = true; s->exec_instr = (uint16_t)v; break;
+        default: break;
+        }
+        return SM_DONE;
+    case 4: // PUSH / PULL
+        if (!(instr & 0x80)) {
+            if ((instr & 0x40) && s->isr_count < thresh(s->cfg.push_threshold)) {
+                return SM_DONE;
+            }
+            return do_push(s, (instr & 0x20) != 0);
+        }
+        if ((instr & 0x40) && s->osr_count < thresh(s->cfg.pull_threshold)) {
+            return SM_DONE;
+        }
+        if (fifo_empty(&s->tx)) {
+            if (instr & 0x20) return SM_STALL;
+            s->osr = s->x;
+        } else {
+            s->osr = fifo_get(&s->tx);
+        }
+        s->osr_count = 0;
+        return SM_DONE;
+    case 5: // MOV
+        switch (arg2 & 7) {
+        case 0: v = pins_read(s->cfg.in_base); break;
+        case 1: v = s->x; break;
+        case 2: v = s->y; break;
+        case 5:
+            n = (s->cfg.mov_status_sel == STATUS_RX_LESSTHAN) ? s->rx.n : s->tx.n;
+            v = (n < s->cfg.mov_status_n) ? 0xFFFFFFFFu : 0;
+            break;
+        case 6: v = s->isr; break;
+        case 7: v = s->osr; break;
+        default: v = 0; break;
+        }
+        if (((arg2 >> 3) & 3) == 1) v = ~v;
+        else if (((arg2 >> 3) & 3) == 2) v = bitrev(v);
+        switch (arg1) {
+        case 0: pins_write(pio, s->cfg.out_base, s->cfg.out_count, v); break;
+        case 1: s->x = v; break;
+        case 2: s->y = v; break;
+        case 4: s->exec_pending = true; s->exec_instr = (uint16_t)v; break;
+        case 5: s->pc = v & 31; return SM_JUMP;
+        case 6: s->isr = v; s->isr_count = 0; break;
+        case 7: s->osr = v; s->osr_count = 0; break;
+        default: break;
+        }
+        return SM_DONE;
+    case 6: // IRQ
+        i = irq_index(s, arg2);
+        if (arg1 & 2) {
+            pio->irq_flags &= ~(1u << i);
+            block_wake(pio);
+            return SM_DONE;
+        }
+        if (!s->irq_waiting) {
+            pio->irq_flags |= 1u << i;
+            block_wake(pio);
+            if (!(arg1 & 1)) {
+                return SM_DONE;
+            }
+            s->irq_waiting = true;
+        }
+        if (pio->irq_flags & (1u << i)) {
+            return SM_STALL;
+        }
+        s->irq_waiting = false;
+        return SM_DONE;
+    default: // SET
+        switch (arg1) {
+        case 0: pins_write(pio, s->cfg.set_base, s->cfg.set_count, arg2); break;
+        case 1: s->x = arg2; break;
+        case 2: s->y = arg2; break;
+        case 4: pindirs_write(pio, s->cfg.set_base, s->cfg.set_count, arg2); break;
+        default: break;
+        }
+        return SM_DONE;
+    }
+}
+
+// execute one instruction, returns the cycles it took (0 := stalled)
+static uint sm_step(sim_sm_t * s) {
+    bool from_exec = s->exec_pending;
+    uint16_t instr = from_exec ? s->exec_instr : s->pio->instr[s->pc];
+    uint field = (instr >> 8) & 0x1F;
+    uint dbits = 5 - s->cfg.sideset_count;
+    int r;
+    sideset(s, field, dbits);
+    if (from_exec) {
+        s->exec_pending = false;
+    }
+    r = execute(s, instr);
+    if (r == SM_STALL) {
+        if (from_exec) {
+            s->exec_pending = true; // retried
+        }
+        return 0;
+    }
+    if (r == SM_DONE && !from_exec) {
+        s->pc = (s->pc == s->cfg.wrap) ? (uint8_t)s->cfg.wrap_target : (uint8_t)((s->pc + 1) & 31);
+    }
+    return 1 + (field & ((1u << dbits) - 1));
+}
+
+static sim_time_t sm_task(void * ctx, sim_time_t now) {
+    sim_sm_t * s = (sim_sm_t *)ctx;
+    double cycle_us = (double)s->cfg.clkdiv / SIM_CLK_SYS_MHZ;
+    uint cycles;
+    while (s->enabled && !s->stalled && s->t_next <= (double)now) {
+        cycles = sm_step(s);
+        if (cycles == 0) {
+            s->stalled = true;
+        } else {
+            s->t_next += cycle_us * cycles;
+        }
+        irq_lines_update(s->pio);
+    }
+    if (!s->enabled || s->stalled) {
+        return SIM_NEVER;
+    }
+    return (sim_time_t)ceil(s->t_next);
+}
+
+// ***************************************************************************
+// SDK API
+// ***************************************************************************
+
+pio_sm_config pio_get_default_sm_config(void) {
+    pio_sm_config c;
+    memset(&c, 0, sizeof(c));
+    c.clkdiv = 1.0f;
+    c.wrap_target = 0;
+    c.wrap = 31;
+    c.in_shift_right = true;
+    c.out_shift_right = true;
+    return c;
+}
+
+static int find_offset(PIO pio, const pio_program_t * p) {
+    uint32_t mask = (1u << p->length) - 1;
+    int off;
+    if (p->length > PIO_INSTRUCTION_COUNT || p->length == 0) {
+        return -1;
+    }
+    if (p->length == 32) {
+        mask = 0xFFFFFFFFu;
+    }
+    if (p->origin >= 0) {
+        return (pio->used & (mask << p->origin)) ? -1 : p->origin;
+    }
+    for (off = PIO_INSTRUCTION_COUNT - p->length ; off >= 0 ; off--) {
+        if (!(pio->used & (mask << off))) {
+            return off;
+        }
+    }
+    return -1;
+}
+
+bool pio_can_add_program(PIO pio, const pio_program_t * program) {
+    return find_offset(pio, program) >= 0;
+}
+
+uint pio_add_program(PIO pio, const pio_program_t * program) {
+    int off = find_offset(pio, program);
+    uint i;
+    if (off < 0) {
+        fprintf(stderr, "[sim] pio: no program space\n");
+        exit(1);
+    }
+    for (i = 0 ; i < program->length ; i++) {
+        uint16_t in = program->instructions[i];
+        // relocate JMP targets
+        pio->instr[off + i] = ((in & 0xE000) == 0) ? (uint16_t)(in + off) : in;
+        pio->used |= 1u << (off + i);
+    }
+    return (uint)off;
+}
+
+void pio_remove_program(PIO pio, const pio_program_t * program, uint loaded_offset) {
+    uint i;
+    for (i = 0 ; i < program->length ; i++) {
+        pio->used &= ~(1u << (loaded_offset + i));
+    }
+}
+
+void pio_sm_claim(PIO pio, uint sm) {
+    pio->sm[sm].claimed = true;
+}
+
+int pio_claim_unused_sm(PIO pio, bool required) {
+    int i;
+    for (i = 0 ; i < NUM_PIO_STATE_MACHINES ; i++) {
+        if (!pio->sm[i].claimed) {
+            pio->sm[i].claimed = true;
+            return i;
+        }
+    }
+    if (required) {
+        fprintf(stderr, "[sim] pio: no free state machine\n");
+        exit(1);
+    }
+    return -1;
+}
+
+void pio_sm_unclaim(PIO pio, uint sm) {
+    pio->sm[sm].claimed = false;
+}
+
+bool pio_sm_is_claimed(PIO pio, uint sm) {
+    return pio->sm[sm].claimed;
+}
+
+void pio_sm_restart(PIO pio, uint sm) {
+    sim_sm_t * s = &pio->sm[sm];
+    s->isr = 0;
+    s->isr_count = 0;
+    s->osr_count = 32; // empty
+    s->exec_pending = false;
+    s->push_pending = false;
+    s->irq_waiting  = false;
+}
+
+void pio_sm_clkdiv_restart(PIO pio, uint sm) {
+    pio->sm[sm].t_next = (double)sim_now();
+}
+
+int pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config * config) {
+    sim_sm_t * s = &pio->sm[sm];
+    pio_sm_set_enabled(pio, sm, false);
+    s->pio = pio;
+    s->num = sm;
+    s->cfg = config ? *config : pio_get_default_sm_config();
+    fifo_depths(s);
+    pio_sm_restart(pio, sm);
+    s->x = s->y = s->osr = 0;
+    s->pc = (uint8_t)initial_pc;
+    s->stalled = false;
+    return 0;
+}
+
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled) {
+    sim_sm_t * s = &pio->sm[sm];
+    if (s->enabled == enabled) {
+        return;
+    }
+    s->pio = pio;
+    s->num = sm;
+    s->enabled = enabled;
+    if (enabled) {
+        if (!s->has_slot) {
+            s->slot = sim_task_add(sm_task, s, SIM_NEVER);
+            s->has_slot = (s->slot >= 0);
+        }
+        s->stalled = false;
+        s->t_next = (double)sim_now();
+        sim_task_due(s->slot, sim_now());
+    } else if (s->has_slot) {
+        sim_task_due(s->slot, SIM_NEVER);
+    }
+}
+
+void pio_sm_exec(PIO pio, uint sm, uint instr) {
+    sim_sm_t * s = &pio->sm[sm];
+    uint field = (instr >> 8) & 0x1F;
+    int r;
+    s->pio = pio;
+    s->num = sm;
+    sideset(s, field, 5 - s->cfg.sideset_count);
+    r = execute(s, (uint16_t)instr);
+    if (r == SM_STALL) {
+        s->exec_pending = true;
+        s->exec_instr = (uint16_t)instr;
+    }
+    irq_lines_update(pio);
+}
+
+uint8_t pio_sm_get_pc(PIO pio, uint sm) {
+    return pio->sm[sm].pc;
+}
+
+void pio_sm_set_pins_with_mask(PIO pio, uint sm, uint32_t pin_values, uint32_t pin_mask) {
+    uint pin;
+    for (pin = 0 ; pin < NUM_BANK0_GPIOS ; pin++) {
+        if ((pin_mask >> pin) & 1) pins_write(pio, pin, 1, (pin_values >> pin) & 1);
+    }
+}
+
+void pio_sm_set_pindirs_with_mask(PIO pio, uint sm, uint32_t pin_dirs, uint32_t pin_mask) {
+    uint pin;
+    for (pin = 0 ; pin < NUM_BANK0_GPIOS ; pin++) {
+        if ((pin_mask >> pin) & 1) pindirs_write(pio, pin, 1, (pin_dirs >> pin) & 1);
+    }
+}
+
+int pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out) {
+    pindirs_write(pio, pin_base, pin_count, is_out ? 0xFFFFFFFFu : 0);
+    return 0;
+}
+
+void pio_gpio_init(PIO pio, uint pin) {
+    gpio_set_function(pin, (enum gpio_function)(GPIO_FUNC_PIO0 + pio_get_index(pio)));
+}
+
+void pio_sm_put(PIO pio, uint sm, uint32_t data) {
+    sim_sm_t * s = &pio->sm[sm];
+    if (!fifo_full(&s->tx)) {
+        fifo_put(&s->tx, data);
+    }
+    sm_wake(s);
+    irq_lines_update(pio);
+}
+
+void pio_sm_put_blocking(PIO pio, uint sm, uint32_t data) {
+    while (fifo_full(&pio->sm[sm].tx)) {
+        tight_loop_contents();
+    }
+    pio_sm_put(pio, sm, data);
+}
+
+uint32_t pio_sm_get(PIO pio, uint sm) {
+    sim_sm_t * s = &pio->sm[sm];
+    uint32_t v = fifo_empty(&s->rx) ? 0 : fifo_get(&s->rx);
+    sm_wake(s);
+    irq_lines_update(pio);
+    return v;
+}
+
+uint32_t pio_sm_get_blocking(PIO pio, uint sm) {
+    while (fifo_empty(&pio->sm[sm].rx)) {
+        tight_loop_contents();
+    }
+    return pio_sm_get(pio, sm);
+}
+
+bool pio_sm_is_rx_fifo_empty(PIO pio, uint sm)  { return fifo_empty(&pio->sm[sm].rx); }
+bool pio_sm_is_rx_fifo_full(PIO pio, uint sm)   { return fifo_full(&pio->sm[sm].rx); }
+bool pio_sm_is_tx_fifo_empty(PIO pio, uint sm)  { return fifo_empty(&pio->sm[sm].tx); }
+bool pio_sm_is_tx_fifo_full(PIO pio, uint sm)   { return fifo_full(&pio->sm[sm].tx); }
+uint pio_sm_get_rx_fifo_level(PIO pio, uint sm) { return pio->sm[sm].rx.n; }
+uint pio_sm_get_tx_fifo_level(PIO pio, uint sm) { return pio->sm[sm].tx.n; }
+
+void pio_sm_clear_fifos(PIO pio, uint sm) {
+    sim_sm_t * s = &pio->sm[sm];
+    s->rx.rd = s->rx.n = 0;
+    s->tx.rd = s->tx.n = 0;
+    sm_wake(s);
+    irq_lines_update(pio);
+}
+
+void pio_sm_drain_tx_fifo(PIO pio, uint sm) {
+    sim_sm_t * s = &pio->sm[sm];
+    s->tx.rd = s->tx.n = 0;
+    sm_wake(s);
+    irq_lines_update(pio);
+}
+
+bool pio_interrupt_get(PIO pio, uint pio_interrupt_num) {
+    return (pio->irq_flags >> pio_interrupt_num) & 1;
+}
+
+void pio_interrupt_clear(PIO pio, uint pio_interrupt_num) {
+    pio->irq_flags &= ~(1u << pio_interrupt_num);
+    block_wake(pio);
+    irq_lines_update(pio);
+}
+
+void pio_set_irqn_source_enabled(PIO pio, uint irq_index, enum pio_interrupt_source source, bool enabled) {
+    if (enabled) {
+        pio->inte[irq_index & 1] |= 1u << source;
+    } else {
+        pio->inte[irq_index & 1] &= ~(1u << source);
+    }
+    irq_lines_update(pio);
+}
+
+void pio_set_irq0_source_enabled(PIO pio, enum pio_interrupt_source source, bool enabled) {
+    pio_set_irqn_source_enabled(pio, 0, source, enabled);
+}
+
+void pio_set_irq1_source_enabled(PIO pio, enum pio_interrupt_source source, bool enabled) {
+    pio_set_irqn_source_enabled(pio, 1, source, enabled);
+}
@@ -0,0 +1,445 @@
+/******************************************************************************
+ * Host Simulation - plant models
+ *
+ * Mains:       line voltage with a zero-crossing detector on AC_ZC_INPUT
+ *              (level toggles at every zero crossing).
+ * Heater:      triac style switch. Gate = HTR_CTRL_ON_L active while
+ *              HTR_CTRL_OFF_L is released. Once gated it conducts until the
+ *              next zero crossing, so a late gate loses the start of the
+ *              half-cycle exactly as a phase-fired triac would.
+ * Tip:         lumped heat capacity with a linear loss to ambient, an
+ *              optional solder joint / ground plane load, and a first order
+ *              thermocouple lag.
+ * Tip ADC:     thermocouple amplifier on ADC_TEMP_CHAN, scaled per board.h,
+ *              with white noise plus pickup of the heater current while the
+ *              heater conducts.
+ * Analog PSU:  +/-16V reservoir caps charged while APSU_xxx_ON_L is active,
+ *              discharged by a constant load, with a hysteretic comparator
+ *              driving APSU_xxx_CHARGE_STATE.
+ *
+ */
+
+#include <sim.h>
+#include <board.h>
+#include <hardware/gpio.h>
+#include <hardware/adc.h>
+#include <hardware/dma.h>
+#include <math.h>
+
+#define PLANT_STEP_US       250     /* thermal integration step */
+#define LOAD_K_PER_W        5.0     /* joint to ambient */
+
+static sim_plant_cfg_t cfg;
+
+// ***************************************************************************
+// mains, heater and tip
+// ***************************************************************************
+
+static sim_time_t half_us;              // half-cycle period
+static sim_time_t zc_time = 0;          // start of the current half-cycle
+static bool       zc_level = false;
+static bool       conducting = false;
+static double     p_rms = 0;            // full conduction heater power
+static sim_time_t last_t = 0;           // thermal state is valid at this time
+static double     t_tip, t_sens, t_load;
+static double     e_total = 0;          // [J] delivered to the tip
+static double     e_half = 0;           // [J] this half-cycle
+static double     w_last_half = 0;      // [W] average over the last half-cycle
+static bool       loaded = false;
+static sim_time_t load_end = 0;
+
+// an undriven pin floats to its inactive level (board pull-ups)
+static bool out_active(uint pin, bool active_level) {
+    return sim_gpio_is_output(pin) && (gpio_get_out_level(pin) == active_level);
+}
+
+static bool heater_gated(void) {
+    return out_active(HTR_CTRL_ON_L, HTR_CTL_ON) && !out_active(HTR_CTRL_OFF_L, HTR_CTL_ON);
+}
+
+// heater energy from x1 to x2 [usec] into the current half-cycle
+static double heater_energy(sim_time_t x1, sim_time_t x2) {
+    double w  = M_PI / (double)half_us;
+    double dt = (double)(x2 - x1) * 1e-6;
+    // integral of 2 * Prms * sin^2(w x)
+    return p_rms * (dt - (sin(2.0 * w * (double)x2) - sin(2.0 * w * (double)x1)) / (2.0 * w) * 1e-6);
+}
+
+// bring the thermal state forward to 't'
+static void plant_integrate(sim_time_t t) {
+    while (last_t < t) {
+        sim_time_t t2 = t;
+        double dt, p_tip, e = 0;
+        if (t2 - last_t > PLANT_STEP_US) {
+            t2 = last_t + PLANT_STEP_US;
+        }
+        dt = (double)(t2 - last_t) * 1e-6;
+        if (conducting) {
+            e = heater_energy(last_t - zc_time, t2 - zc_time);
+            e_half  += e;
+            e_total += e;
+        }
+        p_tip = e / dt - (t_tip - cfg.ambient_c) / cfg.tip_k_per_w;
+        if (loaded) {
+            double q = cfg.load_w_per_k * (t_tip - t_load);
+            p_tip -= q;
+            t_load += (q - (t_load - cfg.ambient_c) / LOAD_K_PER_W) / cfg.load_j_per_k * dt;
+        }
+        t_tip  += p_tip / cfg.tip_j_per_k * dt;
+        t_sens += (t_tip - t_sens) / cfg.sensor_tau_s * dt;
+        last_t = t2;
+    }
+}
+
+static sim_time_t plant_step_task(void * ctx, sim_time_t now) {
+    plant_integrate(now);
+    if (loaded && now >= load_end) {
+        loaded = false;
+    }
+    return now + PLANT_STEP_US;
+}
+
+static sim_time_t zc_task(void * ctx, sim_time_t now) {
+    plant_integrate(now);
+    w_last_half = e_half / ((double)half_us * 1e-6);
+    e_half     = 0;
+    conducting = false;
+    zc_time    = now;
+    zc_level   = !zc_level;
+    sim_gpio_drive(AC_ZC_INPUT, zc_level);  // ZC ISR runs here
+    conducting = heater_gated();
+    return now + half_us;
+}
+
+typedef struct sim_load_type {
+    sim_time_t duration;
+    int        slot;
+} sim_load_t;
+#define LOAD_MAX 8
+static sim_load_t loads[LOAD_MAX];
+static int        load_count = 0;
+
+static sim_time_t load_task(void * ctx, sim_time_t now) {
+    sim_load_t * ld = (sim_load_t *)ctx;
+    plant_integrate(now);
+    loaded   = true;
+    load_end = now + ld->duration;
+    t_load   = cfg.ambient_c;  // fresh joint
+    sim_task_remove(ld->slot);
+    return SIM_NEVER;
+}
+
+void sim_plant_load(sim_time_t start, sim_time_t duration) {
+    if (load_count < LOAD_MAX) {
+        sim_load_t * ld = &loads[load_count++];
+        ld->duration = duration;
+        ld->slot = sim_task_add(load_task, ld, start);
+    }
+}
+
+// iron put in the cradle and lifted again. Putting it down bounces the
+// detect contact a few times, lifting it is a clean edge.
+typedef struct sim_hook_type {
+    sim_time_t lift;        // time the iron is lifted
+    int        bounce;      // detect contact edges left to bounce
+    int        slot;
+} sim_hook_t;
+#define HOOK_MAX        8
+#define HOOK_BOUNCES    4
+#define HOOK_BOUNCE_US  SIM_MS(3)
+static sim_hook_t hooks[HOOK_MAX];
+static int        hook_count = 0;
+static bool       onhook = false;
+
+static sim_time_t hook_task(void * ctx, sim_time_t now) {
+    sim_hook_t * hk = (sim_hook_t *)ctx;
+    if (hk->bounce) {
+        hk->bounce --;
+        sim_gpio_drive(IRON_ONHOOK_DET_L, (hk->bounce & 1) ? IRON_OFFHOOK : IRON_ONHOOK);
+        onhook = true;
+        return hk->bounce ? now + HOOK_BOUNCE_US : hk->lift;
+    }
+    sim_gpio_drive(IRON_ONHOOK_DET_L, IRON_OFFHOOK);
+    onhook = false;
+    sim_task_remove(hk->slot);
+    return SIM_NEVER;
+}
+
+void sim_plant_hook(sim_time_t start, sim_time_t duration) {
+    if (hook_count < HOOK_MAX) {
+        sim_hook_t * hk = &hooks[hook_count++];
+        hk->lift = start + duration;
+        hk->bounce = HOOK_BOUNCES + 1;
+        hk->slot = sim_task_add(hook_task, hk, start);
+    }
+}
+
+// ***************************************************************************
+// tip thermocouple ADC
+// ***************************************************************************
+
+#define ADC_NOISE_LSB       3.0     /* rms */
+#define ADC_PICKUP_LSB      400.0   /* at the heater current peak */
+#define ADC_CONV_US         2
+
+static uint     adc_chan = 0;
+static uint64_t noise_state = 0x9E3779B97F4A7C15ull;
+
+static double noise_uniform(void) {
+    noise_state = noise_state * 6364136223846793005ull + 1442695040888963407ull;
+    return ((double)(noise_state >> 11) + 0.5) / 9007199254740992.0;
+}
+
+static double noise_gauss(void) {
+    return sqrt(-2.0 * log(noise_uniform())) * cos(2.0 * M_PI * noise_uniform());
+}
+
+// raw conversion of the thermocouple channel at the current time
+static uint16_t tip_adc_raw(void) {
+    double raw;
+    plant_integrate(sim_now());
+    raw = (t_sens - ADC_TEMP_CJ_DEGC) * 4096.0 / ADC_TEMP_FS_DEGC;
+    raw += ADC_NOISE_LSB * noise_gauss();
+    if (conducting) {
+        raw += ADC_PICKUP_LSB * fabs(sin(M_PI * (double)(sim_now() - zc_time) / (double)half_us));
+    }
+    if (raw < 0) raw = 0;
+    if (raw > 4095) raw = 4095;
+    return (uint16_t)raw;
+}
+
+// raw conversion of the heater line sense (rectified, divided) at the current time
+static uint16_t vline_adc_raw(void) {
+    double v = cfg.line_vrms * M_SQRT2 * fabs(sin(M_PI * (double)(sim_now() - zc_time) / (double)half_us));
+    double raw = v * 1000.0 * 4096.0 / ADC_VLINE_FS_MV + ADC_NOISE_LSB * noise_gauss();
+    if (raw < 0) raw = 0;
+    if (raw > 4095) raw = 4095;
+    return (uint16_t)raw;
+}
+
+static uint16_t adc_convert(void) {
+    if (adc_chan == ADC_VLINE_CHAN) {
+        return vline_adc_raw();
+    }
+    return (adc_chan == ADC_TEMP_CHAN) ? tip_adc_raw() : 0;
+}
+
+void adc_init(void)                 { }
+void adc_gpio_init(uint gpio)       { }
+void adc_select_input(uint input)   { adc_chan = input; }
+
+uint16_t adc_read(void) {
+    sim_advance(ADC_CONV_US);
+    return adc_convert();
+}
+
+// free-running conversions, FIFO and DREQ
+#define ADC_CLK_HZ          48000000.0
+#define ADC_CONV_CYCLES     96
+#define ADC_FIFO_DEPTH      4
+
+adc_hw_t sim_adc_hw;
+
+static struct {
+    bool       fifo_en;
+    bool       dreq_en;
+    double     period_us;
+    bool       running;
+    sim_time_t t0;          // first conversion of this run
+    uint64_t   n;           // conversions done this run
+    int        slot;
+    uint16_t   fifo[ADC_FIFO_DEPTH];
+    uint8_t    level;
+} adcr = { .period_us = ADC_CONV_CYCLES / (ADC_CLK_HZ / 1e6), .slot = -1 };
+
+static sim_time_t adc_run_task(void * ctx, sim_time_t now) {
+    uint16_t v;
+    if (!adcr.running) {
+        return SIM_NEVER;
+    }
+    v = adc_convert();
+    adcr.n ++;
+    if (adcr.fifo_en) {
+        if (!(adcr.dreq_en && sim_dma_dreq_write(DREQ_ADC, v)) && adcr.level < ADC_FIFO_DEPTH) {
+            adcr.fifo[adcr.level++] = v; // else overflow, dropped
+        }
+    }
+    return adcr.t0 + (sim_time_t)((double)adcr.n * adcr.period_us);
+}
+
+void adc_fifo_setup(bool en, bool dreq_en, uint16_t dreq_thresh, bool err_in_fifo, bool byte_shift) {
+    adcr.fifo_en = en;
+    adcr.dreq_en = dreq_en;
+}
+
+void adc_set_clkdiv(float clkdiv) {
+    double cycles = (clkdiv < ADC_CONV_CYCLES) ? ADC_CONV_CYCLES : (double)clkdiv + 1.0;
+    adcr.period_us = cycles / (ADC_CLK_HZ / 1e6);
+}
+
+void adc_run(bool run) {
+    if (run && !adcr.running) {
+        adcr.t0 = sim_now() + (sim_time_t)adcr.period_us;
+        adcr.n  = 0;
+        if (adcr.slot < 0) {
+            adcr.slot = sim_task_add(adc_run_task, NULL, adcr.t0);
+        } else {
+            sim_task_due(adcr.slot, adcr.t0);
+        }
+    }
+    adcr.running = run;
+}
+
+uint8_t adc_fifo_get_level(void) {
+    return adcr.level;
+}
+
+void adc_fifo_drain(void) {
+    adcr.level = 0;
+}
+
+// ***************************************************************************
+// analog PSU
+// ***************************************************************************
+
+#define PSU_CHG_V_PER_MS    2.0     /* charge slope, MOSFET on */
+#define PSU_LOAD_V_PER_MS   0.05    /* discharge slope, regulator load */
+#define PSU_TH_HI           16.0    /* comparator reports CHG_OVER above */
+#define PSU_TH_LO           15.9    /* ... and CHG_UNDER again below */
+
+typedef struct sim_psu_type {
+    uint       on_pin;
+    uint       state_pin;
+    double     v;
+    double     slope;       // [V/usec] in effect since 't'
+    sim_time_t t;
+    bool       over;
+    int        slot;
+    bool       regulating;  // reached threshold at least once
+    double     vmin, vmax;  // ripple seen while regulating
+} sim_psu_t;
+
+static sim_psu_t psu[2] = {
+    { .on_pin = APSU_P16V_ON_L, .state_pin = APSU_P16V_CHARGE_STATE, .slot = -1 },
+    { .on_pin = APSU_N16V_ON_L, .state_pin = APSU_N16V_CHARGE_STATE, .slot = -1 },
+};
+
+static double psu_slope(sim_psu_t * p) {
+    double s = -PSU_LOAD_V_PER_MS;
+    if (out_active(p->on_pin, APSU_X16V_ENABLE)) {
+        s += PSU_CHG_V_PER_MS;
+    }
+    return s / 1000.0; // per usec
+}
+
+// advance the rail voltage to 'now', update the comparator and
+// schedule the next threshold crossing
+static void psu_update(sim_psu_t * p, sim_time_t now) {
+    double s;
+    sim_time_t next = SIM_NEVER;
+    p->v += p->slope * (double)(now - p->t);
+    if (p->v < 0) p->v = 0;
+    p->t = now;
+    if (p->regulating) {
+        if (p->v < p->vmin) p->vmin = p->v;
+        if (p->v > p->vmax) p->vmax = p->v;
+    }
+    if (!p->over && p->v >= PSU_TH_HI) {
+        p->over = true;
+        if (!p->regulating) {
+            p->regulating = true;
+            p->vmin = p->vmax = p->v;
+        }
+        sim_gpio_drive(p->state_pin, APSU_X16V_CHG_OVER);
+    } else if (p->over && p->v <= PSU_TH_LO) {
+        p->over = false;
+        sim_gpio_drive(p->state_pin, APSU_X16V_CHG_UNDER);
+    }
+    s = psu_slope(p); // after any ISR has switched the MOSFET
+    p->slope = s;
+    if (!p->over && s > 0) {
+        next = now + 1 + (sim_time_t)((PSU_TH_HI - p->v) / s);
+    } else if (p->over && s < 0) {
+        next = now + 1 + (sim_time_t)((p->v - PSU_TH_LO) / -s);
+    }
+    sim_task_due(p->slot, next);
+}
+
+static sim_time_t psu_task(void * ctx, sim_time_t now) {
+    psu_update((sim_psu_t *)ctx, now);
+    return SIM_NEVER; // psu_update() re-arms the slot
+}
+
+// returns false if the rail never reached regulation
+bool sim_plant_psu_ripple(int rail, double * vmin, double * vmax) {
+    if (rail < 0 || rail > 1 || !psu[rail].regulating) {
+        return false;
+    }
+    psu_update(&psu[rail], sim_now());
+    *vmin = psu[rail].vmin;
+    *vmax = psu[rail].vmax;
+    return true;
+}
+
+// ***************************************************************************
+// output pin hook
+// ***************************************************************************
+
+static void plant_gpio_out(uint pin, bool level) {
+    sim_time_t now = sim_now();
+    int i;
+    if (pin == HTR_CTRL_ON_L || pin == HTR_CTRL_OFF_L) {
+        plant_integrate(now);
+        if (!conducting && heater_gated()) {
+            conducting = true; // gated late in the half-cycle
+        }
+    }
+    for (i = 0 ; i < 2 ; i++) {
+        if (pin == psu[i].on_pin && psu[i].slot >= 0) {
+            psu_update(&psu[i], now);
+        }
+    }
+}
+
+// ***************************************************************************
+// public
+// ***************************************************************************
+
+void sim_plant_defaults(sim_plant_cfg_t * c) {
+    c->mains_hz     = 50.0;
+    c->line_vrms    = 24.0;
+    c->htr_ohms     = 2.88;     /* 200 W at 24 Vrms */
+    c->ambient_c    = 25.0;
+    c->tip_j_per_k  = 3.0;
+    c->tip_k_per_w  = 16.0;     /* ~20 W idle at 350 C */
+    c->sensor_tau_s = 0.05;
+    c->load_j_per_k = 20.0;
+    c->load_w_per_k = 1.0;
+}
+
+void sim_plant_init(const sim_plant_cfg_t * c) {
+    int i;
+    cfg     = *c;
+    half_us = (sim_time_t)(1e6 / (2.0 * cfg.mains_hz) + 0.5);
+    p_rms   = cfg.line_vrms * cfg.line_vrms / cfg.htr_ohms;
+    t_tip   = t_sens = t_load = cfg.ambient_c;
+    last_t  = sim_now();
+    sim_gpio_add_out_hook(plant_gpio_out);
+    // idle levels of the inputs the firmware reads
+    sim_gpio_drive(IRON_ONHOOK_DET_L, IRON_OFFHOOK);
+    for (i = 0 ; i < 2 ; i++) {
+        psu[i].t = sim_now();
+        sim_gpio_drive(psu[i].state_pin, APSU_X16V_CHG_UNDER);
+        psu[i].slot = sim_task_add(psu_task, &psu[i], SIM_NEVER);
+        psu_update(&psu[i], sim_now());
+    }
+    sim_task_add(zc_task, NULL, sim_now() + half_us);
+    sim_task_add(plant_step_task, NULL, sim_now() + PLANT_STEP_US);
+}
+
+double sim_plant_tip_c(void)    { return t_tip; }
+double sim_plant_sensor_c(void) { return t_sens; }
+double sim_plant_heater_w(void) { return w_last_half; }
+double sim_plant_energy_j(void) { return e_total; }
+bool   sim_plant_loaded(void)   { return loaded; }
+bool   sim_plant_onhook(void)   { return onhook; }
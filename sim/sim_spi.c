@@ -0,0 +1,120 @@
+/******************************************************************************
+ * Host Simulation - SPI
+ *
+ * spi0 transmit, wired to the simulated SSD1309 panel (sim_gfx.c). Blocking
+ * writes cost (len * 8 / baudrate) of virtual time, DMA writes are shifted
+ * out one byte per byte time. Kept apart from the graphics driver stand-in
+ * so its writes are calls into another object, which the firmware link
+ * wraps (--wrap=spi_write_blocking, disp_panel.c) as on the target.
+ *
+ */
+
+#include <sim.h>
+#include <board.h>
+#include <hardware/spi.h>
+#include <hardware/gpio.h>
+#include <math.h>
+
+static uint64_t   spi_bytes = 0;
+static uint64_t   spi_busy_us = 0;
+static double     spi_busy_dma_us = 0;
+
+spi_inst_t sim_spi[2] = { { 0, 0, false }, { 1, 0, false } };
+spi_hw_t   sim_spi_hw[2];
+
+static sim_time_t spi0_busy_until = 0;  // last byte shifted out
+static int        spi0_tx_slot = -1;    // DMA fed shifter
+static sim_time_t spi0_tx_t0;
+static uint64_t   spi0_tx_n;
+
+static void spi0_tx_kick(void);
+
+uint spi_init(spi_inst_t * spi, uint baudrate) {
+    spi->enabled = true;
+    if (spi->index == 0) {
+        sim_dma_set_kick(DREQ_SPI0_TX, spi0_tx_kick);
+    }
+    return spi_set_baudrate(spi, baudrate);
+}
+
+void spi_deinit(spi_inst_t * spi) {
+    spi->enabled = false;
+}
+
+// the PL022 clock is clk_peri (125 MHz) / even prescale / (1 + postdiv)
+uint spi_set_baudrate(spi_inst_t * spi, uint baudrate) {
+    const uint32_t clk = 125000000u;
+    uint32_t pre, post;
+    for (pre = 2 ; pre <= 254 ; pre += 2) {
+        if ((uint64_t)clk < (uint64_t)(pre + 2) * 256 * baudrate) break;
+    }
+    for (post = 256 ; post > 1 ; post--) {
+        if (clk / (pre * (post - 1)) > baudrate) break;
+    }
+    spi->baudrate = clk / (pre * post);
+    return spi->baudrate;
+}
+
+uint spi_get_baudrate(const spi_inst_t * spi) {
+    return spi->baudrate;
+}
+
+static double spi_byte_us(const spi_inst_t * spi) {
+    uint32_t baud = spi->baudrate ? spi->baudrate : DISP_DRVR_SPI_CLK_FREQ_HZ;
+    return 8e6 / (double)baud;
+}
+
+static sim_time_t spi_time_us(const spi_inst_t * spi, size_t len) {
+    return (sim_time_t)ceil((double)len * spi_byte_us(spi));
+}
+
+int spi_write_blocking(spi_inst_t * spi, const uint8_t * src, size_t len) {
+    sim_time_t us = spi_time_us(spi, len);
+    spi_bytes   += len;
+    spi_busy_us += us;
+    sim_advance(us);
+    if (spi->index == 0) {
+        spi0_busy_until = sim_now();
+        sim_panel_rx(src, len);
+    }
+    return (int)len;
+}
+
+bool spi_is_busy(const spi_inst_t * spi) {
+    return (spi->index == 0) && sim_now() < spi0_busy_until;
+}
+
+bool spi_is_readable(const spi_inst_t * spi) {
+    return false;
+}
+
+// shifter fed by DMA, one byte per byte time
+static sim_time_t spi0_tx_task(void * ctx, sim_time_t now) {
+    uint32_t v;
+    uint8_t b;
+    if (!sim_dma_dreq_read_begin(DREQ_SPI0_TX, &v)) {
+        return SIM_NEVER; // idle until the next kick
+    }
+    b = (uint8_t)v;
+    spi0_tx_n ++;
+    spi0_busy_until = spi0_tx_t0 + (sim_time_t)ceil((double)spi0_tx_n * spi_byte_us(spi0));
+    spi_bytes ++;
+    spi_busy_dma_us += spi_byte_us(spi0);
+    sim_panel_rx(&b, 1);
+    // the completion ISR may already switch DC for the next window
+    sim_dma_dreq_read_end(DREQ_SPI0_TX);
+    return spi0_busy_until;
+}
+
+static void spi0_tx_kick(void) {
+    if (spi0_tx_slot < 0) {
+        spi0_tx_slot = sim_task_add(spi0_tx_task, NULL, SIM_NEVER);
+    }
+    // continue back to back if still shifting, else start now
+    spi0_tx_t0 = (spi0_busy_until > sim_now()) ? spi0_busy_until : sim_now();
+    spi0_tx_n  = 0;
+    sim_task_due(spi0_tx_slot, spi0_tx_t0);
+}
+
+uint64_t sim_spi_bytes(void)    { return spi_bytes; }
+uint64_t sim_spi_busy_us(void)  { return spi_busy_us + (uint64_t)spi_busy_dma_us; }
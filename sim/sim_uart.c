@@ -0,0 +1,244 @@
+/******************************************************************************
+ * Host Simulation - UART / telemetry receiver
+ *
+ * uart0 transmit shifter, one byte per 10 bit times, fed by DMA or by
+ * blocking writes. What comes out is the firmware's telemetry stream
+ * (telemetry_rec.h):
+ *
+ *  - kept raw in a capture file (--tlm), for the host decoder
+ *  - decoded here (tools/tlm_decode.c); log and PSU records are printed as
+ *    text, so the console reads as it did with printf
+ *  - counted per type, with sequence gaps, for the report
+ *
+ * and the uart0 receiver: scripted command lines (--cmd) arrive one byte
+ * per byte time into the receive FIFO, each byte raises UART0_IRQ when the
+ * receive interrupt is on. Command acks are timed from the end of their
+ * line.
+ *
+ */
+
+#include <sim.h>
+#include <hardware/uart.h>
+#include <hardware/irq.h>
+#include <tlm_decode.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+uart_inst_t sim_uart[2] = { { .index = 0 }, { .index = 1 } };
+uart_hw_t   sim_uart_hw[2];
+
+static sim_time_t uart0_busy_until = 0;
+static sim_time_t uart0_busy_us = 0;
+static int        uart0_tx_slot = -1;
+static FILE *     capture = NULL;
+
+static tlm_dec_t  rx;
+
+#define RX_FIFO_LEN     32
+#define TX_SCRIPT_MAX   16
+#define ACK_LINES       64
+
+typedef struct sim_uart_script_type {
+    char *     text;
+    size_t     pos;
+    int        slot;
+} sim_uart_script_t;
+
+static uint8_t    rx_fifo[RX_FIFO_LEN];
+static uint32_t   rx_fifo_head = 0, rx_fifo_tail = 0;
+static bool       rx_irq_on = false;
+static uint32_t   rx_overruns = 0;
+static sim_uart_script_t scripts[TX_SCRIPT_MAX];
+static int        script_count = 0;
+static uint32_t   lines_sent = 0;
+static sim_time_t line_end[ACK_LINES];  // by line number
+static uint32_t   acks = 0, acks_failed = 0;
+static sim_time_t ack_max_us = 0;
+
+static double byte_us(const uart_inst_t * uart) {
+    return uart->baudrate ? 10.0 * 1e6 / (double)uart->baudrate : 0.0;
+}
+
+static void rx_record(const tlm_rec_t * r, uint64_t t_us, void * ctx) {
+    char text[160];
+    switch (r->type) {
+    case TLM_REC_LOG:
+        tlm_log_text(&r->u.log, text, sizeof(text));
+        printf("%s\n", text);
+        break;
+    case TLM_REC_ACK:
+        acks ++;
+        if (r->u.ack.failed) {
+            acks_failed ++;
+        }
+        if (r->u.ack.line >= 1 && r->u.ack.line <= lines_sent && lines_sent - r->u.ack.line < ACK_LINES) {
+            sim_time_t lat = sim_now() - line_end[r->u.ack.line % ACK_LINES];
+            if (lat > ack_max_us) {
+                ack_max_us = lat;
+            }
+            printf("[cmd] line %u: %u done", r->u.ack.line, r->u.ack.done);
+            if (r->u.ack.failed) {
+                printf(", #%u failed (%s)", r->u.ack.failed, tlm_cmd_err_name(r->u.ack.error));
+            }
+            printf(", run %lu us, acked %.3f ms after the line\n", (unsigned long)r->u.ack.exec_us, (double)lat * 1e-3);
+        }
+        break;
+    case TLM_REC_STATE:
+        printf("[cmd] state: set %u %c, tip %d, %u W, preset '%c', %s, standby %u, sleep delay %u s, fault %u, psu fault %u\n",
+            r->u.state.setpoint, r->u.state.scale, r->u.state.tip, r->u.state.power, r->u.state.preset,
+            r->u.state.wake ? "woken" : "asleep", r->u.state.sby, r->u.state.sleep_dly, r->u.state.fault,
+            r->u.state.psu_fault);
+        break;
+    case TLM_REC_PRESETS:
+        printf("[cmd] presets: A %u, B %u, C %u, D %u %c (0 := unset), tuned 0x%x\n", r->u.presets.temp[0],
+            r->u.presets.temp[1], r->u.presets.temp[2], r->u.presets.temp[3], r->u.presets.scale, r->u.presets.tuned);
+        break;
+    case TLM_REC_PSU:
+        printf("[Analog PSU VMon] %c16V discharge fault! @ %lu ms, %lu cycles, max over %lu us\n",
+            r->u.psu.rail ? '-' : '+', (unsigned long)r->u.psu.fault_ms,
+            (unsigned long)r->u.psu.cycles, (unsigned long)r->u.psu.max_over_us);
+        break;
+    default:
+        break;
+    }
+}
+
+// one byte off the wire
+static void rx_byte(uint8_t b) {
+    if (capture) {
+        fputc(b, capture);
+    }
+    tlm_dec_byte(&rx, b);
+}
+
+// shifter fed by DMA, one byte per byte time
+static sim_time_t uart0_tx_task(void * ctx, sim_time_t now) {
+    uint32_t v;
+    if (!sim_dma_dreq_read_begin(DREQ_UART0_TX, &v)) {
+        return SIM_NEVER; // idle until the next kick
+    }
+    uart0_busy_until = now + (sim_time_t)ceil(byte_us(uart0));
+    uart0_busy_us += uart0_busy_until - now;
+    rx_byte((uint8_t)v);
+    sim_dma_dreq_read_end(DREQ_UART0_TX);
+    return uart0_busy_until;
+}
+
+static void uart0_tx_kick(void) {
+    if (uart0_tx_slot < 0) {
+        uart0_tx_slot = sim_task_add(uart0_tx_task, NULL, SIM_NEVER);
+    }
+    sim_task_due(uart0_tx_slot, (uart0_busy_until > sim_now()) ? uart0_busy_until : sim_now());
+}
+
+uint uart_init(uart_inst_t * uart, uint baudrate) {
+    uart->baudrate = baudrate;
+    uart->enabled = true;
+    if (uart->index == 0) {
+        tlm_dec_init(&rx, rx_record, NULL);
+        sim_dma_set_kick(DREQ_UART0_TX, uart0_tx_kick);
+    }
+    return baudrate;
+}
+
+void uart_deinit(uart_inst_t * uart) {
+    uart->enabled = false;
+}
+
+void uart_write_blocking(uart_inst_t * uart, const uint8_t * src, size_t len) {
+    sim_time_t us = (sim_time_t)ceil((double)len * byte_us(uart));
+    sim_advance(us);
+    if (uart->index == 0) {
+        uart0_busy_us += us;
+        while (len--) {
+            rx_byte(*src++);
+        }
+    }
+}
+
+// ---- receiver ----
+
+static sim_time_t rx_task(void * ctx, sim_time_t now) {
+    sim_uart_script_t * s = ctx;
+    uint8_t b = (uint8_t)s->text[s->pos++];
+    if (rx_fifo_head - rx_fifo_tail < RX_FIFO_LEN) {
+        rx_fifo[rx_fifo_head++ % RX_FIFO_LEN] = b;
+    } else {
+        rx_overruns ++;
+    }
+    if (b == '\n') {
+        lines_sent ++;
+        line_end[lines_sent % ACK_LINES] = now;
+    }
+    if (rx_irq_on) {
+        sim_irq_raise(UART0_IRQ);
+    }
+    if (!s->text[s->pos]) {
+        return SIM_NEVER;
+    }
+    return now + (sim_time_t)ceil(byte_us(uart0));
+}
+
+int sim_uart_send(sim_time_t t, const char * text) {
+    sim_uart_script_t * s;
+    size_t n = strlen(text);
+    if (script_count == TX_SCRIPT_MAX || !n) {
+        return 1;
+    }
+    s = &scripts[script_count++];
+    s->text = malloc(n + 2);
+    if (!s->text) {
+        return 1;
+    }
+    memcpy(s->text, text, n);
+    s->text[n] = '\n';
+    s->text[n + 1] = '\0';
+    s->pos = 0;
+    s->slot = sim_task_add(rx_task, s, t);
+    return 0;
+}
+
+bool uart_is_readable(uart_inst_t * uart) {
+    return uart->index == 0 && rx_fifo_head != rx_fifo_tail;
+}
+
+char uart_getc(uart_inst_t * uart) {
+    if (!uart_is_readable(uart)) {
+        return 0;
+    }
+    return (char)rx_fifo[rx_fifo_tail++ % RX_FIFO_LEN];
+}
+
+void uart_set_irq_enables(uart_inst_t * uart, bool rx_has_data, bool tx_needs_data) {
+    if (uart->index == 0) {
+        rx_irq_on = rx_has_data;
+    }
+}
+
+int sim_uart_capture(const char * path) {
+    capture = fopen(path, "wb");
+    return capture ? 0 : 1;
+}
+
+void sim_uart_close(void) {
+    if (capture) {
+        fclose(capture);
+        capture = NULL;
+    }
+}
+
+void sim_uart_stats(sim_uart_stats_t * s) {
+    memset(s, 0, sizeof(*s));
+    s->bytes = rx.st.bytes;
+    s->records = rx.st.records;
+    s->samples = rx.st.per_type[TLM_REC_SAMPLE];
+    s->keys = rx.st.per_type[TLM_REC_KEY];
+    s->logs = rx.st.per_type[TLM_REC_LOG];
+    s->lost = rx.st.lost;
+    s->bad = rx.st.bad;
+    s->busy_us = uart0_busy_us;
+    s->acks = acks;
+    s->acks_failed = acks_failed;
+    s->ack_max_us = ack_max_us;
+}
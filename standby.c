@@ -0,0 +1,135 @@
+/******************************************************************************
+ * Cradle-Aware Standby
+ *
+ *            on-hook for IRON_ONHOOK_DEB_US        get_sleepDelay() [sec]
+ *   ACTIVE -----------------------------> STANDBY -----------------------> SLEEP
+ *     ^                                      |                               |
+ *     +-------------- off-hook edge ---------+-------------------------------+
+ *
+ * Putting the iron down is debounced (it rattles into the cradle), one timer
+ * task confirms the on-hook level and is then re-started as the sleep timer.
+ * The sleep timer re-reads the delay setting at least every
+ * IRON_SLEEP_CHECK_US, so a change made in STANDBY applies to the time
+ * already spent there. A sleep delay of 0 goes straight to SLEEP.
+ *
+ * Only an edge that reads off-hook stops the timer: a bounce or glitch
+ * that still reads on-hook leaves the debounce / sleep timer running.
+ *
+ * Lifting the iron is acted on in the edge ISR itself: the state is back to
+ * ACTIVE before the next mains half-cycle and the temperature controller
+ * is asked for a wake boost (tc_wake_boost()), which drives the heater flat
+ * out instead of ramping the setpoint.
+ *
+ * The controller reads the state on every half-cycle (STANDBY caps its
+ * setpoint, SLEEP zeroes it). Every change posts EV_STBY for the screen.
+ *
+ * Runs on core1 with the controller; the sleep delay is the main loop's
+ * setting as handed over in rt_ctl_t.
+ *
+ */
+
+#include <standby.h>
+#include <rt_core.h>
+#include <temp_ctrl.h>
+#include <board.h>
+#include <events.h>
+#include <timer_wheel.h>
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/timer.h"
+
+static volatile int      sby_state = SBY_ACTIVE;
+static int               sby_tw = -1;           // on-hook debounce, then the sleep timer
+static volatile uint32_t sby_wakes = 0;
+static uint64_t          sby_t0;                // STANDBY entered [usec]
+
+static void sby_set(int state) {
+    sby_state = state;
+    ev_post(EV_STBY);
+}
+
+// STANDBY: SLEEP once the sleep delay (as set now) is up, else look again
+// when it is, or in IRON_SLEEP_CHECK_US if sooner
+static void sby_sleep_check(void) {
+    uint64_t delay = (uint64_t)rt_ctl()->sleep_delay_s * 1000000;
+    uint64_t in = time_us_64() - sby_t0;
+    if (in >= delay) {
+        sby_set(SBY_SLEEP);
+        return;
+    }
+    delay -= in;
+    tw_start_once(sby_tw, (delay < IRON_SLEEP_CHECK_US) ? delay : IRON_SLEEP_CHECK_US);
+}
+
+// on-hook confirmed -> STANDBY, sleep delay elapsed -> SLEEP
+static void sby_timer_cb(void * ctx) {
+    if (sby_state == SBY_ACTIVE) {
+        if (gpio_get(IRON_ONHOOK_DET_L) != IRON_ONHOOK) {
+            return; // lifted again, edge ISR missed (should not happen)
+        }
+        sby_t0 = time_us_64();
+        sby_set(SBY_STANDBY);
+    }
+    if (sby_state == SBY_STANDBY) {
+        sby_sleep_check(); // re-started as the sleep timer
+    }
+}
+
+/* ISR Routine - cradle detect, both edges */
+static void sby_hook_isr(void) {
+    uint32_t ev = gpio_get_irq_event_mask(IRON_ONHOOK_DET_L) & (GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL);
+    if (!ev) {
+        return;
+    }
+    gpio_acknowledge_irq(IRON_ONHOOK_DET_L, ev);
+    if (gpio_get(IRON_ONHOOK_DET_L) == IRON_OFFHOOK) {
+        tw_stop(sby_tw);
+        if (sby_state != SBY_ACTIVE) {
+            sby_wakes ++;
+            tc_wake_boost();
+            sby_set(SBY_ACTIVE);
+        }
+    } else if (sby_state == SBY_ACTIVE) {
+        tw_start_once(sby_tw, IRON_ONHOOK_DEB_US); // (re)start the debounce
+    }
+    // on-hook in STANDBY / SLEEP (bounce, glitch): the sleep timer runs on
+}
+
+// Setup the cradle detect input and its edge ISR.
+int sby_init(void) {
+    gpio_init(IRON_ONHOOK_DET_L);
+    gpio_set_dir(IRON_ONHOOK_DET_L, GPIO_IN);
+#if (IRON_ONHOOK_DET_USE_PU==1)
+    gpio_pull_up(IRON_ONHOOK_DET_L);
+#elif (IRON_ONHOOK_DET_USE_PD==1)
+    gpio_pull_down(IRON_ONHOOK_DET_L);
+#else
+    gpio_disable_pulls(IRON_ONHOOK_DET_L);
+#endif
+    sby_state = SBY_ACTIVE;
+    sby_tw = tw_add(sby_timer_cb, NULL, TW_PRIO_NORMAL);
+    // raw handler, the shared GPIO callback (analog PSU) is left alone
+    gpio_add_raw_irq_handler(IRON_ONHOOK_DET_L, sby_hook_isr);
+    gpio_set_irq_enabled(IRON_ONHOOK_DET_L, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+    if (gpio_get(IRON_ONHOOK_DET_L) == IRON_ONHOOK) {
+        // powered up with the iron in the cradle
+        tw_start_once(sby_tw, IRON_ONHOOK_DEB_US);
+    }
+    return 0;
+}
+
+// current state, SBY_xxx
+int sby_get_state(void) {
+    return sby_state;
+}
+
+// true while the iron is in the cradle (debounced)
+bool sby_is_onhook(void) {
+    return sby_state != SBY_ACTIVE;
+}
+
+// number of wakes from STANDBY / SLEEP (iron lifted)
+uint32_t sby_get_wakes(void) {
+    return sby_wakes;
+}
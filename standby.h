@@ -0,0 +1,36 @@
+/******************************************************************************
+ * Cradle-Aware Standby
+ *
+ * Follows the iron in and out of its cradle (IRON_ONHOOK_DET_L). Put down,
+ * the tip drops to IRON_STANDBY_TEMP_C; left there for get_sleepDelay()
+ * seconds the heater is turned off. Lifting the iron wakes it at once, with
+ * a boost back to the working temperature. A sleep delay changed while in
+ * STANDBY counts from when the iron was put down, and takes effect within
+ * IRON_SLEEP_CHECK_US.
+ *
+ */
+
+#ifndef _STANDBY_H_
+#define _STANDBY_H_
+
+#include "pico/stdlib.h"
+
+// states
+#define SBY_ACTIVE      0   /* off-hook, working temperature */
+#define SBY_STANDBY     1   /* on-hook, setpoint capped to IRON_STANDBY_TEMP_C */
+#define SBY_SLEEP       2   /* on-hook for the sleep delay, heater off */
+
+// Setup the cradle detect input and its edge ISR, the state follows the
+// iron from here on. Call after tc_init().
+int sby_init(void);
+
+// current state, SBY_xxx
+int sby_get_state(void);
+
+// true while the iron is in the cradle (debounced)
+bool sby_is_onhook(void);
+
+// number of wakes from STANDBY / SLEEP (iron lifted)
+uint32_t sby_get_wakes(void);
+
+#endif /* _STANDBY_H_ */
@@ -0,0 +1,245 @@
+/******************************************************************************
+ * Telemetry
+ *
+ * Ring of TLM_RING_RECS records, whole records only (a record never wraps):
+ *
+ *   tail .. tail+inflight   on the wire (DMA)
+ *   .. head                 queued
+ *
+ * A producer takes the ring lock (a hardware spin lock, local interrupts
+ * masked, as for the main loop events) only to claim the head slot, fill it
+ * and start the DMA if it is idle: a few hundred cycles, no waiting on the
+ * UART. The DMA completion ISR frees the records just sent and starts the
+ * next run, up to the end of the ring (the rest goes in the next run).
+ *
+ * The UART is only ever written by the DMA; stdio is not on the UART.
+ *
+ * Core1 does not take the ring lock: its records go into a single producer
+ * / single consumer ring of TLM_CORE1_RECS (core1's interrupts masked while
+ * one is written, so its ISRs can share it), time-stamped there, and the
+ * main loop moves them into the ring on EV_TLM. Records core1 drops there
+ * come out as a gap in the sequence numbers all the same.
+ *
+ */
+
+#include <telemetry.h>
+#include <events.h>
+#include <board.h>
+#include <version.h>
+#include "hardware/uart.h"
+#include "hardware/gpio.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/clocks.h"
+#include <string.h>
+
+#define TLM_DMA_IRQ     DMA_IRQ_0
+
+static tlm_rec_t     tlm_ring[TLM_RING_RECS];
+static spin_lock_t * tlm_lock = NULL;
+static int           tlm_dma = -1;
+static uint32_t      tlm_head = 0;      // next free record
+static uint32_t      tlm_tail = 0;      // oldest record not yet sent
+static uint32_t      tlm_used = 0;      // records queued or in flight
+static uint32_t      tlm_inflight = 0;  // records in the current DMA run
+static uint8_t       tlm_seq = 0;
+static volatile uint32_t tlm_drops = 0;
+
+// core1 -> main loop
+typedef struct tlm_c1_rec_type {
+    uint32_t t_us;
+    uint8_t  type;
+    uint8_t  payload[TLM_PAYLOAD_LEN];
+} tlm_c1_rec_t;
+
+static tlm_c1_rec_t      tlm_c1[TLM_CORE1_RECS];
+static volatile uint32_t tlm_c1_head = 0;   // written by core1 only
+static volatile uint32_t tlm_c1_tail = 0;   // written by core0 only
+static volatile uint32_t tlm_c1_drops = 0;  // core1
+static uint32_t          tlm_c1_gaps = 0;   // core1 drops shown in the sequence
+
+static const uint8_t crc8_tbl[16] = {
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15,
+    0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D
+};
+
+static uint8_t rec_crc(const tlm_rec_t * r) {
+    const uint8_t * p = (const uint8_t *)r;
+    uint8_t crc = 0;
+    int i;
+    for (i = 0 ; i < TLM_REC_LEN ; i++) {
+        if (i != TLM_CRC_OFS) {
+            crc = (uint8_t)((crc << 4) ^ crc8_tbl[(crc >> 4) ^ (p[i] >> 4)]);
+            crc = (uint8_t)((crc << 4) ^ crc8_tbl[(crc >> 4) ^ (p[i] & 0x0F)]);
+        }
+    }
+    return crc;
+}
+
+// start sending the queued records, up to the end of the ring. Lock held.
+static void tlm_start(void) {
+    uint32_t n = tlm_used;
+    if (tlm_inflight || !n) {
+        return;
+    }
+    if (n > TLM_RING_RECS - tlm_tail) {
+        n = TLM_RING_RECS - tlm_tail;
+    }
+    tlm_inflight = n;
+    dma_channel_transfer_from_buffer_now(tlm_dma, &tlm_ring[tlm_tail], n * TLM_REC_LEN);
+}
+
+/* ISR Routine - telemetry DMA run complete */
+static void tlm_dma_isr(void) {
+    uint32_t irq;
+    if (dma_channel_get_irq0_status(tlm_dma)) {
+        dma_channel_acknowledge_irq0(tlm_dma);
+        irq = spin_lock_blocking(tlm_lock);
+        tlm_tail = (tlm_tail + tlm_inflight) % TLM_RING_RECS;
+        tlm_used -= tlm_inflight;
+        tlm_inflight = 0;
+        tlm_start();
+        spin_unlock(tlm_lock, irq);
+    }
+}
+
+// Setup the UART, its DMA channel and the ring
+int tlm_init(void) {
+    dma_channel_config c;
+    tlm_hello_t h;
+    if (tlm_lock) {
+        return 1;
+    }
+    uart_init(TLM_UART, TLM_UART_BAUD);
+    gpio_set_function(TLM_UART_TX, GPIO_FUNC_UART);
+    gpio_set_function(TLM_UART_RX, GPIO_FUNC_UART);
+    // byte DMA into the UART TX FIFO, paced by its DREQ
+    tlm_dma = dma_claim_unused_channel(true);
+    c = dma_channel_get_default_config(tlm_dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, uart_get_dreq(TLM_UART, true));
+    dma_channel_configure(tlm_dma, &c, &uart_get_hw(TLM_UART)->dr, NULL, 0, false);
+    dma_channel_set_irq0_enabled(tlm_dma, true);
+    irq_set_exclusive_handler(TLM_DMA_IRQ, tlm_dma_isr);
+    irq_set_enabled(TLM_DMA_IRQ, true);
+    tlm_lock = spin_lock_init(spin_lock_claim_unused(true));
+    memset(&h, 0, sizeof(h));
+    h.ver_maj = P_VER_MAJ;
+    h.ver_min = P_VER_MIN;
+    h.ver_rev = P_VER_REV;
+    h.rec_len = TLM_REC_LEN;
+    h.baud = TLM_UART_BAUD;
+    h.log_ids = TLM_LOG_COUNT;
+    h.sys_khz = clock_get_hz(clk_sys) / 1000;
+    return tlm_put(TLM_REC_HELLO, &h);
+}
+
+// queue a record stamped 't_us' (core0)
+static int tlm_queue(uint8_t type, const void * payload, uint32_t t_us) {
+    uint32_t irq;
+    tlm_rec_t * r;
+    irq = spin_lock_blocking(tlm_lock);
+    if (tlm_used == TLM_RING_RECS) {
+        tlm_drops ++;
+        tlm_seq ++; // the gap shows on the host
+        spin_unlock(tlm_lock, irq);
+        return 1;
+    }
+    r = &tlm_ring[tlm_head];
+    r->sync = TLM_SYNC;
+    r->type = type;
+    r->seq = tlm_seq ++;
+    r->t_us = t_us;
+    memcpy(r->u.raw, payload, TLM_PAYLOAD_LEN);
+    r->crc = rec_crc(r);
+    tlm_head = (tlm_head + 1) % TLM_RING_RECS;
+    tlm_used ++;
+    tlm_start();
+    spin_unlock(tlm_lock, irq);
+    return 0;
+}
+
+// core1: hand the record over to the main loop
+static int tlm_put_core1(uint8_t type, const void * payload) {
+    tlm_c1_rec_t * x;
+    uint32_t irq = save_and_disable_interrupts();
+    uint32_t head = tlm_c1_head;
+    if (head - tlm_c1_tail == TLM_CORE1_RECS) {
+        tlm_c1_drops ++;
+        restore_interrupts(irq);
+        return 1;
+    }
+    x = &tlm_c1[head % TLM_CORE1_RECS];
+    x->t_us = time_us_32();
+    x->type = type;
+    memcpy(x->payload, payload, TLM_PAYLOAD_LEN);
+    __dmb(); // the record before the head that publishes it
+    tlm_c1_head = head + 1;
+    restore_interrupts(irq);
+    ev_post(EV_TLM);
+    return 0;
+}
+
+// Send a record, ISR safe, either core
+int tlm_put(uint8_t type, const void * payload) {
+    if (!tlm_lock) {
+        return 1;
+    }
+    if (get_core_num() != 0) {
+        return tlm_put_core1(type, payload);
+    }
+    return tlm_queue(type, payload, time_us_32());
+}
+
+// Main loop: queue the records handed over by core1
+int tlm_poll(void) {
+    tlm_c1_rec_t * x;
+    uint32_t irq, gaps, tail = tlm_c1_tail;
+    int n = 0;
+    if (!tlm_lock) {
+        return 0;
+    }
+    while (tail != tlm_c1_head) {
+        __dmb(); // the head before the record it publishes
+        x = &tlm_c1[tail % TLM_CORE1_RECS];
+        tlm_queue(x->type, x->payload, x->t_us);
+        __dmb(); // done with the slot before core1 may reuse it
+        tlm_c1_tail = ++tail;
+        n ++;
+    }
+    gaps = tlm_c1_drops - tlm_c1_gaps;
+    if (gaps) {
+        tlm_c1_gaps += gaps;
+        irq = spin_lock_blocking(tlm_lock);
+        tlm_seq += (uint8_t)gaps;
+        spin_unlock(tlm_lock, irq);
+    }
+    return n;
+}
+
+// Send log message 'id'
+int tlm_log(uint16_t id, uint32_t a0, uint32_t a1, uint32_t a2) {
+    tlm_log_t l;
+    l.id = id;
+    l.rsvd = 0;
+    l.arg[0] = a0;
+    l.arg[1] = a1;
+    l.arg[2] = a2;
+    return tlm_put(TLM_REC_LOG, &l);
+}
+
+// Send a key event
+int tlm_key(char key) {
+    tlm_key_t k;
+    memset(&k, 0, sizeof(k));
+    k.key = (uint8_t)key;
+    return tlm_put(TLM_REC_KEY, &k);
+}
+
+// records dropped so far
+uint32_t tlm_get_drops(void) {
+    return tlm_drops + tlm_c1_drops;
+}
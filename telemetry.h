@@ -0,0 +1,43 @@
+/******************************************************************************
+ * Telemetry
+ *
+ * Binary telemetry on the console UART (TLM_UART), in place of printf. The
+ * producers (ISRs on either core and the main loop) copy fixed size records
+ * (telemetry_rec.h) into a ring; DMA sends them out behind the CPU. A
+ * producer never waits on the UART: with the ring full the record is
+ * dropped, which the host sees as a gap in the sequence numbers.
+ *
+ * Telemetry belongs to core0. Core1's records are handed over through a
+ * lock-free ring of their own and queued by the main loop (tlm_poll), so
+ * the control path never waits on core0.
+ *
+ */
+
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+#include "pico/stdlib.h"
+#include <telemetry_rec.h>
+
+// Setup the UART, its DMA channel and the ring, send the HELLO record.
+// Call before any producer is started.
+int tlm_init(void);
+
+// Send a record of 'type' with TLM_PAYLOAD_LEN bytes of 'payload'. ISR safe,
+// either core. returns 0 := queued, 1 := dropped (ring full / not started)
+int tlm_put(uint8_t type, const void * payload);
+
+// Main loop: queue the records handed over by core1 (EV_TLM).
+// Returns the number queued.
+int tlm_poll(void);
+
+// Send log message 'id' (TLM_LOG_xxx), unused arguments are ignored
+int tlm_log(uint16_t id, uint32_t a0, uint32_t a1, uint32_t a2);
+
+// Send a key event
+int tlm_key(char key);
+
+// records dropped so far
+uint32_t tlm_get_drops(void);
+
+#endif /* _TELEMETRY_H_ */
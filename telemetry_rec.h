@@ -0,0 +1,266 @@
+/******************************************************************************
+ * Telemetry Records
+ *
+ * Wire format of the telemetry stream on the console UART, shared with the
+ * host side (simulation, decoder tool): plain C, no SDK headers.
+ *
+ * Every record is TLM_REC_LEN bytes, little endian:
+ *
+ *   0  sync    TLM_SYNC
+ *   1  type    TLM_REC_xxx
+ *   2  seq     +1 per record sent, a gap := records dropped (ring full)
+ *   3  crc     CRC-8 (poly 0x07, init 0) over bytes 0 .. 2 and 4 .. 23
+ *   4  t_us    time_us_32() when the record was made
+ *   8  payload TLM_PAYLOAD_LEN bytes, by type
+ *
+ * Debug log messages are sent as an ID and up to three 32 bit arguments,
+ * the text is only formatted on the host (TLM_LOG_IDS). printf style
+ * conversions %c %d %i %u %x %X with optional flags, width and 'l', no %s.
+ * New IDs go at the end of their group, an ID never changes meaning.
+ *
+ * Profile records (profile.h) carry the cycle counts of one profiled code
+ * path (TLM_PRF_IDS) over the last profile window.
+ *
+ * Deadline records (deadline.h) carry the lateness of one periodic task
+ * (TLM_DL_TASKS) over the last deadline window.
+ *
+ * Ack, state and preset records answer the command lines received on the
+ * console UART (command.h).
+ *
+ */
+
+#ifndef _TELEMETRY_REC_H_
+#define _TELEMETRY_REC_H_
+
+#include <stdint.h>
+
+#define TLM_SYNC            0xA5
+#define TLM_REC_LEN         24
+#define TLM_PAYLOAD_LEN     16
+#define TLM_CRC_OFS         3
+
+// record types
+#define TLM_REC_HELLO       1   /* sent once at start up */
+#define TLM_REC_SAMPLE      2   /* temperature controller, every mains half-cycle */
+#define TLM_REC_KEY         3   /* key passed to the menu operations */
+#define TLM_REC_PSU         4   /* analog PSU rail fault */
+#define TLM_REC_LOG         5   /* debug log message */
+#define TLM_REC_PROF        6   /* profiled code path, every profile window */
+#define TLM_REC_DEADLINE    7   /* periodic task lateness, every deadline window */
+#define TLM_REC_ACK         8   /* command line done */
+#define TLM_REC_STATE       9   /* station state, on request ('?') */
+#define TLM_REC_PRESETS     10  /* temperature presets, on request ('?') */
+
+// sample flags
+#define TLM_SF_FRESH        0x01    /* new tip reading this half-cycle */
+#define TLM_SF_BOOST        0x02    /* boost on */
+#define TLM_SF_OPEN_LOOP    0x04    /* fixed power (tuning) */
+#define TLM_SF_SBY_SHIFT    4       /* bits 4..5 standby state SBY_xxx */
+#define TLM_SF_SBY_MASK     0x30
+
+typedef struct tlm_hello_type {
+    uint8_t  ver_maj;
+    uint8_t  ver_min;
+    uint8_t  ver_rev;
+    uint8_t  rec_len;       // TLM_REC_LEN
+    uint32_t baud;
+    uint32_t log_ids;       // TLM_LOG_COUNT
+    uint32_t sys_khz;       // processor clock [kHz], profile cycles
+} tlm_hello_t;
+
+typedef struct tlm_sample_type {
+    int32_t  temp;          // tip [cdeg C], INT32_MAX := open
+    int32_t  setpoint;      // operator setpoint [cdeg C], 0 := heater off
+    uint16_t power;         // controller request [W]
+    uint8_t  fault;         // TC_FAULT_xxx
+    uint8_t  flags;         // TLM_SF_xxx
+    uint32_t fired;         // running count of fired half-cycles
+} tlm_sample_t;
+
+typedef struct tlm_key_type {
+    uint8_t  key;
+    uint8_t  rsvd[15];
+} tlm_key_t;
+
+typedef struct tlm_psu_type {
+    uint8_t  rail;          // APC_RAIL_xxx, 0 := +16V
+    uint8_t  fault;
+    uint16_t rsvd;
+    uint32_t fault_ms;      // fault time since boot [msec]
+    uint32_t cycles;        // regulator cycles
+    uint32_t max_over_us;   // longest time above the threshold [usec]
+} tlm_psu_t;
+
+typedef struct tlm_log_type {
+    uint16_t id;            // TLM_LOG_xxx
+    uint16_t rsvd;
+    uint32_t arg[3];
+} tlm_log_t;
+
+typedef struct tlm_prof_type {
+    uint8_t  id;            // TLM_PRF_xxx
+    uint8_t  core;          // core it last ran on
+    uint16_t count;         // calls in the window, saturated
+    uint32_t min;           // [cycles]
+    uint32_t max;           // [cycles]
+    uint32_t mean;          // [cycles]
+} tlm_prof_t;
+
+typedef struct tlm_deadline_type {
+    uint8_t  task;          // TLM_DL_xxx
+    uint8_t  shed;          // shed level at the end of the window
+    uint16_t missed;        // runs past the deadline in the window, saturated
+    uint32_t max_late_us;
+    uint8_t  hist[8];       // runs by lateness, bin 0 < 16 us, bin i < 16 << i us, saturated
+} tlm_deadline_t;
+
+// command errors
+#define TLM_CMD_OK          0
+#define TLM_CMD_ERR_SYNTAX  1   /* unknown command, bad argument */
+#define TLM_CMD_ERR_RANGE   2   /* value out of range */
+#define TLM_CMD_ERR_REFUSED 3   /* the operation did not take (e.g. an unset preset) */
+#define TLM_CMD_ERR_LONG    4   /* line too long or receive overrun, not run */
+
+typedef struct tlm_ack_type {
+    uint16_t line;          // command lines received, 1 := first
+    uint8_t  done;          // commands run
+    uint8_t  failed;        // failing command, 1 := first, 0 := all ok
+    uint8_t  error;         // TLM_CMD_xxx of the failing command
+    uint8_t  rsvd[3];
+    uint32_t exec_us;       // line run time
+    uint32_t rx_drops;      // received bytes dropped so far
+} tlm_ack_t;
+
+typedef struct tlm_state_type {
+    uint16_t setpoint;      // in 'scale'
+    int16_t  tip;           // measured, in 'scale', INT16_MIN := open
+    uint16_t power;         // delivered [W]
+    uint16_t sleep_dly;     // [sec]
+    uint8_t  scale;         // 'C' | 'F'
+    uint8_t  preset;        // 'A' .. 'D', ' ' := set manually
+    uint8_t  wake;          // 1 := woken (manual sleep / wake)
+    uint8_t  sby;           // standby state
+    uint8_t  fault;         // controller fault
+    uint8_t  psu_fault;     // 1 := analog PSU fault latched
+    uint8_t  boost;         // boost time left [sec]
+    uint8_t  rsvd;
+} tlm_state_t;
+
+typedef struct tlm_presets_type {
+    uint16_t temp[4];       // 'A' .. 'D' in 'scale', 0 := unset
+    uint8_t  tuned;         // bit n := preset n has a tuned model
+    uint8_t  scale;         // 'C' | 'F'
+    uint8_t  rsvd[6];
+} tlm_presets_t;
+
+typedef struct tlm_rec_type {
+    uint8_t  sync;
+    uint8_t  type;
+    uint8_t  seq;
+    uint8_t  crc;
+    uint32_t t_us;
+    union {
+        uint8_t        raw[TLM_PAYLOAD_LEN];
+        tlm_hello_t    hello;
+        tlm_sample_t   sample;
+        tlm_key_t      key;
+        tlm_psu_t      psu;
+        tlm_log_t      log;
+        tlm_prof_t     prof;
+        tlm_deadline_t deadline;
+        tlm_ack_t      ack;
+        tlm_state_t    state;
+        tlm_presets_t  presets;
+    } u;
+} tlm_rec_t;
+
+// log message IDs and their text
+#define TLM_LOG_IDS(X) \
+    X(TLM_LOG_OPS_RESET,            "[ops_poll()] resetting operations") \
+    X(TLM_LOG_APC_NOT_RUNNING,      "[Analog PSU VMon] monitoring task did not start!") \
+    X(TLM_LOG_SBY_ACTIVE,           "[standby] active") \
+    X(TLM_LOG_SBY_STANDBY,          "[standby] standby") \
+    X(TLM_LOG_SBY_SLEEP,            "[standby] sleep") \
+    X(TLM_LOG_ENERGY_MANUAL,        "[energy] session %lu mWh, manual %lu mWh") \
+    X(TLM_LOG_ENERGY_PRESET,        "[energy] session %lu mWh, preset %c %lu mWh") \
+    X(TLM_LOG_BOOST_END,            "[boost] ended, budget left %lu J") \
+    X(TLM_LOG_AT_STEP,              "[autotune] T0 %ld cdeg, P0 %lu mW, step %lu mW") \
+    X(TLM_LOG_AT_MODEL,             "[autotune] K %u cdeg/W, tau %lu ms, L %u ms") \
+    X(TLM_LOG_TS_SET,               "*** [sf_ts_invoke] * Set Temp [%c] = %u, idx[%u]") \
+    X(TLM_LOG_TS_CLEARED,           "*** [sf_ts_wt_vals] * Setting [%c] CLEARED/UNSET, idx[%u]") \
+    X(TLM_LOG_TS_CANCEL,            "*** [sf_ts_wt_vals] * Operation Cancelled") \
+    X(TLM_LOG_SCALE_C,              "*** [sf_sset_chk_scale] * Set Scale :: Celcius") \
+    X(TLM_LOG_SCALE_F,              "*** [sf_sset_chk_scale] * Set Scale :: Farenheit") \
+    X(TLM_LOG_SCALE_INVALID,        "*** [sf_sset_chk_scale] * Set Scale :: INVALID KEY (ignored)") \
+    X(TLM_LOG_SLPDLY_SET,           "*** [sf_slpdly_invoke] * Sleep delay = %u") \
+    X(TLM_LOG_SLPDLY_DEFAULT,       "*** [sf_slpdly_wt_vals] * Sleep Delay RESET TO DEFAULT") \
+    X(TLM_LOG_SLPDLY_CANCEL,        "*** [sf_slpdly_wt_vals] * Operation Cancelled") \
+    X(TLM_LOG_SLEEP,                "*** [sw_isWoken] * going to sleep") \
+    X(TLM_LOG_WAKE,                 "*** [sw_isWoken] * waking up") \
+    X(TLM_LOG_TUNE_NO_PRESET,       "*** [sf_tune] * select a preset to tune first") \
+    X(TLM_LOG_TUNE_START,           "*** [sf_tune] * tuning preset [%c] at T=[%u]") \
+    X(TLM_LOG_TUNE_REFUSED,         "*** [sf_tune] * tuning refused (asleep, in the cradle or faulted)") \
+    X(TLM_LOG_BOOST_STOP,           "*** [sf_boost] * boost stopped") \
+    X(TLM_LOG_BOOST_START,          "*** [sf_boost] * boost +%u C for %u s, budget %u J") \
+    X(TLM_LOG_BOOST_REFUSED,        "*** [sf_boost] * boost refused (asleep, in the cradle or budget %u J used up)") \
+    X(TLM_LOG_PRESET_CHECK,         "*** [sf_selectPreset] * Checking preset index[%u]...") \
+    X(TLM_LOG_PRESET_SELECT,        "*** [sf_selectPreset] * Changing temp preset to Setting [%c] T=[%u]") \
+    X(TLM_LOG_PRESET_SELECT_TUNED,  "*** [sf_selectPreset] * Changing temp preset to Setting [%c] T=[%u] (tuned)") \
+    X(TLM_LOG_PRESET_INVALID,       "*** [sf_selectPreset] * Preset not SET or selection invalid.") \
+    X(TLM_LOG_TEMP_DEC,             "*** [sf_dec_temp] * manual temp change to [%u]") \
+    X(TLM_LOG_TEMP_INC,             "*** [sf_inc_temp] * manual temp change to [%u]") \
+    X(TLM_LOG_MENU_INVALID,         "*** [sf_menu_chk] * Invalid key, ignored: %c") \
+    X(TLM_LOG_TUNE_DONE,            "*** [ops_tune_done] * preset [%c] tuned") \
+    X(TLM_LOG_TUNE_CANCELLED,       "*** [ops_tune_done] * tuning cancelled") \
+    X(TLM_LOG_TUNE_FAILED,          "*** [ops_tune_done] * tuning failed") \
+    X(TLM_LOG_DL_SHED,              "[deadline] shed level %u (last late half-cycle %lu us)") \
+    X(TLM_LOG_SST_FAIL,             "[settings] flash write failed (%u in a row), retry in %lu ms") \
+    X(TLM_LOG_FX_DIGS,              "[fx_bench] digs_to_val: pow %lu cycles, fx_digs_to_u32 %lu cycles") \
+    X(TLM_LOG_FX_STRFLEN,           "[fx_bench] i_to_strflen: pow %lu cycles, fx_u32_to_strflen %lu cycles") \
+    X(TLM_LOG_FX_PERCENT,           "[fx_bench] pwr_percent: float %lu cycles, fx_percent %lu cycles") \
+    X(TLM_LOG_FX_BAR,               "[fx_bench] pwr bar length: float %lu cycles, fx_scale %lu cycles")
+
+#define TLM_LOG_ENUM(id, fmt)   id,
+enum tlm_log_id {
+    TLM_LOG_IDS(TLM_LOG_ENUM)
+    TLM_LOG_COUNT
+};
+#undef TLM_LOG_ENUM
+
+// profiled code paths, with the name on the diagnostics screen (7 chars)
+#define TLM_PRF_IDS(X) \
+    X(TLM_PRF_GPIO_CALLBACK,    "gpio_callback",    "gpio_cb") \
+    X(TLM_PRF_CHK_THRESHOLDS,   "chk_thresholds",   "chk_thr") \
+    X(TLM_PRF_APC_PIO_ISR,      "apc_pio_isr",      "apc_pio") \
+    X(TLM_PRF_CHK_KEYBOARD,     "chk_keyboard",     "chk_kbd") \
+    X(TLM_PRF_KPS_RX_ISR,       "kps_rx_isr",       "kps_rx") \
+    X(TLM_PRF_ZC_ISR,           "zc_isr",           "zc_isr") \
+    X(TLM_PRF_OPS_POLL,         "ops_poll",         "ops") \
+    X(TLM_PRF_DISP_REFRESH,     "disp_refresh",     "disp_rf") \
+    X(TLM_PRF_DISP_RENDER,      "render",           "render") \
+    X(TLM_PRF_LEDO_REFRESH,     "ledo_refresh",     "ledo_rf") \
+    X(TLM_PRF_TW_ISR,           "tw_alarm_isr",     "tw_isr") \
+    X(TLM_PRF_TW_ISR1,          "tw_alarm_isr1",    "tw_isr1")
+
+#define TLM_PRF_ENUM(id, name, abbr)    id,
+enum tlm_prf_id {
+    TLM_PRF_IDS(TLM_PRF_ENUM)
+    TLM_PRF_COUNT
+};
+#undef TLM_PRF_ENUM
+
+// periodic tasks watched by the deadline monitor
+#define TLM_DL_TASKS(X) \
+    X(TLM_DL_ZC,        "zc") \
+    X(TLM_DL_PSU,       "psu_scan") \
+    X(TLM_DL_KEYPAD,    "keypad_scan") \
+    X(TLM_DL_FRAME,     "frame")
+
+#define TLM_DL_ENUM(id, name)   id,
+enum tlm_dl_task {
+    TLM_DL_TASKS(TLM_DL_ENUM)
+    TLM_DL_COUNT
+};
+#undef TLM_DL_ENUM
+
+#endif /* _TELEMETRY_REC_H_ */
@@ -0,0 +1,450 @@
+/******************************************************************************
+ * Tip Temperature Controller
+ *
+ * Runs once per mains half-cycle (100/120 Hz) inside the heater engine's
+ * zero-crossing ISR, ahead of the firing decision. The loop is updated on
+ * every fresh tip reading (each half-cycle the heater was off), the power
+ * request is held in between:
+ *
+ *   tip temp --> ramped reference --> PID + feedforward --> htr_set_power()
+ *
+ * - The operator's setpoint is not applied as a step. An internal reference
+ *   ramps toward it at 'ramp' C/s, which the heater can actually follow.
+ * - Feedforward: the holding power for the reference temperature
+ *   (kff * (ref - ambient)) plus the energy to move the tip along the ramp
+ *   (kc * d(ref)/dt). During a setpoint change the feedforward does the
+ *   heating and the PID only corrects the model error, so heat-up runs at
+ *   full power without winding up the integrator or overshooting.
+ * - Derivative on measurement (low-pass filtered), so setpoint changes do
+ *   not kick the output.
+ * - Anti-windup: the integrator is frozen while the output is saturated in
+ *   the direction of the error, and clamped to the output range.
+ * - Boost: the setpoint is raised by BOOST_TEMP_C for up to BOOST_TIME_S.
+ *   Every fired half-cycle of a boost is taken out of an energy budget
+ *   (nominal IRON_MAX_WATT * half-cycle), which refills at BOOST_RECHARGE_W
+ *   in between; an empty budget ends the boost early, so a heavy load
+ *   cannot hold the cartridge at full power for long.
+ * - Standby (standby.c): in the cradle the setpoint is capped, asleep it is
+ *   0. A wake boost (iron lifted) skips the ramp once: the reference goes
+ *   straight to the setpoint and the heater runs flat out until the PID
+ *   brings it back in, the ramp is for the operator's changes, not for
+ *   someone waiting to solder.
+ *
+ * Every half-cycle ends with a TLM_REC_SAMPLE telemetry record (1 in
+ * DL_TLM_THIN while the deadline monitor sheds telemetry, deadline.h).
+ *
+ * The loop runs on core1 (rt_core.h). The operator's settings, the gains,
+ * the open loop power and the boost requests come from the main loop in
+ * rt_ctl_t; the state goes back in rt_meas_t, published every half-cycle
+ * before the events that tell the main loop to look at it. The core0 API
+ * below (setters, getters, boost) works on those two records only.
+ *
+ * All arithmetic is integer (centi-degrees, milliwatts, microseconds).
+ *
+ */
+
+#include <temp_ctrl.h>
+#include <rt_core.h>
+#include <tip_temp.h>
+#include <heater_ctrl.h>
+#include <operations.h>
+#include <standby.h>
+#include <board.h>
+#include <events.h>
+#include <telemetry.h>
+#include <deadline.h>
+
+// default gains, a JBC C245 style cartridge
+#define TC_KP_DEFAULT       25000   /* [mW / C] */
+#define TC_KI_DEFAULT       4000    /* [mW / (C * s)] */
+#define TC_KD_DEFAULT       1000    /* [mW * s / C] */
+#define TC_KFF_DEFAULT      62      /* [mW / C], ~16 C/W to ambient */
+#define TC_KC_DEFAULT       3000    /* [mJ / C] */
+#define TC_RAMP_DEFAULT     50      /* [C / s] */
+
+#define TC_OUT_MAX_MW       ((int64_t)IRON_MAX_WATT * 1000)
+#define TC_DT_DEFAULT_US    10000   /* until the mains period is measured */
+#define TC_DFILT_SHIFT      2       /* derivative low-pass, alpha = 1/4 */
+#define TC_TRIP_HYST_CDEG   TT_CDEG(10)
+#define TC_STALE_MAX        (4 * (HTR_MEAS_GAP_MAX + 1))  /* half-cycles without a reading := fault */
+
+static volatile bool     tc_running = false;
+static volatile int32_t  tc_temp = TT_TEMP_OPEN;    // measured
+static volatile int32_t  tc_sp = 0;                 // target setpoint, 0 := off
+static volatile uint32_t tc_power = 0;              // [W]
+static volatile int      tc_fault = TC_FAULT_NONE;
+static bool              tc_active = false;         // loop state is valid (heating)
+static int32_t           ref = 0;                   // ramped reference [cdeg C]
+static int32_t           meas_prev = 0;
+static int64_t           integ = 0;                 // integrator [mW * 1e8]
+static int64_t           d_filt = 0;                // filtered derivative term [mW]
+static int64_t           dt_acc = 0;                // time since the last reading [usec]
+static uint32_t          stale = 0;                 // half-cycles since the last reading
+static volatile bool     wake_boost = false;        // skip the ramp on the next step
+static volatile bool     boost_on = false;
+static volatile uint32_t boost_left_us = 0;
+static volatile int32_t  boost_budget = BOOST_BUDGET_J * 1000;  // [mJ]
+static uint32_t          boost_req = 0;             // rt_ctl_t boost requests taken
+static bool              tc_fresh = false;          // reading this half-cycle
+static uint32_t          tc_ev = 0;                 // events to post once published
+
+#define INTEG_SCALE         100000000ll             /* C->cdeg (100) * s->usec (1e6) */
+
+// operator setpoint in cdeg C, capped in standby, 0 when the iron is put
+// to sleep (manually or by the standby timer)
+static int32_t operator_setpoint(const rt_ctl_t * c) {
+    int32_t sp;
+    int sby = sby_get_state();
+    if (!c->awake || sby == SBY_SLEEP) {
+        return 0;
+    }
+    sp = c->sp_cdeg;
+    if (boost_on) {
+        sp += TT_CDEG(BOOST_TEMP_C);
+    }
+    if (sp > tt_scale_to_cdeg(IRON_MAX_TEMP, 'F')) {
+        sp = tt_scale_to_cdeg(IRON_MAX_TEMP, 'F');
+    }
+    if (sby == SBY_STANDBY && sp > TT_CDEG(IRON_STANDBY_TEMP_C)) {
+        sp = TT_CDEG(IRON_STANDBY_TEMP_C);
+    }
+    return (sp > 0) ? sp : 0;
+}
+
+static void loop_reset(int32_t meas) {
+    tc_active = false;
+    dt_acc = 0;
+    ref = meas;
+    meas_prev = meas;
+    integ = 0;
+    d_filt = 0;
+}
+
+static int64_t clamp64(int64_t v, int64_t lo, int64_t hi) {
+    return (v < lo) ? lo : ((v > hi) ? hi : v);
+}
+
+// a boost may start: the iron awake and lifted, the controller on, not
+// faulted nor in open loop, at least BOOST_MIN_J in the budget
+static bool boost_ok(const rt_ctl_t * c) {
+    return tc_running && tc_fault == TC_FAULT_NONE && c->open_loop_w < 0 && c->awake &&
+           sby_get_state() == SBY_ACTIVE && boost_budget >= BOOST_MIN_J * 1000;
+}
+
+// take a start / stop request from the main loop. A start refused here
+// (the state changed since tc_boost_start() checked) ends it at once.
+static void boost_request(const rt_ctl_t * c) {
+    if (c->boost_req == boost_req) {
+        return;
+    }
+    boost_req = c->boost_req;
+    if (c->boost_on && boost_ok(c)) {
+        boost_left_us = BOOST_TIME_S * 1000000u;
+        boost_on = true;
+    } else {
+        if (c->boost_on) {
+            tc_ev |= EV_BOOST;
+        }
+        boost_on = false;
+        boost_left_us = 0;
+    }
+}
+
+// boost time and energy budget, every half-cycle. The heater gate still
+// shows the half-cycle that just ended.
+static void boost_step(const rt_ctl_t * c, uint32_t hc_us) {
+    boost_request(c);
+    if (boost_on) {
+        if (htr_is_firing()) {
+            boost_budget -= (int32_t)(IRON_MAX_WATT * hc_us / 1000);
+        }
+        boost_left_us = (boost_left_us > hc_us) ? boost_left_us - hc_us : 0;
+        if (boost_left_us == 0 || boost_budget <= 0 || tc_fault != TC_FAULT_NONE ||
+            !c->awake || sby_get_state() != SBY_ACTIVE) {
+            boost_on = false;
+            boost_left_us = 0;
+            tc_ev |= EV_BOOST;
+        }
+    } else if (boost_budget < BOOST_BUDGET_J * 1000) {
+        boost_budget += (int32_t)(BOOST_RECHARGE_W * hc_us / 1000);
+        if (boost_budget > BOOST_BUDGET_J * 1000) {
+            boost_budget = BOOST_BUDGET_J * 1000;
+        }
+    }
+}
+
+// one controller step, every half-cycle
+static void tc_control(uint32_t halfcycle_us) {
+    int64_t dt, err, p, d, ff, u;
+    int32_t ref_prev, step;
+    const rt_ctl_t * c = rt_ctl();
+    const tc_gains_t * g = &c->gains;
+    int32_t meas = tc_temp;
+    int32_t sp = operator_setpoint(c);
+    bool fresh = tt_collect(&meas);
+    tc_fresh = fresh;
+    tc_temp = meas;
+    tc_sp = sp;
+    if (fresh) {
+        tc_ev |= EV_ADC;
+    }
+    dt_acc += halfcycle_us ? halfcycle_us : TC_DT_DEFAULT_US;
+    boost_step(c, halfcycle_us ? halfcycle_us : TC_DT_DEFAULT_US);
+    stale = fresh ? 0 : stale + 1;
+    if (!tc_running) {
+        dt_acc = 0;
+        return;
+    }
+    // safety first
+    if (stale > TC_STALE_MAX) {
+        tc_fault = TC_FAULT_STALE;
+    } else if (!fresh) {
+        // hold the last request until the next reading (unless tripped)
+        if (tc_fault != TC_FAULT_NONE || sp == 0) {
+            htr_set_power(0);
+            tc_power = 0;
+        }
+        return;
+    } else if (meas == TT_TEMP_OPEN) {
+        tc_fault = TC_FAULT_OPEN;
+    } else if (meas > TT_CDEG(IRON_TRIP_TEMP_C)) {
+        tc_fault = TC_FAULT_OVERTEMP;
+    } else if (tc_fault == TC_FAULT_OPEN || tc_fault == TC_FAULT_STALE ||
+              (tc_fault == TC_FAULT_OVERTEMP && meas < TT_CDEG(IRON_TRIP_TEMP_C) - TC_TRIP_HYST_CDEG)) {
+        tc_fault = TC_FAULT_NONE;
+    }
+    dt = dt_acc;
+    dt_acc = 0;
+    if (tc_fault != TC_FAULT_NONE || sp == 0) {
+        htr_set_power(0);
+        tc_power = 0;
+        loop_reset(meas);
+        wake_boost = false;
+        return;
+    }
+    if (c->open_loop_w >= 0) {
+        // fixed power (tuning), the loop restarts bumpless afterwards
+        loop_reset(meas);
+        tc_power = (uint32_t)c->open_loop_w;
+        htr_set_power(tc_power);
+        return;
+    }
+    if (!tc_active) {
+        loop_reset(meas); // bumpless start from the current tip temp
+        tc_active = true;
+    }
+    // ramp the reference toward the setpoint, or jump on a wake boost
+    ref_prev = ref;
+    step = (int32_t)(TT_CDEG(g->ramp) * dt / 1000000);
+    if (wake_boost) {
+        wake_boost = false;
+        ref = sp;
+    } else if (sp > ref) {
+        ref = (sp - ref > step) ? ref + step : sp;
+    } else if (sp < ref) {
+        ref = (ref - sp > step) ? ref - step : sp;
+    }
+    // feedforward: hold power at 'ref' + energy to follow the ramp
+    ff = (ref > TT_CDEG(ADC_TEMP_CJ_DEGC)) ? (int64_t)g->kff * (ref - TT_CDEG(ADC_TEMP_CJ_DEGC)) / 100 : 0;
+    ff += (int64_t)g->kc * (ref - ref_prev) * 10000 / dt;   // mJ/C * cdeg/us -> mW
+    // PID
+    err = ref - meas;
+    p = (int64_t)g->kp * err / 100;
+    d = -(int64_t)g->kd * (meas - meas_prev) * 10000 / dt; // mW*s/C * cdeg/us -> mW
+    d_filt += (d - d_filt) >> TC_DFILT_SHIFT;
+    meas_prev = meas;
+    u = p + integ / INTEG_SCALE + d_filt + ff;
+    // integrate unless saturated in the direction of the error
+    if (!((u >= TC_OUT_MAX_MW && err > 0) || (u <= 0 && err < 0))) {
+        integ += (int64_t)g->ki * err * dt;
+        integ = clamp64(integ, -TC_OUT_MAX_MW * INTEG_SCALE, TC_OUT_MAX_MW * INTEG_SCALE);
+    }
+    u = clamp64(u, 0, TC_OUT_MAX_MW);
+    tc_power = (uint32_t)((u + 500) / 1000);
+    htr_set_power(tc_power);
+}
+
+// the controller state for the main loop
+static void tc_publish(void) {
+    rt_meas_t m;
+    int32_t b = boost_budget;
+    m.temp = tc_temp;
+    m.setpoint = tc_sp;
+    m.power = tc_power;
+    m.boost_left_ms = boost_left_us / 1000;
+    m.boost_budget_j = (b > 0) ? (uint32_t)b / 1000 : 0;
+    m.boost_req = boost_req;
+    m.fault = (uint8_t)tc_fault;
+    m.running = tc_running;
+    m.boost = boost_on;
+    rt_meas_put(&m);
+}
+
+/* ISR Routine - runs from the heater engine ZC hook (core1) */
+static void tc_zc_step(uint32_t halfcycle_us) {
+    static uint32_t thin = 0;
+    tlm_sample_t s;
+    tc_control(halfcycle_us);
+    tc_publish();
+    if (tc_ev) {
+        ev_post(tc_ev); // the main loop reads the state just published
+        tc_ev = 0;
+    }
+    if (dl_is_shed(DL_SHED_TLM) && (++thin % DL_TLM_THIN) != 0) {
+        return; // shedding load, 1 in DL_TLM_THIN samples
+    }
+    s.temp = tc_temp;
+    s.setpoint = tc_sp;
+    s.power = (uint16_t)tc_power;
+    s.fault = (uint8_t)tc_fault;
+    s.flags = (uint8_t)((tc_fresh ? TLM_SF_FRESH : 0) | (boost_on ? TLM_SF_BOOST : 0) |
+                        (rt_ctl()->open_loop_w >= 0 ? TLM_SF_OPEN_LOOP : 0) | (sby_get_state() << TLM_SF_SBY_SHIFT));
+    htr_get_counts(NULL, &s.fired);
+    tlm_put(TLM_REC_SAMPLE, &s);
+}
+
+// Setup the controller and attach it to the heater engine's half-cycle hook.
+int tc_init(void) {
+    tc_running = false;
+    tc_fault = TC_FAULT_NONE;
+    loop_reset(0);
+    tc_publish();
+    return htr_set_zc_hook(tc_zc_step);
+}
+
+// Enable closed loop control
+int tc_enable(void) {
+    int rc = 1;
+    if (!tc_running) {
+        tc_active = false;
+        tc_running = true;
+        tc_publish();
+        rc = 0;
+    }
+    return rc;
+}
+
+// is the controller running ?
+bool tc_is_running(void) {
+    return rt_meas()->running;
+}
+
+// Disable closed loop control, heater power request set to 0.
+int tc_disable(void) {
+    int rc = 1;
+    if (tc_running) {
+        tc_running = false;
+        htr_set_power(0);
+        tc_power = 0;
+        tc_publish();
+        rc = 0;
+    }
+    return rc;
+}
+
+// gains go to core1 in one piece with the rest of rt_ctl_t
+void tc_set_gains(const tc_gains_t * g) {
+    if (g) {
+        rt_ctl_edit()->gains = *g;
+        rt_ctl_commit();
+    }
+}
+
+void tc_get_default_gains(tc_gains_t * g) {
+    if (g) {
+        g->kp = TC_KP_DEFAULT;
+        g->ki = TC_KI_DEFAULT;
+        g->kd = TC_KD_DEFAULT;
+        g->kff = TC_KFF_DEFAULT;
+        g->kc = TC_KC_DEFAULT;
+        g->ramp = TC_RAMP_DEFAULT;
+    }
+}
+
+void tc_get_gains(tc_gains_t * g) {
+    if (g) {
+        *g = rt_ctl_edit()->gains;
+    }
+}
+
+// Skip the setpoint ramp once, on the next reading. ISR safe (core1).
+void tc_wake_boost(void) {
+    wake_boost = true;
+}
+
+// true while a boost request has not been taken by core1 yet
+static bool boost_pending(void) {
+    return rt_ctl_edit()->boost_req != rt_meas()->boost_req;
+}
+
+// Start a boost, refused (1) with the iron asleep / in the cradle, the
+// controller off, faulted or in open loop, or less than BOOST_MIN_J in the
+// budget. Checked here on the last half-cycle's state, and again by core1
+// when it takes the request (EV_BOOST if it refuses after all).
+int tc_boost_start(void) {
+    const rt_meas_t * m = rt_meas();
+    rt_ctl_t * c = rt_ctl_edit();
+    if (!m->running || m->fault != TC_FAULT_NONE || c->open_loop_w >= 0 || !get_wakeStatus() ||
+        sby_get_state() != SBY_ACTIVE || m->boost_budget_j < BOOST_MIN_J) {
+        return 1;
+    }
+    c->boost_req ++;
+    c->boost_on = true;
+    rt_ctl_commit();
+    return 0;
+}
+
+// End a boost early
+int tc_boost_stop(void) {
+    rt_ctl_t * c = rt_ctl_edit();
+    if (!tc_boost_active()) {
+        return 1;
+    }
+    c->boost_req ++;
+    c->boost_on = false;
+    rt_ctl_commit();
+    return 0;
+}
+
+// Fixed heater power instead of the PID (system identification), -1 :=
+// back to closed loop. Faults, sleep and standby still turn the heater off.
+int tc_set_open_loop(int32_t watts) {
+    if (watts > IRON_MAX_WATT) {
+        return 1;
+    }
+    rt_ctl_edit()->open_loop_w = (watts < 0) ? -1 : watts;
+    rt_ctl_commit();
+    return 0;
+}
+
+// a request core1 has not taken yet counts as done
+bool tc_boost_active(void) {
+    return boost_pending() ? rt_ctl_edit()->boost_on : rt_meas()->boost;
+}
+
+uint32_t tc_get_boost_left_ms(void) {
+    if (boost_pending()) {
+        return rt_ctl_edit()->boost_on ? BOOST_TIME_S * 1000u : 0;
+    }
+    return rt_meas()->boost_left_ms;
+}
+
+uint32_t tc_get_boost_budget_j(void) {
+    return rt_meas()->boost_budget_j;
+}
+
+int32_t tc_get_temp(void) {
+    return rt_meas()->temp;
+}
+
+int32_t tc_get_setpoint(void) {
+    return rt_meas()->setpoint;
+}
+
+uint32_t tc_get_power(void) {
+    return rt_meas()->power;
+}
+
+int tc_get_fault(void) {
+    return rt_meas()->fault;
+}
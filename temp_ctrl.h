@@ -0,0 +1,81 @@
+/******************************************************************************
+ * Tip Temperature Controller
+ *
+ * Closed loop PID controller, run on every mains half-cycle from the heater
+ * engine's zero-crossing hook (core1). Tracks the operator's set temperature
+ * (get_tipTempSetting(), handed over by rt_poll()) and requests heater power
+ * through htr_set_power().
+ *
+ * tc_init / tc_enable / tc_disable / tc_wake_boost run on core1, the rest
+ * is the main loop's (core0) side: it goes through rt_core.h, it does not
+ * touch the loop state.
+ *
+ */
+
+#ifndef _TEMP_CTRL_H_
+#define _TEMP_CTRL_H_
+
+#include "pico/stdlib.h"
+
+// Controller gains. Temperatures in deg. C, power in mW.
+typedef struct tc_gains_type {
+    int32_t kp;     // proportional         [mW / C]
+    int32_t ki;     // integral             [mW / (C * s)]
+    int32_t kd;     // derivative (on meas) [mW * s / C]
+    int32_t kff;    // holding power feedforward, above ambient [mW / C]
+    int32_t kc;     // setpoint ramp feedforward, tip heat capacity [mJ / C]
+    int32_t ramp;   // setpoint ramp rate limit [C / s]
+} tc_gains_t;
+
+// fault codes
+#define TC_FAULT_NONE       0
+#define TC_FAULT_OPEN       1   /* thermocouple open */
+#define TC_FAULT_OVERTEMP   2   /* above IRON_TRIP_TEMP_C */
+#define TC_FAULT_STALE      3   /* no tip reading for too long */
+
+// Setup the controller and attach it to the heater engine's half-cycle hook.
+// Requires htr_init() and tt_init() first.
+int tc_init(void);
+
+// Enable closed loop control
+int tc_enable(void);
+
+// is the controller running ?
+bool tc_is_running(void);
+
+// Disable closed loop control, heater power request set to 0.
+int tc_disable(void);
+
+// gains
+void tc_set_gains(const tc_gains_t * g);
+void tc_get_gains(tc_gains_t * g);
+void tc_get_default_gains(tc_gains_t * g);  // built in (untuned) gains
+
+// Iron lifted from standby / sleep: on the next reading the reference goes
+// straight to the setpoint (no ramp), the heater runs flat out to get there.
+// ISR safe.
+void tc_wake_boost(void);
+
+// Fixed heater power request instead of the PID, for system identification.
+// Faults, sleep and standby still turn the heater off. 'watts' < 0 := back
+// to closed loop (bumpless). returns 1 if above IRON_MAX_WATT.
+int tc_set_open_loop(int32_t watts);
+
+// Boost: setpoint + BOOST_TEMP_C for BOOST_TIME_S, ended early when the
+// energy budget (BOOST_BUDGET_J, refilled at BOOST_RECHARGE_W while not
+// boosting) runs out or the iron is put down / to sleep. Posts EV_BOOST
+// when it ends by itself.
+// start returns 0 := boosting, 1 := refused (see temp_ctrl.c)
+int      tc_boost_start(void);
+int      tc_boost_stop(void);           // 0 := stopped, 1 := was not boosting
+bool     tc_boost_active(void);
+uint32_t tc_get_boost_left_ms(void);    // time left, 0 := not boosting
+uint32_t tc_get_boost_budget_j(void);   // energy budget left [J]
+
+// Getters (values from the last half-cycle)
+int32_t  tc_get_temp(void);         // measured tip temp [cdeg C]
+int32_t  tc_get_setpoint(void);     // target (before ramping) [cdeg C], 0 := heater off
+uint32_t tc_get_power(void);        // requested heater power [W]
+int      tc_get_fault(void);        // TC_FAULT_xxx
+
+#endif /* _TEMP_CTRL_H_ */
@@ -0,0 +1,259 @@
+/******************************************************************************
+ * Timer Wheel
+ *
+ * A fixed table of TW_TASK_MAX slots, each with its due time on the 64 bit
+ * microsecond timer (no wrap to handle). With a handful of tasks a scan of
+ * the table is cheaper than keeping it sorted, so every change re-scans it
+ * for the earliest due time and moves the alarm there.
+ *
+ * Each core has its own alarm, its own table and its own hardware spin lock
+ * (which also masks the local interrupts): a task belongs to the core that
+ * added it (task id / TW_TASK_MAX) and the alarm of that core runs it. As
+ * long as each core only starts its own tasks, as all modules do, the
+ * cores never wait on each other's lock; starting a task of the other core
+ * works, it takes that core's lock. The alarm ISR takes the lock only to
+ * pick the next task and book its next run, the task itself runs unlocked
+ * so it can re-start itself or start others.
+ *
+ */
+
+#include <timer_wheel.h>
+#include <profile.h>
+#include "hardware/timer.h"
+#include "hardware/sync.h"
+#include <pico/time.h>
+
+#define TW_IDLE UINT64_MAX
+
+typedef struct tw_task_type {
+    tw_fn    fn;                // NULL := slot free
+    void *   ctx;
+    uint8_t  prio;
+    uint32_t period_us;         // 0 := one-shot
+    uint64_t due;               // TW_IDLE := stopped
+} tw_task_t;
+
+// per core
+static tw_task_t      tw_task[2][TW_TASK_MAX];
+static spin_lock_t *  tw_lock[2] = { NULL, NULL };
+static int            tw_alarm[2] = { -1, -1 };
+static uint64_t       tw_armed[2] = { TW_IDLE, TW_IDLE }; // the alarm's target
+static tw_stats_t     tw_st[2];
+
+// lock held: move the alarm of 'core' to its earliest due task, true if
+// that is already past (the alarm is then not set)
+static bool tw_arm(uint core) {
+    uint64_t next = TW_IDLE;
+    int i;
+    for (i = 0 ; i < TW_TASK_MAX ; i++) {
+        if (tw_task[core][i].fn && tw_task[core][i].due < next) {
+            next = tw_task[core][i].due;
+        }
+    }
+    if (next == tw_armed[core]) {
+        return false;
+    }
+    tw_armed[core] = next;
+    if (next == TW_IDLE) {
+        hardware_alarm_cancel(tw_alarm[core]);
+        return false;
+    }
+    if (hardware_alarm_set_target(tw_alarm[core], from_us_since_boot(next))) {
+        tw_armed[core] = TW_IDLE;
+        return true;
+    }
+    return false;
+}
+
+// lock held: the task of 'core' to run next, by priority / due / slot, -1
+// if none
+static int tw_pick(uint core, uint64_t now) {
+    tw_task_t * t;
+    int i, sel = -1;
+    for (i = 0 ; i < TW_TASK_MAX ; i++) {
+        t = &tw_task[core][i];
+        if (!t->fn || t->due == TW_IDLE || t->due > now + TW_SLACK_US) {
+            continue;
+        }
+        if (sel < 0 || t->prio < tw_task[core][sel].prio
+            || (t->prio == tw_task[core][sel].prio && t->due < tw_task[core][sel].due)) {
+            sel = i;
+        }
+    }
+    return sel;
+}
+
+/* ISR Routine - the alarm of this core, runs its tasks due */
+static void tw_alarm_isr(uint alarm_num) {
+    tw_task_t * t;
+    uint64_t now;
+    uint32_t irq, late, skip;
+    uint core = get_core_num();
+    tw_stats_t * st = &tw_st[core];
+    int sel;
+    bool ran = false;
+    PRF_MARK(m);
+    st->irqs ++;
+    tw_armed[core] = TW_IDLE; // fired (or forced), no longer set
+    while (1) {
+        irq = spin_lock_blocking(tw_lock[core]);
+        now = time_us_64();
+        sel = tw_pick(core, now);
+        if (sel < 0) {
+            if (!tw_arm(core)) {
+                spin_unlock(tw_lock[core], irq);
+                break;
+            }
+            spin_unlock(tw_lock[core], irq);
+            continue; // next one came due meanwhile
+        }
+        t = &tw_task[core][sel];
+        late = (now > t->due) ? (uint32_t)(now - t->due) : 0;
+        if (t->period_us) {
+            t->due += t->period_us;
+            if (t->due <= now) {
+                skip = (uint32_t)((now - t->due) / t->period_us) + 1;
+                t->due += (uint64_t)skip * t->period_us;
+                st->skipped += skip;
+            }
+        } else {
+            t->due = TW_IDLE;
+        }
+        spin_unlock(tw_lock[core], irq);
+        if (late > st->max_late_us) {
+            st->max_late_us = late;
+        }
+        st->runs ++;
+        ran = true;
+        t->fn(t->ctx);
+    }
+    if (!ran) {
+        st->idle ++;
+    }
+    PRF_END(core ? TLM_PRF_TW_ISR1 : TLM_PRF_TW_ISR, m); // one writer per path
+}
+
+// Claim the lock and the hardware alarm of the calling core (its IRQ is
+// enabled on the core that sets the callback).
+int tw_init(void) {
+    uint core = get_core_num();
+    uint32_t irq;
+    int i;
+    if (!tw_lock[core]) {
+        tw_lock[core] = spin_lock_init(spin_lock_claim_unused(true));
+    }
+    if (tw_alarm[core] < 0) {
+        tw_alarm[core] = hardware_alarm_claim_unused(true);
+        hardware_alarm_set_callback(tw_alarm[core], tw_alarm_isr);
+    }
+    irq = spin_lock_blocking(tw_lock[core]);
+    for (i = 0 ; i < TW_TASK_MAX ; i++) {
+        tw_task[core][i].fn = NULL;
+        tw_task[core][i].due = TW_IDLE;
+    }
+    tw_armed[core] = TW_IDLE;
+    hardware_alarm_cancel(tw_alarm[core]);
+    tw_st[core] = (tw_stats_t){ 0 };
+    spin_unlock(tw_lock[core], irq);
+    return 0;
+}
+
+// Add a task (stopped) run by the calling core's alarm, returns its id or
+// -1 if TW_TASK_MAX are in use
+int tw_add(tw_fn fn, void * ctx, uint8_t prio) {
+    uint core = get_core_num();
+    tw_task_t * t;
+    uint32_t irq;
+    int i, id = -1;
+    if (!tw_lock[core] || tw_alarm[core] < 0 || !fn) {
+        return -1;
+    }
+    irq = spin_lock_blocking(tw_lock[core]);
+    for (i = 0 ; i < TW_TASK_MAX ; i++) {
+        t = &tw_task[core][i];
+        if (!t->fn) {
+            t->ctx = ctx;
+            t->prio = prio;
+            t->period_us = 0;
+            t->due = TW_IDLE;
+            t->fn = fn;
+            tw_st[core].tasks ++;
+            id = (int)core * TW_TASK_MAX + i;
+            break;
+        }
+    }
+    spin_unlock(tw_lock[core], irq);
+    return id;
+}
+
+// task 'id', NULL if not in use
+static tw_task_t * tw_get(int id) {
+    tw_task_t * t;
+    if (id < 0 || id >= 2 * TW_TASK_MAX) {
+        return NULL;
+    }
+    t = &tw_task[id / TW_TASK_MAX][id % TW_TASK_MAX];
+    return t->fn ? t : NULL;
+}
+
+// (re)book task 'id' for 'due', 'period_us' 0 := one-shot
+static int tw_start(int id, uint32_t period_us, uint64_t due) {
+    tw_task_t * t = tw_get(id);
+    uint core = (uint)id / TW_TASK_MAX;
+    uint32_t irq;
+    bool past;
+    if (!t) {
+        return 1;
+    }
+    irq = spin_lock_blocking(tw_lock[core]);
+    t->period_us = period_us;
+    t->due = due;
+    past = tw_arm(core);
+    spin_unlock(tw_lock[core], irq);
+    if (past) {
+        hardware_alarm_force_irq(tw_alarm[core]); // taken on the task's core
+    }
+    return 0;
+}
+
+// Run task 'id' every 'period_us', first on the next multiple of the period
+int tw_start_periodic(int id, uint32_t period_us) {
+    uint64_t now = time_us_64();
+    if (!period_us) {
+        return 1;
+    }
+    return tw_start(id, period_us, (now / period_us + 1) * period_us);
+}
+
+// Run task 'id' once, 'delay_us' from now (moved if already pending)
+int tw_start_once(int id, uint64_t delay_us) {
+    return tw_start(id, 0, time_us_64() + delay_us);
+}
+
+// Stop task 'id', a pending run is dropped
+int tw_stop(int id) {
+    return tw_start(id, 0, TW_IDLE);
+}
+
+// true while task 'id' is started (periodic) or pending (one-shot)
+bool tw_is_pending(int id) {
+    tw_task_t * t = tw_get(id);
+    return (t && t->due != TW_IDLE);
+}
+
+// Totals since tw_init, both cores, 0 := ok
+int tw_get_stats(tw_stats_t * st) {
+    if (!tw_lock[0] && !tw_lock[1]) {
+        return 1;
+    }
+    *st = tw_st[0];
+    st->irqs += tw_st[1].irqs;
+    st->runs += tw_st[1].runs;
+    st->idle += tw_st[1].idle;
+    st->skipped += tw_st[1].skipped;
+    st->tasks += tw_st[1].tasks;
+    if (tw_st[1].max_late_us > st->max_late_us) {
+        st->max_late_us = tw_st[1].max_late_us;
+    }
+    return 0;
+}
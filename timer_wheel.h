@@ -0,0 +1,77 @@
+/******************************************************************************
+ * Timer Wheel
+ *
+ * One scheduler per core, each on its own hardware alarm (claimed by
+ * tw_init on that core), for all the timed tasks, in place of a repeating
+ * timer / pool alarm per module. A task is added once (tw_add) and then
+ * started as
+ *
+ *   periodic   tw_start_periodic(id, period): runs every 'period' usec, on
+ *              multiples of the period since boot, so tasks of related
+ *              periods (10 / 20 msec) come due together. A run more than a
+ *              period late skips the periods missed, it does not catch up.
+ *   one-shot   tw_start_once(id, delay): runs once, 'delay' usec from now.
+ *              Starting it again while pending moves it (a watchdog is
+ *              kicked by re-starting it). A task may re-start itself from
+ *              its own run.
+ *
+ * The alarm is set for the earliest task due. Its ISR runs every task due
+ * by then (or within TW_SLACK_US after), one at a time, the highest
+ * priority first, then the earliest due, then the first added: the order
+ * is fixed whatever the interrupt latency was. Tasks run in the alarm ISR
+ * of the core that added them (the control tasks on core1, the keypad scan
+ * on core0), they must be short and must not block.
+ *
+ * Each core has its own table and lock, a core starting its own tasks
+ * never waits on the other. Safe to call from thread code and ISRs, either
+ * core.
+ *
+ */
+
+#ifndef _TIMER_WHEEL_H_
+#define _TIMER_WHEEL_H_
+
+#include <board.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// task priorities, the lower the sooner it runs when tasks fall due together
+#define TW_PRIO_HIGH    0   /* safety, power stage */
+#define TW_PRIO_NORMAL  1
+#define TW_PRIO_LOW     2   /* user interface */
+
+typedef void (*tw_fn)(void * ctx);
+
+typedef struct tw_stats_type {
+    uint32_t irqs;          // alarm interrupts taken
+    uint32_t runs;          // task runs, more than irqs when runs share one
+    uint32_t idle;          // interrupts with nothing due (forced / raced)
+    uint32_t skipped;       // periods skipped, a periodic task ran late
+    uint32_t max_late_us;   // latest run after its due time
+    uint32_t tasks;         // added
+} tw_stats_t;
+
+// Claim the lock and the hardware alarm of the calling core. Call on each
+// core before it adds a task.
+int tw_init(void);
+
+// Add a task (stopped) run by the calling core's alarm, returns its id or
+// -1 if TW_TASK_MAX are in use
+int tw_add(tw_fn fn, void * ctx, uint8_t prio);
+
+// Run task 'id' every 'period_us', first on the next multiple of the period
+int tw_start_periodic(int id, uint32_t period_us);
+
+// Run task 'id' once, 'delay_us' from now (moved if already pending)
+int tw_start_once(int id, uint64_t delay_us);
+
+// Stop task 'id', a pending run is dropped
+int tw_stop(int id);
+
+// true while task 'id' is started (periodic) or pending (one-shot)
+bool tw_is_pending(int id);
+
+// Totals since tw_init, both cores, 0 := ok
+int tw_get_stats(tw_stats_t * st);
+
+#endif /* _TIMER_WHEEL_H_ */
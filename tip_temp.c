@@ -0,0 +1,122 @@
+/******************************************************************************
+ * Tip Temperature Measurement
+ * 
+ * Samples the tip thermocouple amplifier on ADC_TEMP and converts the 
+ * reading to temperature.
+ * 
+ * The board has no cold junction sensor, ADC_TEMP_CJ_DEGC is assumed. The
+ * amplifier is linear with ADC full-scale := ADC_TEMP_FS_DEGC above the 
+ * cold junction.
+ * 
+ * Sampling pipeline, no CPU work per conversion:
+ * 
+ *  ZC --> heater off this half-cycle ? --> ADC free-running @ ADC_TEMP_SAMPLE_HZ
+ *     --> ADC FIFO --> DMA --> window buffer (ADC_TEMP_WINDOW conversions)
+ *  next ZC --> stop, average the window (less the first ADC_TEMP_SETTLE) 
+ *     --> one reading per clean half-cycle
+ * 
+ * The thermocouple signal is swamped while the heater conducts, so a window
+ * is only opened on half-cycles the heater engine leaves off (it never fires
+ * more than HTR_MEAS_GAP_MAX in a row, bounding the reading latency). The DMA
+ * writes through a ring the size of the window buffer so it can never run
+ * past it.
+ * 
+ */
+
+#include <tip_temp.h>
+#include <heater_ctrl.h>
+#include <board.h>
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+
+#define ADC_FS_COUNTS   4096
+#define ADC_CLK_HZ      48000000
+#define WINDOW_BYTES    (ADC_TEMP_WINDOW * sizeof(uint16_t))
+
+static uint16_t win_buf[ADC_TEMP_WINDOW] __attribute__((aligned(ADC_TEMP_WINDOW * 2)));
+static int              win_dma = -1;
+static volatile bool    win_open = false;
+static volatile int32_t tt_last = TT_TEMP_OPEN;
+
+/* ISR Routine - heater engine gate hook, runs after every ZC firing decision */
+static void tt_window(bool fired) {
+    if (fired) {
+        return; // no clean signal this half-cycle
+    }
+    adc_run(false);
+    adc_fifo_drain();
+    dma_channel_set_write_addr(win_dma, win_buf, false);
+    dma_channel_set_trans_count(win_dma, ADC_TEMP_WINDOW, true);
+    adc_run(true);
+    win_open = true;
+}
+
+// Setup the ADC for the tip thermocouple, and the DMA window capture.
+int tt_init(void) {
+    dma_channel_config c;
+    adc_init();
+    adc_gpio_init(ADC_TEMP);
+    adc_select_input(ADC_TEMP_CHAN);
+    adc_fifo_setup(true, true, 1, false, false); // FIFO on, DREQ at 1 sample
+    adc_set_clkdiv((float)(ADC_CLK_HZ / ADC_TEMP_SAMPLE_HZ - 1));
+    win_dma = dma_claim_unused_channel(true);
+    c = dma_channel_get_default_config(win_dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, __builtin_ctz(WINDOW_BYTES));
+    channel_config_set_dreq(&c, DREQ_ADC);
+    dma_channel_configure(win_dma, &c, win_buf, &adc_hw->fifo, ADC_TEMP_WINDOW, false);
+    return htr_set_gate_hook(tt_window);
+}
+
+// convert an averaged raw reading of 'n' conversions
+static int32_t raw_to_cdeg(uint32_t raw_sum, uint32_t n) {
+    if (raw_sum > (uint32_t)ADC_TEMP_OPEN_RAW * n) {
+        return TT_TEMP_OPEN;
+    }
+    return TT_CDEG(ADC_TEMP_CJ_DEGC) + 
+        (int32_t)(((uint64_t)raw_sum * TT_CDEG(ADC_TEMP_FS_DEGC)) / ((uint32_t)ADC_FS_COUNTS * n));
+}
+
+// Close the window of the last half-cycle and decimate it
+bool tt_collect(int32_t * cdeg) {
+    uint32_t n, i, sum = 0;
+    if (!win_open) {
+        return false;
+    }
+    win_open = false;
+    adc_run(false);
+    n = ADC_TEMP_WINDOW - dma_channel_hw_addr(win_dma)->transfer_count;
+    dma_channel_abort(win_dma);
+    if (n <= ADC_TEMP_SETTLE) {
+        return false; // window cut short
+    }
+    for (i = ADC_TEMP_SETTLE ; i < n ; i++) {
+        sum += win_buf[i];
+    }
+    tt_last = raw_to_cdeg(sum, n - ADC_TEMP_SETTLE);
+    if (cdeg) {
+        *cdeg = tt_last;
+    }
+    return true;
+}
+
+// last reading taken
+int32_t tt_get_temp(void) {
+    return tt_last;
+}
+
+int32_t tt_cdeg_to_scale(int32_t cdeg, char scale) {
+    if (scale == 'F') {
+        return (cdeg * 9 / 5 + 3200 + 50) / 100;
+    }
+    return (cdeg + 50) / 100;
+}
+
+int32_t tt_scale_to_cdeg(int32_t t, char scale) {
+    if (scale == 'F') {
+        return (t - 32) * 500 / 9;
+    }
+    return TT_CDEG(t);
+}
@@ -0,0 +1,37 @@
+/******************************************************************************
+ * Tip Temperature Measurement
+ * 
+ * Samples the tip thermocouple amplifier on ADC_TEMP and converts the 
+ * reading to temperature. Temperatures are in centi-degrees Celcius
+ * (1/100 C) throughout the control path.
+ * 
+ */
+
+#ifndef _TIP_TEMP_H_
+#define _TIP_TEMP_H_
+
+#include "pico/stdlib.h"
+
+#define TT_CDEG(c)      ((int32_t)(c) * 100)    /* deg. C to centi-deg. C */
+#define TT_TEMP_OPEN    INT32_MAX               /* thermocouple open / no reading */
+
+// Setup the ADC for the tip thermocouple and the DMA window capture. 
+// Windows are opened from the heater engine after each zero-crossing on
+// which the heater is left off.
+int tt_init(void);
+
+// Close the capture window of the half-cycle just ended and average it.
+// Call at the zero-crossing (from the heater engine's ZC hook). Returns true
+// with a fresh reading in 'cdeg' (tip temp [cdeg C] or TT_TEMP_OPEN), false 
+// if the heater was on for that half-cycle (no reading).
+bool tt_collect(int32_t * cdeg);
+
+// last reading taken [cdeg C] or TT_TEMP_OPEN
+int32_t tt_get_temp(void);
+
+// temperature conversion between centi-deg. C and whole degrees in
+// the user's scale ('C' or 'F')
+int32_t tt_cdeg_to_scale(int32_t cdeg, char scale);
+int32_t tt_scale_to_cdeg(int32_t t, char scale);
+
+#endif /* _TIP_TEMP_H_ */
@@ -0,0 +1,811 @@
+/******************************************************************************
+ * jbc_tlm - telemetry decoder and trace analyzer (host)
+ *
+ * Reads the station's telemetry stream (telemetry_rec.h) from
+ *
+ *  - a serial port (raw, TLM_UART_BAUD by default), until ^C or --time.
+ *    --cmd sends a command line (command.h) first and prints the station's
+ *    answers; without --time it stops at the ack, with no report, and exits
+ *    non-zero if a command failed or no ack came (provisioning scripts)
+ *  - a capture file, e.g. the simulation's --tlm output, or '-' for stdin
+ *  - a simulation trace (--trace CSV, recognized by its header); the tip
+ *    temperature and the heater power of each 10 ms row stand in for the
+ *    samples, a row with heater power counts as a fired half-cycle
+ *
+ * and reports, per setpoint step (a change of the operator setpoint; steps
+ * to 0, heater off, are not analyzed):
+ *
+ *  - reach:      time from the step until the tip is first within +/-band
+ *  - overshoot:  largest excursion past the setpoint after reaching it, in
+ *                the direction of the step
+ *  - settle:     time from the step until the tip stays within +/-band for
+ *                the rest of the step, '-' if it never does
+ *  - duty:       fired half-cycles over all half-cycles of the step, and
+ *                after settling
+ *
+ * and the duty-cycle distribution over 1 s windows (min, mean, p95, max,
+ * share of windows at full power), the hot-path profile (profile records)
+ * and the periodic tasks' lateness (deadline records) over the whole
+ * capture. The samples go to --csv, the summary to --json, log / key / PSU /
+ * profile / deadline records to the console with --log.
+ *
+ */
+
+#include <tlm_decode.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#define DEF_BAUD        921600
+#define DEF_BAND_C      5.0
+#define WIN_US          1000000ull
+#define FULL_DUTY       0.99
+#define TEMP_OPEN       INT32_MAX
+#define ACK_TMOUT_S     2.0
+
+typedef struct smp_type {
+    double   t;         // [sec] station time (since boot / start of the trace)
+    double   temp;      // [C], NAN := open
+    double   sp;        // [C], 0 := heater off
+    double   power;     // [W]
+    uint32_t fired;     // running count of fired half-cycles
+    uint8_t  fault;
+    uint8_t  flags;
+} smp_t;
+
+typedef struct step_type {
+    double   t0, t1;    // [sec]
+    double   sp, from;
+    double   reach;     // [sec] after t0, < 0 := never
+    double   over;      // [C]
+    double   settle;    // [sec] after t0, < 0 := never
+    double   duty;
+    double   duty_settled;  // < 0 := never settled
+    bool     open_loop;
+} step_t;
+
+typedef struct prof_type {
+    uint64_t count;
+    uint64_t sum;       // [cycles]
+    uint32_t min, max;  // [cycles]
+    uint8_t  core;
+} prof_t;
+
+typedef struct dl_type {
+    uint32_t windows;
+    uint64_t runs;
+    uint64_t missed;
+    uint32_t max_late;  // [usec]
+    uint64_t hist[8];   // lateness bins, bin 0 < 16 us, bin i < 16 << i us
+    uint8_t  shed_max;
+} dl_t;
+
+typedef struct duty_stats_type {
+    uint32_t windows;
+    double   min, mean, p95, max;
+    double   full;      // share of windows at FULL_DUTY or more
+    double   overall;
+} duty_stats_t;
+
+static smp_t *   smp = NULL;
+static uint32_t  smp_n = 0, smp_cap = 0;
+static step_t *  steps = NULL;
+static uint32_t  step_n = 0;
+static prof_t    prof[TLM_PRF_COUNT];
+static dl_t      dl[TLM_DL_COUNT];
+static double    cyc_us = 125.0;    // processor clock [MHz], from the hello record
+static double    opt_band = DEF_BAND_C;
+static bool      opt_log = false;
+static bool      cmd_wait = false;  // stop at the command ack
+static int       cmd_rc = -1;       // -1 := no ack yet, else TLM_CMD_xxx
+static volatile sig_atomic_t stop = 0;
+
+static void usage(void) {
+    fprintf(stderr,
+        "usage: jbc_tlm [options] <input>\n"
+        "  input            serial port, telemetry capture file, simulation --trace CSV, or - (stdin)\n"
+        "  --baud n         serial port speed (default %u)\n"
+        "  --time s         stop reading the serial port after s seconds (default: ^C)\n"
+        "  --save file      keep the raw serial stream in file\n"
+        "  --band C         settling band +/-C (default %.1f)\n"
+        "  --csv file       samples as CSV\n"
+        "  --json file      summary as JSON\n"
+        "  --cmd line       send a command line on the serial port, print the answers\n"
+        "                   (stops at the ack unless --time is given)\n"
+        "  --log            print log, key and PSU records\n",
+        DEF_BAUD, DEF_BAND_C);
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+static smp_t * smp_add(void) {
+    if (smp_n == smp_cap) {
+        smp_cap = smp_cap ? smp_cap * 2 : 4096;
+        smp = realloc(smp, smp_cap * sizeof(*smp));
+        if (!smp) {
+            fprintf(stderr, "jbc_tlm: out of memory\n");
+            exit(1);
+        }
+    }
+    return &smp[smp_n++];
+}
+
+// ---- input -----------------------------------------------------------------
+
+// answers to a command line
+static void print_reply(const tlm_rec_t * r, uint64_t t_us) {
+    switch (r->type) {
+    case TLM_REC_ACK:
+        printf("%12.6f  ack    line %u, %u done", t_us * 1e-6, r->u.ack.line, r->u.ack.done);
+        if (r->u.ack.failed) {
+            printf(", command %u failed: %s", r->u.ack.failed, tlm_cmd_err_name(r->u.ack.error));
+        }
+        printf(", %lu us, %lu bytes dropped\n", (unsigned long)r->u.ack.exec_us, (unsigned long)r->u.ack.rx_drops);
+        break;
+    case TLM_REC_STATE:
+        printf("%12.6f  state  set %u %c, tip ", t_us * 1e-6, r->u.state.setpoint, r->u.state.scale);
+        if (r->u.state.tip == INT16_MIN) {
+            printf("open");
+        } else {
+            printf("%d", r->u.state.tip);
+        }
+        printf(", %u W, preset %c, %s, standby %u, sleep delay %u s, boost %u s, fault %u, PSU fault %u\n",
+            r->u.state.power, r->u.state.preset, r->u.state.wake ? "woken" : "asleep", r->u.state.sby,
+            r->u.state.sleep_dly, r->u.state.boost, r->u.state.fault, r->u.state.psu_fault);
+        break;
+    case TLM_REC_PRESETS: {
+        int i;
+        printf("%12.6f  preset", t_us * 1e-6);
+        for (i = 0 ; i < 4 ; i++) {
+            if (r->u.presets.temp[i]) {
+                printf(" %c %u%s", 'A' + i, r->u.presets.temp[i], (r->u.presets.tuned & (1u << i)) ? " (tuned)" : "");
+            } else {
+                printf(" %c unset", 'A' + i);
+            }
+            printf("%s", (i < 3) ? "," : "");
+        }
+        printf(" [%c]\n", r->u.presets.scale);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static void on_record(const tlm_rec_t * r, uint64_t t_us, void * ctx) {
+    char text[160];
+    smp_t * s;
+    (void)ctx;
+    if (r->type == TLM_REC_SAMPLE) {
+        s = smp_add();
+        s->t = (double)t_us * 1e-6;
+        s->temp = (r->u.sample.temp == TEMP_OPEN) ? NAN : r->u.sample.temp / 100.0;
+        s->sp = r->u.sample.setpoint / 100.0;
+        s->power = r->u.sample.power;
+        s->fired = r->u.sample.fired;
+        s->fault = r->u.sample.fault;
+        s->flags = r->u.sample.flags;
+        return;
+    }
+    if (r->type == TLM_REC_HELLO && r->u.hello.sys_khz) {
+        cyc_us = r->u.hello.sys_khz / 1000.0;
+    }
+    if (r->type == TLM_REC_PROF && r->u.prof.id < TLM_PRF_COUNT && r->u.prof.count) {
+        prof_t * p = &prof[r->u.prof.id];
+        if (!p->count || r->u.prof.min < p->min) {
+            p->min = r->u.prof.min;
+        }
+        if (r->u.prof.max > p->max) {
+            p->max = r->u.prof.max;
+        }
+        p->count += r->u.prof.count;
+        p->sum += (uint64_t)r->u.prof.mean * r->u.prof.count;
+        p->core = r->u.prof.core;
+    }
+    if (r->type == TLM_REC_ACK || r->type == TLM_REC_STATE || r->type == TLM_REC_PRESETS) {
+        print_reply(r, t_us);
+        if (r->type == TLM_REC_ACK) {
+            cmd_rc = r->u.ack.error;
+            if (cmd_wait) {
+                stop = 1;
+            }
+        }
+        return;
+    }
+    if (r->type == TLM_REC_DEADLINE && r->u.deadline.task < TLM_DL_COUNT) {
+        dl_t * d = &dl[r->u.deadline.task];
+        int b;
+        d->windows ++;
+        d->missed += r->u.deadline.missed;
+        for (b = 0 ; b < 8 ; b++) {
+            d->hist[b] += r->u.deadline.hist[b];
+            d->runs += r->u.deadline.hist[b];
+        }
+        if (r->u.deadline.max_late_us > d->max_late) {
+            d->max_late = r->u.deadline.max_late_us;
+        }
+        if (r->u.deadline.shed > d->shed_max) {
+            d->shed_max = r->u.deadline.shed;
+        }
+    }
+    if (!opt_log) {
+        return;
+    }
+    switch (r->type) {
+    case TLM_REC_HELLO:
+        printf("%12.6f  hello  v%u.%u.%u, %u byte records, %lu baud, %lu log IDs\n", t_us * 1e-6,
+            r->u.hello.ver_maj, r->u.hello.ver_min, r->u.hello.ver_rev, r->u.hello.rec_len,
+            (unsigned long)r->u.hello.baud, (unsigned long)r->u.hello.log_ids);
+        break;
+    case TLM_REC_KEY:
+        printf("%12.6f  key    %c\n", t_us * 1e-6, r->u.key.key);
+        break;
+    case TLM_REC_PSU:
+        printf("%12.6f  psu    %c16V fault %u @ %lu ms, %lu cycles, max over %lu us\n", t_us * 1e-6,
+            r->u.psu.rail ? '-' : '+', r->u.psu.fault, (unsigned long)r->u.psu.fault_ms,
+            (unsigned long)r->u.psu.cycles, (unsigned long)r->u.psu.max_over_us);
+        break;
+    case TLM_REC_LOG:
+        tlm_log_text(&r->u.log, text, sizeof(text));
+        printf("%12.6f  log    %s\n", t_us * 1e-6, text);
+        break;
+    case TLM_REC_PROF:
+        printf("%12.6f  prof   %-15s core %u, %u calls, min %lu mean %lu max %lu cycles\n", t_us * 1e-6,
+            tlm_prf_name(r->u.prof.id), r->u.prof.core, r->u.prof.count, (unsigned long)r->u.prof.min,
+            (unsigned long)r->u.prof.mean, (unsigned long)r->u.prof.max);
+        break;
+    case TLM_REC_DEADLINE:
+        printf("%12.6f  dl     %-15s shed %u, missed %u, max late %lu us, hist %u %u %u %u %u %u %u %u\n",
+            t_us * 1e-6, tlm_dl_name(r->u.deadline.task), r->u.deadline.shed, r->u.deadline.missed,
+            (unsigned long)r->u.deadline.max_late_us, r->u.deadline.hist[0], r->u.deadline.hist[1],
+            r->u.deadline.hist[2], r->u.deadline.hist[3], r->u.deadline.hist[4], r->u.deadline.hist[5],
+            r->u.deadline.hist[6], r->u.deadline.hist[7]);
+        break;
+    default:
+        printf("%12.6f  type %u\n", t_us * 1e-6, r->type);
+        break;
+    }
+}
+
+static speed_t baud_code(unsigned baud) {
+    switch (baud) {
+    case 115200:  return B115200;
+    case 230400:  return B230400;
+    case 460800:  return B460800;
+    case 921600:  return B921600;
+    case 1000000: return B1000000;
+    case 2000000: return B2000000;
+    default:      return 0;
+    }
+}
+
+static int serial_open(const char * path, unsigned baud) {
+    struct termios tio;
+    speed_t sp = baud_code(baud);
+    int fd;
+    if (!sp) {
+        fprintf(stderr, "jbc_tlm: unsupported baud rate %u\n", baud);
+        return -1;
+    }
+    fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        fprintf(stderr, "jbc_tlm: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (tcgetattr(fd, &tio)) {
+        fprintf(stderr, "jbc_tlm: %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 1;
+    cfsetispeed(&tio, sp);
+    cfsetospeed(&tio, sp);
+    if (tcsetattr(fd, TCSANOW, &tio)) {
+        fprintf(stderr, "jbc_tlm: %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    tcflush(fd, TCIFLUSH);
+    return fd;
+}
+
+// serial port until ^C or 'secs'
+static void read_serial(int fd, tlm_dec_t * d, FILE * save, double secs) {
+    uint8_t buf[4096];
+    struct timeval t0, t;
+    ssize_t n;
+    gettimeofday(&t0, NULL);
+    while (!stop) {
+        n = read(fd, buf, sizeof(buf)); // returns 0 on the VTIME timeout
+        if (n < 0 && errno != EINTR) {
+            fprintf(stderr, "jbc_tlm: read: %s\n", strerror(errno));
+            break;
+        }
+        if (n > 0) {
+            if (save) {
+                fwrite(buf, 1, (size_t)n, save);
+            }
+            tlm_dec_bytes(d, buf, (size_t)n);
+        }
+        gettimeofday(&t, NULL);
+        if (secs > 0 && (t.tv_sec - t0.tv_sec) + (t.tv_usec - t0.tv_usec) * 1e-6 >= secs) {
+            break;
+        }
+    }
+}
+
+// capture file to EOF
+static void read_capture(FILE * f, tlm_dec_t * d) {
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        tlm_dec_bytes(d, buf, n);
+    }
+}
+
+// simulation trace: t_s,tip_c,sensor_c,heater_w,meter_w,setpoint_c,loaded,onhook
+static int read_trace(FILE * f) {
+    char line[256];
+    double t, tip, sensor, hw, mw, sp;
+    int loaded, onhook;
+    uint32_t fired = 0;
+    smp_t * s;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%lf,%lf,%lf,%lf,%lf,%lf,%d,%d", &t, &tip, &sensor, &hw, &mw, &sp,
+                   &loaded, &onhook) != 8) {
+            fprintf(stderr, "jbc_tlm: bad trace line: %s", line);
+            return 1;
+        }
+        fired += (hw > 0.0);
+        s = smp_add();
+        s->t = t;
+        s->temp = tip;
+        s->sp = sp;
+        s->power = hw;
+        s->fired = fired;
+        s->fault = 0;
+        s->flags = 0;
+    }
+    return 0;
+}
+
+// ---- analysis --------------------------------------------------------------
+
+// fired half-cycles over the samples [a, b)
+static double duty_of(uint32_t a, uint32_t b) {
+    if (b <= a + 1) {
+        return 0.0;
+    }
+    return (double)(uint32_t)(smp[b - 1].fired - smp[a].fired) / (double)(b - 1 - a);
+}
+
+static void analyze_step(step_t * st, uint32_t a, uint32_t b) {
+    double dir = (st->sp >= st->from) ? 1.0 : -1.0;
+    double dev;
+    uint32_t i, in = 0;
+    bool out = true;
+    // from the first tip reading of the step, else the previous setpoint
+    for (i = a ; i < b && isnan(smp[i].temp) ; i++) {
+    }
+    if (i < b) {
+        st->from = smp[i].temp;
+        dir = (st->sp >= st->from) ? 1.0 : -1.0;
+    }
+    st->t0 = smp[a].t;
+    st->t1 = smp[b - 1].t;
+    st->reach = -1.0;
+    st->settle = -1.0;
+    st->over = 0.0;
+    st->open_loop = false;
+    for (i = a ; i < b ; i++) {
+        st->open_loop |= (smp[i].flags & TLM_SF_OPEN_LOOP) != 0;
+        if (isnan(smp[i].temp)) {
+            out = true;
+            continue;
+        }
+        dev = smp[i].temp - st->sp;
+        if (fabs(dev) <= opt_band) {
+            if (st->reach < 0) {
+                st->reach = smp[i].t - st->t0;
+            }
+            if (out) {
+                in = i;
+                out = false;
+            }
+        } else {
+            out = true;
+        }
+        if (st->reach >= 0 && dev * dir > st->over) {
+            st->over = dev * dir;
+        }
+    }
+    if (!out) {
+        st->settle = smp[in].t - st->t0;
+    }
+    st->duty = duty_of(a, b);
+    st->duty_settled = out ? -1.0 : duty_of(in, b);
+}
+
+static void analyze_steps(void) {
+    uint32_t i, a = 0;
+    double from = 0.0;
+    steps = calloc(smp_n + 1, sizeof(*steps));
+    for (i = 1 ; i <= smp_n ; i++) {
+        if (i < smp_n && smp[i].sp == smp[a].sp) {
+            continue;
+        }
+        if (smp[a].sp > 0) {
+            steps[step_n].sp = smp[a].sp;
+            steps[step_n].from = from;
+            analyze_step(&steps[step_n++], a, i);
+        }
+        from = smp[a].sp;
+        a = i;
+    }
+}
+
+static int cmp_double(const void * a, const void * b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void analyze_duty(duty_stats_t * ds) {
+    double * w;
+    uint32_t i, a = 0, n = 0, full = 0;
+    double sum = 0.0;
+    memset(ds, 0, sizeof(*ds));
+    if (smp_n < 2) {
+        return;
+    }
+    w = malloc(smp_n * sizeof(*w));
+    for (i = 1 ; i < smp_n ; i++) {
+        if ((smp[i].t - smp[a].t) * 1e6 >= (double)WIN_US) {
+            w[n] = duty_of(a, i + 1);
+            sum += w[n];
+            full += (w[n] >= FULL_DUTY);
+            n ++;
+            a = i;
+        }
+    }
+    ds->overall = duty_of(0, smp_n);
+    if (!n) {
+        free(w);
+        return;
+    }
+    qsort(w, n, sizeof(*w), cmp_double);
+    ds->windows = n;
+    ds->min = w[0];
+    ds->max = w[n - 1];
+    ds->mean = sum / n;
+    ds->p95 = w[(uint32_t)ceil(0.95 * n) - 1];
+    ds->full = (double)full / n;
+    free(w);
+}
+
+// ---- output ----------------------------------------------------------------
+
+static void print_secs(double s) {
+    if (s < 0) {
+        printf("%9s", "-");
+    } else {
+        printf("%8.2fs", s);
+    }
+}
+
+static void report(const char * src, const tlm_dec_stats_t * ds, const duty_stats_t * du) {
+    uint32_t i;
+    printf("source     %s\n", src);
+    if (ds) {
+        printf("records    %lu (%lu samples, %lu logs, %lu keys, %lu psu), %lu lost, %lu bad bytes\n",
+            (unsigned long)ds->records, (unsigned long)ds->per_type[TLM_REC_SAMPLE],
+            (unsigned long)ds->per_type[TLM_REC_LOG], (unsigned long)ds->per_type[TLM_REC_KEY],
+            (unsigned long)ds->per_type[TLM_REC_PSU], (unsigned long)ds->lost, (unsigned long)ds->bad);
+    }
+    printf("samples    %lu over %.2f s\n", (unsigned long)smp_n, smp_n ? smp[smp_n - 1].t - smp[0].t : 0.0);
+    printf("\nsteps (band +/-%.1f C)\n", opt_band);
+    printf("    t0      from ->   sp      reach  overshoot    settle   duty  settled\n");
+    for (i = 0 ; i < step_n ; i++) {
+        step_t * s = &steps[i];
+        printf("%8.2fs %6.1f -> %5.1f ", s->t0, s->from, s->sp);
+        print_secs(s->reach);
+        printf("  %7.1f C ", s->over);
+        print_secs(s->settle);
+        printf("  %5.1f%%", s->duty * 100.0);
+        if (s->duty_settled < 0) {
+            printf("        -");
+        } else {
+            printf("   %5.1f%%", s->duty_settled * 100.0);
+        }
+        printf("%s\n", s->open_loop ? "  (open loop)" : "");
+    }
+    printf("\nduty       overall %.1f%%", du->overall * 100.0);
+    if (du->windows) {
+        printf(", 1 s windows: min %.1f%%, mean %.1f%%, p95 %.1f%%, max %.1f%%, %.1f%% at full power",
+            du->min * 100.0, du->mean * 100.0, du->p95 * 100.0, du->max * 100.0, du->full * 100.0);
+    }
+    printf("\n");
+    if (ds && ds->per_type[TLM_REC_PROF]) {
+        printf("\nprofile (cycles, usec at %.0f MHz)\n", cyc_us);
+        printf("  path             core     calls      min     mean      max   max us\n");
+        for (i = 0 ; i < TLM_PRF_COUNT ; i++) {
+            prof_t * p = &prof[i];
+            if (p->count) {
+                printf("  %-15s  %4u %9llu %8lu %8llu %8lu %8.1f\n", tlm_prf_name((uint8_t)i), p->core,
+                    (unsigned long long)p->count, (unsigned long)p->min,
+                    (unsigned long long)(p->sum / p->count), (unsigned long)p->max, p->max / cyc_us);
+            }
+        }
+    }
+    if (ds && ds->per_type[TLM_REC_DEADLINE]) {
+        printf("\ndeadlines (lateness bins: <16 <32 <64 <128 <256 <512 <1024 >=1024 us)\n");
+        printf("  task             runs   missed  max late  shed max  bins\n");
+        for (i = 0 ; i < TLM_DL_COUNT ; i++) {
+            dl_t * d = &dl[i];
+            int b;
+            if (d->windows) {
+                printf("  %-12s %8llu %8llu %6lu us %9u ", tlm_dl_name((uint8_t)i), (unsigned long long)d->runs,
+                    (unsigned long long)d->missed, (unsigned long)d->max_late, d->shed_max);
+                for (b = 0 ; b < 8 ; b++) {
+                    printf(" %llu", (unsigned long long)d->hist[b]);
+                }
+                printf("\n");
+            }
+        }
+    }
+}
+
+static int write_csv(const char * path) {
+    FILE * f = fopen(path, "w");
+    uint32_t i, a = 0;
+    if (!f) {
+        fprintf(stderr, "jbc_tlm: %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    // duty_1s: fired share over the samples of the last second
+    fprintf(f, "t_s,temp_c,setpoint_c,power_w,fired,duty_1s,fault,flags\n");
+    for (i = 0 ; i < smp_n ; i++) {
+        while ((smp[i].t - smp[a].t) * 1e6 > (double)WIN_US) {
+            a ++;
+        }
+        if (isnan(smp[i].temp)) {
+            fprintf(f, "%.6f,,", smp[i].t);
+        } else {
+            fprintf(f, "%.6f,%.2f,", smp[i].t, smp[i].temp);
+        }
+        fprintf(f, "%.2f,%.1f,%lu,%.3f,%u,%u\n", smp[i].sp, smp[i].power,
+            (unsigned long)(i ? smp[i].fired - smp[i - 1].fired : 0), duty_of(a, i + 1),
+            smp[i].fault, smp[i].flags);
+    }
+    fclose(f);
+    return 0;
+}
+
+static void json_num(FILE * f, const char * key, double v, const char * sep) {
+    if (v < 0 || isnan(v)) {
+        fprintf(f, "\"%s\": null%s", key, sep);
+    } else {
+        fprintf(f, "\"%s\": %.4g%s", key, v, sep);
+    }
+}
+
+static int write_json(const char * path, const char * src, const tlm_dec_stats_t * ds,
+                      const duty_stats_t * du) {
+    FILE * f = fopen(path, "w");
+    const char * c;
+    uint32_t i, n;
+    if (!f) {
+        fprintf(stderr, "jbc_tlm: %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    fprintf(f, "{\n  \"source\": \"");
+    for (c = src ; *c ; c++) {
+        fprintf(f, (*c == '"' || *c == '\\') ? "\\%c" : "%c", *c);
+    }
+    fprintf(f, "\",\n");
+    if (ds) {
+        fprintf(f, "  \"records\": {\"total\": %lu, \"samples\": %lu, \"logs\": %lu, \"keys\": %lu, "
+            "\"psu\": %lu, \"lost\": %lu, \"bad_bytes\": %lu},\n",
+            (unsigned long)ds->records, (unsigned long)ds->per_type[TLM_REC_SAMPLE],
+            (unsigned long)ds->per_type[TLM_REC_LOG], (unsigned long)ds->per_type[TLM_REC_KEY],
+            (unsigned long)ds->per_type[TLM_REC_PSU], (unsigned long)ds->lost, (unsigned long)ds->bad);
+    }
+    fprintf(f, "  \"samples\": %lu,\n  \"duration_s\": %.3f,\n  \"band_c\": %.2f,\n  \"steps\": [",
+        (unsigned long)smp_n, smp_n ? smp[smp_n - 1].t - smp[0].t : 0.0, opt_band);
+    for (i = 0 ; i < step_n ; i++) {
+        step_t * s = &steps[i];
+        fprintf(f, "%s\n    {", i ? "," : "");
+        json_num(f, "t0_s", s->t0, ", ");
+        json_num(f, "t1_s", s->t1, ", ");
+        json_num(f, "from_c", s->from, ", ");
+        json_num(f, "setpoint_c", s->sp, ", ");
+        json_num(f, "reach_s", s->reach, ", ");
+        json_num(f, "overshoot_c", s->over, ", ");
+        json_num(f, "settle_s", s->settle, ", ");
+        json_num(f, "duty", s->duty, ", ");
+        json_num(f, "duty_settled", s->duty_settled, ", ");
+        fprintf(f, "\"open_loop\": %s}", s->open_loop ? "true" : "false");
+    }
+    fprintf(f, "%s],\n  \"profile\": [", step_n ? "\n  " : "");
+    for (i = 0, n = 0 ; i < TLM_PRF_COUNT ; i++) {
+        prof_t * p = &prof[i];
+        if (p->count) {
+            fprintf(f, "%s\n    {\"path\": \"%s\", \"core\": %u, \"calls\": %llu, \"min_cycles\": %lu, "
+                "\"mean_cycles\": %llu, \"max_cycles\": %lu}", n++ ? "," : "", tlm_prf_name((uint8_t)i), p->core,
+                (unsigned long long)p->count, (unsigned long)p->min,
+                (unsigned long long)(p->sum / p->count), (unsigned long)p->max);
+        }
+    }
+    fprintf(f, "%s],\n  \"deadlines\": [", n ? "\n  " : "");
+    for (i = 0, n = 0 ; i < TLM_DL_COUNT ; i++) {
+        dl_t * d = &dl[i];
+        int b;
+        if (d->windows) {
+            fprintf(f, "%s\n    {\"task\": \"%s\", \"runs\": %llu, \"missed\": %llu, \"max_late_us\": %lu, "
+                "\"shed_max\": %u, \"hist\": [", n++ ? "," : "", tlm_dl_name((uint8_t)i),
+                (unsigned long long)d->runs, (unsigned long long)d->missed, (unsigned long)d->max_late, d->shed_max);
+            for (b = 0 ; b < 8 ; b++) {
+                fprintf(f, "%s%llu", b ? ", " : "", (unsigned long long)d->hist[b]);
+            }
+            fprintf(f, "]}");
+        }
+    }
+    fprintf(f, "%s],\n  \"sys_mhz\": %.0f,\n  \"duty\": {", n ? "\n  " : "", cyc_us);
+    json_num(f, "overall", du->overall, ", ");
+    fprintf(f, "\"windows\": %lu, ", (unsigned long)du->windows);
+    json_num(f, "min", du->windows ? du->min : -1, ", ");
+    json_num(f, "mean", du->windows ? du->mean : -1, ", ");
+    json_num(f, "p95", du->windows ? du->p95 : -1, ", ");
+    json_num(f, "max", du->windows ? du->max : -1, ", ");
+    json_num(f, "full_share", du->windows ? du->full : -1, "");
+    fprintf(f, "}\n}\n");
+    fclose(f);
+    return 0;
+}
+
+// ---- main ------------------------------------------------------------------
+
+int main(int argc, char ** argv) {
+    const char * in = NULL, * csv = NULL, * json = NULL, * save = NULL, * cmd = NULL;
+    unsigned baud = DEF_BAUD;
+    double secs = 0.0;
+    tlm_dec_t dec;
+    duty_stats_t du;
+    struct stat sb;
+    FILE * f = NULL, * fsave = NULL;
+    char head[8];
+    size_t n;
+    bool is_trace = false;
+    int i, fd, rc = 0;
+
+    for (i = 1 ; i < argc ; i++) {
+        const char * a = argv[i];
+        const char * v = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (!strcmp(a, "--log")) {
+            opt_log = true;
+            continue;
+        }
+        if (a[0] == '-' && a[1] == '-') {
+            if (!v) {
+                usage();
+                return 2;
+            }
+            if (!strcmp(a, "--baud"))       baud = (unsigned)atoi(v);
+            else if (!strcmp(a, "--time"))  secs = atof(v);
+            else if (!strcmp(a, "--save"))  save = v;
+            else if (!strcmp(a, "--band"))  opt_band = atof(v);
+            else if (!strcmp(a, "--csv"))   csv = v;
+            else if (!strcmp(a, "--json"))  json = v;
+            else if (!strcmp(a, "--cmd"))   cmd = v;
+            else {
+                usage();
+                return 2;
+            }
+            i ++;
+        } else if (!in) {
+            in = a;
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (!in) {
+        usage();
+        return 2;
+    }
+
+    tlm_dec_init(&dec, on_record, NULL);
+    if (strcmp(in, "-") && !stat(in, &sb) && S_ISCHR(sb.st_mode)) {
+        // serial port
+        fd = serial_open(in, baud);
+        if (fd < 0) {
+            return 1;
+        }
+        if (save && !(fsave = fopen(save, "wb"))) {
+            fprintf(stderr, "jbc_tlm: %s: %s\n", save, strerror(errno));
+            close(fd);
+            return 1;
+        }
+        signal(SIGINT, on_signal);
+        signal(SIGTERM, on_signal);
+        if (cmd) {
+            if (write(fd, cmd, strlen(cmd)) < 0 || write(fd, "\n", 1) < 0) {
+                fprintf(stderr, "jbc_tlm: write: %s\n", strerror(errno));
+                close(fd);
+                return 1;
+            }
+            cmd_wait = (secs <= 0);
+        }
+        if (cmd_wait) {
+            read_serial(fd, &dec, fsave, ACK_TMOUT_S);
+        } else {
+            fprintf(stderr, "jbc_tlm: reading %s at %u baud, ^C to stop\n", in, baud);
+            read_serial(fd, &dec, fsave, secs);
+        }
+        close(fd);
+        if (fsave) {
+            fclose(fsave);
+        }
+        if (cmd_wait) {
+            if (cmd_rc < 0) {
+                fprintf(stderr, "jbc_tlm: no answer from the station\n");
+            }
+            return (cmd_rc == TLM_CMD_OK) ? 0 : 1;
+        }
+    } else {
+        f = strcmp(in, "-") ? fopen(in, "rb") : stdin;
+        if (!f) {
+            fprintf(stderr, "jbc_tlm: %s: %s\n", in, strerror(errno));
+            return 1;
+        }
+        // a simulation trace starts with its CSV header, telemetry with TLM_SYNC
+        n = fread(head, 1, 4, f);
+        if (n == 4 && !memcmp(head, "t_s,", 4)) {
+            is_trace = true;
+            if (!fgets(head, sizeof(head), f)) {
+                head[0] = '\0';
+            }
+            while (head[0] && !strchr(head, '\n') && fgets(head, sizeof(head), f)) {
+            }
+            rc = read_trace(f);
+        } else {
+            tlm_dec_bytes(&dec, (const uint8_t *)head, n);
+            read_capture(f, &dec);
+        }
+        if (f != stdin) {
+            fclose(f);
+        }
+        if (rc) {
+            return rc;
+        }
+    }
+
+    analyze_steps();
+    analyze_duty(&du);
+    if (opt_log) {
+        printf("\n");
+    }
+    report(in, is_trace ? NULL : &dec.st, &du);
+    if (csv) {
+        rc |= write_csv(csv);
+    }
+    if (json) {
+        rc |= write_json(json, in, is_trace ? NULL : &dec.st, &du);
+    }
+    free(smp);
+    free(steps);
+    return rc;
+}
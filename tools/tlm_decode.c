@@ -0,0 +1,189 @@
+/******************************************************************************
+ * Telemetry Decoder (host)
+ *
+ * See tlm_decode.h. A record is taken once TLM_REC_LEN bytes starting with
+ * TLM_SYNC are in and its CRC matches; on a mismatch the search for the
+ * next record restarts at the next sync byte within the bytes already
+ * taken, so a single corrupted or cut record costs at most that record.
+ *
+ */
+
+#include <tlm_decode.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char * const log_fmt[] = {
+#define TLM_LOG_FMT(id, fmt)    fmt,
+    TLM_LOG_IDS(TLM_LOG_FMT)
+#undef TLM_LOG_FMT
+};
+
+static const char * const prf_name[] = {
+#define TLM_PRF_NAME(id, name, abbr)    name,
+    TLM_PRF_IDS(TLM_PRF_NAME)
+#undef TLM_PRF_NAME
+};
+
+static const char * const dl_name[] = {
+#define TLM_DL_NAME(id, name)   name,
+    TLM_DL_TASKS(TLM_DL_NAME)
+#undef TLM_DL_NAME
+};
+
+void tlm_dec_init(tlm_dec_t * d, tlm_dec_fn fn, void * ctx) {
+    memset(d, 0, sizeof(*d));
+    d->fn = fn;
+    d->ctx = ctx;
+}
+
+uint8_t tlm_rec_crc(const uint8_t * rec) {
+    uint8_t crc = 0;
+    int i, b;
+    for (i = 0 ; i < TLM_REC_LEN ; i++) {
+        if (i == TLM_CRC_OFS) {
+            continue;
+        }
+        crc ^= rec[i];
+        for (b = 0 ; b < 8 ; b++) {
+            crc = (uint8_t)((crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1);
+        }
+    }
+    return crc;
+}
+
+static void dec_record(tlm_dec_t * d) {
+    tlm_rec_t r;
+    memcpy(&r, d->buf, sizeof(r));
+    if (d->have_seq && r.seq != d->seq) {
+        d->st.lost += (uint8_t)(r.seq - d->seq);
+    }
+    d->have_seq = true;
+    d->seq = (uint8_t)(r.seq + 1);
+    if (r.type == TLM_REC_HELLO) {
+        // station restarted: new time base
+        d->have_t = false;
+        d->t_hi = 0;
+    }
+    if (d->have_t && r.t_us < d->t_last) {
+        d->t_hi += 1ull << 32;
+    }
+    d->have_t = true;
+    d->t_last = r.t_us;
+    d->st.records ++;
+    d->st.per_type[(r.type < TLM_DEC_TYPES) ? r.type : 0] ++;
+    if (d->fn) {
+        d->fn(&r, d->t_hi + r.t_us, d->ctx);
+    }
+}
+
+void tlm_dec_byte(tlm_dec_t * d, uint8_t b) {
+    uint32_t i;
+    d->st.bytes ++;
+    if (d->n == 0 && b != TLM_SYNC) {
+        d->st.bad ++;
+        return;
+    }
+    d->buf[d->n++] = b;
+    if (d->n < TLM_REC_LEN) {
+        return;
+    }
+    if (tlm_rec_crc(d->buf) == d->buf[TLM_CRC_OFS]) {
+        dec_record(d);
+        d->n = 0;
+        return;
+    }
+    // resync on the next sync byte in what was taken
+    d->st.bad ++;
+    for (i = 1 ; i < TLM_REC_LEN && d->buf[i] != TLM_SYNC ; i++) {
+    }
+    memmove(d->buf, d->buf + i, TLM_REC_LEN - i);
+    d->n = TLM_REC_LEN - i;
+}
+
+void tlm_dec_bytes(tlm_dec_t * d, const uint8_t * p, size_t len) {
+    while (len--) {
+        tlm_dec_byte(d, *p++);
+    }
+}
+
+// printf style text of a log record, one conversion per argument
+void tlm_log_text(const tlm_log_t * l, char * out, size_t len) {
+    const char * f;
+    char spec[16];
+    size_t o = 0, s;
+    uint32_t v;
+    int a = 0;
+    if (l->id >= TLM_LOG_COUNT) {
+        snprintf(out, len, "[tlm] log id %u (%lu, %lu, %lu)", l->id,
+            (unsigned long)l->arg[0], (unsigned long)l->arg[1], (unsigned long)l->arg[2]);
+        return;
+    }
+    for (f = log_fmt[l->id] ; *f && o + 1 < len ; f++) {
+        if (*f != '%' || f[1] == '%') {
+            out[o++] = *f;
+            f += (*f == '%');
+            continue;
+        }
+        // copy flags / width, drop the length modifiers
+        s = 0;
+        spec[s++] = *f++;
+        while (*f && strchr("-+ #0123456789.", *f) && s < sizeof(spec) - 3) {
+            spec[s++] = *f++;
+        }
+        while (*f == 'l' || *f == 'h') {
+            f++;
+        }
+        if (!*f) {
+            break;
+        }
+        v = (a < 3) ? l->arg[a++] : 0;
+        if (*f == 'c') {
+            spec[s++] = 'c';
+            spec[s] = '\0';
+            o += snprintf(out + o, len - o, spec, (int)v);
+        } else if (*f == 'd' || *f == 'i') {
+            spec[s++] = 'l';
+            spec[s++] = 'd';
+            spec[s] = '\0';
+            o += snprintf(out + o, len - o, spec, (long)(int32_t)v);
+        } else {
+            spec[s++] = 'l';
+            spec[s++] = *f;
+            spec[s] = '\0';
+            o += snprintf(out + o, len - o, spec, (unsigned long)v);
+        }
+        if (o >= len) {
+            o = len - 1;
+        }
+    }
+    out[o] = '\0';
+}
+
+const char * tlm_prf_name(uint8_t id) {
+    return (id < TLM_PRF_COUNT) ? prf_name[id] : "?";
+}
+
+const char * tlm_dl_name(uint8_t task) {
+    return (task < TLM_DL_COUNT) ? dl_name[task] : "?";
+}
+
+const char * tlm_cmd_err_name(uint8_t err) {
+    static const char * const name[] = { "ok", "syntax", "range", "refused", "too long" };
+    return (err < sizeof(name) / sizeof(name[0])) ? name[err] : "?";
+}
+
+const char * tlm_rec_name(uint8_t type) {
+    switch (type) {
+    case TLM_REC_HELLO:  return "hello";
+    case TLM_REC_SAMPLE: return "sample";
+    case TLM_REC_KEY:    return "key";
+    case TLM_REC_PSU:    return "psu";
+    case TLM_REC_LOG:    return "log";
+    case TLM_REC_PROF:   return "prof";
+    case TLM_REC_DEADLINE: return "deadline";
+    case TLM_REC_ACK:    return "ack";
+    case TLM_REC_STATE:  return "state";
+    case TLM_REC_PRESETS: return "presets";
+    default:             return "?";
+    }
+}
@@ -0,0 +1,68 @@
+/******************************************************************************
+ * Telemetry Decoder (host)
+ *
+ * Byte stream to records for the firmware's telemetry (telemetry_rec.h):
+ * framing on TLM_SYNC, CRC-8 check with resync, sequence gaps counted as
+ * lost records, and the text of log records. Used by the simulation's UART
+ * model and by the jbc_tlm tool.
+ *
+ */
+
+#ifndef _TLM_DECODE_H_
+#define _TLM_DECODE_H_
+
+#include <telemetry_rec.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define TLM_DEC_TYPES   16
+
+typedef struct tlm_dec_stats_type {
+    uint64_t bytes;
+    uint32_t records;
+    uint32_t per_type[TLM_DEC_TYPES];   // by TLM_REC_xxx (0 := unknown type)
+    uint32_t lost;          // sequence gaps
+    uint32_t bad;           // bytes skipped resyncing, CRC errors
+} tlm_dec_stats_t;
+
+// called for every good record, 't_us' is the record time unwrapped to 64 bit
+typedef void (*tlm_dec_fn)(const tlm_rec_t * rec, uint64_t t_us, void * ctx);
+
+typedef struct tlm_dec_type {
+    uint8_t         buf[TLM_REC_LEN];
+    uint32_t        n;
+    bool            have_seq;
+    uint8_t         seq;        // next expected
+    bool            have_t;
+    uint32_t        t_last;
+    uint64_t        t_hi;       // wraps of the 32 bit record time
+    tlm_dec_fn      fn;
+    void *          ctx;
+    tlm_dec_stats_t st;
+} tlm_dec_t;
+
+void tlm_dec_init(tlm_dec_t * d, tlm_dec_fn fn, void * ctx);
+
+// feed one / 'len' bytes off the wire
+void tlm_dec_byte(tlm_dec_t * d, uint8_t b);
+void tlm_dec_bytes(tlm_dec_t * d, const uint8_t * p, size_t len);
+
+// CRC-8 of a record as sent (the crc byte itself excluded)
+uint8_t tlm_rec_crc(const uint8_t * rec);
+
+// printf style text of a log record
+void tlm_log_text(const tlm_log_t * log, char * out, size_t len);
+
+// name of a record type, "?" if unknown
+const char * tlm_rec_name(uint8_t type);
+
+// name of a profiled code path (TLM_PRF_xxx), "?" if unknown
+const char * tlm_prf_name(uint8_t id);
+
+// name of a deadline monitored task (TLM_DL_xxx), "?" if unknown
+const char * tlm_dl_name(uint8_t task);
+
+// name of a command error (TLM_CMD_xxx), "?" if unknown
+const char * tlm_cmd_err_name(uint8_t err);
+
+#endif /* _TLM_DECODE_H_ */